@@ -181,6 +181,7 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
         CaretLogInfo("computing " + AString::number(numCacheRows) + " rows at a time, reading rows as needed during processing");
     }
     vector<CaretArray<float> > outRows;
+    vector<int> chunkIndices;
     if (cacheFullInput)
     {
         for (int i = 0; i < numRows; ++i)
@@ -193,6 +194,7 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
         int endrow = startrow + numCacheRows;
         if (endrow > numRows) endrow = numRows;
         outRows.resize(endrow - startrow);
+        chunkIndices.resize(endrow - startrow);
         for (int i = startrow; i < endrow; ++i)
         {
             if (!cacheFullInput)
@@ -203,38 +205,9 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
             {
                 outRows[i - startrow] = CaretArray<float>(numRows);
             }
+            chunkIndices[i - startrow] = i;
         }
-        int curRow = 0;//because we can't trust the order threads hit the critical section
-#pragma omp CARET_PARFOR schedule(dynamic)
-        for (int i = 0; i < numRows; ++i)
-        {
-            float movingRrs;
-            int myrow;
-            const float* movingRow;
-#pragma omp critical
-            {//CiftiFile may explode if we request multiple rows concurrently (needs mutexes), but we should force sequential requests anyway
-                myrow = curRow;//so, manually force it to read sequentially
-                ++curRow;
-                movingRow = getRow(myrow, movingRrs);
-            }
-            for (int j = startrow; j < endrow; ++j)
-            {
-                if (myrow >= startrow && myrow < endrow)//check whether we are in the output memory area
-                {
-                    if (j >= myrow)//if so, only compute one half, and store both places
-                    {
-                        float cacheRrs;
-                        const float* cacheRow = getRow(j, cacheRrs, true);
-                        outRows[j - startrow][myrow] = correlate(movingRow, movingRrs, cacheRow, cacheRrs, fisherZ);
-                        outRows[myrow - startrow][j] = outRows[j - startrow][myrow];
-                    }
-                } else {
-                    float cacheRrs;
-                    const float* cacheRow = getRow(j, cacheRrs, true);
-                    outRows[j - startrow][myrow] = correlate(movingRow, movingRrs, cacheRow, cacheRrs, fisherZ);
-                }
-            }
-        }
+        computeChunk(chunkIndices, outRows, fisherZ);
         for (int i = startrow; i < endrow; ++i)
         {
             myCiftiOut->setRow(outRows[i - startrow], i);
@@ -362,6 +335,7 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
         CaretLogInfo("computing " + AString::number(numCacheRows) + " rows at a time, reading rows as needed during processing");
     }
     vector<CaretArray<float> > outRows;
+    vector<int> chunkIndices;
     if (cacheFullInput)
     {
         for (int i = 0; i < numRows; ++i)
@@ -369,13 +343,12 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
             cacheRow(i);
         }
     }
-    CaretArray<int> indexReverse(numRows, -1);
     for (int startrow = 0; startrow < numSelected; startrow += numCacheRows)
     {
         int endrow = startrow + numCacheRows;
         if (endrow > numSelected) endrow = numSelected;
         outRows.resize(endrow - startrow);
-        int curRow = 0;//because we can't trust the order threads hit the critical section
+        chunkIndices.resize(endrow - startrow);
         for (int i = startrow; i < endrow; ++i)
         {
             if (!cacheFullInput)
@@ -386,42 +359,12 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
             {
                 outRows[i - startrow] = CaretArray<float>(numRows);
             }
-            indexReverse[ciftiIndexList[i].first] = i;
-        }
-#pragma omp CARET_PARFOR schedule(dynamic)
-        for (int i = 0; i < numRows; ++i)
-        {
-            float movingRrs;
-            int myrow;
-            const float* movingRow;
-#pragma omp critical
-            {//CiftiFile may explode if we request multiple rows concurrently (needs mutexes), but we should force sequential requests anyway
-                myrow = curRow;//so, manually force it to read sequentially
-                ++curRow;
-                movingRow = getRow(myrow, movingRrs);
-            }
-            for (int j = startrow; j < endrow; ++j)
-            {
-                if (indexReverse[myrow] != -1)//check if we are on a row that is in the output memory range
-                {
-                    if (indexReverse[myrow] <= j)//if so, only compute one of the elements, then store it both places
-                    {
-                        float cacheRrs;
-                        const float* cacheRow = getRow(ciftiIndexList[j].first, cacheRrs, true);
-                        outRows[j - startrow][myrow] = correlate(movingRow, movingRrs, cacheRow, cacheRrs, fisherZ);
-                        outRows[indexReverse[myrow] - startrow][ciftiIndexList[j].first] = outRows[j - startrow][myrow];
-                    }
-                } else {
-                    float cacheRrs;
-                    const float* cacheRow = getRow(ciftiIndexList[j].first, cacheRrs, true);
-                    outRows[j - startrow][myrow] = correlate(movingRow, movingRrs, cacheRow, cacheRrs, fisherZ);
-                }
-            }
+            chunkIndices[i - startrow] = ciftiIndexList[i].first;
         }
+        computeChunk(chunkIndices, outRows, fisherZ);
         for (int i = startrow; i < endrow; ++i)
         {
             myCiftiOut->setRow(outRows[i - startrow], ciftiIndexList[i].second);
-            indexReverse[ciftiIndexList[i].first] = -1;
         }
         if (!cacheFullInput)
         {
@@ -434,31 +377,113 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
     }
 }
 
-float AlgorithmCiftiCorrelation::correlate(const float* row1, const float& rrs1, const float* row2, const float& rrs2, const bool& fisherZ)
+//dot products of CORR_TILE rows against CORR_TILE rows, reusing each loaded value CORR_TILE times
+//each element is accumulated in column order exactly like a scalar loop, so the output doesn't depend on the tiling
+//the independent accumulators give the compiler straight-line code to vectorize across the tile without reassociating sums
+void AlgorithmCiftiCorrelation::dotTile(const float* const left[CORR_TILE], const float* const right[CORR_TILE], const int& length, double out[CORR_TILE][CORR_TILE])
 {
-    double r;
-    if (row1 == row2)
+    double accum[CORR_TILE][CORR_TILE];
+    for (int a = 0; a < CORR_TILE; ++a)
     {
-        r = 1.0;//short circuit for same row
-    } else {
-        if (m_weightedMode)
+        for (int b = 0; b < CORR_TILE; ++b)
+        {
+            accum[a][b] = 0.0;
+        }
+    }
+    for (int k = 0; k < length; ++k)
+    {
+        float leftVals[CORR_TILE], rightVals[CORR_TILE];
+        for (int a = 0; a < CORR_TILE; ++a)
+        {
+            leftVals[a] = left[a][k];
+            rightVals[a] = right[a][k];
+        }
+        for (int a = 0; a < CORR_TILE; ++a)
         {
-            int numWeights = (int)m_weightIndexes.size();
-            double accum = 0.0;
-            for (int i = 0; i < numWeights; ++i)//because we compacted the data in the row to not include any zero weights
+            for (int b = 0; b < CORR_TILE; ++b)
             {
-                accum += row1[i] * row2[i];//these have already had the weighted row means subtracted out, and weights applied
+                accum[a][b] += leftVals[a] * rightVals[b];
             }
-            r = accum / (rrs1 * rrs2);//as do these
-        } else {
-            double accum = 0.0;
-            for (int i = 0; i < m_numCols; ++i)
+        }
+    }
+    for (int a = 0; a < CORR_TILE; ++a)
+    {
+        for (int b = 0; b < CORR_TILE; ++b)
+        {
+            out[a][b] = accum[a][b];
+        }
+    }
+}
+
+void AlgorithmCiftiCorrelation::computeChunk(const vector<int>& chunkIndices, vector<CaretArray<float> >& outRows, const bool& fisherZ)
+{
+    int numRows = m_inputCifti->getNumberOfRows();
+    int numChunk = (int)chunkIndices.size();
+    int rowLength = (m_weightedMode ? (int)m_weightIndexes.size() : m_numCols);//weighted rows are compacted to not include zero weights
+    vector<const float*> chunkRows(numChunk);
+    vector<float> chunkRrs(numChunk);
+    for (int c = 0; c < numChunk; ++c)
+    {
+        chunkRows[c] = getRow(chunkIndices[c], chunkRrs[c]);
+    }
+    int numPanelRows = numRowsPerPanel();
+    if (numPanelRows > numRows) numPanelRows = numRows;
+    if ((int)m_panelRows.size() < numPanelRows) m_panelRows.resize(numPanelRows);
+    vector<const float*> panelRows(numPanelRows);
+    vector<float> panelRrs(numPanelRows);
+    for (int panelStart = 0; panelStart < numRows; panelStart += numPanelRows)
+    {
+        int panelEnd = panelStart + numPanelRows;
+        if (panelEnd > numRows) panelEnd = numRows;
+        for (int i = panelStart; i < panelEnd; ++i)
+        {//read any uncached rows sequentially before the parallel section, so the compute loop has no critical sections
+            CaretAssertVectorIndex(m_panelRows, i - panelStart);
+            vector<float>& scratch = m_panelRows[i - panelStart];
+            if (m_rowInfo[i].m_cacheIndex == -1 && (int)scratch.size() != m_numCols) scratch.resize(m_numCols);
+            panelRows[i - panelStart] = getRow(i, panelRrs[i - panelStart], scratch.data());
+        }
+        int numPanelTiles = (panelEnd - panelStart + CORR_TILE - 1) / CORR_TILE;
+#pragma omp CARET_PARFOR schedule(dynamic)
+        for (int tile = 0; tile < numPanelTiles; ++tile)
+        {
+            int tileStart = panelStart + tile * CORR_TILE;
+            int tileCount = min((int)CORR_TILE, panelEnd - tileStart);
+            const float* left[CORR_TILE];
+            for (int a = 0; a < CORR_TILE; ++a)
             {
-                accum += row1[i] * row2[i];//these have already had the row means subtracted out
+                left[a] = panelRows[tileStart + min(a, tileCount - 1) - panelStart];//pad partial tiles by repeating the last row
+            }
+            for (int chunkStart = 0; chunkStart < numChunk; chunkStart += CORR_TILE)
+            {
+                int chunkCount = min((int)CORR_TILE, numChunk - chunkStart);
+                const float* right[CORR_TILE];
+                for (int b = 0; b < CORR_TILE; ++b)
+                {
+                    right[b] = chunkRows[chunkStart + min(b, chunkCount - 1)];
+                }
+                double dots[CORR_TILE][CORR_TILE];
+                dotTile(left, right, rowLength, dots);
+                for (int a = 0; a < tileCount; ++a)
+                {
+                    int movingIndex = tileStart + a;
+                    for (int b = 0; b < chunkCount; ++b)
+                    {
+                        int c = chunkStart + b;
+                        if (chunkIndices[c] == movingIndex)
+                        {
+                            outRows[c][movingIndex] = finishCorrelation(1.0, fisherZ);//short circuit for same row
+                        } else {
+                            outRows[c][movingIndex] = finishCorrelation(dots[a][b] / (panelRrs[tileStart + a - panelStart] * chunkRrs[c]), fisherZ);
+                        }
+                    }
+                }
             }
-            r = accum / (rrs1 * rrs2);
         }
     }
+}
+
+float AlgorithmCiftiCorrelation::finishCorrelation(double r, const bool& fisherZ)
+{
     if (fisherZ)
     {
         if (r > 0.999999) r = 0.999999;//prevent inf
@@ -471,6 +496,17 @@ float AlgorithmCiftiCorrelation::correlate(const float* row1, const float& rrs1,
     }
 }
 
+int AlgorithmCiftiCorrelation::numRowsPerPanel()
+{
+    int numRows = m_inputCifti->getNumberOfRows();
+    if (m_cacheUsed >= numRows) return numRows;//everything is cached, panels don't need any scratch memory
+#ifdef CARET_OMP
+    return PANEL_ROWS_PER_THREAD * omp_get_max_threads();
+#else
+    return PANEL_ROWS_PER_THREAD;
+#endif
+}
+
 void AlgorithmCiftiCorrelation::init(const CiftiFile* input, const vector<float>* weights)
 {
     m_inputCifti = input;
@@ -543,7 +579,7 @@ void AlgorithmCiftiCorrelation::clearCache()
     m_cacheUsed = 0;
 }
 
-const float* AlgorithmCiftiCorrelation::getRow(const int& ciftiIndex, float& rootResidSqr, const bool& mustBeCached)
+const float* AlgorithmCiftiCorrelation::getRow(const int& ciftiIndex, float& rootResidSqr, float* scratch)
 {
     float* ret;
     CaretAssertVectorIndex(m_rowInfo, ciftiIndex);
@@ -551,12 +587,12 @@ const float* AlgorithmCiftiCorrelation::getRow(const int& ciftiIndex, float& roo
     {
         ret = m_rowCache[m_rowInfo[ciftiIndex].m_cacheIndex].m_row.data();
     } else {
-        CaretAssert(!mustBeCached);
-        if (mustBeCached)//largely so it doesn't give warning about unused when compiled in release
+        CaretAssert(scratch != NULL);
+        if (scratch == NULL)//largely so it doesn't crash when compiled in release
         {
             throw AlgorithmException("something very bad happened, notify the developers");
         }
-        ret = getTempRow();
+        ret = scratch;
         m_inputCifti->getRow(ret, ciftiIndex);
         if (!m_rowInfo[ciftiIndex].m_haveCalculated)
         {
@@ -654,30 +690,6 @@ void AlgorithmCiftiCorrelation::doSubtract(float* row, const float& mean)
     }
 }
 
-float* AlgorithmCiftiCorrelation::getTempRow()
-{
-#ifdef CARET_OMP
-    int oldsize = (int)m_tempRows.size();
-    int threadNum = omp_get_thread_num();
-    if (threadNum >= oldsize)
-    {
-        m_tempRows.resize(threadNum + 1);
-        for (int i = oldsize; i <= threadNum; ++i)
-        {
-            m_tempRows[i] = CaretArray<float>(m_numCols);
-        }
-    }
-    return m_tempRows[threadNum].getArray();
-#else
-    if (m_tempRows.size() == 0)
-    {
-        m_tempRows.resize(1);
-        m_tempRows[0] = CaretArray<float>(m_numCols);
-    }
-    return m_tempRows[0].getArray();
-#endif
-}
-
 int AlgorithmCiftiCorrelation::numRowsForMem(const float& memLimitGB, bool& cacheFullInput)
 {
     int numRows = m_inputCifti->getNumberOfRows();
@@ -685,9 +697,9 @@ int AlgorithmCiftiCorrelation::numRowsForMem(const float& memLimitGB, bool& cach
     int64_t targetBytes = (int64_t)(memLimitGB * 1024 * 1024 * 1024);
     if (m_inputCifti->isInMemory()) targetBytes -= numRows * m_numCols * 4;//count in-memory input against the total too
 #ifdef CARET_OMP
-    targetBytes -= inrowBytes * omp_get_max_threads();
+    targetBytes -= inrowBytes * PANEL_ROWS_PER_THREAD * omp_get_max_threads();//rows read into panels that aren't a reference to cache
 #else
-    targetBytes -= inrowBytes;//1 row in memory that isn't a reference to cache
+    targetBytes -= inrowBytes * PANEL_ROWS_PER_THREAD;
 #endif
     targetBytes -= numRows * sizeof(RowInfo);//storage for mean, stdev, and info about caching
     int64_t perRowBytes = inrowBytes + outrowBytes;//cache and memory collation for output rows
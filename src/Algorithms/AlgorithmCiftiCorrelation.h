@@ -50,7 +50,7 @@ namespace caret {
         };
         std::vector<CacheRow> m_rowCache;
         std::vector<RowInfo> m_rowInfo;
-        std::vector<CaretArray<float> > m_tempRows;//reuse return values in getRow instead of reallocating
+        std::vector<std::vector<float> > m_panelRows;//scratch for uncached rows read during a pass, reused instead of reallocating
         std::vector<float> m_weights;
         std::vector<int> m_weightIndexes;
         bool m_binaryWeights, m_weightedMode;
@@ -61,9 +61,13 @@ namespace caret {
         void computeRowStats(const float* row, float& mean, float& rootResidSqr);
         void doSubtract(float* row, const float& mean);
         void clearCache();
-        const float* getRow(const int& ciftiIndex, float& rootResidSqr, const bool& mustBeCached = false);
-        float* getTempRow();
-        float correlate(const float* row1, const float& rrs1, const float* row2, const float& rrs2, const bool& fisherZ);
+        const float* getRow(const int& ciftiIndex, float& rootResidSqr, float* scratch = NULL);//scratch is only used if the row isn't cached
+        void computeChunk(const std::vector<int>& chunkIndices, std::vector<CaretArray<float> >& outRows, const bool& fisherZ);
+        static float finishCorrelation(double r, const bool& fisherZ);
+        int numRowsPerPanel();
+        enum { PANEL_ROWS_PER_THREAD = 16 };//uncached rows are read in panels of this many rows per thread, then correlated in parallel
+        enum { CORR_TILE = 4 };//rows per side of a register tile, 4x4 accumulators fit in registers on SSE and up
+        static void dotTile(const float* const left[CORR_TILE], const float* const right[CORR_TILE], const int& length, double out[CORR_TILE][CORR_TILE]);
         void init(const CiftiFile* input, const std::vector<float>* weights);
         int numRowsForMem(const float& memLimitGB, bool& cacheFullInput);
     protected:
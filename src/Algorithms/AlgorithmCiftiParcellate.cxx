@@ -20,6 +20,8 @@
 
 #include "AlgorithmCiftiParcellate.h"
 #include "AlgorithmException.h"
+#include "CaretAssert.h"
+#include "CiftiRowStream.h"
 #include "GiftiLabel.h"
 #include "GiftiLabelTable.h"
 #include <map>
@@ -126,10 +128,13 @@ AlgorithmCiftiParcellate::AlgorithmCiftiParcellate(ProgressObject* myProgObj, co
     if (direction == CiftiXMLOld::ALONG_ROW)
     {
         vector<float> scratchOutRow(numParcels);
+        CiftiRowStream rowStream(myCiftiIn);//reads ahead on other threads
         for (int64_t i = 0; i < numRows; ++i)
         {
             vector<double> scratchAccum(numParcels, 0.0);
-            myCiftiIn->getRow(scratchRow.data(), i);
+            int64_t rowIndex;
+            rowStream.nextRow(scratchRow.data(), rowIndex);
+            CaretAssert(rowIndex == i);
             for (int64_t j = 0; j < numCols; ++j)
             {
                 int parcel = indexToParcel[j];
@@ -151,12 +156,20 @@ AlgorithmCiftiParcellate::AlgorithmCiftiParcellate(ProgressObject* myProgObj, co
         }
     } else if (direction == CiftiXMLOld::ALONG_COLUMN) {
         vector<vector<double> > accumRows(numParcels, vector<double>(numCols, 0.0f));
+        vector<int64_t> rowList;
+        for (int64_t i = 0; i < numRows; ++i)
+        {
+            if (indexToParcel[i] != -1) rowList.push_back(i);
+        }
+        CiftiRowStream rowStream(myCiftiIn, rowList);//only read the rows inside parcels, ahead on other threads
         for (int64_t i = 0; i < numRows; ++i)
         {
             int parcel = indexToParcel[i];
             if (parcel != -1)
             {
-                myCiftiIn->getRow(scratchRow.data(), i);
+                int64_t rowIndex;
+                rowStream.nextRow(scratchRow.data(), rowIndex);
+                CaretAssert(rowIndex == i);
                 vector<double>& parcelRowRef = accumRows[parcel];
                 for (int64_t j = 0; j < numCols; ++j)
                 {
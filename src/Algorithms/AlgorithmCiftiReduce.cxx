@@ -20,7 +20,9 @@
 
 #include "AlgorithmCiftiReduce.h"
 #include "AlgorithmException.h"
+#include "CaretAssert.h"
 #include "CiftiFile.h"
+#include "CiftiRowStream.h"
 #include "ReductionOperation.h"
 
 #include <vector>
@@ -86,9 +88,12 @@ AlgorithmCiftiReduce::AlgorithmCiftiReduce(ProgressObject* myProgObj, const Cift
     myOutXML.setMapNameForRowIndex(0, ReductionEnum::toName(myReduce));
     ciftiOut->setCiftiXML(myOutXML);
     vector<float> scratchRow(numCols), outCol(numRows);
+    CiftiRowStream rowStream(ciftiIn);//reads ahead on other threads
     for (int64_t i = 0; i < numRows; ++i)
     {
-        ciftiIn->getRow(scratchRow.data(), i);
+        int64_t rowIndex;
+        rowStream.nextRow(scratchRow.data(), rowIndex);
+        CaretAssert(rowIndex == i);
         outCol[i] = ReductionOperation::reduce(scratchRow.data(), numCols, myReduce);
     }
     ciftiOut->setColumn(outCol.data(), 0);
@@ -105,9 +110,12 @@ AlgorithmCiftiReduce::AlgorithmCiftiReduce(ProgressObject* myProgObj, const Cift
     myOutXML.setMapNameForRowIndex(0, ReductionEnum::toName(myReduce));
     ciftiOut->setCiftiXML(myOutXML);
     vector<float> scratchRow(numCols), outCol(numRows);
+    CiftiRowStream rowStream(ciftiIn);//reads ahead on other threads
     for (int64_t i = 0; i < numRows; ++i)
     {
-        ciftiIn->getRow(scratchRow.data(), i);
+        int64_t rowIndex;
+        rowStream.nextRow(scratchRow.data(), rowIndex);
+        CaretAssert(rowIndex == i);
         outCol[i] = ReductionOperation::reduceExcludeDev(scratchRow.data(), numCols, myReduce, sigmaBelow, sigmaAbove);
     }
     ciftiOut->setColumn(outCol.data(), 0);
@@ -109,11 +109,15 @@ OperationParameters* AlgorithmCiftiResample::getParameters()
     cerebAreaSurfsOpt->addSurfaceParameter(1, "current-area", "a relevant cerebellum anatomical surface with current mesh");
     cerebAreaSurfsOpt->addSurfaceParameter(2, "new-area", "a relevant cerebellum anatomical surface with new mesh");
     
+    OptionalParameter* cacheOpt = ret->createOptionalParameter(16, "-weight-cache", "reuse surface resampling weights saved in a directory");
+    cacheOpt->addStringParameter(1, "directory", "the directory to load and save surface resampling weights in");
+    
     AString myHelpText =
         AString("Resample cifti data to a different brainordinate space.  Use COLUMN to resample dscalar, dlabel, or dtseries.  ") +
         "Resampling a dconn requires running the command twice, once for each direction.  " +
         "Dilation is done with the 'nearest' method, and is done on <new-sphere> for surface data.  " +
-        "Volume components are padded before dilation so that dilation doesn't run into the edge of the component bounding box.\n\n" +
+        "Volume components are padded before dilation so that dilation doesn't run into the edge of the component bounding box.  " +
+        "See -metric-resample for details of -weight-cache.\n\n" +
         "The <volume-method> argument must be one of the following:\n\n" +
         "CUBIC\nENCLOSING_VOXEL\nTRILINEAR\n\n" +
         "The <surface-method> argument must be one of the following:\n\n";
@@ -263,17 +267,23 @@ void AlgorithmCiftiResample::useParameters(OperationParameters* myParams, Progre
             newCerebAreaSurf = newCerebSphere;
         }
     }
+    AString weightCacheDirectory;
+    OptionalParameter* cacheOpt = myParams->getOptionalParameter(16);
+    if (cacheOpt->m_present)
+    {
+        weightCacheDirectory = cacheOpt->getString(1);
+    }
     if (warpfieldOpt->m_present)
     {
         AlgorithmCiftiResample(myProgObj, myCiftiIn, direction, myTemplate, templateDir, mySurfMethod, myVolMethod, myCiftiOut, surfLargest, voldilatemm, surfdilatemm, myWarpfield.getWarpfield(),
                                curLeftSphere, newLeftSphere, curLeftAreaSurf, newLeftAreaSurf,
                                curRightSphere, newRightSphere, curRightAreaSurf, newRightAreaSurf,
-                               curCerebSphere, newCerebSphere, curCerebAreaSurf, newCerebAreaSurf);
+                               curCerebSphere, newCerebSphere, curCerebAreaSurf, newCerebAreaSurf, weightCacheDirectory);
     } else {//rely on AffineFile() being the identity transform for if neither option is specified
         AlgorithmCiftiResample(myProgObj, myCiftiIn, direction, myTemplate, templateDir, mySurfMethod, myVolMethod, myCiftiOut, surfLargest, voldilatemm, surfdilatemm, myAffine.getMatrix(),
                                curLeftSphere, newLeftSphere, curLeftAreaSurf, newLeftAreaSurf,
                                curRightSphere, newRightSphere, curRightAreaSurf, newRightAreaSurf,
-                               curCerebSphere, newCerebSphere, curCerebAreaSurf, newCerebAreaSurf);
+                               curCerebSphere, newCerebSphere, curCerebAreaSurf, newCerebAreaSurf, weightCacheDirectory);
     }
 }
 
@@ -283,7 +293,8 @@ AlgorithmCiftiResample::AlgorithmCiftiResample(ProgressObject* myProgObj, const
                                                const VolumeFile* warpfield,
                                                const SurfaceFile* curLeftSphere, const SurfaceFile* newLeftSphere, const SurfaceFile* curLeftAreaSurf, const SurfaceFile* newLeftAreaSurf,
                                                const SurfaceFile* curRightSphere, const SurfaceFile* newRightSphere, const SurfaceFile* curRightAreaSurf, const SurfaceFile* newRightAreaSurf,
-                                               const SurfaceFile* curCerebSphere, const SurfaceFile* newCerebSphere, const SurfaceFile* curCerebAreaSurf, const SurfaceFile* newCerebAreaSurf) : AbstractAlgorithm(myProgObj)
+                                               const SurfaceFile* curCerebSphere, const SurfaceFile* newCerebSphere, const SurfaceFile* curCerebAreaSurf, const SurfaceFile* newCerebAreaSurf,
+                                               const AString& weightCacheDirectory) : AbstractAlgorithm(myProgObj)
 {
     LevelProgress myProgress(myProgObj);
     if (direction > 1) throw AlgorithmException("unsupported mapping direction");
@@ -339,7 +350,7 @@ AlgorithmCiftiResample::AlgorithmCiftiResample(ProgressObject* myProgObj, const
                 throw AlgorithmException("unsupported surface structure: " + StructureEnum::toGuiName(surfList[i]));
                 break;
         }
-        processSurfaceComponent(myCiftiIn, direction, surfList[i], mySurfMethod, myCiftiOut, surfLargest, surfdilatemm, curSphere, newSphere, curArea, newArea);
+        processSurfaceComponent(myCiftiIn, direction, surfList[i], mySurfMethod, myCiftiOut, surfLargest, surfdilatemm, curSphere, newSphere, curArea, newArea, weightCacheDirectory);
     }
     for (int i = 0; i < (int)volList.size(); ++i)
     {
@@ -353,7 +364,8 @@ AlgorithmCiftiResample::AlgorithmCiftiResample(ProgressObject* myProgObj, const
                                                const FloatMatrix& affine,
                                                const SurfaceFile* curLeftSphere, const SurfaceFile* newLeftSphere, const SurfaceFile* curLeftAreaSurf, const SurfaceFile* newLeftAreaSurf,
                                                const SurfaceFile* curRightSphere, const SurfaceFile* newRightSphere, const SurfaceFile* curRightAreaSurf, const SurfaceFile* newRightAreaSurf,
-                                               const SurfaceFile* curCerebSphere, const SurfaceFile* newCerebSphere, const SurfaceFile* curCerebAreaSurf, const SurfaceFile* newCerebAreaSurf) : AbstractAlgorithm(myProgObj)
+                                               const SurfaceFile* curCerebSphere, const SurfaceFile* newCerebSphere, const SurfaceFile* curCerebAreaSurf, const SurfaceFile* newCerebAreaSurf,
+                                               const AString& weightCacheDirectory) : AbstractAlgorithm(myProgObj)
 {
     LevelProgress myProgress(myProgObj);
     if (direction > 1) throw AlgorithmException("unsupported mapping direction");
@@ -409,7 +421,7 @@ AlgorithmCiftiResample::AlgorithmCiftiResample(ProgressObject* myProgObj, const
                 throw AlgorithmException("unsupported surface structure: " + StructureEnum::toGuiName(surfList[i]));
                 break;
         }
-        processSurfaceComponent(myCiftiIn, direction, surfList[i], mySurfMethod, myCiftiOut, surfLargest, surfdilatemm, curSphere, newSphere, curArea, newArea);
+        processSurfaceComponent(myCiftiIn, direction, surfList[i], mySurfMethod, myCiftiOut, surfLargest, surfdilatemm, curSphere, newSphere, curArea, newArea, weightCacheDirectory);
     }
     for (int i = 0; i < (int)volList.size(); ++i)
     {
@@ -419,7 +431,7 @@ AlgorithmCiftiResample::AlgorithmCiftiResample(ProgressObject* myProgObj, const
 
 void AlgorithmCiftiResample::processSurfaceComponent(const CiftiFile* myCiftiIn, const int& direction, const StructureEnum::Enum& myStruct, const SurfaceResamplingMethodEnum::Enum& mySurfMethod,
                                                      CiftiFile* myCiftiOut, const bool& surfLargest, const float& surfdilatemm, const SurfaceFile* curSphere, const SurfaceFile* newSphere,
-                                                     const SurfaceFile* curArea, const SurfaceFile* newArea)
+                                                     const SurfaceFile* curArea, const SurfaceFile* newArea, const AString& weightCacheDirectory)
 {
     const CiftiXMLOld& myInputXML = myCiftiIn->getCiftiXMLOld();
     if (myInputXML.getMappingType(1 - direction) == CIFTI_INDEX_TYPE_LABELS)
@@ -429,7 +441,7 @@ void AlgorithmCiftiResample::processSurfaceComponent(const CiftiFile* myCiftiIn,
         AlgorithmCiftiSeparate(NULL, myCiftiIn, direction, myStruct, &origLabel, &origRoi);
         LabelFile newLabel, newDilate, *newUse;
         newUse = &newLabel;
-        AlgorithmLabelResample(NULL, &origLabel, curSphere, newSphere, mySurfMethod, &newLabel, curArea, newArea, &origRoi, &resampleROI, surfLargest);
+        AlgorithmLabelResample(NULL, &origLabel, curSphere, newSphere, mySurfMethod, &newLabel, curArea, newArea, &origRoi, &resampleROI, surfLargest, weightCacheDirectory);
         if (surfdilatemm > 0.0f)
         {
             MetricFile invertResampleROI;
@@ -448,7 +460,7 @@ void AlgorithmCiftiResample::processSurfaceComponent(const CiftiFile* myCiftiIn,
         AlgorithmCiftiSeparate(NULL, myCiftiIn, direction, myStruct, &origMetric, &origROI);
         MetricFile newMetric, newDilate, resampleROI, *newUse;
         newUse = &newMetric;
-        AlgorithmMetricResample(NULL, &origMetric, curSphere, newSphere, mySurfMethod, &newMetric, curArea, newArea, &origROI, &resampleROI, surfLargest);
+        AlgorithmMetricResample(NULL, &origMetric, curSphere, newSphere, mySurfMethod, &newMetric, curArea, newArea, &origROI, &resampleROI, surfLargest, weightCacheDirectory);
         if (surfdilatemm > 0.0f)
         {
             MetricFile invertResampleROI;
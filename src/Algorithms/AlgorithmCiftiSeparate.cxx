@@ -23,6 +23,7 @@
 #include "CaretLogger.h"
 #include "CaretPointer.h"
 #include "CiftiFile.h"
+#include "CiftiRowStream.h"
 #include "GiftiLabelTable.h"
 #include "LabelFile.h"
 #include "MetricFile.h"
@@ -203,9 +204,17 @@ AlgorithmCiftiSeparate::AlgorithmCiftiSeparate(ProgressObject* myProgObj, const
         int mapSize = (int)myMap.size();
         CaretArray<float> rowScratch(rowSize);
         CaretArray<float> nodeUsed(numNodes, 0.0f);
+        vector<int64_t> rowList(mapSize);
         for (int i = 0; i < mapSize; ++i)
         {
-            ciftiIn->getRow(rowScratch, myMap[i].m_ciftiIndex);
+            rowList[i] = myMap[i].m_ciftiIndex;
+        }
+        CiftiRowStream rowStream(ciftiIn, rowList);//reads ahead on other threads
+        for (int i = 0; i < mapSize; ++i)
+        {
+            int64_t rowIndex;
+            rowStream.nextRow(rowScratch, rowIndex);
+            CaretAssert(rowIndex == myMap[i].m_ciftiIndex);
             nodeUsed[myMap[i].m_surfaceNode] = 1.0f;
             for (int j = 0; j < rowSize; ++j)
             {
@@ -246,9 +255,12 @@ AlgorithmCiftiSeparate::AlgorithmCiftiSeparate(ProgressObject* myProgObj, const
             }
             roiOut->setValuesForColumn(0, nodeUsed);
         }
+        CiftiRowStream rowStream(ciftiIn);//reads ahead on other threads
         for (int i = 0; i < colSize; ++i)
         {
-            ciftiIn->getRow(rowScratch, i);
+            int64_t rowIndex;
+            rowStream.nextRow(rowScratch, rowIndex);
+            CaretAssert(rowIndex == i);
             for (int j = 0; j < mapSize; ++j)
             {
                 metricScratch[myMap[j].m_surfaceNode] = rowScratch[myMap[j].m_ciftiIndex];
@@ -290,9 +302,17 @@ AlgorithmCiftiSeparate::AlgorithmCiftiSeparate(ProgressObject* myProgObj, const
             map<int32_t, int32_t> thisRemap = myTable.append(*(myLabelsMap.getMapLabelTable(i)));
             cumulativeRemap.insert(thisRemap.begin(), thisRemap.end());
         }
+        vector<int64_t> rowList(mapSize);
+        for (int64_t i = 0; i < mapSize; ++i)
+        {
+            rowList[i] = myMap[i].m_ciftiIndex;
+        }
+        CiftiRowStream rowStream(ciftiIn, rowList);//reads ahead on other threads
         for (int64_t i = 0; i < mapSize; ++i)
         {
-            ciftiIn->getRow(rowScratch, myMap[i].m_ciftiIndex);
+            int64_t rowIndex;
+            rowStream.nextRow(rowScratch, rowIndex);
+            CaretAssert(rowIndex == myMap[i].m_ciftiIndex);
             nodeUsed[myMap[i].m_surfaceNode] = 1.0f;
             for (int j = 0; j < rowSize; ++j)
             {
@@ -356,9 +376,12 @@ AlgorithmCiftiSeparate::AlgorithmCiftiSeparate(ProgressObject* myProgObj, const
         }
         *(labelOut->getLabelTable()) = myTable;
         int32_t unusedLabel = myTable.getUnassignedLabelKey();
+        CiftiRowStream rowStream(ciftiIn);//reads ahead on other threads
         for (int64_t i = 0; i < colSize; ++i)
         {
-            ciftiIn->getRow(rowScratch, i);
+            int64_t rowIndex;
+            rowStream.nextRow(rowScratch, rowIndex);
+            CaretAssert(rowIndex == i);
             for (int64_t j = 0; j < mapSize; ++j)
             {
                 int32_t inVal = (int32_t)floor(rowScratch[j] + 0.5f);
@@ -429,6 +452,12 @@ AlgorithmCiftiSeparate::AlgorithmCiftiSeparate(ProgressObject* myProgObj, const
                 *(volOut->getMapLabelTable(j)) = *(myLabelsMap.getMapLabelTable(j));
             }
         }
+        vector<int64_t> rowList(numVoxels);
+        for (int64_t i = 0; i < numVoxels; ++i)
+        {
+            rowList[i] = myMap[i].m_ciftiIndex;
+        }
+        CiftiRowStream rowStream(ciftiIn, rowList);//reads ahead on other threads
         for (int64_t i = 0; i < numVoxels; ++i)
         {
             int64_t thisvoxel[3] = { myMap[i].m_ijk[0] - offsetOut[0], myMap[i].m_ijk[1] - offsetOut[1], myMap[i].m_ijk[2] - offsetOut[2] };
@@ -436,7 +465,9 @@ AlgorithmCiftiSeparate::AlgorithmCiftiSeparate(ProgressObject* myProgObj, const
             {
                 roiOut->setValue(1.0f, thisvoxel);
             }
-            ciftiIn->getRow(rowScratch, myMap[i].m_ciftiIndex);
+            int64_t rowIndex;
+            rowStream.nextRow(rowScratch, rowIndex);
+            CaretAssert(rowIndex == myMap[i].m_ciftiIndex);
             for (int j = 0; j < rowSize; ++j)
             {
                 volOut->setValue(rowScratch[j], thisvoxel, j);
@@ -455,9 +486,12 @@ AlgorithmCiftiSeparate::AlgorithmCiftiSeparate(ProgressObject* myProgObj, const
                 *(volOut->getMapLabelTable(j)) = *(myLabelsMap.getMapLabelTable(j));
             }
         }
+        CiftiRowStream rowStream(ciftiIn);//reads ahead on other threads
         for (int64_t i = 0; i < colSize; ++i)
         {
-            ciftiIn->getRow(rowScratch, i);
+            int64_t rowIndex;
+            rowStream.nextRow(rowScratch, rowIndex);
+            CaretAssert(rowIndex == i);
             for (int64_t j = 0; j < numVoxels; ++j)
             {
                 int64_t thisvoxel[3] = { myMap[j].m_ijk[0] - offsetOut[0], myMap[j].m_ijk[1] - offsetOut[1], myMap[j].m_ijk[2] - offsetOut[2] };
@@ -518,6 +552,12 @@ AlgorithmCiftiSeparate::AlgorithmCiftiSeparate(ProgressObject* myProgObj, const
                 *(volOut->getMapLabelTable(j)) = *(myLabelsMap.getMapLabelTable(j));
             }
         }
+        vector<int64_t> rowList(numVoxels);
+        for (int64_t i = 0; i < numVoxels; ++i)
+        {
+            rowList[i] = myMap[i].m_ciftiIndex;
+        }
+        CiftiRowStream rowStream(ciftiIn, rowList);//reads ahead on other threads
         for (int64_t i = 0; i < numVoxels; ++i)
         {
             int64_t thisvoxel[3] = { myMap[i].m_ijk[0] - offsetOut[0], myMap[i].m_ijk[1] - offsetOut[1], myMap[i].m_ijk[2] - offsetOut[2] };
@@ -525,7 +565,9 @@ AlgorithmCiftiSeparate::AlgorithmCiftiSeparate(ProgressObject* myProgObj, const
             {
                 roiOut->setValue(1.0f, thisvoxel);
             }
-            ciftiIn->getRow(rowScratch, myMap[i].m_ciftiIndex);
+            int64_t rowIndex;
+            rowStream.nextRow(rowScratch, rowIndex);
+            CaretAssert(rowIndex == myMap[i].m_ciftiIndex);
             for (int j = 0; j < rowSize; ++j)
             {
                 volOut->setValue(rowScratch[j], thisvoxel, j);
@@ -544,9 +586,12 @@ AlgorithmCiftiSeparate::AlgorithmCiftiSeparate(ProgressObject* myProgObj, const
                 *(volOut->getMapLabelTable(j)) = *(myLabelsMap.getMapLabelTable(j));
             }
         }
+        CiftiRowStream rowStream(ciftiIn);//reads ahead on other threads
         for (int64_t i = 0; i < colSize; ++i)
         {
-            ciftiIn->getRow(rowScratch, i);
+            int64_t rowIndex;
+            rowStream.nextRow(rowScratch, rowIndex);
+            CaretAssert(rowIndex == i);
             for (int64_t j = 0; j < numVoxels; ++j)
             {
                 int64_t thisvoxel[3] = { myMap[j].m_ijk[0] - offsetOut[0], myMap[j].m_ijk[1] - offsetOut[1], myMap[j].m_ijk[2] - offsetOut[2] };
@@ -67,12 +67,16 @@ OperationParameters* AlgorithmCiftiSmoothing::getParameters()
     
     ret->createOptionalParameter(11, "-fix-zeros-surface", "treat values of zero on the surface as missing data");
     
+    OptionalParameter* cacheOpt = ret->createOptionalParameter(12, "-weight-cache", "reuse surface smoothing weights saved in a directory");
+    cacheOpt->addStringParameter(1, "directory", "the directory to load and save surface smoothing weights in");
+    
     ret->setHelpText(
         AString("The input cifti file must have a brain models mapping on the chosen dimension, columns for .dtseries, and ") +
         "either for .dconn.  The fix zeros options will treat values of zero as lack of data, " +
         "and not use that value when generating the smoothed values, but will fill zeros with extrapolated values.  " +
         "The ROI should have a brain models mapping along columns, exactly matching the mapping of the chosen direction in the input file.  " +
-        "Data outside the ROI is ignored."
+        "Data outside the ROI is ignored.  " +
+        "See -metric-smoothing for details of -weight-cache."
     );
     return ret;
 }
@@ -117,12 +121,18 @@ void AlgorithmCiftiSmoothing::useParameters(OperationParameters* myParams, Progr
     }
     bool fixZerosVol = myParams->getOptionalParameter(10)->m_present;
     bool fixZerosSurf = myParams->getOptionalParameter(11)->m_present;
-    AlgorithmCiftiSmoothing(myProgObj, myCifti, surfKern, volKern, myDir, myCiftiOut, myLeftSurf, myRightSurf, myCerebSurf, roiCifti, fixZerosVol, fixZerosSurf);
+    AString weightCacheDirectory;
+    OptionalParameter* cacheOpt = myParams->getOptionalParameter(12);
+    if (cacheOpt->m_present)
+    {
+        weightCacheDirectory = cacheOpt->getString(1);
+    }
+    AlgorithmCiftiSmoothing(myProgObj, myCifti, surfKern, volKern, myDir, myCiftiOut, myLeftSurf, myRightSurf, myCerebSurf, roiCifti, fixZerosVol, fixZerosSurf, weightCacheDirectory);
 }
 
 AlgorithmCiftiSmoothing::AlgorithmCiftiSmoothing(ProgressObject* myProgObj, const CiftiInterface* myCifti, const float& surfKern, const float& volKern, const int& myDir, CiftiFile* myCiftiOut,
                                                  const SurfaceFile* myLeftSurf, const SurfaceFile* myRightSurf, const SurfaceFile* myCerebSurf,
-                                                 const CiftiInterface* roiCifti, bool fixZerosVol, bool fixZerosSurf) : AbstractAlgorithm(myProgObj)
+                                                 const CiftiInterface* roiCifti, bool fixZerosVol, bool fixZerosSurf, const AString& weightCacheDirectory) : AbstractAlgorithm(myProgObj)
 {
     LevelProgress myProgress(myProgObj);
     const CiftiXMLOld& myXML = myCifti->getCiftiXMLOld();
@@ -207,7 +217,7 @@ AlgorithmCiftiSmoothing::AlgorithmCiftiSmoothing(ProgressObject* myProgObj, cons
         {//due to above testing, we know the structure mask is the same, so just overwrite the ROI from the mask
             AlgorithmCiftiSeparate(NULL, roiCifti, CiftiXMLOld::ALONG_COLUMN, surfaceList[whichStruct], &myRoi);
         }
-        AlgorithmMetricSmoothing(NULL, mySurf, &myMetric, surfKern, &myMetricOut, &myRoi, fixZerosSurf);
+        AlgorithmMetricSmoothing(NULL, mySurf, &myMetric, surfKern, &myMetricOut, &myRoi, fixZerosSurf, -1, MetricSmoothingObject::GEO_GAUSS_AREA, false, weightCacheDirectory);
         AlgorithmCiftiReplaceStructure(NULL, myCiftiOut, myDir, surfaceList[whichStruct], &myMetricOut);
     }
     for (int whichStruct = 0; whichStruct < (int)volumeList.size(); ++whichStruct)
@@ -36,7 +36,7 @@ namespace caret {
     public:
         AlgorithmCiftiSmoothing(ProgressObject* myProgObj, const CiftiInterface* myCifti, const float& surfKern, const float& volKern, const int& myDir, CiftiFile* myCiftiOut,
                                 const SurfaceFile* myLeftSurf = NULL, const SurfaceFile* myRightSurf = NULL, const SurfaceFile* myCerebSurf = NULL,
-                                const CiftiInterface* roiCifti = NULL, bool fixZerosVol = false, bool fixZerosSurf = false);
+                                const CiftiInterface* roiCifti = NULL, bool fixZerosVol = false, bool fixZerosSurf = false, const AString& weightCacheDirectory = "");
         static OperationParameters* getParameters();
         static void useParameters(OperationParameters* myParams, ProgressObject* myProgObj);
         static AString getCommandSwitch();
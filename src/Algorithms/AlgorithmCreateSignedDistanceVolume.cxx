@@ -21,6 +21,7 @@
 #include "AlgorithmCreateSignedDistanceVolume.h"
 #include "AlgorithmException.h"
 #include "VolumeFile.h"
+#include "CaretLogger.h"
 #include "CaretOMP.h"
 #include "CaretHeap.h"
 #include "MathFunctions.h"
@@ -28,6 +29,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <limits>
 #include <set>
 
 using namespace caret;
@@ -70,13 +72,20 @@ OperationParameters* AlgorithmCreateSignedDistanceVolume::getParameters()
     OptionalParameter* windingMethodOpt = ret->createOptionalParameter(8, "-winding", "winding method for point inside surface test");
     windingMethodOpt->addStringParameter(1, "method", "name of the method (default EVEN_ODD)");
     
+    OptionalParameter* approxMethodOpt = ret->createOptionalParameter(10, "-approx-method", "method for calculating approximate distances");
+    approxMethodOpt->addStringParameter(1, "method", "name of the method (default DIJKSTRA)");
+    
     ret->setHelpText(
         AString("Computes the signed distance function of the surface.  Exact distance is calculated by finding the closest point on any surface triangle ") +
         "to the center of the voxel.  Approximate distance is calculated starting with these distances, using dijkstra's method with a neighborhood of voxels.  " +
         "Specifying too small of an exact distance may produce unexpected results.  Valid specifiers for winding methods are as follows:\n\n" +
         "EVEN_ODD (default)\nNEGATIVE\nNONZERO\nNORMALS\n\nThe NORMALS method uses the normals of triangles and edges, or the closest triangle hit by a ray from the point.  " +
         "This method may be slightly faster, but is only reliable for a closed surface that does not cross through itself.  All other methods count entry (positive) and " +
-        "exit (negative) crossings of a vertical ray from the point, then counts as inside if the total is odd, negative, or nonzero, respectively."
+        "exit (negative) crossings of a vertical ray from the point, then counts as inside if the total is odd, negative, or nonzero, respectively.\n\n" +
+        "Valid specifiers for approximate methods are as follows:\n\nDIJKSTRA (default)\nSWEEP\n\n" +
+        "The SWEEP method solves the eikonal equation outward from the exact distances by fast sweeping, updating each diagonal plane of voxels in parallel.  " +
+        "It is much faster than DIJKSTRA for large approximate limits on fine grids, ignores -approx-neighborhood, and requires a volume space with orthogonal axes, " +
+        "otherwise DIJKSTRA is used instead."
     );
     return ret;
 }
@@ -144,11 +153,26 @@ void AlgorithmCreateSignedDistanceVolume::useParameters(OperationParameters* myP
     {
         myRoiOut = roiOutOpt->getOutputVolume(1);
     }
-    AlgorithmCreateSignedDistanceVolume(myProgObj, mySurf, myVolOut, myRoiOut, fillValue, exactLim, approxLim, approxNeighborhood, myWinding);
+    ApproxMethod approxMethod = DIJKSTRA;
+    OptionalParameter* approxMethodOpt = myParams->getOptionalParameter(10);
+    if (approxMethodOpt->m_present)
+    {
+        AString methodName = approxMethodOpt->getString(1);
+        if (methodName == "DIJKSTRA")
+        {
+            approxMethod = DIJKSTRA;
+        } else if (methodName == "SWEEP") {
+            approxMethod = FAST_SWEEP;
+        } else {
+            throw AlgorithmException("unrecognized approximate method");
+        }
+    }
+    AlgorithmCreateSignedDistanceVolume(myProgObj, mySurf, myVolOut, myRoiOut, fillValue, exactLim, approxLim, approxNeighborhood, myWinding, approxMethod);
 }
 
 AlgorithmCreateSignedDistanceVolume::AlgorithmCreateSignedDistanceVolume(ProgressObject* myProgObj, const SurfaceFile* mySurf, VolumeFile* myVolOut, VolumeFile* myRoiOut, const float& fillValue,
-                                                                         const float& exactLim, const float& approxLim, const int& approxNeighborhood, const SignedDistanceHelper::WindingLogic& myWinding) : AbstractAlgorithm(myProgObj)
+                                                                         const float& exactLim, const float& approxLim, const int& approxNeighborhood, const SignedDistanceHelper::WindingLogic& myWinding,
+                                                                         const ApproxMethod& approxMethod) : AbstractAlgorithm(myProgObj)
 {
     if (exactLim <= 0.0f)
     {
@@ -271,22 +295,50 @@ AlgorithmCreateSignedDistanceVolume::AlgorithmCreateSignedDistanceVolume(Progres
     }
     myProgress.reportProgress(markweight);
     myProgress.setTask("computing exact distances");
+    int64_t numExact = (int64_t)exactVoxelList.size() / 3;
+    vector<float> exactCoords(numExact * 3), exactDists(numExact);
+    for (int64_t i = 0; i < numExact; ++i)
+    {
+        myVolOut->indexToSpace(exactVoxelList.data() + i * 3, exactCoords.data() + i * 3);
+    }
+    const int64_t BATCH_SIZE = 4096;//the helper sorts each batch spatially, so points close together share tree searches
+    int64_t numBatches = (numExact + BATCH_SIZE - 1) / BATCH_SIZE;
 #pragma omp CARET_PAR
     {
         CaretPointer<SignedDistanceHelper> myDist = mySurf->getSignedDistanceHelper();
-        int numExact = (int)exactVoxelList.size();
-        Vector3D thisCoord;
 #pragma omp CARET_FOR schedule(dynamic)
-        for (int i = 0; i < numExact; i += 3)
+        for (int64_t batch = 0; batch < numBatches; ++batch)
         {
-            myVolOut->indexToSpace(exactVoxelList.data() + i, thisCoord);
-            myVolOut->setValue(myDist->dist(thisCoord, myWinding), exactVoxelList.data() + i);
-            volMarked[myVolOut->getIndex(exactVoxelList.data() + i)] |= 22;//set marked to have valid value (positive and negative), and frozen
+            int64_t batchStart = batch * BATCH_SIZE;
+            int64_t batchCount = min(BATCH_SIZE, numExact - batchStart);
+            myDist->dist(exactCoords.data() + batchStart * 3, batchCount, myWinding, exactDists.data() + batchStart);
         }
     }
+    for (int64_t i = 0; i < numExact; ++i)
+    {
+        myVolOut->setValue(exactDists[i], exactVoxelList.data() + i * 3);
+        volMarked[myVolOut->getIndex(exactVoxelList.data() + i * 3)] |= 22;//set marked to have valid value (positive and negative), and frozen
+    }
     myProgress.reportProgress(markweight + exactweight);
-    if (approxLim > exactLim)
+    bool useSweep = false;
+    if (approxLim > exactLim && approxMethod == FAST_SWEEP)
+    {
+        const float ORTH_TOLERANCE = 0.0001f;//relative, sforms written with limited precision aren't exactly orthogonal
+        if (abs(ivec.dot(jvec)) <= ORTH_TOLERANCE * ivec.length() * jvec.length() &&
+            abs(ivec.dot(kvec)) <= ORTH_TOLERANCE * ivec.length() * kvec.length() &&
+            abs(jvec.dot(kvec)) <= ORTH_TOLERANCE * jvec.length() * kvec.length())
+        {
+            useSweep = true;
+        } else {
+            CaretLogWarning("volume space is not orthogonal, using DIJKSTRA method for approximate distances");
+        }
+    }
+    if (useSweep)
     {
+        myProgress.setTask("approximating distances in extended region");
+        float spacing[3] = { ivec.length(), jvec.length(), kvec.length() };
+        sweepApproximate(myVolOut, volMarked, approxLim, spacing);
+    } else if (approxLim > exactLim) {
         myProgress.setTask("approximating distances in extended region");
         int faceNeigh[] = { 1, 0, 0, 
                             -1, 0, 0,
@@ -526,6 +578,157 @@ AlgorithmCreateSignedDistanceVolume::AlgorithmCreateSignedDistanceVolume(Progres
     }
 }
 
+namespace
+{
+    float sweepUpdate(float neighDist[3], float invSpacingSqr[3])
+    {//godunov upwind solution of |grad u| = 1, using the smallest neighbor on each axis, only axes whose neighbor is below the result contribute
+        for (int i = 1; i < 3; ++i)
+        {//sort by neighbor distance, insertion sort on 3 elements
+            for (int j = i; j > 0 && neighDist[j] < neighDist[j - 1]; --j)
+            {
+                swap(neighDist[j], neighDist[j - 1]);
+                swap(invSpacingSqr[j], invSpacingSqr[j - 1]);
+            }
+        }
+        float ret = numeric_limits<float>::infinity();
+        float weightSum = 0.0f, weightedSum = 0.0f, weightedSqrSum = 0.0f;
+        for (int i = 0; i < 3; ++i)
+        {
+            if (!(neighDist[i] < ret)) break;//also stops at infinite neighbors
+            weightSum += invSpacingSqr[i];
+            weightedSum += invSpacingSqr[i] * neighDist[i];
+            weightedSqrSum += invSpacingSqr[i] * neighDist[i] * neighDist[i];
+            float discriminant = weightedSum * weightedSum - weightSum * (weightedSqrSum - 1.0f);
+            if (discriminant < 0.0f) break;//can't happen in exact math when the new neighbor is below the previous result, but guard against rounding
+            ret = (weightedSum + sqrt(discriminant)) / weightSum;
+        }
+        return ret;
+    }
+}
+
+void AlgorithmCreateSignedDistanceVolume::sweepApproximate(VolumeFile* myVolOut, int* volMarked, const float& approxLim, const float spacing[3])
+{//fast sweeping on the unsigned distance from the frozen exact voxels, each voxel takes the sign of the smallest neighbor it was computed from
+    const int MAX_SWEEP_ITERATIONS = 20;//each iteration is 8 sweeps, distance fields usually converge in 2 or 3
+    vector<int64_t> myDims;
+    myVolOut->getDimensions(myDims);
+    const int64_t dimI = myDims[0], dimJ = myDims[1], dimK = myDims[2];
+    const int64_t frameSize = dimI * dimJ * dimK;
+    const int64_t jStep = dimI, kStep = dimI * dimJ;//matches VolumeFile::getIndex
+    const float* frame = myVolOut->getFrame();
+    vector<float> unsignedDist(frameSize, numeric_limits<float>::infinity());
+    vector<char> distSign(frameSize, 1);
+    int64_t boxMin[3] = { dimI, dimJ, dimK }, boxMax[3] = { -1, -1, -1 };
+    for (int64_t k = 0; k < dimK; ++k)
+    {
+        for (int64_t j = 0; j < dimJ; ++j)
+        {
+            for (int64_t i = 0; i < dimI; ++i)
+            {
+                int64_t index = i + j * jStep + k * kStep;
+                if ((volMarked[index] & 4) != 0)
+                {
+                    unsignedDist[index] = abs(frame[index]);
+                    if (frame[index] < 0.0f) distSign[index] = -1;
+                    if (i < boxMin[0]) boxMin[0] = i;
+                    if (j < boxMin[1]) boxMin[1] = j;
+                    if (k < boxMin[2]) boxMin[2] = k;
+                    if (i > boxMax[0]) boxMax[0] = i;
+                    if (j > boxMax[1]) boxMax[1] = j;
+                    if (k > boxMax[2]) boxMax[2] = k;
+                }
+            }
+        }
+    }
+    if (boxMax[0] < 0) return;//no exact values to extend
+    for (int axis = 0; axis < 3; ++axis)
+    {//nothing beyond approxLim of the exact voxels can get a value, so only sweep that box
+        int64_t extend = (int64_t)ceil(approxLim / spacing[axis]) + 1;
+        boxMin[axis] = max((int64_t)0, boxMin[axis] - extend);
+        boxMax[axis] = min(myDims[axis] - 1, boxMax[axis] + extend);
+    }
+    const int64_t boxDims[3] = { boxMax[0] - boxMin[0] + 1, boxMax[1] - boxMin[1] + 1, boxMax[2] - boxMin[2] + 1 };
+    const int64_t maxLevel = boxDims[0] + boxDims[1] + boxDims[2] - 3;
+    const float tolerance = 0.0001f * min(min(spacing[0], spacing[1]), spacing[2]);
+    for (int iteration = 0; iteration < MAX_SWEEP_ITERATIONS; ++iteration)
+    {
+        int numChanged = 0;
+        for (int direction = 0; direction < 8; ++direction)
+        {
+            bool flipI = (direction & 1) != 0, flipJ = (direction & 2) != 0, flipK = (direction & 4) != 0;
+            for (int64_t level = 0; level <= maxLevel; ++level)
+            {//in sweep order, a voxel's upwind neighbors are all on the previous plane of constant i + j + k, so each plane can be updated in parallel with the same result as a serial sweep
+                int64_t iStart = max((int64_t)0, level - (boxDims[1] - 1) - (boxDims[2] - 1)), iEnd = min(boxDims[0] - 1, level);
+#pragma omp CARET_PARFOR schedule(dynamic, 16) reduction(+:numChanged)
+                for (int64_t localI = iStart; localI <= iEnd; ++localI)
+                {
+                    int64_t jStart = max((int64_t)0, level - localI - (boxDims[2] - 1)), jEnd = min(boxDims[1] - 1, level - localI);
+                    for (int64_t localJ = jStart; localJ <= jEnd; ++localJ)
+                    {
+                        int64_t localK = level - localI - localJ;
+                        int64_t i = boxMin[0] + (flipI ? boxDims[0] - 1 - localI : localI);
+                        int64_t j = boxMin[1] + (flipJ ? boxDims[1] - 1 - localJ : localJ);
+                        int64_t k = boxMin[2] + (flipK ? boxDims[2] - 1 - localK : localK);
+                        int64_t index = i + j * jStep + k * kStep;
+                        if ((volMarked[index] & 4) != 0) continue;//exact values are fixed
+                        float neighDist[3], invSpacingSqr[3];
+                        int64_t neighIndex[3];
+                        const int64_t ijk[3] = { i, j, k }, steps[3] = { 1, jStep, kStep };
+                        for (int axis = 0; axis < 3; ++axis)
+                        {
+                            neighDist[axis] = numeric_limits<float>::infinity();
+                            neighIndex[axis] = -1;
+                            if (ijk[axis] > 0 && unsignedDist[index - steps[axis]] < neighDist[axis])
+                            {
+                                neighDist[axis] = unsignedDist[index - steps[axis]];
+                                neighIndex[axis] = index - steps[axis];
+                            }
+                            if (ijk[axis] < myDims[axis] - 1 && unsignedDist[index + steps[axis]] < neighDist[axis])
+                            {
+                                neighDist[axis] = unsignedDist[index + steps[axis]];
+                                neighIndex[axis] = index + steps[axis];
+                            }
+                            invSpacingSqr[axis] = 1.0f / (spacing[axis] * spacing[axis]);
+                        }
+                        int closestAxis = 0;
+                        if (neighDist[1] < neighDist[closestAxis]) closestAxis = 1;
+                        if (neighDist[2] < neighDist[closestAxis]) closestAxis = 2;
+                        if (neighIndex[closestAxis] == -1) continue;//no neighbor has a value yet
+                        char newSign = distSign[neighIndex[closestAxis]];
+                        float newDist = sweepUpdate(neighDist, invSpacingSqr);
+                        if (newDist < unsignedDist[index])
+                        {
+                            if (unsignedDist[index] - newDist > tolerance) ++numChanged;
+                            unsignedDist[index] = newDist;
+                            distSign[index] = newSign;
+                        }
+                    }
+                }
+            }
+        }
+        if (numChanged == 0) break;
+    }
+    for (int64_t k = boxMin[2]; k <= boxMax[2]; ++k)
+    {
+        for (int64_t j = boxMin[1]; j <= boxMax[1]; ++j)
+        {
+            for (int64_t i = boxMin[0]; i <= boxMax[0]; ++i)
+            {
+                int64_t index = i + j * jStep + k * kStep;
+                if ((volMarked[index] & 4) == 0 && unsignedDist[index] <= approxLim)
+                {
+                    myVolOut->setValue(distSign[index] * unsignedDist[index], i, j, k);
+                    if (distSign[index] > 0)
+                    {
+                        volMarked[index] |= 6;//same marking as the dijkstra method: valid positive value, and frozen
+                    } else {
+                        volMarked[index] |= 20;
+                    }
+                }
+            }
+        }
+    }
+}
+
 float AlgorithmCreateSignedDistanceVolume::getAlgorithmInternalWeight()
 {
     return 1.0f;//override this if needed, if the progress bar isn't smooth
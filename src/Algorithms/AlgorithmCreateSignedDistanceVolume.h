@@ -54,9 +54,18 @@ namespace caret {
     protected:
         static float getSubAlgorithmWeight();
         static float getAlgorithmInternalWeight();
+    public:
+        enum ApproxMethod
+        {
+            DIJKSTRA,
+            FAST_SWEEP
+        };
+    private:
+        static void sweepApproximate(VolumeFile* myVolOut, int* volMarked, const float& approxLim, const float spacing[3]);
     public:
         AlgorithmCreateSignedDistanceVolume(ProgressObject* myProgObj, const SurfaceFile* mySurf, VolumeFile* myVolOut, VolumeFile* myRoiOut = NULL, const float& fillValue = 0.0f, const float& exactLim = 5.0f,
-                                            const float& approxLim = 20.0f, const int& approxNeighborhood = 2, const SignedDistanceHelper::WindingLogic& myWinding = SignedDistanceHelper::EVEN_ODD);
+                                            const float& approxLim = 20.0f, const int& approxNeighborhood = 2, const SignedDistanceHelper::WindingLogic& myWinding = SignedDistanceHelper::EVEN_ODD,
+                                            const ApproxMethod& approxMethod = DIJKSTRA);
         static OperationParameters* getParameters();
         static void useParameters(OperationParameters* myParams, ProgressObject* myProgObj);
         static AString getCommandSwitch();
@@ -66,11 +66,15 @@ OperationParameters* AlgorithmLabelResample::getParameters()
     
     ret->createOptionalParameter(9, "-largest", "use only the label of the vertex with the largest weight");
     
+    OptionalParameter* cacheOpt = ret->createOptionalParameter(10, "-weight-cache", "reuse resampling weights saved in a directory");
+    cacheOpt->addStringParameter(1, "directory", "the directory to load and save resampling weights in");
+    
     AString myHelpText =
         AString("Resamples a label file, given two spherical surfaces that are in register.  ") +
         "If -area-surfs are not specified, the sphere surfaces are used for area correction, if the method used does area correction.\n\n" +
         "The -largest option results in nearest vertex behavior when used with BARYCENTRIC, it uses the value of the source vertex that has the largest weight.  " +
         "When -largest is not specified, the vertex weights are summed according to which label they correspond to, and the label with the largest sum is used.\n\n" +
+        "See -metric-resample for details of -weight-cache.\n\n" +
         "The <method> argument must be one of the following:\n\n";
     
     vector<SurfaceResamplingMethodEnum::Enum> allEnums;
@@ -125,12 +129,19 @@ void AlgorithmLabelResample::useParameters(OperationParameters* myParams, Progre
         validRoiOut = validRoiOutOpt->getOutputMetric(1);
     }
     bool largest = myParams->getOptionalParameter(9)->m_present;
-    AlgorithmLabelResample(myProgObj, labelIn, curSphere, newSphere, myMethod, labelOut, curArea, newArea, currentRoi, validRoiOut, largest);
+    AString weightCacheDirectory;
+    OptionalParameter* cacheOpt = myParams->getOptionalParameter(10);
+    if (cacheOpt->m_present)
+    {
+        weightCacheDirectory = cacheOpt->getString(1);
+    }
+    AlgorithmLabelResample(myProgObj, labelIn, curSphere, newSphere, myMethod, labelOut, curArea, newArea, currentRoi, validRoiOut, largest, weightCacheDirectory);
 }
 
 AlgorithmLabelResample::AlgorithmLabelResample(ProgressObject* myProgObj, const LabelFile* labelIn, const SurfaceFile* curSphere, const SurfaceFile* newSphere,
                                                const SurfaceResamplingMethodEnum::Enum& myMethod, LabelFile* labelOut, const SurfaceFile* curArea,
-                                               const SurfaceFile* newArea, const MetricFile* currentRoi, MetricFile* validRoiOut, const bool& largest) : AbstractAlgorithm(myProgObj)
+                                               const SurfaceFile* newArea, const MetricFile* currentRoi, MetricFile* validRoiOut, const bool& largest,
+                                               const AString& weightCacheDirectory) : AbstractAlgorithm(myProgObj)
 {
     LevelProgress myProgress(myProgObj);
     if (labelIn->getNumberOfNodes() != curSphere->getNumberOfNodes()) throw AlgorithmException("input label file has different number of nodes than input sphere");
@@ -151,7 +162,7 @@ AlgorithmLabelResample::AlgorithmLabelResample(ProgressObject* myProgObj, const
     vector<int32_t> colScratch(numNewNodes, unusedLabel);
     const float* roiCol = NULL;
     if (currentRoi != NULL) roiCol = currentRoi->getValuePointerForColumn(0);
-    SurfaceResamplingHelper myHelp(myMethod, curSphere, newSphere, curArea, newArea, roiCol);
+    SurfaceResamplingHelper myHelp(myMethod, curSphere, newSphere, curArea, newArea, roiCol, weightCacheDirectory);
     if (validRoiOut != NULL)
     {
         validRoiOut->setNumberOfNodesAndColumns(numNewNodes, 1);
@@ -26,6 +26,9 @@
 #include "PaletteColorMapping.h"
 #include "SurfaceFile.h"
 #include "SurfaceResamplingHelper.h"
+#include "WeightOperatorFile.h"
+
+#include <algorithm>
 
 using namespace caret;
 using namespace std;
@@ -65,6 +68,9 @@ OperationParameters* AlgorithmMetricResample::getParameters()
     
     ret->createOptionalParameter(9, "-largest", "use only the value of the vertex with the largest weight");
     
+    OptionalParameter* cacheOpt = ret->createOptionalParameter(10, "-weight-cache", "reuse resampling weights saved in a directory");
+    cacheOpt->addStringParameter(1, "directory", "the directory to load and save resampling weights in");
+    
     AString myHelpText =
         AString("Resamples a metric file, given two spherical surfaces that are in register.  ") +
         "If -area-surfs are not specified, the sphere surfaces are used for area correction, if the method used does area correction.\n\n" +
@@ -72,6 +78,9 @@ OperationParameters* AlgorithmMetricResample::getParameters()
         "when using -current-roi.\n\n" +
         "The -largest option results in nearest vertex behavior when used with BARYCENTRIC, instead of doing a weighted average, it uses the value " +
         "of the source vertex that has the largest weight for each target vertex.  This is mainly intended for resampling ROI metrics.\n\n" +
+        "Computing the resampling weights is often slower than applying them.  " +
+        "When -weight-cache is specified, the weights are saved in the given directory under a name derived from the spheres, area surfaces, method, and roi, " +
+        "and later runs with the same inputs load them instead of recomputing them.\n\n" +
         "The <method> argument must be one of the following:\n\n";
     
     vector<SurfaceResamplingMethodEnum::Enum> allEnums;
@@ -126,12 +135,18 @@ void AlgorithmMetricResample::useParameters(OperationParameters* myParams, Progr
         validRoiOut = validRoiOutOpt->getOutputMetric(1);
     }
     bool largest = myParams->getOptionalParameter(9)->m_present;
-    AlgorithmMetricResample(myProgObj, metricIn, curSphere, newSphere, myMethod, metricOut, curArea, newArea, currentRoi, validRoiOut, largest);
+    AString weightCacheDirectory;
+    OptionalParameter* cacheOpt = myParams->getOptionalParameter(10);
+    if (cacheOpt->m_present)
+    {
+        weightCacheDirectory = cacheOpt->getString(1);
+    }
+    AlgorithmMetricResample(myProgObj, metricIn, curSphere, newSphere, myMethod, metricOut, curArea, newArea, currentRoi, validRoiOut, largest, weightCacheDirectory);
 }
 
 AlgorithmMetricResample::AlgorithmMetricResample(ProgressObject* myProgObj, const MetricFile* metricIn, const SurfaceFile* curSphere, const SurfaceFile* newSphere,
                                                  const SurfaceResamplingMethodEnum::Enum& myMethod, MetricFile* metricOut, const SurfaceFile* curArea, const SurfaceFile* newArea,
-                                                 const MetricFile* currentRoi, MetricFile* validRoiOut, const bool& largest) : AbstractAlgorithm(myProgObj)
+                                                 const MetricFile* currentRoi, MetricFile* validRoiOut, const bool& largest, const AString& weightCacheDirectory) : AbstractAlgorithm(myProgObj)
 {
     LevelProgress myProgress(myProgObj);
     if (metricIn->getNumberOfNodes() != curSphere->getNumberOfNodes()) throw AlgorithmException("input metric has different number of nodes than input sphere");
@@ -151,7 +166,7 @@ AlgorithmMetricResample::AlgorithmMetricResample(ProgressObject* myProgObj, cons
     vector<float> colScratch(numNewNodes, 0.0f);
     const float* roiCol = NULL;
     if (currentRoi != NULL) roiCol = currentRoi->getValuePointerForColumn(0);
-    SurfaceResamplingHelper myHelp(myMethod, curSphere, newSphere, curArea, newArea, roiCol);
+    SurfaceResamplingHelper myHelp(myMethod, curSphere, newSphere, curArea, newArea, roiCol, weightCacheDirectory);
     if (validRoiOut != NULL)
     {
         validRoiOut->setNumberOfNodesAndColumns(numNewNodes, 1);
@@ -167,10 +182,29 @@ AlgorithmMetricResample::AlgorithmMetricResample(ProgressObject* myProgObj, cons
         if (largest)
         {
             myHelp.resampleLargest(metricIn->getValuePointerForColumn(i), colScratch.data());
-        } else {
-            myHelp.resampleNormal(metricIn->getValuePointerForColumn(i), colScratch.data());
+            metricOut->setValuesForColumn(i, colScratch.data());
+        }
+    }
+    if (!largest)
+    {//resample a block of columns per pass over the weights, so each row of weights is read once per block rather than once per column
+        int blockCols = min(numColumns, (int)WeightOperatorFile::COLUMN_BLOCK);
+        vector<float> blockScratch((int64_t)numNewNodes * blockCols);
+        vector<const float*> inputs(blockCols);
+        vector<float*> outputs(blockCols);
+        for (int start = 0; start < numColumns; start += blockCols)
+        {
+            int numThisBlock = min(blockCols, numColumns - start);
+            for (int c = 0; c < numThisBlock; ++c)
+            {
+                inputs[c] = metricIn->getValuePointerForColumn(start + c);
+                outputs[c] = blockScratch.data() + (int64_t)numNewNodes * c;
+            }
+            myHelp.resampleNormal(inputs.data(), outputs.data(), numThisBlock);
+            for (int c = 0; c < numThisBlock; ++c)
+            {
+                metricOut->setValuesForColumn(start + c, outputs[c]);
+            }
         }
-        metricOut->setValuesForColumn(i, colScratch.data());
     }
 }
 
@@ -65,6 +65,9 @@ OperationParameters* AlgorithmMetricSmoothing::getParameters()
     OptionalParameter* methodSelect = ret->createOptionalParameter(8, "-method", "select smoothing method, default GEO_GAUSS_AREA");
     methodSelect->addStringParameter(1, "method", "the name of the smoothing method");
     
+    OptionalParameter* cacheOpt = ret->createOptionalParameter(9, "-weight-cache", "reuse smoothing weights saved in a directory");
+    cacheOpt->addStringParameter(1, "directory", "the directory to load and save smoothing weights in");
+    
     ret->setHelpText(
         AString("Smooth a metric file on a surface.  ") +
         "By default, smooths all input columns on the entire surface, specify -column to use only one input column, and -roi to smooth only where " +
@@ -85,7 +88,10 @@ OperationParameters* AlgorithmMetricSmoothing::getParameters()
         "The GEO_GAUSS_AREA method is the default because it is usually the correct choice.  " +
         "GEO_GAUSS_EQUAL may be the correct choice when the sum of vertex values is more meaningful then the surface integral (sum of values .* areas), " +
         "for instance when smoothing vertex areas (the sum is the total surface area, while the surface integral is the sum of squares of the vertex areas).  " +
-        "The GEO_GAUSS method is not recommended, it exists mainly to replicate methods of studies done with caret5's smoothing."
+        "The GEO_GAUSS method is not recommended, it exists mainly to replicate methods of studies done with caret5's smoothing.\n\n" +
+        "Computing the smoothing weights is often slower than the smoothing itself.  " +
+        "When -weight-cache is specified, the weights are saved in the given directory under a name derived from the surface coordinates and topology, " +
+        "kernel, method, and roi, and later runs with the same inputs load them instead of recomputing them."
     );
     return ret;
 }
@@ -132,12 +138,19 @@ void AlgorithmMetricSmoothing::useParameters(OperationParameters* myParams, Prog
             throw AlgorithmException("unknown smoothing method name");
         }
     }
-    AlgorithmMetricSmoothing(myProgObj, mySurf, myMetric, myKernel, myMetricOut, myRoi, fixZeros, columnNum, myMethod, matchRoiColumns);
+    AString weightCacheDirectory;
+    OptionalParameter* cacheOpt = myParams->getOptionalParameter(9);
+    if (cacheOpt->m_present)
+    {
+        weightCacheDirectory = cacheOpt->getString(1);
+    }
+    AlgorithmMetricSmoothing(myProgObj, mySurf, myMetric, myKernel, myMetricOut, myRoi, fixZeros, columnNum, myMethod, matchRoiColumns, weightCacheDirectory);
 }
 
 AlgorithmMetricSmoothing::AlgorithmMetricSmoothing(ProgressObject* myProgObj, const SurfaceFile* mySurf, const MetricFile* myMetric,
                                                    const double myKernel, MetricFile* myMetricOut, const MetricFile* myRoi, const bool fixZeros,
-                                                   const int64_t columnNum, const MetricSmoothingObject::Method myMethod, const bool matchRoiColumns) : AbstractAlgorithm(myProgObj)
+                                                   const int64_t columnNum, const MetricSmoothingObject::Method myMethod, const bool matchRoiColumns,
+                                                   const AString& weightCacheDirectory) : AbstractAlgorithm(myProgObj)
 {
     float precomputeWeightWork = 5.0f;//TODO: adjust this based on number of columns to smooth, if we ever end up using progress indicators
     LevelProgress myProgress(myProgObj, 1.0f + precomputeWeightWork);
@@ -167,9 +180,9 @@ AlgorithmMetricSmoothing::AlgorithmMetricSmoothing(ProgressObject* myProgObj, co
     myProgress.setTask("Precomputing Smoothing Weights");
     if (matchRoiColumns)
     {
-        mySmoothObj.grabNew(new MetricSmoothingObject(mySurf, myKernel, NULL, myMethod));//don't use an ROI to build weights when the ROI changes each time
+        mySmoothObj.grabNew(new MetricSmoothingObject(mySurf, myKernel, NULL, myMethod, weightCacheDirectory));//don't use an ROI to build weights when the ROI changes each time
     } else {
-        mySmoothObj.grabNew(new MetricSmoothingObject(mySurf, myKernel, myRoi, myMethod));
+        mySmoothObj.grabNew(new MetricSmoothingObject(mySurf, myKernel, myRoi, myMethod, weightCacheDirectory));
     }
     myProgress.reportProgress(precomputeWeightWork);
     if (columnNum == -1)
@@ -178,16 +191,21 @@ AlgorithmMetricSmoothing::AlgorithmMetricSmoothing(ProgressObject* myProgObj, co
         myMetricOut->setStructure(mySurf->getStructure());
         for (int32_t col = 0; col < numCols; ++col)
         {
-            myProgress.setTask("Smoothing Column " + AString::number(col));
             myMetricOut->setColumnName(col, myMetric->getColumnName(col) + ", smooth " + AString::number(myKernel));
             *(myMetricOut->getPaletteColorMapping(col)) = *(myMetric->getPaletteColorMapping(col));//copy the palette settings
-            if (myRoi != NULL && matchRoiColumns)
+        }
+        if (myRoi != NULL && matchRoiColumns)
+        {
+            for (int32_t col = 0; col < numCols; ++col)
             {
+                myProgress.setTask("Smoothing Column " + AString::number(col));
                 mySmoothObj->smoothColumn(myMetric, col, myMetricOut, col, myRoi, col, fixZeros);
-            } else {
-                mySmoothObj->smoothColumn(myMetric, col, myMetricOut, col, myRoi, 0, fixZeros);
+                myProgress.reportProgress(precomputeWeightWork + ((float)col + 1) / numCols);
             }
-            myProgress.reportProgress(precomputeWeightWork + ((float)col + 1) / numCols);
+        } else {//with a single roi, smooth blocks of columns per pass over the weights
+            myProgress.setTask("Smoothing Columns");
+            mySmoothObj->smoothMetric(myMetric, myMetricOut, myRoi, fixZeros);
+            myProgress.reportProgress(precomputeWeightWork + 1.0f);
         }
     } else {
         myMetricOut->setNumberOfNodesAndColumns(numNodes, 1);
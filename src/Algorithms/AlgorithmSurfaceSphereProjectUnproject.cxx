@@ -87,11 +87,12 @@ AlgorithmSurfaceSphereProjectUnproject::AlgorithmSurfaceSphereProjectUnproject(P
     *sphereOut = *sphereIn;
     sphereOut->setStructure(unprojectSphere->getStructure());
     CaretPointer<SignedDistanceHelper> myHelper = projectMod.getSignedDistanceHelper();
+    vector<BarycentricInfo> allInfo(numNodes);
+    myHelper->barycentricWeights(inCoords, numNodes, allInfo.data());//one batch query, so it can sort the points spatially
     for (int i = 0; i < numNodes; ++i)
     {
         int i3 = i * 3;
-        BarycentricInfo myInfo;
-        myHelper->barycentricWeights(inCoords + i3, myInfo);
+        const BarycentricInfo& myInfo = allInfo[i];
         Vector3D outCoord = myInfo.baryWeights[0] * Vector3D(unprojectCoords + myInfo.nodes[0] * 3) +
                             myInfo.baryWeights[1] * Vector3D(unprojectCoords + myInfo.nodes[1] * 3) +
                             myInfo.baryWeights[2] * Vector3D(unprojectCoords + myInfo.nodes[2] * 3);
@@ -24,6 +24,7 @@
 #include "CaretLogger.h"
 #include "CaretOMP.h"
 #include "Vector3D.h"
+#include "VolumeResamplingHelper.h"
 
 using namespace caret;
 using namespace std;
@@ -132,31 +133,31 @@ AlgorithmVolumeAffineResample::AlgorithmVolumeAffineResample(ProgressObject* myP
             *(outVol->getMapLabelTable(i)) = *(inVol->getMapLabelTable(i));
         }
     }
-    for (int64_t c = 0; c < numComponents; ++c)
+    int64_t frameSize = outDims[0] * outDims[1] * outDims[2];
+    VolumeResamplingHelper myHelp(inVol->getVolumeSpace(), frameSize, myMethod);//the transform is the same for every frame, so only compute it once
+#pragma omp CARET_PARFOR schedule(dynamic)
+    for (int64_t k = 0; k < outDims[2]; ++k)
     {
-        for (int64_t b = 0; b < numMaps; ++b)
+        for (int64_t j = 0; j < outDims[1]; ++j)
         {
-            if (myMethod == VolumeFile::CUBIC)
-            {
-                inVol->validateSplines(b, c);//because deconvolve is parallel, but won't execute parallel if we are already in a parallel section
-            }
-#pragma omp CARET_PARFOR schedule(dynamic)
-            for (int64_t k = 0; k < outDims[2]; ++k)
+            for (int64_t i = 0; i < outDims[0]; ++i)
             {
-                for (int64_t j = 0; j < outDims[1]; ++j)
-                {
-                    for (int64_t i = 0; i < outDims[0]; ++i)
-                    {
-                        Vector3D outCoord, inCoord;
-                        outVol->indexToSpace(i, j, k, outCoord);
-                        inCoord = xvec * outCoord[0] + yvec * outCoord[1] + zvec * outCoord[2] + offset;
-                        float interpVal = inVol->interpolateValue(inCoord, myMethod, NULL, b, c);
-                        outVol->setValue(interpVal, i, j, k, b, c);
-                    }
-                }
+                Vector3D outCoord, inCoord;
+                outVol->indexToSpace(i, j, k, outCoord);
+                inCoord = xvec * outCoord[0] + yvec * outCoord[1] + zvec * outCoord[2] + offset;
+                myHelp.setSourceCoordinate(outVol->getIndex(i, j, k), inCoord);
             }
         }
     }
+    vector<float> outFrame(frameSize);
+    for (int64_t c = 0; c < numComponents; ++c)
+    {
+        for (int64_t b = 0; b < numMaps; ++b)
+        {
+            myHelp.resampleFrame(inVol, b, c, outFrame.data());
+            outVol->setFrame(outFrame.data(), b, c);
+        }
+    }
 }
 
 float AlgorithmVolumeAffineResample::getAlgorithmInternalWeight()
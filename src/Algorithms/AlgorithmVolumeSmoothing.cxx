@@ -275,84 +275,115 @@ AlgorithmVolumeSmoothing::AlgorithmVolumeSmoothing(ProgressObject* myProgObj, co
 
 void AlgorithmVolumeSmoothing::smoothFrame(const float* inFrame, vector<int64_t> myDims, CaretArray<float> scratchFrame, CaretArray<float> scratchFrame2, CaretArray<float> scratchWeights, CaretArray<float> scratchWeights2, const VolumeFile* inVol, CaretArray<float> iweights, CaretArray<float> jweights, CaretArray<float> kweights, int irange, int jrange, int krange, const bool& fixZeros)
 {//this function should ONLY get invoked when the volume is orthogonal (axes are perpendicular, not necessarily aligned with x, y, z, and not necessarily equal spacing)
+    //all three passes accumulate whole rows along i, so the inner loops are contiguous and can be vectorized, while each voxel still adds its kernel terms in the same order as a per-voxel loop
+    const int rowSize = (int)myDims[0];
 #pragma omp CARET_PARFOR schedule(dynamic)
     for (int k = 0; k < myDims[2]; ++k)//smooth along i axis
     {
         for (int j = 0; j < myDims[1]; ++j)
         {
-            for (int i = 0; i < myDims[0]; ++i)
+            int64_t baseInd = inVol->getIndex(0, j, k, 0);//extra 0 on a default parameter is to prevent int->pointer vs int->int64 conversion ambiguity
+            const float* inRow = inFrame + baseInd;
+            float* sumRow = scratchFrame + baseInd;
+            float* weightRow = scratchWeights + baseInd;
+            for (int i = 0; i < rowSize; ++i)
+            {
+                sumRow[i] = 0.0f;
+                weightRow[i] = 0.0f;
+            }
+            for (int ioff = -irange; ioff <= irange; ++ioff)//apply one kernel offset to the whole row at a time
             {
-                int imin = i - irange, imax = i + irange + 1;//one-after array size convention
+                int imin = -ioff, imax = rowSize - ioff;//one-after array size convention
                 if (imin < 0) imin = 0;
-                if (imax > myDims[0]) imax = myDims[0];
-                float sum = 0.0f, weightsum = 0.0f;
-                int64_t baseInd = inVol->getIndex(0, j, k, 0);//extra 0 on a default parameter is to prevent int->pointer vs int->int64 conversion ambiguity
-                int64_t curInd = baseInd + i;
-                for (int ikern = imin; ikern < imax; ++ikern)
+                if (imax > rowSize) imax = rowSize;
+                float weight = iweights[ioff + irange];
+                if (fixZeros)
                 {
-                    int64_t thisIndex = baseInd + ikern;
-                    if ((!fixZeros || inFrame[thisIndex] != 0.0f))
+                    for (int i = imin; i < imax; ++i)
                     {
-                        float weight = iweights[ikern - i + irange];
-                        weightsum += weight;
-                        sum += weight * inFrame[thisIndex];
+                        float value = inRow[i + ioff];
+                        float useWeight = (value != 0.0f ? weight : 0.0f);//no branch, so this loop also vectorizes
+                        weightRow[i] += useWeight;
+                        sumRow[i] += useWeight * value;
+                    }
+                } else {
+                    for (int i = imin; i < imax; ++i)
+                    {
+                        weightRow[i] += weight;
+                        sumRow[i] += weight * inRow[i + ioff];//don't divide yet, we will divide later after we gather the weighted sums of the weighted sums of the weight sums (yes, that repetition is right)
                     }
                 }
-                scratchWeights[curInd] = weightsum;
-                scratchFrame[curInd] = sum;//don't divide yet, we will divide later after we gather the weighted sums of the weighted sums of the weight sums (yes, that repetition is right)
             }
         }
     }
 #pragma omp CARET_PARFOR schedule(dynamic)
     for (int k = 0; k < myDims[2]; ++k)//now j
     {
-        for (int i = 0; i < myDims[0]; ++i)
+        for (int j = 0; j < myDims[1]; ++j)
         {
-            for (int j = 0; j < myDims[1]; ++j)//step along the dimension being smoothed last for best cache coherence
+            int jmin = j - jrange, jmax = j + jrange + 1;//one-after array size convention
+            if (jmin < 0) jmin = 0;
+            if (jmax > myDims[1]) jmax = myDims[1];
+            int64_t baseInd = inVol->getIndex(0, j, k, 0);
+            float* sumRow = scratchFrame2 + baseInd;
+            float* weightRow = scratchWeights2 + baseInd;
+            for (int i = 0; i < rowSize; ++i)
+            {
+                sumRow[i] = 0.0f;
+                weightRow[i] = 0.0f;
+            }
+            for (int jkern = jmin; jkern < jmax; ++jkern)
             {
-                int jmin = j - jrange, jmax = j + jrange + 1;//one-after array size convention
-                if (jmin < 0) jmin = 0;
-                if (jmax > myDims[1]) jmax = myDims[1];
-                float sum = 0.0f, weightsum = 0.0f;
-                int64_t baseInd = inVol->getIndex(i, 0, k);
-                int64_t curInd = baseInd + j * myDims[0];
-                for (int jkern = jmin; jkern < jmax; ++jkern)
+                int64_t thisBase = inVol->getIndex(0, jkern, k, 0);
+                const float* thisSums = scratchFrame + thisBase;
+                const float* thisWeights = scratchWeights + thisBase;
+                float weight = jweights[jkern - j + jrange];
+                for (int i = 0; i < rowSize; ++i)
                 {
-                    int64_t thisIndex = baseInd + jkern * myDims[0];
-                    float weight = jweights[jkern - j + jrange];
-                    weightsum += weight * scratchWeights[thisIndex];
-                    sum += weight * scratchFrame[thisIndex];
+                    weightRow[i] += weight * thisWeights[i];
+                    sumRow[i] += weight * thisSums[i];//we now have the weighted sum of the weight sums
                 }
-                scratchWeights2[curInd] = weightsum;
-                scratchFrame2[curInd] = sum;//we now have the weighted sum of the weight sums
             }
         }
     }
-#pragma omp CARET_PARFOR schedule(dynamic)
-    for (int j = 0; j < myDims[1]; ++j)//and finally k
+#pragma omp CARET_PAR
     {
-        for (int i = 0; i < myDims[0]; ++i)
+        vector<float> weightRow(rowSize);//sums go straight into the output frame, but the weight sums need a per-thread row
+#pragma omp CARET_FOR schedule(dynamic)
+        for (int k = 0; k < myDims[2]; ++k)//and finally k
         {
-            for (int k = 0; k < myDims[2]; ++k)//ditto
+            int kmin = k - krange, kmax = k + krange + 1;//one-after array size convention
+            if (kmin < 0) kmin = 0;
+            if (kmax > myDims[2]) kmax = myDims[2];
+            for (int j = 0; j < myDims[1]; ++j)
             {
-                int64_t baseInd = inVol->getIndex(i, j, 0);
-                int64_t curInd = baseInd + k * myDims[0] * myDims[1];
-                int kmin = k - krange, kmax = k + krange + 1;//one-after array size convention
-                if (kmin < 0) kmin = 0;
-                if (kmax > myDims[2]) kmax = myDims[2];
-                float sum = 0.0f, weightsum = 0.0f;
+                int64_t baseInd = inVol->getIndex(0, j, k, 0);
+                float* sumRow = scratchFrame + baseInd;
+                for (int i = 0; i < rowSize; ++i)
+                {
+                    sumRow[i] = 0.0f;
+                    weightRow[i] = 0.0f;
+                }
                 for (int kkern = kmin; kkern < kmax; ++kkern)
                 {
-                    int64_t thisIndex = baseInd + kkern * myDims[0] * myDims[1];
+                    int64_t thisBase = inVol->getIndex(0, j, kkern, 0);
+                    const float* thisSums = scratchFrame2 + thisBase;
+                    const float* thisWeights = scratchWeights2 + thisBase;
                     float weight = kweights[kkern - k + krange];
-                    weightsum += weight * scratchWeights2[thisIndex];
-                    sum += weight * scratchFrame2[thisIndex];
+                    for (int i = 0; i < rowSize; ++i)
+                    {
+                        weightRow[i] += weight * thisWeights[i];
+                        sumRow[i] += weight * thisSums[i];
+                    }
                 }
-                if (weightsum != 0.0f)
+                for (int i = 0; i < rowSize; ++i)
                 {
-                    scratchFrame[curInd] = sum / weightsum;//NOW we can divide
-                } else {
-                    scratchFrame[curInd] = 0.0f;
+                    if (weightRow[i] != 0.0f)
+                    {
+                        sumRow[i] /= weightRow[i];//NOW we can divide
+                    } else {
+                        sumRow[i] = 0.0f;
+                    }
                 }
             }
         }
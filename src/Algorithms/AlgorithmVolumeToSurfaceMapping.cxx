@@ -48,6 +48,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "AlgorithmVolumeToSurfaceMapping.h"
 #include "AlgorithmException.h"
 
+#include "CaretAssert.h"
 #include "CaretOMP.h"
 #include "FloatMatrix.h"
 #include "MathFunctions.h"
@@ -56,12 +57,25 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "TopologyHelper.h"
 #include "Vector3D.h"
 #include "VolumeFile.h"
+#include "VolumeResamplingHelper.h"
+#include "WeightOperatorFile.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QFile>
 
 #include <cmath>
 
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    const char RIBBON_WEIGHTS_MAGIC[] = "WBRIBW01";
+    const int64_t RIBBON_MAPPING_COLUMN_BLOCK = WeightOperatorFile::COLUMN_BLOCK;
+    const int64_t RIBBON_MASK_CHUNK = 1 << 20;//voxels per piece of roi mask added to the hash
+}
+
 AString AlgorithmVolumeToSurfaceMapping::getCommandSwitch()
 {
     return "-volume-to-surface-mapping";
@@ -97,6 +111,10 @@ OperationParameters* AlgorithmVolumeToSurfaceMapping::getParameters()
     OptionalParameter* ribbonWeights = ribbonOpt->createOptionalParameter(5, "-output-weights", "write the voxel weights for a vertex to a volume file");
     ribbonWeights->addIntegerParameter(1, "vertex", "the vertex number to get the voxel weights for, 0-based");
     ribbonWeights->addVolumeOutputParameter(2, "weights-out", "volume to write the weights to");
+    OptionalParameter* ribbonWeightsFileOut = ribbonOpt->createOptionalParameter(6, "-write-weights", "write the voxel weights of all vertices to a file, for use with -read-weights");
+    ribbonWeightsFileOut->addStringParameter(1, "weights-file", "output - the file to write the weights to");
+    OptionalParameter* ribbonWeightsFileIn = ribbonOpt->createOptionalParameter(7, "-read-weights", "use voxel weights from a file written by -write-weights instead of computing them");
+    ribbonWeightsFileIn->addStringParameter(1, "weights-file", "the file to read the weights from");
     
     OptionalParameter* myelinStyleOpt = ret->createOptionalParameter(9, "-myelin-style", "use the method from myelin mapping");
     myelinStyleOpt->addVolumeParameter(1, "ribbon-roi", "an roi volume of the cortical ribbon for this hemisphere");
@@ -114,7 +132,10 @@ OperationParameters* AlgorithmVolumeToSurfaceMapping::getParameters()
         "The volume ROI is useful to exclude partial volume effects of voxels the surfaces pass through, and will cause the mapping to ignore " +
         "voxels that don't have a positive value in the mask.  The subdivision number specifies how it approximates the amount of the volume the polyhedron " +
         "intersects, by splitting each voxel into NxNxN pieces, and checking whether the center of each piece is inside the polyhedron.  If you have very large " +
-        "voxels, consider increasing this if you get zeros in your output.\n\n" +
+        "voxels, consider increasing this if you get zeros in your output.  " +
+        "Computing the ribbon weights is much slower than applying them, so when mapping many volumes with the same surfaces, use -write-weights once, and " +
+        "-read-weights for the other volumes.  A weights file is only accepted when the volume space, both surfaces, the volume ROI and the subdivision number " +
+        "match the ones it was computed with.\n\n" +
         "The myelin style method uses part of the caret5 myelin mapping command to do the mapping: for each surface vertex, take all voxels closer than the thickness at the vertex " +
         "that are within the ribbon ROI, and less than half the thickness value away from the vertex along the direction of the surface normal, and apply a gaussian kernel " +
         "with the specified sigma to them to get the weights to use."
@@ -228,7 +249,19 @@ void AlgorithmVolumeToSurfaceMapping::useParameters(OperationParameters* myParam
                 weightsOutVertex = (int)ribbonWeights->getInteger(1);
                 weightsOut = ribbonWeights->getOutputVolume(2);
             }
-            AlgorithmVolumeToSurfaceMapping(myProgObj, myVolume, mySurface, myMetricOut, innerSurf, outerSurf, myRoiVol, subdivisions, mySubVol, weightsOutVertex, weightsOut);
+            AString weightsFileOut, weightsFileIn;
+            OptionalParameter* ribbonWeightsFileOut = ribbonOpt->getOptionalParameter(6);
+            if (ribbonWeightsFileOut->m_present)
+            {
+                weightsFileOut = ribbonWeightsFileOut->getString(1);
+            }
+            OptionalParameter* ribbonWeightsFileIn = ribbonOpt->getOptionalParameter(7);
+            if (ribbonWeightsFileIn->m_present)
+            {
+                weightsFileIn = ribbonWeightsFileIn->getString(1);
+            }
+            AlgorithmVolumeToSurfaceMapping(myProgObj, myVolume, mySurface, myMetricOut, innerSurf, outerSurf, myRoiVol, subdivisions, mySubVol, weightsOutVertex, weightsOut,
+                                            weightsFileIn, weightsFileOut);
             break;
         }
         case MYELIN_STYLE:
@@ -279,16 +312,18 @@ AlgorithmVolumeToSurfaceMapping::AlgorithmVolumeToSurfaceMapping(ProgressObject*
             methodName = " enclosing voxel";
             break;
     }
+    VolumeResamplingHelper myHelp(myVolume->getVolumeSpace(), numNodes, myMethod);//node locations are the same for every frame, and cubic deconvolves one frame at a time instead of caching splines in the volume
+#pragma omp CARET_PARFOR
+    for (int64_t node = 0; node < numNodes; ++node)
+    {
+        myHelp.setSourceCoordinate(node, mySurface->getCoordinate(node));
+    }
     if (mySubVol == -1)
     {
         for (int64_t i = 0; i < myVolDims[3]; ++i)
         {
             for (int64_t j = 0; j < myVolDims[4]; ++j)
             {
-                if (myMethod == VolumeFile::CUBIC)
-                {
-                    myVolume->validateSplines(i, j);//to do spline deconvolution in parallel
-                }
                 AString metricLabel = myVolume->getMapName(i);
                 if (myVolDims[4] != 1)
                 {
@@ -297,21 +332,13 @@ AlgorithmVolumeToSurfaceMapping::AlgorithmVolumeToSurfaceMapping(ProgressObject*
                 metricLabel += methodName;
                 int64_t thisCol = i * myVolDims[4] + j;
                 myMetricOut->setColumnName(thisCol, metricLabel);
-#pragma omp CARET_PARFOR
-                for (int64_t node = 0; node < numNodes; ++node)
-                {
-                    myArray[node] = myVolume->interpolateValue(mySurface->getCoordinate(node), myMethod, NULL, i, j);
-                }
+                myHelp.resampleFrame(myVolume, i, j, myArray.data());
                 myMetricOut->setValuesForColumn(thisCol, myArray.data());
             }
         }
     } else {
         for (int64_t j = 0; j < myVolDims[4]; ++j)
         {
-            if (myMethod == VolumeFile::CUBIC)
-            {
-                myVolume->validateSplines(mySubVol, j);//to do spline deconvolution in parallel
-            }
             AString metricLabel = myVolume->getMapName(mySubVol);
             if (myVolDims[4] != 1)
             {
@@ -320,11 +347,7 @@ AlgorithmVolumeToSurfaceMapping::AlgorithmVolumeToSurfaceMapping(ProgressObject*
             metricLabel += methodName;
             int64_t thisCol = j;
             myMetricOut->setColumnName(thisCol, metricLabel);
-#pragma omp CARET_PARFOR
-            for (int64_t node = 0; node < numNodes; ++node)
-            {
-                myArray[node] = myVolume->interpolateValue(mySurface->getCoordinate(node), myMethod, NULL, mySubVol, j);
-            }
+            myHelp.resampleFrame(myVolume, mySubVol, j, myArray.data());
             myMetricOut->setValuesForColumn(thisCol, myArray.data());
         }
     }
@@ -333,7 +356,8 @@ AlgorithmVolumeToSurfaceMapping::AlgorithmVolumeToSurfaceMapping(ProgressObject*
 //ribbon mapping
 AlgorithmVolumeToSurfaceMapping::AlgorithmVolumeToSurfaceMapping(ProgressObject* myProgObj, const VolumeFile* myVolume, const SurfaceFile* mySurface, MetricFile* myMetricOut,
                                                                  const SurfaceFile* innerSurf, const SurfaceFile* outerSurf, const VolumeFile* roiVol,
-                                                                 const int32_t& subdivisions, const int64_t& mySubVol, const int& weightsOutVertex, VolumeFile* weightsOut) : AbstractAlgorithm(myProgObj)
+                                                                 const int32_t& subdivisions, const int64_t& mySubVol, const int& weightsOutVertex, VolumeFile* weightsOut,
+                                                                 const AString& weightsFileIn, const AString& weightsFileOut) : AbstractAlgorithm(myProgObj)
 {
     LevelProgress myProgress(myProgObj);
     vector<int64_t> myVolDims;
@@ -368,7 +392,22 @@ AlgorithmVolumeToSurfaceMapping::AlgorithmVolumeToSurfaceMapping(ProgressObject*
         weightsOut->reinitialize(weightDims, myVolume->getSform());
     }
     vector<vector<VoxelWeight> > myWeights;
-    precomputeWeightsRibbon(myWeights, myVolume, innerSurf, outerSurf, roiVol, subdivisions);
+    if (weightsFileIn != "" || weightsFileOut != "")
+    {
+        const AString key = getRibbonWeightsKey(myVolume, innerSurf, outerSurf, roiVol, subdivisions);
+        if (weightsFileIn != "")
+        {
+            readRibbonWeights(weightsFileIn, key, myVolume, numNodes, myWeights);
+        } else {
+            precomputeWeightsRibbon(myWeights, myVolume, innerSurf, outerSurf, roiVol, subdivisions);
+        }
+        if (weightsFileOut != "")
+        {
+            writeRibbonWeights(weightsFileOut, key, myVolume, myWeights);
+        }
+    } else {
+        precomputeWeightsRibbon(myWeights, myVolume, innerSurf, outerSurf, roiVol, subdivisions);
+    }
     if (weightsOut != NULL)
     {
         weightsOut->setValueAllVoxels(0.0f);
@@ -379,77 +418,35 @@ AlgorithmVolumeToSurfaceMapping::AlgorithmVolumeToSurfaceMapping(ProgressObject*
             weightsOut->setValue(vertexWeights[i].weight, vertexWeights[i].ijk);
         }
     }
-    CaretArray<float> myScratchArray(numNodes);
-    float* myScratch = myScratchArray.getArray();
+    vector<int64_t> bricks, components;
     if (mySubVol == -1)
     {
         for (int64_t i = 0; i < myVolDims[3]; ++i)
         {
             for (int64_t j = 0; j < myVolDims[4]; ++j)
             {
-                int64_t thisCol = i * myVolDims[4] + j;
-                AString metricLabel = myVolume->getMapName(i);
-                if (myVolDims[4] != 1)
-                {
-                    metricLabel += " component " + AString::number(j);
-                }
-                metricLabel += " ribbon constrained";
-                myMetricOut->setColumnName(thisCol, metricLabel);
-#pragma omp CARET_PARFOR schedule(dynamic)
-                for (int64_t node = 0; node < numNodes; ++node)
-                {
-                    myScratch[node] = 0.0f;
-                    float totalWeight = 0.0f;
-                    int numVoxels = (int)myWeights[node].size();
-                    for (int voxel = 0; voxel < numVoxels; ++voxel)
-                    {
-                        float thisWeight = myWeights[node][voxel].weight;
-                        totalWeight += thisWeight;
-                        myScratch[node] += thisWeight * myVolume->getValue(myWeights[node][voxel].ijk, i, j);
-                    }
-                    if (totalWeight != 0.0f)
-                    {
-                        myScratch[node] /= totalWeight;
-                    } else {
-                        myScratch[node] = 0.0f;
-                    }
-                }
-                myMetricOut->setValuesForColumn(thisCol, myScratch);
+                bricks.push_back(i);
+                components.push_back(j);
             }
         }
     } else {
         for (int64_t j = 0; j < myVolDims[4]; ++j)
         {
-            AString metricLabel = myVolume->getMapName(mySubVol);
-            if (myVolDims[4] != 1)
-            {
-                metricLabel += " component " + AString::number(j);
-            }
-            metricLabel += " ribbon constrained";
-            int64_t thisCol = j;
-            myMetricOut->setColumnName(thisCol, metricLabel);
-#pragma omp CARET_PARFOR schedule(dynamic)
-            for (int64_t node = 0; node < numNodes; ++node)
-            {
-                    myScratch[node] = 0.0f;
-                    float totalWeight = 0.0f;
-                    int numVoxels = (int)myWeights[node].size();
-                    for (int voxel = 0; voxel < numVoxels; ++voxel)
-                    {
-                        float thisWeight = myWeights[node][voxel].weight;
-                        totalWeight += thisWeight;
-                        myScratch[node] += thisWeight * myVolume->getValue(myWeights[node][voxel].ijk, mySubVol, j);
-                    }
-                    if (totalWeight != 0.0f)
-                    {
-                        myScratch[node] /= totalWeight;
-                    } else {
-                        myScratch[node] = 0.0f;
-                    }
-            }
-            myMetricOut->setValuesForColumn(thisCol, myScratch);
+            bricks.push_back(mySubVol);
+            components.push_back(j);
         }
     }
+    for (int64_t thisCol = 0; thisCol < (int64_t)bricks.size(); ++thisCol)
+    {
+        AString metricLabel = myVolume->getMapName(bricks[thisCol]);
+        if (myVolDims[4] != 1)
+        {
+            metricLabel += " component " + AString::number(components[thisCol]);
+        }
+        metricLabel += " ribbon constrained";
+        myMetricOut->setColumnName(thisCol, metricLabel);
+    }
+    mapRibbonWeights(myVolume, myWeights, bricks, components, myMetricOut);
 }
 
 //myelin style mapping
@@ -622,6 +619,249 @@ void AlgorithmVolumeToSurfaceMapping::precomputeWeightsRibbon(vector<vector<Voxe
     }
 }
 
+AString AlgorithmVolumeToSurfaceMapping::getRibbonWeightsKey(const VolumeFile* myVolume, const SurfaceFile* innerSurf, const SurfaceFile* outerSurf,
+                                                             const VolumeFile* roiVol, const int& numDivisions)
+{//the weights depend on the voxel grid, the coordinates and topology of both surfaces, which voxels are in the roi, and the subdivisions
+    QCryptographicHash myHash(QCryptographicHash::Sha1);
+    myHash.addData(RIBBON_WEIGHTS_MAGIC, sizeof(RIBBON_WEIGHTS_MAGIC));//so that a format change also changes every key
+    int32_t divisions = numDivisions;
+    myHash.addData((const char*)&divisions, sizeof(divisions));
+    const int64_t* dims = myVolume->getVolumeSpace().getDims();
+    myHash.addData((const char*)dims, sizeof(int64_t) * 3);
+    const vector<vector<float> >& mySform = myVolume->getSform();
+    for (int i = 0; i < 3; ++i)
+    {
+        myHash.addData((const char*)mySform[i].data(), sizeof(float) * 4);
+    }
+    const SurfaceFile* mySurfs[2] = { innerSurf, outerSurf };
+    for (int i = 0; i < 2; ++i)
+    {
+        int32_t numNodes = mySurfs[i]->getNumberOfNodes(), numTiles = mySurfs[i]->getNumberOfTriangles();
+        myHash.addData((const char*)&numNodes, sizeof(numNodes));
+        myHash.addData((const char*)&numTiles, sizeof(numTiles));
+        myHash.addData((const char*)mySurfs[i]->getCoordinateData(), sizeof(float) * 3 * numNodes);
+        if (numTiles > 0)
+        {
+            myHash.addData((const char*)mySurfs[i]->getTriangle(0), sizeof(int32_t) * 3 * numTiles);
+        }
+    }
+    if (roiVol != NULL)
+    {//only whether each voxel is in the roi matters to the weights, so hash the mask rather than the values
+        int64_t numVoxels = dims[0] * dims[1] * dims[2];
+        const float* roiFrame = roiVol->getFrame();
+        vector<char> mask(min(numVoxels, RIBBON_MASK_CHUNK));
+        for (int64_t start = 0; start < numVoxels; start += RIBBON_MASK_CHUNK)
+        {//in pieces, so huge volumes don't need an int sized QByteArray, hashing in pieces gives the same digest
+            int64_t numThisChunk = min(RIBBON_MASK_CHUNK, numVoxels - start);
+            for (int64_t i = 0; i < numThisChunk; ++i)
+            {
+                mask[i] = (roiFrame[start + i] > 0.0f ? 1 : 0);
+            }
+            myHash.addData(mask.data(), (int)numThisChunk);
+        }
+    }
+    return AString(myHash.result().toHex());
+}
+
+void AlgorithmVolumeToSurfaceMapping::writeRibbonWeights(const AString& fileName, const AString& key, const VolumeFile* myVolume, const vector<vector<VoxelWeight> >& myWeights)
+{//stored as CSR: row start for each vertex, then voxel offsets within a frame and the weights, arrays are raw in the byte order of the writing machine
+    const int64_t* dims = myVolume->getVolumeSpace().getDims();
+    int64_t numNodes = (int64_t)myWeights.size();
+    vector<int64_t> rowStart(numNodes + 1, 0);
+    for (int64_t node = 0; node < numNodes; ++node)
+    {
+        rowStart[node + 1] = rowStart[node] + (int64_t)myWeights[node].size();
+    }
+    int64_t numEntries = rowStart[numNodes];
+    vector<int64_t> voxelOffsets(numEntries);
+    vector<float> voxelWeights(numEntries);
+    for (int64_t node = 0; node < numNodes; ++node)
+    {
+        int64_t entry = rowStart[node];
+        int numVoxels = (int)myWeights[node].size();
+        for (int voxel = 0; voxel < numVoxels; ++voxel)
+        {
+            const int64_t* ijk = myWeights[node][voxel].ijk;
+            voxelOffsets[entry] = ijk[0] + dims[0] * (ijk[1] + dims[1] * ijk[2]);
+            voxelWeights[entry] = myWeights[node][voxel].weight;
+            ++entry;
+        }
+    }
+    WeightOperatorFile myFile;
+    if (!myFile.openWrite(fileName, RIBBON_WEIGHTS_MAGIC))
+    {
+        throw AlgorithmException("failed to open ribbon weights file '" + fileName + "' for writing");
+    }
+    myFile.getStream() << key.toAscii() << (qint64)numNodes << (qint64)dims[0] << (qint64)dims[1] << (qint64)dims[2] << (qint64)numEntries;
+    myFile.writeByteOrderCheck();
+    myFile.writeRawData(rowStart.data(), sizeof(int64_t) * (numNodes + 1));
+    myFile.writeRawData(voxelOffsets.data(), sizeof(int64_t) * numEntries);
+    myFile.writeRawData(voxelWeights.data(), sizeof(float) * numEntries);
+    if (!myFile.finishWrite())
+    {
+        throw AlgorithmException("failed to write ribbon weights file '" + fileName + "'");
+    }
+}
+
+void AlgorithmVolumeToSurfaceMapping::readRibbonWeights(const AString& fileName, const AString& key, const VolumeFile* myVolume, const int64_t& numNodes,
+                                                        vector<vector<VoxelWeight> >& myWeights)
+{
+    WeightOperatorFile myFile;
+    if (!QFile::exists(fileName))
+    {
+        throw AlgorithmException("failed to open ribbon weights file '" + fileName + "'");
+    }
+    if (!myFile.openRead(fileName, RIBBON_WEIGHTS_MAGIC))
+    {
+        throw AlgorithmException("'" + fileName + "' is not a ribbon weights file");
+    }
+    QDataStream& myStream = myFile.getStream();
+    QByteArray storedKey;
+    qint64 fileNumNodes, fileDims[3], numEntries;
+    myStream >> storedKey >> fileNumNodes >> fileDims[0] >> fileDims[1] >> fileDims[2] >> numEntries;
+    if (myStream.status() != QDataStream::Ok || numEntries < 0)
+    {
+        throw AlgorithmException("ribbon weights file '" + fileName + "' is truncated or corrupt");
+    }
+    const int64_t* dims = myVolume->getVolumeSpace().getDims();
+    if (fileDims[0] != dims[0] || fileDims[1] != dims[1] || fileDims[2] != dims[2])
+    {
+        throw AlgorithmException("ribbon weights file '" + fileName + "' was computed for a volume with different dimensions");
+    }
+    if (fileNumNodes != numNodes)
+    {
+        throw AlgorithmException("ribbon weights file '" + fileName + "' was computed for surfaces with a different number of vertices");
+    }
+    if (AString(storedKey) != key)
+    {
+        throw AlgorithmException("ribbon weights file '" + fileName + "' was computed with a different volume space, surfaces, volume roi, or number of subdivisions");
+    }
+    if (!myFile.readByteOrderCheck())
+    {
+        throw AlgorithmException("ribbon weights file '" + fileName + "' was written on a machine with a different byte order");
+    }
+    const int64_t entrySize = sizeof(int64_t) + sizeof(float), rowStartBytes = sizeof(int64_t) * (numNodes + 1);
+    int64_t remaining = myFile.getRemainingBytes() - rowStartBytes;
+    if (remaining < 0 || numEntries > remaining / entrySize)
+    {//check before allocating, a corrupt count could otherwise ask for any amount of memory
+        throw AlgorithmException("ribbon weights file '" + fileName + "' is truncated or corrupt, it is too short for " + AString::number(numEntries) + " weights");
+    }
+    vector<int64_t> rowStart(numNodes + 1);
+    vector<int64_t> voxelOffsets(numEntries);
+    vector<float> voxelWeights(numEntries);
+    bool ok = (myFile.readRawData(rowStart.data(), sizeof(int64_t) * (numNodes + 1)) &&
+               myFile.readRawData(voxelOffsets.data(), sizeof(int64_t) * numEntries) &&
+               myFile.readRawData(voxelWeights.data(), sizeof(float) * numEntries));
+    if (ok)
+    {//a truncated or corrupted file must not lead to out of range accesses
+        const int64_t numVoxels = dims[0] * dims[1] * dims[2];
+        ok = (rowStart[0] == 0 && rowStart[numNodes] == numEntries);
+        for (int64_t node = 0; ok && node < numNodes; ++node)
+        {
+            if (rowStart[node + 1] < rowStart[node]) ok = false;
+        }
+        for (int64_t entry = 0; ok && entry < numEntries; ++entry)
+        {
+            if (voxelOffsets[entry] < 0 || voxelOffsets[entry] >= numVoxels) ok = false;
+        }
+    }
+    if (!ok)
+    {
+        throw AlgorithmException("ribbon weights file '" + fileName + "' is truncated or corrupt");
+    }
+    myWeights.resize(numNodes);
+    const int64_t frameSlice = dims[0] * dims[1];
+    for (int64_t node = 0; node < numNodes; ++node)
+    {
+        myWeights[node].clear();
+        myWeights[node].reserve(rowStart[node + 1] - rowStart[node]);
+        for (int64_t entry = rowStart[node]; entry < rowStart[node + 1]; ++entry)
+        {
+            int64_t ijk[3];
+            ijk[2] = voxelOffsets[entry] / frameSlice;
+            ijk[1] = (voxelOffsets[entry] % frameSlice) / dims[0];
+            ijk[0] = voxelOffsets[entry] % dims[0];
+            myWeights[node].push_back(VoxelWeight(voxelWeights[entry], ijk));
+        }
+    }
+}
+
+void AlgorithmVolumeToSurfaceMapping::mapRibbonWeights(const VolumeFile* myVolume, const vector<vector<VoxelWeight> >& myWeights, const vector<int64_t>& bricks,
+                                                       const vector<int64_t>& components, MetricFile* myMetricOut)
+{//flatten the weights into a sparse gather over voxel offsets within a frame, so that blocks of columns share each pass over the weights
+    CaretAssert(bricks.size() == components.size());
+    const int64_t* dims = myVolume->getVolumeSpace().getDims();
+    int64_t numNodes = (int64_t)myWeights.size();
+    vector<int64_t> rowStart(numNodes + 1, 0);
+    for (int64_t node = 0; node < numNodes; ++node)
+    {
+        rowStart[node + 1] = rowStart[node] + (int64_t)myWeights[node].size();
+    }
+    int64_t numEntries = rowStart[numNodes];
+    vector<int64_t> voxelOffsets(numEntries);
+    vector<float> voxelWeights(numEntries);
+    vector<float> totalWeights(numNodes);
+#pragma omp CARET_PARFOR schedule(dynamic)
+    for (int64_t node = 0; node < numNodes; ++node)
+    {
+        float totalWeight = 0.0f;
+        int64_t entry = rowStart[node];
+        int numVoxels = (int)myWeights[node].size();
+        for (int voxel = 0; voxel < numVoxels; ++voxel)
+        {
+            const int64_t* ijk = myWeights[node][voxel].ijk;
+            voxelOffsets[entry] = ijk[0] + dims[0] * (ijk[1] + dims[1] * ijk[2]);
+            voxelWeights[entry] = myWeights[node][voxel].weight;
+            totalWeight += myWeights[node][voxel].weight;
+            ++entry;
+        }
+        totalWeights[node] = totalWeight;
+    }
+    int64_t numColumns = (int64_t)bricks.size();
+    vector<float> myScratch(numNodes * RIBBON_MAPPING_COLUMN_BLOCK);
+    for (int64_t start = 0; start < numColumns; start += RIBBON_MAPPING_COLUMN_BLOCK)
+    {//each column accumulates in the same order as mapping it alone, so blocking columns doesn't change the results
+        int64_t numThisBlock = min(RIBBON_MAPPING_COLUMN_BLOCK, numColumns - start);
+        const float* frames[RIBBON_MAPPING_COLUMN_BLOCK];
+        for (int64_t c = 0; c < numThisBlock; ++c)
+        {
+            frames[c] = myVolume->getFrame(bricks[start + c], components[start + c]);
+        }
+#pragma omp CARET_PARFOR schedule(dynamic)
+        for (int64_t node = 0; node < numNodes; ++node)
+        {
+            float accum[RIBBON_MAPPING_COLUMN_BLOCK];
+            for (int64_t c = 0; c < numThisBlock; ++c)
+            {
+                accum[c] = 0.0f;
+            }
+            int64_t rowEnd = rowStart[node + 1];
+            for (int64_t entry = rowStart[node]; entry < rowEnd; ++entry)
+            {
+                int64_t offset = voxelOffsets[entry];
+                float thisWeight = voxelWeights[entry];
+                for (int64_t c = 0; c < numThisBlock; ++c)
+                {
+                    accum[c] += thisWeight * frames[c][offset];
+                }
+            }
+            for (int64_t c = 0; c < numThisBlock; ++c)
+            {
+                if (totalWeights[node] != 0.0f)
+                {
+                    myScratch[c * numNodes + node] = accum[c] / totalWeights[node];
+                } else {
+                    myScratch[c * numNodes + node] = 0.0f;
+                }
+            }
+        }
+        for (int64_t c = 0; c < numThisBlock; ++c)
+        {
+            myMetricOut->setValuesForColumn(start + c, myScratch.data() + c * numNodes);
+        }
+    }
+}
+
 void AlgorithmVolumeToSurfaceMapping::precomputeWeightsMyelin(vector<vector<VoxelWeight> >& myWeights, const SurfaceFile* mySurface, const VolumeFile* roiVol,
                                                               const MetricFile* thickness, const float& sigma)
 {
@@ -75,6 +75,10 @@ namespace caret {
         void precomputeWeightsRibbon(std::vector<std::vector<VoxelWeight> >& myWeights, const VolumeFile* myVol, const SurfaceFile* innerSurf, const SurfaceFile* outerSurf, const VolumeFile* roiVol, const int& numDivisions);//surfaces MUST be in node correspondence, otherwise SEVERE strangeness, possible crashes
         float computeVoxelFraction(const VolumeFile* myVolume, const int64_t* ijk, PolyInfo& myPoly, const int divisions, const Vector3D& ivec, const Vector3D& jvec, const Vector3D& kvec);
         void precomputeWeightsMyelin(std::vector<std::vector<VoxelWeight> >& myWeights, const SurfaceFile* mySurface, const VolumeFile* roiVol, const MetricFile* thickness, const float& sigma);
+        static AString getRibbonWeightsKey(const VolumeFile* myVolume, const SurfaceFile* innerSurf, const SurfaceFile* outerSurf, const VolumeFile* roiVol, const int& numDivisions);
+        static void writeRibbonWeights(const AString& fileName, const AString& key, const VolumeFile* myVolume, const std::vector<std::vector<VoxelWeight> >& myWeights);
+        static void readRibbonWeights(const AString& fileName, const AString& key, const VolumeFile* myVolume, const int64_t& numNodes, std::vector<std::vector<VoxelWeight> >& myWeights);
+        static void mapRibbonWeights(const VolumeFile* myVolume, const std::vector<std::vector<VoxelWeight> >& myWeights, const std::vector<int64_t>& bricks, const std::vector<int64_t>& components, MetricFile* myMetricOut);
         enum Method
         {
             TRILINEAR,
@@ -91,7 +95,8 @@ namespace caret {
                                         const int64_t& mySubVol = -1);
         AlgorithmVolumeToSurfaceMapping(ProgressObject* myProgObj, const VolumeFile* myVolume, const SurfaceFile* mySurface, MetricFile* myMetricOut,
                                         const SurfaceFile* innerSurf, const SurfaceFile* outerSurf, const VolumeFile* roiVol = NULL, const int32_t& subdivisions = 3,
-                                        const int64_t& mySubVol = -1, const int& weightsOutVertex = -1, VolumeFile* weightsOut = NULL);
+                                        const int64_t& mySubVol = -1, const int& weightsOutVertex = -1, VolumeFile* weightsOut = NULL,
+                                        const AString& weightsFileIn = "", const AString& weightsFileOut = "");
         AlgorithmVolumeToSurfaceMapping(ProgressObject* myProgObj, const VolumeFile* myVolume, const SurfaceFile* mySurface, MetricFile* myMetricOut,
                                         const VolumeFile* roiVol, const MetricFile* thickness, const float& sigma, const int64_t& mySubVol = -1);
         static OperationParameters* getParameters();
@@ -24,6 +24,7 @@
 #include "CaretLogger.h"
 #include "CaretOMP.h"
 #include "Vector3D.h"
+#include "VolumeResamplingHelper.h"
 #include "WarpfieldFile.h"
 
 using namespace caret;
@@ -118,40 +119,38 @@ AlgorithmVolumeWarpfieldResample::AlgorithmVolumeWarpfieldResample(ProgressObjec
             *(outVol->getMapLabelTable(i)) = *(inVol->getMapLabelTable(i));
         }
     }
-    for (int64_t c = 0; c < numComponents; ++c)
+    int64_t frameSize = outDims[0] * outDims[1] * outDims[2];
+    VolumeResamplingHelper myHelp(inVol->getVolumeSpace(), frameSize, myMethod);//the warp is the same for every frame, so only look it up once
+#pragma omp CARET_PARFOR schedule(dynamic)
+    for (int64_t k = 0; k < outDims[2]; ++k)
     {
-        for (int64_t b = 0; b < numMaps; ++b)
+        for (int64_t j = 0; j < outDims[1]; ++j)
         {
-            if (myMethod == VolumeFile::CUBIC)
-            {
-                inVol->validateSplines(b, c);//because deconvolve is parallel, but won't execute parallel if we are already in a parallel section
-            }
-#pragma omp CARET_PARFOR schedule(dynamic)
-            for (int64_t k = 0; k < outDims[2]; ++k)
+            for (int64_t i = 0; i < outDims[0]; ++i)
             {
-                for (int64_t j = 0; j < outDims[1]; ++j)
+                Vector3D outCoord, inCoord, displacement;
+                outVol->indexToSpace(i, j, k, outCoord);
+                bool validDisplacement = false;
+                displacement[0] = warpfield->interpolateValue(outCoord, VolumeFile::TRILINEAR, &validDisplacement, 0);
+                if (validDisplacement)
                 {
-                    for (int64_t i = 0; i < outDims[0]; ++i)
-                    {
-                        Vector3D outCoord, inCoord, displacement;
-                        outVol->indexToSpace(i, j, k, outCoord);
-                        bool validDisplacement = false;
-                        displacement[0] = warpfield->interpolateValue(outCoord, VolumeFile::TRILINEAR, &validDisplacement, 0);
-                        if (validDisplacement)
-                        {
-                            displacement[1] = warpfield->interpolateValue(outCoord, VolumeFile::TRILINEAR, NULL, 1);
-                            displacement[2] = warpfield->interpolateValue(outCoord, VolumeFile::TRILINEAR, NULL, 2);
-                            inCoord = outCoord + displacement;
-                            float interpVal = inVol->interpolateValue(inCoord, myMethod, NULL, b, c);
-                            outVol->setValue(interpVal, i, j, k, b, c);
-                        } else {
-                            outVol->setValue(VolumeFile::INVALID_INTERP_VALUE, i, j, k, b, c);
-                        }
-                    }
-                }
+                    displacement[1] = warpfield->interpolateValue(outCoord, VolumeFile::TRILINEAR, NULL, 1);
+                    displacement[2] = warpfield->interpolateValue(outCoord, VolumeFile::TRILINEAR, NULL, 2);
+                    inCoord = outCoord + displacement;
+                    myHelp.setSourceCoordinate(outVol->getIndex(i, j, k), inCoord);
+                }//otherwise, the helper outputs INVALID_INTERP_VALUE
             }
         }
     }
+    vector<float> outFrame(frameSize);
+    for (int64_t c = 0; c < numComponents; ++c)
+    {
+        for (int64_t b = 0; b < numMaps; ++b)
+        {
+            myHelp.resampleFrame(inVol, b, c, outFrame.data());
+            outVol->setFrame(outFrame.data(), b, c);
+        }
+    }
 }
 
 float AlgorithmVolumeWarpfieldResample::getAlgorithmInternalWeight()
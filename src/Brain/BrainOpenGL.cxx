@@ -353,6 +353,7 @@ BrainOpenGL::initializeOpenGL()
     s_supportsDisplayLists = false;
     s_supportsImmediateMode = false;
     s_supportsVertexBuffers = false;
+    s_supports3DTextures = false;
     
     GLint maximumNumberOfClipPlanes;
     glGetIntegerv(GL_MAX_CLIP_PLANES,
@@ -407,6 +408,13 @@ BrainOpenGL::initializeOpenGL()
     s_supportsVertexBuffers = true;
 #endif // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
     
+#ifdef BRAIN_OPENGL_INFO_SUPPORTS_3D_TEXTURES
+    /*
+     * Volume dimensions are rarely powers of two
+     */
+    s_supports3DTextures = testForVersionOfOpenGLSupported("2.0");
+#endif // BRAIN_OPENGL_INFO_SUPPORTS_3D_TEXTURES
+    
     lineInfo += ("\n\nBest Drawing Mode: "
             + BrainOpenGL::getBestDrawingModeName());
     lineInfo += ("\nDisplay Lists Supported: "
@@ -415,6 +423,8 @@ BrainOpenGL::initializeOpenGL()
             + AString::fromBool(s_supportsImmediateMode));
     lineInfo += ("\nVertex Buffers Supported: "
             + AString::fromBool(s_supportsVertexBuffers));
+    lineInfo += ("\n3D Textures Supported: "
+            + AString::fromBool(s_supports3DTextures));
     
     lineInfo += extInfo;
     
@@ -32,6 +32,7 @@
 #undef BRAIN_OPENGL_INFO_SUPPORTS_DISPLAY_LISTS
 #undef BRAIN_OPENGL_INFO_SUPPORTS_IMMEDIATE
 #undef BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+#undef BRAIN_OPENGL_INFO_SUPPORTS_3D_TEXTURES
 
 #define BRAIN_OPENGL_INFO_SUPPORTS_DISPLAY_LISTS 1
 #define BRAIN_OPENGL_INFO_SUPPORTS_IMMEDIATE 1
@@ -42,6 +43,10 @@
 //#define BRAIN_OPENGL_INFO_SUPPORTS_DISPLAY_LISTS 1
 //#endif // GL_VERSION_1_1
 //
+#ifdef GL_VERSION_1_3
+#define BRAIN_OPENGL_INFO_SUPPORTS_3D_TEXTURES 1
+#endif // GL_VERSION_1_3
+
 #ifdef GL_VERSION_2_1
 #define BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS 1
 #endif // GL_VERSION_2_1
@@ -183,6 +188,14 @@ namespace caret {
             return s_supportsVertexBuffers;
         }
         
+        /**
+         * @return True if 3D textures (with border clamping and
+         * dimensions that are not powers of two) are supported.
+         */
+        inline static bool is3DTexturesSupported() {
+            return s_supports3DTextures;
+        }
+        
         virtual AString getStateOfOpenGL() const;
         
     private:
@@ -245,6 +258,8 @@ namespace caret {
         
         static bool s_supportsVertexBuffers;
         
+        static bool s_supports3DTextures;
+        
         AString m_openGLInformation;
     };
 
@@ -259,6 +274,7 @@ namespace caret {
     bool BrainOpenGL::s_supportsDisplayLists  = false;
     bool BrainOpenGL::s_supportsImmediateMode = false;
     bool BrainOpenGL::s_supportsVertexBuffers = false;
+    bool BrainOpenGL::s_supports3DTextures = false;
 #endif //__BRAIN_OPENGL_DEFINE_H
 
 } // namespace
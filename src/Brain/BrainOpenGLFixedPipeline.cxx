@@ -44,6 +44,8 @@
 #include "BrainOpenGLShapeCube.h"
 #include "BrainOpenGLShapeCylinder.h"
 #include "BrainOpenGLShapeSphere.h"
+#include "BrainOpenGLSurfaceBufferCache.h"
+#include "BrainOpenGLVolumeTextureCache.h"
 #include "BrainOpenGLViewportContent.h"
 #include "BrainStructure.h"
 #include "BrowserTabContent.h"
@@ -147,6 +149,8 @@ BrainOpenGLFixedPipeline::BrainOpenGLFixedPipeline(BrainOpenGLTextRenderInterfac
     m_shapeCube   = NULL;
     m_shapeCubeRounded = NULL;
     this->surfaceNodeColoring = new SurfaceNodeColoring();
+    m_surfaceBufferCache = new BrainOpenGLSurfaceBufferCache();
+    m_volumeTextureCache = new BrainOpenGLVolumeTextureCache();
     m_brain = NULL;
 }
 
@@ -179,6 +183,14 @@ BrainOpenGLFixedPipeline::~BrainOpenGLFixedPipeline()
         delete this->surfaceNodeColoring;
         this->surfaceNodeColoring = NULL;
     }
+    if (m_surfaceBufferCache != NULL) {
+        delete m_surfaceBufferCache;
+        m_surfaceBufferCache = NULL;
+    }
+    if (m_volumeTextureCache != NULL) {
+        delete m_volumeTextureCache;
+        m_volumeTextureCache = NULL;
+    }
     delete this->colorIdentification;
     this->colorIdentification = NULL;
 }
@@ -392,6 +404,13 @@ BrainOpenGLFixedPipeline::drawModels(std::vector<BrainOpenGLViewportContent*>& v
         m_brain = NULL;
     }
     
+    /*
+     * Free buffers of surfaces and textures of volumes that were
+     * not drawn in any viewport
+     */
+    m_surfaceBufferCache->releaseUnusedBuffers();
+    m_volumeTextureCache->releaseUnusedTextures();
+    
     this->checkForOpenGLError(NULL, "At end of drawModels()");
     
 }
@@ -1694,6 +1713,15 @@ void
 BrainOpenGLFixedPipeline::drawSurfaceTrianglesWithVertexArrays(const Surface* surface,
                                                                const float* nodeColoringRGBA)
 {
+    /*
+     * When vertex buffers are available, the surface's geometry and
+     * coloring remain on the graphics card between frames.
+     */
+    if (m_surfaceBufferCache->drawSurfaceTriangles(surface,
+                                                   nodeColoringRGBA)) {
+        return;
+    }
+    
     glEnableClientState(GL_VERTEX_ARRAY);
     if (nodeColoringRGBA != NULL) {
         glEnableClientState(GL_COLOR_ARRAY);
@@ -50,6 +50,8 @@ namespace caret {
     class BrainOpenGLShapeCube;
     class BrainOpenGLShapeCylinder;
     class BrainOpenGLShapeSphere;
+    class BrainOpenGLSurfaceBufferCache;
+    class BrainOpenGLVolumeTextureCache;
     class BrainOpenGLViewportContent;
     class BrowserTabContent;
     class CaretMappableDataFile;
@@ -523,6 +525,12 @@ namespace caret {
         /** Cylinder symbol */
         BrainOpenGLShapeCylinder* m_shapeCylinder;
         
+        /** Surface geometry and coloring kept in vertex buffers */
+        BrainOpenGLSurfaceBufferCache* m_surfaceBufferCache;
+        
+        /** Voxel coloring of volume maps kept in 3D textures */
+        BrainOpenGLVolumeTextureCache* m_volumeTextureCache;
+        
         std::list<FiberOrientation*> m_fiberOrientationsForDrawing;
         
         double inverseRotationMatrix[16];
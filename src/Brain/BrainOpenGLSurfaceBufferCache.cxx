@@ -0,0 +1,343 @@
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#define __BRAIN_OPEN_GL_SURFACE_BUFFER_CACHE_DECLARE__
+#include "BrainOpenGLSurfaceBufferCache.h"
+#undef __BRAIN_OPEN_GL_SURFACE_BUFFER_CACHE_DECLARE__
+
+#include "CaretAssert.h"
+#include "CaretLogger.h"
+#include "CaretPreferences.h"
+#include "SessionManager.h"
+#include "Surface.h"
+
+using namespace caret;
+
+
+    
+/**
+ * \class caret::BrainOpenGLSurfaceBufferCache 
+ * \brief Keeps surface geometry and node coloring in OpenGL vertex buffers.
+ *
+ * Coordinates, normals, and triangles are uploaded once and kept on the
+ * graphics card until the surface's geometry version changes.  Node colors
+ * are kept per coloring array (there is one for each tab and model type)
+ * and uploaded again only when the surface's node coloring version changes.
+ * Buffers for surfaces that were not drawn in a frame are released by
+ * releaseUnusedBuffers().
+ *
+ * Buffers belong to the OpenGL context that was current when they were
+ * created, so an instance must only be used with a single context.
+ */
+
+/**
+ * Constructor.
+ */
+BrainOpenGLSurfaceBufferCache::BrainOpenGLSurfaceBufferCache()
+: CaretObject()
+{
+    
+}
+
+/**
+ * Destructor.
+ */
+BrainOpenGLSurfaceBufferCache::~BrainOpenGLSurfaceBufferCache()
+{
+    releaseAllBuffers();
+}
+
+/**
+ * Draw the triangles of a surface using vertex buffers.
+ *
+ * @param surface
+ *    Surface that is drawn.
+ * @param nodeColoringRGBA
+ *    RGBA coloring for the nodes.  If NULL, the surface is drawn in
+ *    the background color.
+ * @return
+ *    True if the surface was drawn.  False if vertex buffers are not
+ *    available, in which case the caller must draw the surface itself.
+ */
+bool
+BrainOpenGLSurfaceBufferCache::drawSurfaceTriangles(const Surface* surface,
+                                                    const float* nodeColoringRGBA)
+{
+#ifdef BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    CaretAssert(surface);
+    if (BrainOpenGL::getBestDrawingMode() != BrainOpenGL::DRAW_MODE_VERTEX_BUFFERS) {
+        return false;
+    }
+    const int32_t numNodes = surface->getNumberOfNodes();
+    const int32_t numTriangles = surface->getNumberOfTriangles();
+    if ((numNodes <= 0)
+        || (numTriangles <= 0)) {
+        return false;
+    }
+    
+    SurfaceBuffers& surfaceBuffers = m_surfaceBuffers[surface];
+    surfaceBuffers.m_used = true;
+    if (surfaceBuffers.m_geometryVersion != surface->getGeometryVersion()) {
+        updateGeometryBuffers(surface,
+                              surfaceBuffers);
+    }
+    
+    if (surfaceBuffers.m_triangleBufferID == 0) {
+        return false;
+    }
+    
+    /*
+     * Colors are uploaded again only after the surface's
+     * coloring has changed.
+     */
+    GLuint colorBufferID = 0;
+    if (nodeColoringRGBA != NULL) {
+        ColorBuffer& colorBuffer = surfaceBuffers.m_colorBuffers[nodeColoringRGBA];
+        colorBuffer.m_used = true;
+        if (colorBuffer.m_bufferID == 0) {
+            glGenBuffers(1, &colorBuffer.m_bufferID);
+            if (colorBuffer.m_bufferID == 0) {
+                CaretLogSevere("Failed to create an OpenGL Vertex Buffer for node colors of surface "
+                               + surface->getFileNameNoPath());
+                return false;
+            }
+        }
+        colorBufferID = colorBuffer.m_bufferID;
+        if (colorBuffer.m_nodeColoringVersion != surface->getNodeColoringVersion()) {
+            glBindBuffer(GL_ARRAY_BUFFER,
+                         colorBufferID);
+            glBufferData(GL_ARRAY_BUFFER,
+                         numNodes * 4 * sizeof(GLfloat),
+                         nodeColoringRGBA,
+                         GL_DYNAMIC_DRAW);
+            colorBuffer.m_nodeColoringVersion = surface->getNodeColoringVersion();
+        }
+    }
+    
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    
+    glBindBuffer(GL_ARRAY_BUFFER,
+                 surfaceBuffers.m_coordinateBufferID);
+    glVertexPointer(3,
+                    GL_FLOAT,
+                    0,
+                    (GLvoid*)0);
+    
+    glBindBuffer(GL_ARRAY_BUFFER,
+                 surfaceBuffers.m_normalBufferID);
+    glNormalPointer(GL_FLOAT,
+                    0,
+                    (GLvoid*)0);
+    
+    if (colorBufferID > 0) {
+        glEnableClientState(GL_COLOR_ARRAY);
+        glBindBuffer(GL_ARRAY_BUFFER,
+                     colorBufferID);
+        glColorPointer(4,
+                       GL_FLOAT,
+                       0,
+                       (GLvoid*)0);
+    }
+    else {
+        CaretPreferences* prefs = SessionManager::get()->getCaretPreferences();
+        float rgba[4];
+        prefs->getColorBackground(rgba);
+        glColor3f(rgba[0], rgba[1], rgba[2]);
+    }
+    
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,
+                 surfaceBuffers.m_triangleBufferID);
+    glDrawElements(GL_TRIANGLES,
+                   (3 * numTriangles),
+                   GL_UNSIGNED_INT,
+                   (GLvoid*)0);
+    
+    /*
+     * Deselect active buffers so that drawing with client
+     * side arrays continues to function.
+     */
+    glBindBuffer(GL_ARRAY_BUFFER,
+                 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,
+                 0);
+    
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    
+    return true;
+#else // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    return false;
+#endif // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+}
+
+/**
+ * Upload a surface's coordinates, normals, and triangles into its buffers.
+ *
+ * @param surface
+ *    Surface whose geometry is uploaded.
+ * @param surfaceBuffers
+ *    Buffers of the surface.
+ */
+void
+BrainOpenGLSurfaceBufferCache::updateGeometryBuffers(const Surface* surface,
+                                                     SurfaceBuffers& surfaceBuffers)
+{
+#ifdef BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    if (surfaceBuffers.m_coordinateBufferID == 0) {
+        glGenBuffers(1, &surfaceBuffers.m_coordinateBufferID);
+        glGenBuffers(1, &surfaceBuffers.m_normalBufferID);
+        glGenBuffers(1, &surfaceBuffers.m_triangleBufferID);
+        if ((surfaceBuffers.m_coordinateBufferID == 0)
+            || (surfaceBuffers.m_normalBufferID == 0)
+            || (surfaceBuffers.m_triangleBufferID == 0)) {
+            CaretLogSevere("Failed to create OpenGL Vertex Buffers for surface "
+                           + surface->getFileNameNoPath());
+            releaseSurfaceBuffers(surfaceBuffers);
+            return;
+        }
+    }
+    
+    const int32_t numNodes = surface->getNumberOfNodes();
+    const int32_t numTriangles = surface->getNumberOfTriangles();
+    
+    glBindBuffer(GL_ARRAY_BUFFER,
+                 surfaceBuffers.m_coordinateBufferID);
+    glBufferData(GL_ARRAY_BUFFER,
+                 numNodes * 3 * sizeof(GLfloat),
+                 surface->getCoordinateData(),
+                 GL_STATIC_DRAW);
+    
+    glBindBuffer(GL_ARRAY_BUFFER,
+                 surfaceBuffers.m_normalBufferID);
+    glBufferData(GL_ARRAY_BUFFER,
+                 numNodes * 3 * sizeof(GLfloat),
+                 surface->getNormalData(),
+                 GL_STATIC_DRAW);
+    
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,
+                 surfaceBuffers.m_triangleBufferID);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 numTriangles * 3 * sizeof(GLuint),
+                 surface->getTriangle(0),
+                 GL_STATIC_DRAW);
+    
+    glBindBuffer(GL_ARRAY_BUFFER,
+                 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,
+                 0);
+    
+    surfaceBuffers.m_geometryVersion = surface->getGeometryVersion();
+#else // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    CaretLogSevere("PROGRAM ERROR: Creating OpenGL vertex buffers for surface "
+                   + surface->getFileNameNoPath()
+                   + " but vertex buffers not supported.");
+    surfaceBuffers.m_geometryVersion = surface->getGeometryVersion();
+#endif // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+}
+
+/**
+ * Release the buffers of surfaces and node colorings that were not drawn
+ * since the previous call to this method.  Call this at the end of each
+ * frame so that buffers of closed surfaces (and tabs) do not accumulate.
+ */
+void
+BrainOpenGLSurfaceBufferCache::releaseUnusedBuffers()
+{
+    std::map<const Surface*, SurfaceBuffers>::iterator surfaceIter = m_surfaceBuffers.begin();
+    while (surfaceIter != m_surfaceBuffers.end()) {
+        SurfaceBuffers& surfaceBuffers = surfaceIter->second;
+        if ( ! surfaceBuffers.m_used) {
+            releaseSurfaceBuffers(surfaceBuffers);
+            m_surfaceBuffers.erase(surfaceIter++);
+            continue;
+        }
+        surfaceBuffers.m_used = false;
+        
+        std::map<const float*, ColorBuffer>::iterator colorIter = surfaceBuffers.m_colorBuffers.begin();
+        while (colorIter != surfaceBuffers.m_colorBuffers.end()) {
+            if ( ! colorIter->second.m_used) {
+                releaseBuffer(colorIter->second.m_bufferID);
+                surfaceBuffers.m_colorBuffers.erase(colorIter++);
+                continue;
+            }
+            colorIter->second.m_used = false;
+            ++colorIter;
+        }
+        
+        ++surfaceIter;
+    }
+}
+
+/**
+ * Release all buffers.
+ */
+void
+BrainOpenGLSurfaceBufferCache::releaseAllBuffers()
+{
+    for (std::map<const Surface*, SurfaceBuffers>::iterator iter = m_surfaceBuffers.begin();
+         iter != m_surfaceBuffers.end();
+         iter++) {
+        releaseSurfaceBuffers(iter->second);
+    }
+    m_surfaceBuffers.clear();
+}
+
+/**
+ * Release the geometry and color buffers of one surface.
+ *
+ * @param surfaceBuffers
+ *    Buffers of the surface.
+ */
+void
+BrainOpenGLSurfaceBufferCache::releaseSurfaceBuffers(SurfaceBuffers& surfaceBuffers)
+{
+    releaseBuffer(surfaceBuffers.m_coordinateBufferID);
+    releaseBuffer(surfaceBuffers.m_normalBufferID);
+    releaseBuffer(surfaceBuffers.m_triangleBufferID);
+    for (std::map<const float*, ColorBuffer>::iterator iter = surfaceBuffers.m_colorBuffers.begin();
+         iter != surfaceBuffers.m_colorBuffers.end();
+         iter++) {
+        releaseBuffer(iter->second.m_bufferID);
+    }
+    surfaceBuffers.m_colorBuffers.clear();
+}
+
+/**
+ * Release a buffer, if it was created.
+ *
+ * @param bufferID
+ *    ID of the buffer, set to zero upon return.
+ */
+void
+BrainOpenGLSurfaceBufferCache::releaseBuffer(GLuint& bufferID)
+{
+#ifdef BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    if (bufferID > 0) {
+        if (glIsBuffer(bufferID)) {
+            glDeleteBuffers(1, &bufferID);
+        }
+    }
+#endif // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    bufferID = 0;
+}
+
@@ -0,0 +1,104 @@
+#ifndef __BRAIN_OPEN_GL_SURFACE_BUFFER_CACHE_H_
+#define __BRAIN_OPEN_GL_SURFACE_BUFFER_CACHE_H_
+
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include <map>
+#include <stdint.h>
+
+#include "BrainOpenGL.h"
+
+namespace caret {
+
+    class Surface;
+    
+    class BrainOpenGLSurfaceBufferCache : public CaretObject {
+        
+    public:
+        BrainOpenGLSurfaceBufferCache();
+        
+        virtual ~BrainOpenGLSurfaceBufferCache();
+        
+    private:
+        BrainOpenGLSurfaceBufferCache(const BrainOpenGLSurfaceBufferCache&);
+
+        BrainOpenGLSurfaceBufferCache& operator=(const BrainOpenGLSurfaceBufferCache&);
+        
+    public:
+
+        // ADD_NEW_METHODS_HERE
+
+        bool drawSurfaceTriangles(const Surface* surface,
+                                  const float* nodeColoringRGBA);
+        
+        void releaseUnusedBuffers();
+        
+        void releaseAllBuffers();
+        
+    private:
+        /** Buffer holding one set of node colors for a surface */
+        struct ColorBuffer {
+            ColorBuffer() { m_bufferID = 0; m_nodeColoringVersion = -1; m_used = false; }
+            
+            GLuint m_bufferID;
+            
+            int64_t m_nodeColoringVersion;
+            
+            bool m_used;
+        };
+        
+        /** Buffers holding a surface's geometry and its node colors */
+        struct SurfaceBuffers {
+            SurfaceBuffers() { m_coordinateBufferID = 0; m_normalBufferID = 0; m_triangleBufferID = 0; m_geometryVersion = -1; m_used = false; }
+            
+            GLuint m_coordinateBufferID;
+            
+            GLuint m_normalBufferID;
+            
+            GLuint m_triangleBufferID;
+            
+            int64_t m_geometryVersion;
+            
+            /** Color buffers keyed by the address of the node coloring (one per tab and model type) */
+            std::map<const float*, ColorBuffer> m_colorBuffers;
+            
+            bool m_used;
+        };
+        
+        void updateGeometryBuffers(const Surface* surface,
+                                   SurfaceBuffers& surfaceBuffers);
+        
+        void releaseSurfaceBuffers(SurfaceBuffers& surfaceBuffers);
+        
+        void releaseBuffer(GLuint& bufferID);
+        
+        // ADD_NEW_MEMBERS_HERE
+        
+        std::map<const Surface*, SurfaceBuffers> m_surfaceBuffers;
+    };
+    
+#ifdef __BRAIN_OPEN_GL_SURFACE_BUFFER_CACHE_DECLARE__
+    // <PLACE DECLARATIONS OF STATIC MEMBERS HERE>
+#endif // __BRAIN_OPEN_GL_SURFACE_BUFFER_CACHE_DECLARE__
+
+} // namespace
+#endif  //__BRAIN_OPEN_GL_SURFACE_BUFFER_CACHE_H_
@@ -34,6 +34,7 @@
 #include "BoundingBox.h"
 #include "Brain.h"
 #include "BrainOpenGLPrimitiveDrawing.h"
+#include "BrainOpenGLVolumeTextureCache.h"
 #include "BrowserTabContent.h"
 #include "CaretAssert.h"
 #include "CaretLogger.h"
@@ -89,6 +90,9 @@ BrainOpenGLVolumeSliceDrawing::BrainOpenGLVolumeSliceDrawing()
     Matrix4x4 identity;
     identity.identity();
     identity.getMatrixForOpenGL(m_viewingMatrix);
+    
+    m_identificationModeFlag = false;
+    m_textureDrawingFlag = false;
 }
 
 /**
@@ -156,6 +160,9 @@ BrainOpenGLVolumeSliceDrawing::draw(BrainOpenGLFixedPipeline* fixedPipelineDrawi
     
     m_sliceViewMode = sliceViewMode;
     
+    m_textureDrawingFlag = (SessionManager::get()->getCaretPreferences()->isVolumeSliceTextureDrawingEnabled()
+                            && BrainOpenGL::is3DTexturesSupported());
+    
     const int32_t invalidSliceIndex = -1;
     
     /*
@@ -2037,6 +2044,16 @@ BrainOpenGLVolumeSliceDrawing::drawOrthogonalSlice(const DRAW_MODE drawMode,
                 break;
         }
 
+        const uint8_t volumeDrawingOpacity = static_cast<int8_t>(volInfo.opacity * 255.0);
+        
+        /*
+         * When the map is in a texture, the slice's colors are not needed.
+         * The first volume drawn shows undisplayed voxels in black.
+         */
+        const GLuint sliceTextureName = getVolumeTexture(iVol,
+                                                         volumeDrawingOpacity,
+                                                         (iVol == 0));
+        
         /*
          * Stores RGBA values for each voxel.
          * Use a vector for voxel colors so no worries about memory being freed.
@@ -2050,13 +2067,15 @@ BrainOpenGLVolumeSliceDrawing::drawOrthogonalSlice(const DRAW_MODE drawMode,
         /*
          * Get colors for all voxels in the slice.
          */
-        volumeFile->getVoxelColorsForSliceInMap(m_brain->getPaletteFile(),
-                                                mapIndex,
-                                                sliceViewPlane,
-                                                sliceIndexForDrawing,
-                                                displayGroup,
-                                                browserTabIndex,
-                                                sliceVoxelsRGBA);
+        if (sliceTextureName == 0) {
+            volumeFile->getVoxelColorsForSliceInMap(m_brain->getPaletteFile(),
+                                                    mapIndex,
+                                                    sliceViewPlane,
+                                                    sliceIndexForDrawing,
+                                                    displayGroup,
+                                                    browserTabIndex,
+                                                    sliceVoxelsRGBA);
+        }
         
         /*
          * Is label outline mode?
@@ -2122,8 +2141,6 @@ BrainOpenGLVolumeSliceDrawing::drawOrthogonalSlice(const DRAW_MODE drawMode,
                 break;
         }
         
-        const uint8_t volumeDrawingOpacity = static_cast<int8_t>(volInfo.opacity * 255.0);
-
         /*
          * Setup for drawing the voxels in the slice.
          */
@@ -2192,18 +2209,32 @@ BrainOpenGLVolumeSliceDrawing::drawOrthogonalSlice(const DRAW_MODE drawMode,
         /*
          * Draw the voxels in the slice.
          */
-        drawOrthogonalSliceVoxels(sliceViewPlane,
-                                  sliceNormalVector,
-                                  selectedSliceIndices,
-                                  startCoordinate,
-                                  rowStep,
-                                  columnStep,
-                                  numberOfColumns,
-                                  numberOfRows,
-                                  sliceVoxelsRgbaVector,
-                                  iVol,
-                                  mapIndex,
-                                  volumeDrawingOpacity);
+        if (sliceTextureName > 0) {
+            drawOrthogonalSliceTexture(sliceViewPlane,
+                                       sliceNormalVector,
+                                       sliceIndexForDrawing,
+                                       startCoordinate,
+                                       rowStep,
+                                       columnStep,
+                                       numberOfColumns,
+                                       numberOfRows,
+                                       iVol,
+                                       sliceTextureName);
+        }
+        else {
+            drawOrthogonalSliceVoxels(sliceViewPlane,
+                                      sliceNormalVector,
+                                      selectedSliceIndices,
+                                      startCoordinate,
+                                      rowStep,
+                                      columnStep,
+                                      numberOfColumns,
+                                      numberOfRows,
+                                      sliceVoxelsRgbaVector,
+                                      iVol,
+                                      mapIndex,
+                                      volumeDrawingOpacity);
+        }
         
         glDisable(GL_POLYGON_OFFSET_FILL);
     }
@@ -2439,6 +2470,186 @@ BrainOpenGLVolumeSliceDrawing::drawOrthogonalSliceVoxels(const VolumeSliceViewPl
 }
 
 
+/**
+ * Draw an orthogonal slice as one quadrilateral textured with the
+ * 3D texture containing the coloring of the volume's map.
+ *
+ * @param sliceViewPlane
+ *    The slice plane being viewed.
+ * @param sliceNormalVector
+ *    Normal vector of the slice plane.
+ * @param sliceIndex
+ *    Index of the slice in the volume.
+ * @param coordinate
+ *    Coordinate of first voxel in the slice (bottom left as begin viewed)
+ * @param rowStep
+ *    Three-dimensional step to next row.
+ * @param columnStep
+ *    Three-dimensional step to next column.
+ * @param numberOfColumns
+ *    Number of columns in the slice.
+ * @param numberOfRows
+ *    Number of rows in the slice.
+ * @param volumeIndex
+ *    Index of the volume being drawn.
+ * @param textureName
+ *    Name of the texture containing the volume's coloring.
+ */
+void
+BrainOpenGLVolumeSliceDrawing::drawOrthogonalSliceTexture(const VolumeSliceViewPlaneEnum::Enum sliceViewPlane,
+                                                          const float sliceNormalVector[3],
+                                                          const int64_t sliceIndex,
+                                                          const float coordinate[3],
+                                                          const float rowStep[3],
+                                                          const float columnStep[3],
+                                                          const int64_t numberOfColumns,
+                                                          const int64_t numberOfRows,
+                                                          const int32_t volumeIndex,
+                                                          const GLuint textureName)
+{
+    float corners[4][3];
+    for (int32_t i = 0; i < 3; i++) {
+        const float columnOffset = numberOfColumns * columnStep[i];
+        const float rowOffset    = numberOfRows * rowStep[i];
+        corners[0][i] = coordinate[i];
+        corners[1][i] = coordinate[i] + columnOffset;
+        corners[2][i] = coordinate[i] + columnOffset + rowOffset;
+        corners[3][i] = coordinate[i] + rowOffset;
+    }
+    
+    /*
+     * Texture coordinates span the columns and rows of the slice and
+     * sample the center of the slice's voxels in the third dimension.
+     */
+    const float columnTexCoord[4] = { 0.0, 1.0, 1.0, 0.0 };
+    const float rowTexCoord[4]    = { 0.0, 0.0, 1.0, 1.0 };
+    
+    CaretAssertVectorIndex(m_volumeDrawInfo, volumeIndex);
+    const BrainOpenGLFixedPipeline::VolumeDrawInfo& volInfo = m_volumeDrawInfo[volumeIndex];
+    int64_t dims[5] = { 1, 1, 1, 1, 1 };
+    volInfo.volumeFile->getDimensions(dims[0], dims[1], dims[2], dims[3], dims[4]);
+    
+    float texCoords[4][3];
+    for (int32_t i = 0; i < 4; i++) {
+        switch (sliceViewPlane) {
+            case VolumeSliceViewPlaneEnum::ALL:
+                CaretAssert(0);
+                break;
+            case VolumeSliceViewPlaneEnum::AXIAL:
+                texCoords[i][0] = columnTexCoord[i];
+                texCoords[i][1] = rowTexCoord[i];
+                texCoords[i][2] = (sliceIndex + 0.5) / dims[2];
+                break;
+            case VolumeSliceViewPlaneEnum::CORONAL:
+                texCoords[i][0] = columnTexCoord[i];
+                texCoords[i][1] = (sliceIndex + 0.5) / dims[1];
+                texCoords[i][2] = rowTexCoord[i];
+                break;
+            case VolumeSliceViewPlaneEnum::PARASAGITTAL:
+                texCoords[i][0] = (sliceIndex + 0.5) / dims[0];
+                texCoords[i][1] = columnTexCoord[i];
+                texCoords[i][2] = rowTexCoord[i];
+                break;
+        }
+    }
+    
+    drawTextureSlice(textureName,
+                     sliceNormalVector,
+                     corners,
+                     texCoords);
+}
+
+/**
+ * Get the 3D texture containing the coloring of a volume being drawn.
+ *
+ * @param volumeIndex
+ *    Index of the volume being drawn.
+ * @param sliceOpacity
+ *    Opacity from the overlay.
+ * @param blackUndisplayedVoxelsFlag
+ *    If true, voxels that are not displayed are black instead of transparent.
+ * @return
+ *    Name of the texture or zero if the volume must be drawn voxel by voxel
+ *    (texture drawing off, identification, label volume, CIFTI file, or
+ *    texture could not be created).
+ */
+GLuint
+BrainOpenGLVolumeSliceDrawing::getVolumeTexture(const int32_t volumeIndex,
+                                                const uint8_t sliceOpacity,
+                                                const bool blackUndisplayedVoxelsFlag)
+{
+    if ( ! m_textureDrawingFlag) {
+        return 0;
+    }
+    if (m_identificationModeFlag) {
+        return 0;
+    }
+    
+    CaretAssertVectorIndex(m_volumeDrawInfo, volumeIndex);
+    const BrainOpenGLFixedPipeline::VolumeDrawInfo& volInfo = m_volumeDrawInfo[volumeIndex];
+    if (volInfo.mapFile->isMappedWithLabelTable()) {
+        return 0;
+    }
+    
+    const VolumeFile* volumeFile = dynamic_cast<const VolumeFile*>(volInfo.volumeFile);
+    if (volumeFile == NULL) {
+        return 0;
+    }
+    
+    return m_fixedPipelineDrawing->m_volumeTextureCache->getTexture(volumeFile,
+                                                                    volInfo.mapIndex,
+                                                                    sliceOpacity,
+                                                                    blackUndisplayedVoxelsFlag);
+}
+
+/**
+ * Draw a quadrilateral textured with a volume's 3D texture.
+ *
+ * @param textureName
+ *    Name of the texture.
+ * @param sliceNormalVector
+ *    Normal vector of the slice plane.
+ * @param cornerCoordinates
+ *    Coordinates of the quadrilateral's corners in counter-clockwise order.
+ * @param cornerTextureCoordinates
+ *    Texture coordinates at the quadrilateral's corners.
+ */
+void
+BrainOpenGLVolumeSliceDrawing::drawTextureSlice(const GLuint textureName,
+                                                const float sliceNormalVector[3],
+                                                const float cornerCoordinates[4][3],
+                                                const float cornerTextureCoordinates[4][3])
+{
+#ifdef BRAIN_OPENGL_INFO_SUPPORTS_3D_TEXTURES
+    glPushAttrib(GL_ENABLE_BIT
+                 | GL_TEXTURE_BIT
+                 | GL_COLOR_BUFFER_BIT);
+    
+    glEnable(GL_TEXTURE_3D);
+    glBindTexture(GL_TEXTURE_3D, textureName);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+    
+    /*
+     * Transparent texels must not write to the depth buffer
+     * so that layers below remain visible.
+     */
+    glEnable(GL_ALPHA_TEST);
+    glAlphaFunc(GL_GREATER, 0.0);
+    
+    glBegin(GL_QUADS);
+    glNormal3fv(sliceNormalVector);
+    for (int32_t i = 0; i < 4; i++) {
+        glTexCoord3fv(cornerTextureCoordinates[i]);
+        glVertex3fv(cornerCoordinates[i]);
+    }
+    glEnd();
+    
+    glBindTexture(GL_TEXTURE_3D, 0);
+    glPopAttrib();
+#else  // BRAIN_OPENGL_INFO_SUPPORTS_3D_TEXTURES
+    CaretAssertMessage(0, "Texture drawing of volume slices requires OpenGL 1.3 or later.");
+#endif // BRAIN_OPENGL_INFO_SUPPORTS_3D_TEXTURES
+}
 /**
  * Draw a volume slice's voxels.
  *
@@ -2760,6 +2971,79 @@ BrainOpenGLVolumeSliceDrawing::drawObliqueSlice(const VolumeSliceViewPlaneEnum::
         glEnd();
     }
     
+    /*
+     * When the coloring of all layers is in textures, draw each layer
+     * as one textured quadrilateral covering the screen.  The texture
+     * coordinates are the voxel indices of the corners so that the
+     * texture is sampled at the voxel enclosing each point on the slice.
+     */
+    std::vector<GLuint> obliqueTextureNames;
+    for (int32_t i = 0; i < numVolumes; i++) {
+        const GLuint textureName = getVolumeTexture(i,
+                                                    255,
+                                                    false);
+        if (textureName == 0) {
+            obliqueTextureNames.clear();
+            break;
+        }
+        obliqueTextureNames.push_back(textureName);
+    }
+    if ( ! obliqueTextureNames.empty()) {
+        float sliceNormalVector[3];
+        plane.getNormalVector(sliceNormalVector);
+        
+        const float* corners[4] = {
+            bottomLeft,
+            bottomRight,
+            topRight,
+            topLeft
+        };
+        float cornerCoordinates[4][3];
+        for (int32_t iCorner = 0; iCorner < 4; iCorner++) {
+            for (int32_t j = 0; j < 3; j++) {
+                cornerCoordinates[iCorner][j] = corners[iCorner][j];
+            }
+        }
+        
+        glPushAttrib(GL_ENABLE_BIT
+                     | GL_POLYGON_BIT);
+        glPushMatrix();
+        glScalef(zoom, zoom, zoom);
+        for (int32_t i = 0; i < numVolumes; i++) {
+            const VolumeFile* volumeFile = dynamic_cast<const VolumeFile*>(m_volumeDrawInfo[i].volumeFile);
+            CaretAssert(volumeFile);
+            int64_t dims[5];
+            volumeFile->getDimensions(dims[0], dims[1], dims[2], dims[3], dims[4]);
+            
+            float cornerTextureCoordinates[4][3];
+            for (int32_t iCorner = 0; iCorner < 4; iCorner++) {
+                float cornerIndex[3];
+                volumeFile->spaceToIndex(cornerCoordinates[iCorner],
+                                         cornerIndex);
+                for (int32_t j = 0; j < 3; j++) {
+                    cornerTextureCoordinates[iCorner][j] = (cornerIndex[j] + 0.5) / dims[j];
+                }
+            }
+            
+            /*
+             * Keep layers drawn later in front of earlier layers.
+             */
+            if (i > 0) {
+                glEnable(GL_POLYGON_OFFSET_FILL);
+                glPolygonOffset(-i, -i);
+            }
+            
+            drawTextureSlice(obliqueTextureNames[i],
+                             sliceNormalVector,
+                             cornerCoordinates,
+                             cornerTextureCoordinates);
+        }
+        glPopMatrix();
+        glPopAttrib();
+        
+        return;
+    }
+    
     /*
      * Unit vector and distance in model coords along left side of screen
      */
@@ -211,6 +211,26 @@ namespace caret {
                                        const int32_t mapIndex,
                                        const uint8_t sliceOpacity);
         
+        void drawOrthogonalSliceTexture(const VolumeSliceViewPlaneEnum::Enum sliceViewPlane,
+                                        const float sliceNormalVector[3],
+                                        const int64_t sliceIndex,
+                                        const float coordinate[3],
+                                        const float rowStep[3],
+                                        const float columnStep[3],
+                                        const int64_t numberOfColumns,
+                                        const int64_t numberOfRows,
+                                        const int32_t volumeIndex,
+                                        const GLuint textureName);
+        
+        GLuint getVolumeTexture(const int32_t volumeIndex,
+                                const uint8_t sliceOpacity,
+                                const bool blackUndisplayedVoxelsFlag);
+        
+        void drawTextureSlice(const GLuint textureName,
+                              const float sliceNormalVector[3],
+                              const float cornerCoordinates[4][3],
+                              const float cornerTextureCoordinates[4][3]);
+        
         void drawObliqueSlice(const VolumeSliceViewPlaneEnum::Enum sliceViewPlane,
                               const Plane& plane,
                               const DRAW_MODE drawMode,
@@ -311,6 +331,9 @@ namespace caret {
         
         bool m_identificationModeFlag;
         
+        /** Draw slices from 3D textures of the voxel coloring when possible */
+        bool m_textureDrawingFlag;
+        
         static const int32_t IDENTIFICATION_INDICES_PER_VOXEL;
     };
     
@@ -0,0 +1,310 @@
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include <vector>
+
+#define __BRAIN_OPEN_GL_VOLUME_TEXTURE_CACHE_DECLARE__
+#include "BrainOpenGLVolumeTextureCache.h"
+#undef __BRAIN_OPEN_GL_VOLUME_TEXTURE_CACHE_DECLARE__
+
+#include "CaretAssert.h"
+#include "CaretLogger.h"
+#include "VolumeFile.h"
+
+using namespace caret;
+
+
+    
+/**
+ * \class caret::BrainOpenGLVolumeTextureCache 
+ * \brief Keeps the voxel coloring of volume maps in OpenGL 3D textures.
+ *
+ * The coloring of an entire map (from the volume's voxel colorizer) is
+ * uploaded once as a 3D texture so that any orthogonal or oblique slice
+ * is drawn as a single textured polygon.  A texture is uploaded again
+ * only when the map's coloring version (or the overlay opacity) changes.
+ * Textures that were not used in a frame are released by
+ * releaseUnusedTextures().
+ *
+ * Textures belong to the OpenGL context that was current when they were
+ * created, so an instance must only be used with a single context.
+ */
+
+/**
+ * Constructor.
+ */
+BrainOpenGLVolumeTextureCache::BrainOpenGLVolumeTextureCache()
+: CaretObject()
+{
+    
+}
+
+/**
+ * Destructor.
+ */
+BrainOpenGLVolumeTextureCache::~BrainOpenGLVolumeTextureCache()
+{
+    releaseAllTextures();
+}
+
+/**
+ * Get the texture containing the coloring of a volume's map.  Voxels
+ * that are displayed have the given opacity and the texture's border is
+ * transparent so that slice polygons may extend beyond the volume.
+ *
+ * @param volumeFile
+ *    The volume file.
+ * @param mapIndex
+ *    Index of the map.
+ * @param opacity
+ *    Opacity of displayed voxels.
+ * @param blackUndisplayedVoxelsFlag
+ *    If true, voxels that are not displayed are opaque black (as in the
+ *    bottom layer), otherwise they are transparent.
+ * @return
+ *    Name of the 3D texture or zero if textures are not available for the
+ *    map (not supported, not yet colored, or too large) in which case the
+ *    caller must draw the voxels itself.
+ */
+GLuint
+BrainOpenGLVolumeTextureCache::getTexture(const VolumeFile* volumeFile,
+                                          const int32_t mapIndex,
+                                          const uint8_t opacity,
+                                          const bool blackUndisplayedVoxelsFlag)
+{
+#ifdef BRAIN_OPENGL_INFO_SUPPORTS_3D_TEXTURES
+    CaretAssert(volumeFile);
+    if ( ! BrainOpenGL::is3DTexturesSupported()) {
+        return 0;
+    }
+    const int64_t coloringVersion = volumeFile->getVoxelColoringVersionForMap(mapIndex);
+    if (coloringVersion < 0) {
+        return 0;
+    }
+    
+    TextureInfo& textureInfo = m_textures[TextureKey(volumeFile,
+                                                     mapIndex,
+                                                     blackUndisplayedVoxelsFlag)];
+    textureInfo.m_used = true;
+    if ((textureInfo.m_coloringVersion != coloringVersion)
+        || (textureInfo.m_opacity != opacity)) {
+        updateTexture(volumeFile,
+                      mapIndex,
+                      opacity,
+                      blackUndisplayedVoxelsFlag,
+                      textureInfo);
+    }
+    
+    return textureInfo.m_textureName;
+#else // BRAIN_OPENGL_INFO_SUPPORTS_3D_TEXTURES
+    return 0;
+#endif // BRAIN_OPENGL_INFO_SUPPORTS_3D_TEXTURES
+}
+
+/**
+ * Upload the coloring of a map into its texture.  If the map cannot be
+ * placed into a texture, the texture is released and its name is zero.
+ * Either way, the texture is not updated again until the coloring or
+ * opacity changes.
+ *
+ * @param volumeFile
+ *    The volume file.
+ * @param mapIndex
+ *    Index of the map.
+ * @param opacity
+ *    Opacity of displayed voxels.
+ * @param blackUndisplayedVoxelsFlag
+ *    Draw voxels that are not displayed in black.
+ * @param textureInfo
+ *    The texture that is updated.
+ */
+void
+BrainOpenGLVolumeTextureCache::updateTexture(const VolumeFile* volumeFile,
+                                             const int32_t mapIndex,
+                                             const uint8_t opacity,
+                                             const bool blackUndisplayedVoxelsFlag,
+                                             TextureInfo& textureInfo)
+{
+#ifdef BRAIN_OPENGL_INFO_SUPPORTS_3D_TEXTURES
+    textureInfo.m_coloringVersion = volumeFile->getVoxelColoringVersionForMap(mapIndex);
+    textureInfo.m_opacity = opacity;
+    
+    const uint8_t* mapRGBA = volumeFile->getVoxelColorsForMap(mapIndex);
+    if (mapRGBA == NULL) {
+        releaseTexture(textureInfo.m_textureName);
+        return;
+    }
+    
+    int64_t dimI, dimJ, dimK, numMaps, numComponents;
+    volumeFile->getDimensions(dimI, dimJ, dimK, numMaps, numComponents);
+    
+    /*
+     * Verify that the graphics system can hold the texture
+     */
+    glTexImage3D(GL_PROXY_TEXTURE_3D,
+                 0,
+                 GL_RGBA8,
+                 dimI,
+                 dimJ,
+                 dimK,
+                 0,
+                 GL_RGBA,
+                 GL_UNSIGNED_BYTE,
+                 NULL);
+    GLint proxyWidth = 0;
+    glGetTexLevelParameteriv(GL_PROXY_TEXTURE_3D,
+                             0,
+                             GL_TEXTURE_WIDTH,
+                             &proxyWidth);
+    if (proxyWidth <= 0) {
+        CaretLogFine("Map "
+                     + AString::number(mapIndex + 1)
+                     + " of "
+                     + volumeFile->getFileNameNoPath()
+                     + " is too large for an OpenGL 3D texture, voxels are drawn individually.");
+        releaseTexture(textureInfo.m_textureName);
+        return;
+    }
+    
+    /*
+     * Same rules as voxel drawing in orthogonal slices: displayed voxels
+     * use the overlay's opacity and voxels that are not displayed are
+     * either black or transparent.
+     */
+    const int64_t numVoxels = dimI * dimJ * dimK;
+    std::vector<uint8_t> texels(numVoxels * 4);
+    const uint8_t undisplayedAlpha = (blackUndisplayedVoxelsFlag ? 255 : 0);
+    for (int64_t i = 0; i < numVoxels; i++) {
+        const int64_t i4 = i * 4;
+        if (mapRGBA[i4 + 3] > 0) {
+            texels[i4]     = mapRGBA[i4];
+            texels[i4 + 1] = mapRGBA[i4 + 1];
+            texels[i4 + 2] = mapRGBA[i4 + 2];
+            texels[i4 + 3] = opacity;
+        }
+        else {
+            texels[i4]     = 0;
+            texels[i4 + 1] = 0;
+            texels[i4 + 2] = 0;
+            texels[i4 + 3] = undisplayedAlpha;
+        }
+    }
+    
+    if (textureInfo.m_textureName == 0) {
+        glGenTextures(1, &textureInfo.m_textureName);
+        if (textureInfo.m_textureName == 0) {
+            CaretLogSevere("Failed to create an OpenGL texture for "
+                           + volumeFile->getFileNameNoPath());
+            return;
+        }
+    }
+    
+    glBindTexture(GL_TEXTURE_3D,
+                  textureInfo.m_textureName);
+    
+    /*
+     * Nearest filtering so that voxels appear as blocks.  Texture
+     * coordinates outside of the volume get the transparent border color.
+     */
+    const GLfloat borderColor[4] = { 0.0, 0.0, 0.0, 0.0 };
+    glTexParameterfv(GL_TEXTURE_3D, GL_TEXTURE_BORDER_COLOR, borderColor);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    
+    glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage3D(GL_TEXTURE_3D,
+                 0,
+                 GL_RGBA8,
+                 dimI,
+                 dimJ,
+                 dimK,
+                 0,
+                 GL_RGBA,
+                 GL_UNSIGNED_BYTE,
+                 &texels[0]);
+    glPopClientAttrib();
+    
+    glBindTexture(GL_TEXTURE_3D,
+                  0);
+#else // BRAIN_OPENGL_INFO_SUPPORTS_3D_TEXTURES
+    CaretLogSevere("PROGRAM ERROR: Creating OpenGL 3D texture for "
+                   + volumeFile->getFileNameNoPath()
+                   + " but 3D textures not supported.");
+    textureInfo.m_coloringVersion = volumeFile->getVoxelColoringVersionForMap(mapIndex);
+    textureInfo.m_opacity = opacity;
+#endif // BRAIN_OPENGL_INFO_SUPPORTS_3D_TEXTURES
+}
+
+/**
+ * Release textures that were not used since the previous call to this
+ * method.  Call this at the end of each frame so that textures of closed
+ * volumes (and maps no longer viewed) do not accumulate.
+ */
+void
+BrainOpenGLVolumeTextureCache::releaseUnusedTextures()
+{
+    std::map<TextureKey, TextureInfo>::iterator iter = m_textures.begin();
+    while (iter != m_textures.end()) {
+        if ( ! iter->second.m_used) {
+            releaseTexture(iter->second.m_textureName);
+            m_textures.erase(iter++);
+            continue;
+        }
+        iter->second.m_used = false;
+        ++iter;
+    }
+}
+
+/**
+ * Release all textures.
+ */
+void
+BrainOpenGLVolumeTextureCache::releaseAllTextures()
+{
+    for (std::map<TextureKey, TextureInfo>::iterator iter = m_textures.begin();
+         iter != m_textures.end();
+         iter++) {
+        releaseTexture(iter->second.m_textureName);
+    }
+    m_textures.clear();
+}
+
+/**
+ * Release a texture, if it was created.
+ *
+ * @param textureName
+ *    Name of the texture, set to zero upon return.
+ */
+void
+BrainOpenGLVolumeTextureCache::releaseTexture(GLuint& textureName)
+{
+    if (textureName > 0) {
+        if (glIsTexture(textureName)) {
+            glDeleteTextures(1, &textureName);
+        }
+    }
+    textureName = 0;
+}
+
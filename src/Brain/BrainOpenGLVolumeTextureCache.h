@@ -0,0 +1,114 @@
+#ifndef __BRAIN_OPEN_GL_VOLUME_TEXTURE_CACHE_H_
+#define __BRAIN_OPEN_GL_VOLUME_TEXTURE_CACHE_H_
+
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include <map>
+#include <stdint.h>
+
+#include "BrainOpenGL.h"
+
+namespace caret {
+
+    class VolumeFile;
+    
+    class BrainOpenGLVolumeTextureCache : public CaretObject {
+        
+    public:
+        BrainOpenGLVolumeTextureCache();
+        
+        virtual ~BrainOpenGLVolumeTextureCache();
+        
+    private:
+        BrainOpenGLVolumeTextureCache(const BrainOpenGLVolumeTextureCache&);
+
+        BrainOpenGLVolumeTextureCache& operator=(const BrainOpenGLVolumeTextureCache&);
+        
+    public:
+
+        // ADD_NEW_METHODS_HERE
+
+        GLuint getTexture(const VolumeFile* volumeFile,
+                          const int32_t mapIndex,
+                          const uint8_t opacity,
+                          const bool blackUndisplayedVoxelsFlag);
+        
+        void releaseUnusedTextures();
+        
+        void releaseAllTextures();
+        
+    private:
+        /** Identifies the texture of a map */
+        struct TextureKey {
+            TextureKey(const VolumeFile* volumeFile,
+                       const int32_t mapIndex,
+                       const bool blackUndisplayedVoxelsFlag) {
+                m_volumeFile = volumeFile;
+                m_mapIndex = mapIndex;
+                m_blackUndisplayedVoxelsFlag = blackUndisplayedVoxelsFlag;
+            }
+            
+            bool operator<(const TextureKey& rhs) const {
+                if (m_volumeFile != rhs.m_volumeFile) return (m_volumeFile < rhs.m_volumeFile);
+                if (m_mapIndex != rhs.m_mapIndex) return (m_mapIndex < rhs.m_mapIndex);
+                return (m_blackUndisplayedVoxelsFlag < rhs.m_blackUndisplayedVoxelsFlag);
+            }
+            
+            const VolumeFile* m_volumeFile;
+            
+            int32_t m_mapIndex;
+            
+            bool m_blackUndisplayedVoxelsFlag;
+        };
+        
+        /** A texture and what was used to create it */
+        struct TextureInfo {
+            TextureInfo() { m_textureName = 0; m_coloringVersion = -1; m_opacity = 0; m_used = false; }
+            
+            GLuint m_textureName;
+            
+            int64_t m_coloringVersion;
+            
+            uint8_t m_opacity;
+            
+            bool m_used;
+        };
+        
+        void updateTexture(const VolumeFile* volumeFile,
+                           const int32_t mapIndex,
+                           const uint8_t opacity,
+                           const bool blackUndisplayedVoxelsFlag,
+                           TextureInfo& textureInfo);
+        
+        void releaseTexture(GLuint& textureName);
+        
+        // ADD_NEW_MEMBERS_HERE
+        
+        std::map<TextureKey, TextureInfo> m_textures;
+    };
+    
+#ifdef __BRAIN_OPEN_GL_VOLUME_TEXTURE_CACHE_DECLARE__
+    // <PLACE DECLARATIONS OF STATIC MEMBERS HERE>
+#endif // __BRAIN_OPEN_GL_VOLUME_TEXTURE_CACHE_DECLARE__
+
+} // namespace
+#endif  //__BRAIN_OPEN_GL_VOLUME_TEXTURE_CACHE_H_
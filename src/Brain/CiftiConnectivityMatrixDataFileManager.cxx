@@ -35,6 +35,7 @@
 #include "ScenePrimitiveArray.h"
 #include "Surface.h"
 #include "SurfaceFile.h"
+#include "TopologyHelper.h"
 
 using namespace caret;
 
@@ -107,6 +108,9 @@ CiftiConnectivityMatrixDataFileManager::loadRowFromParcelFile(Brain* brain,
  *    Index of the surface node.
  * @param rowColumnInformationOut
  *    Appends one string for each row/column loaded
+ * @param backgroundLoadingFlag
+ *    If true, rows of large dense files are read on background threads
+ *    and displayed when finishBackgroundLoading() finds them complete.
  * @return
  *    true if any connectivity loaders are active, else false.
  */
@@ -114,7 +118,8 @@ bool
 CiftiConnectivityMatrixDataFileManager::loadDataForSurfaceNode(Brain* brain,
                                                                const SurfaceFile* surfaceFile,
                                                                const int32_t nodeIndex,
-                                                               std::vector<AString>& rowColumnInformationOut) throw (DataFileException)
+                                                               std::vector<AString>& rowColumnInformationOut,
+                                                               const bool backgroundLoadingFlag) throw (DataFileException)
 {
     std::vector<CiftiMappableConnectivityMatrixDataFile*> ciftiMatrixFiles;
     brain->getAllCiftiConnectivityMatrixFiles(ciftiMatrixFiles);
@@ -128,10 +133,19 @@ CiftiConnectivityMatrixDataFileManager::loadDataForSurfaceNode(Brain* brain,
         CiftiMappableConnectivityMatrixDataFile* cmf = *iter;
         if (cmf->isEmpty() == false) {
             const int32_t mapIndex = 0;
-            const int64_t rowIndex = cmf->loadMapDataForSurfaceNode(mapIndex,
-                                                                    surfaceFile->getNumberOfNodes(),
-                                                                    surfaceFile->getStructure(),
-                                                                    nodeIndex);
+            int64_t rowIndex = -1;
+            if (backgroundLoadingFlag) {
+                rowIndex = cmf->loadMapDataForSurfaceNodeInBackground(mapIndex,
+                                                                      surfaceFile->getNumberOfNodes(),
+                                                                      surfaceFile->getStructure(),
+                                                                      nodeIndex);
+            }
+            else {
+                rowIndex = cmf->loadMapDataForSurfaceNode(mapIndex,
+                                                          surfaceFile->getNumberOfNodes(),
+                                                          surfaceFile->getStructure(),
+                                                          nodeIndex);
+            }
             cmf->updateScalarColoringForMap(mapIndex,
                                             paletteFile);
             haveData = true;
@@ -156,6 +170,79 @@ CiftiConnectivityMatrixDataFileManager::loadDataForSurfaceNode(Brain* brain,
     return haveData;
 }
 
+/**
+ * Install the rows of any background loads started by loadDataForSurfaceNode()
+ * that have finished.
+ *
+ * @param brain
+ *    Brain for which data is loaded.
+ * @return
+ *    true if the data of any file changed, else false.
+ */
+bool
+CiftiConnectivityMatrixDataFileManager::finishBackgroundLoading(Brain* brain) throw (DataFileException)
+{
+    std::vector<CiftiMappableConnectivityMatrixDataFile*> ciftiMatrixFiles;
+    brain->getAllCiftiConnectivityMatrixFiles(ciftiMatrixFiles);
+    
+    PaletteFile* paletteFile = brain->getPaletteFile();
+    
+    bool haveData = false;
+    AString errorMessage;
+    for (std::vector<CiftiMappableConnectivityMatrixDataFile*>::iterator iter = ciftiMatrixFiles.begin();
+         iter != ciftiMatrixFiles.end();
+         iter++) {
+        CiftiMappableConnectivityMatrixDataFile* cmf = *iter;
+        try {
+            if (cmf->finishBackgroundLoading()) {
+                const int32_t mapIndex = 0;
+                cmf->updateScalarColoringForMap(mapIndex,
+                                                paletteFile);
+                haveData = true;
+            }
+        }
+        catch (const DataFileException& dfe) {
+            /*
+             * Keep going so that other files are not left pending
+             */
+            errorMessage.appendWithNewLine(dfe.whatString());
+        }
+    }
+    
+    if (haveData) {
+        EventManager::get()->sendEvent(EventSurfaceColoringInvalidate().getPointer());
+    }
+    
+    if (errorMessage.isEmpty() == false) {
+        throw DataFileException(errorMessage);
+    }
+    
+    return haveData;
+}
+
+/**
+ * @param brain
+ *    Brain for which data is loaded.
+ * @return
+ *    true if any file has a background load that has not been installed.
+ */
+bool
+CiftiConnectivityMatrixDataFileManager::isBackgroundLoadingPending(Brain* brain) const
+{
+    std::vector<CiftiMappableConnectivityMatrixDataFile*> ciftiMatrixFiles;
+    brain->getAllCiftiConnectivityMatrixFiles(ciftiMatrixFiles);
+    
+    for (std::vector<CiftiMappableConnectivityMatrixDataFile*>::iterator iter = ciftiMatrixFiles.begin();
+         iter != ciftiMatrixFiles.end();
+         iter++) {
+        if ((*iter)->isBackgroundLoadingPending()) {
+            return true;
+        }
+    }
+    
+    return false;
+}
+
 /**
  * Load data for each of the given surface node indices and average the data.
  * @param brain
@@ -177,6 +264,56 @@ CiftiConnectivityMatrixDataFileManager::loadAverageDataForSurfaceNodes(Brain* br
     
     PaletteFile* paletteFile = brain->getPaletteFile();
     
+    /*
+     * When a region is dragged over the surface, the next average
+     * usually includes nodes adjacent to the region, so the rows
+     * of those nodes are read ahead of time.  Only files read
+     * in the background use them, so skip finding the neighbors
+     * when no file can.
+     */
+    bool prefetchFlag = false;
+    for (std::vector<CiftiMappableConnectivityMatrixDataFile*>::iterator iter = ciftiMatrixFiles.begin();
+         iter != ciftiMatrixFiles.end();
+         iter++) {
+        CiftiMappableConnectivityMatrixDataFile* cmf = *iter;
+        if ((cmf->isEmpty() == false)
+            && cmf->isBackgroundLoadingSupported()) {
+            prefetchFlag = true;
+            break;
+        }
+    }
+    std::vector<int32_t> prefetchNodeIndices;
+    if (prefetchFlag) {
+        const int32_t numberOfNodes = surfaceFile->getNumberOfNodes();
+        std::vector<bool> nodeUsed(numberOfNodes, false);
+        const int32_t numberOfNodeIndices = static_cast<int32_t>(nodeIndices.size());
+        for (int32_t i = 0; i < numberOfNodeIndices; i++) {
+            const int32_t nodeIndex = nodeIndices[i];
+            if ((nodeIndex >= 0)
+                && (nodeIndex < numberOfNodes)) {
+                nodeUsed[nodeIndex] = true;
+            }
+        }
+        CaretPointer<TopologyHelper> topologyHelper = surfaceFile->getTopologyHelper();
+        for (int32_t i = 0; i < numberOfNodeIndices; i++) {
+            const int32_t nodeIndex = nodeIndices[i];
+            if ((nodeIndex < 0)
+                || (nodeIndex >= numberOfNodes)) {
+                continue;
+            }
+            int32_t numberOfNeighbors = 0;
+            const int32_t* neighbors = topologyHelper->getNodeNeighbors(nodeIndex,
+                                                                        numberOfNeighbors);
+            for (int32_t j = 0; j < numberOfNeighbors; j++) {
+                const int32_t neighbor = neighbors[j];
+                if (nodeUsed[neighbor] == false) {
+                    nodeUsed[neighbor] = true;
+                    prefetchNodeIndices.push_back(neighbor);
+                }
+            }
+        }
+    }
+    
     bool haveData = false;
     for (std::vector<CiftiMappableConnectivityMatrixDataFile*>::iterator iter = ciftiMatrixFiles.begin();
          iter != ciftiMatrixFiles.end();
@@ -187,7 +324,8 @@ CiftiConnectivityMatrixDataFileManager::loadAverageDataForSurfaceNodes(Brain* br
             cmf->loadMapAverageDataForSurfaceNodes(mapIndex,
                                                    surfaceFile->getNumberOfNodes(),
                                                    surfaceFile->getStructure(),
-                                                   nodeIndices);
+                                                   nodeIndices,
+                                                   prefetchNodeIndices);
             cmf->updateScalarColoringForMap(mapIndex,
                                             paletteFile);
             haveData = true;
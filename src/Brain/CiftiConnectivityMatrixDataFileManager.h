@@ -44,7 +44,12 @@ namespace caret {
         bool loadDataForSurfaceNode(Brain* brain,
                                     const SurfaceFile* surfaceFile,
                                     const int32_t nodeIndex,
-                                    std::vector<AString>& rowColumnInformationOut) throw (DataFileException);
+                                    std::vector<AString>& rowColumnInformationOut,
+                                    const bool backgroundLoadingFlag = false) throw (DataFileException);
+        
+        bool finishBackgroundLoading(Brain* brain) throw (DataFileException);
+        
+        bool isBackgroundLoadingPending(Brain* brain) const;
         
         bool loadAverageDataForSurfaceNodes(Brain* brain,
                                             const SurfaceFile* surfaceFile,
@@ -165,6 +165,7 @@ void CiftiFile::openFile(const AString &fileName, const CacheEnum &caching)
         vec[0] = vec[1];
         vec[1] = temp;
         m_matrix.setup(vec,offset,m_caching,m_swapNeeded);
+        updateMappedCaching();
     }
     catch (CaretException& e) {
         throw CiftiFileException("Error reading file \"" + fileName + "\": " + e.whatString());
@@ -242,6 +243,7 @@ void CiftiFile::setupMatrix()
     dim[0] = dim[1];
     dim[1] = temp;
     m_matrix.setup(dim, vox_offset, this->m_caching, this->m_swapNeeded);
+    updateMappedCaching();
 }
 
 /*
@@ -270,7 +272,16 @@ void CiftiFile::writeFile(const AString &fileName)
     bool writingNewFile = true;
     bool shouldSwap = false;
     
-    if (m_caching == IN_MEMORY)//rewrite the XML bytes only if in-memory, because if it already on-disk, then we can't resize the xml bytes
+    if (m_caching == MEMORY_MAPPED)
+    {
+        AString mappedFileName;
+        m_matrix.getMatrixFile(mappedFileName);
+        if (FileInformation(mappedFileName).getCanonicalFilePath() == FileInformation(fileName).getCanonicalFilePath())
+        {
+            convertToInMemory();//don't overwrite the file we are reading from through the mapping
+        }
+    }
+    if (m_caching != ON_DISK)//rewrite the XML bytes only if in-memory, because if it already on-disk, then we can't resize the xml bytes
     {
         m_writingVersion = CiftiVersion();//use default cifti version for the rewrite
         m_xmlBytes = m_xml.writeXMLToQByteArray(m_writingVersion);
@@ -290,7 +301,7 @@ void CiftiFile::writeFile(const AString &fileName)
     {
         file = new QFile();
         file->setFileName(fileName);
-        if(m_caching == IN_MEMORY)
+        if(m_caching != ON_DISK)
         {
             if (!file->open(QIODevice::WriteOnly))//this function is writeFile, try to open writable at all times
             {
@@ -315,7 +326,7 @@ void CiftiFile::writeFile(const AString &fileName)
     CiftiHeader ciftiHeader;
     this->m_headerIO.getHeader(ciftiHeader);
 
-    if (m_caching == IN_MEMORY)//also update the intent code and name if writing from in-memory
+    if (m_caching != ON_DISK)//also update the intent code and name if writing from in-memory
     {
         char name[17];//just to be safe, use one more char and make it null
         name[16] = '\0';
@@ -409,6 +420,7 @@ void CiftiFile::convertToInMemory()
         newMatrix.setRow(rowScratch.data(), i);
     }
     m_matrix = newMatrix;
+    m_caching = IN_MEMORY;
     CaretAssert(isInMemory());//make sure it knows it is in memory
 }
 
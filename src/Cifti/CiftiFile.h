@@ -49,6 +49,8 @@ public:
     
     //check if it is in memory or not
     bool isInMemory() const;
+    ///the caching the matrix actually uses, MEMORY_MAPPED falls back to ON_DISK when mapping fails, and becomes IN_MEMORY on the first write
+    CacheEnum getCaching() const { return m_caching; }
     ///convert to in-memory file
     void convertToInMemory();
 
@@ -72,12 +74,19 @@ public:
     /// get Row
     void getRow(float * rowOut,const int64_t &rowIndex) const
     { m_matrix.getRow(rowOut, rowIndex); }
+    /// get consecutive Rows with one read, rowsOut must hold numRows * getNumberOfColumns() values
+    void getRows(float * rowsOut, const int64_t &firstRow, const int64_t &numRows) const
+    { m_matrix.getRows(rowsOut, firstRow, numRows); }
     /// set Row
     void setRow(float * rowIn, const int64_t &rowIndex)
     {
         invalidateDataRange();
         m_matrix.setRow(rowIn, rowIndex);
+        updateMappedCaching();
     }
+    /// get a pointer directly into a memory mapped file, NULL if not MEMORY_MAPPED or byte swapping is needed
+    const float* getRowPointer(const int64_t &rowIndex) const
+    { return m_matrix.getRowPointer(rowIndex); }
     /// get Column
     void getColumn(float * columnOut, const int64_t &columnIndex) const
     { m_matrix.getColumn(columnOut, columnIndex); }
@@ -86,6 +95,7 @@ public:
     {
         invalidateDataRange();
         m_matrix.setColumn(columnIn, columnIndex);
+        updateMappedCaching();
     }
     /// get Matrix
     void getMatrix(float *matrixOut)
@@ -95,6 +105,7 @@ public:
     {
         invalidateDataRange();
         m_matrix.setMatrix(matrixIn);
+        updateMappedCaching();
     }
     // setup Matrix
     //void setupMatrix(vector<int64_t> &dimensions, const int64_t &offsetIn = 0, const CacheEnum &e=IN_MEMORY, const bool &needsSwapping=false) throw (CiftiFileException);
@@ -116,6 +127,10 @@ protected:
     
     virtual void init();
     
+    ///keep m_caching in step with the matrix when it stops using a mapping
+    void updateMappedCaching()
+    { if (m_caching == MEMORY_MAPPED) m_matrix.getCaching(m_caching); }
+    
     CiftiVersion m_writingVersion;
     QByteArray m_xmlBytes;
     
@@ -22,6 +22,8 @@
 #include "zlib.h"
 #include "QFile"
 #include "ByteSwapping.h"
+#include "CaretAssert.h"
+#include "CaretLogger.h"
 #include "qtemporaryfile.h"
 #include <FileInformation.h>
 #include <qdir.h>
@@ -52,6 +54,7 @@ void CiftiMatrix::init()
     m_beenInitialized = false;
     m_caching = IN_MEMORY;
     m_matrixOffset = 0;
+    m_mappedMatrix = NULL;
     matrixChanged = false;
 }
 
@@ -77,7 +80,23 @@ void CiftiMatrix::setup(vector<int64_t> &dimensions, const int64_t &offsetIn, co
 
     m_matrixOffset = offsetIn;
     m_caching = e;
-    m_beenInitialized = true;    
+    m_beenInitialized = true;
+    if(m_caching == MEMORY_MAPPED)
+    {
+#ifdef CARET_OS_WINDOWS
+        m_caching = ON_DISK;//windows can't truncate or replace a file while it is mapped, which breaks writing an output over an input
+#else
+        if(!QFile::exists(m_fileName))
+        {
+            m_caching = IN_MEMORY;//nothing to map, we are creating a new file
+        } else if (!mapMatrix()) {
+            CaretLogFine("unable to memory map file '" + m_fileName + "', falling back to reading from disk");
+            m_caching = ON_DISK;
+        } else {
+            return;
+        }
+#endif
+    }
     if(m_caching == IN_MEMORY)
     {
         int64_t matrixSize = m_dimensions[0]*m_dimensions[1];
@@ -153,12 +172,61 @@ void CiftiMatrix::setup(vector<int64_t> &dimensions, const int64_t &offsetIn, co
     }    
 }
 
+bool CiftiMatrix::mapMatrix()
+{
+    m_file.grabNew(NULL);
+    m_readFile.grabNew(NULL);
+    m_cacheFile.grabNew(NULL);
+    m_mapFile.grabNew(NULL);
+    m_mappedMatrix = NULL;
+    int64_t matrixBytes = m_dimensions[0] * m_dimensions[1] * sizeof(float);
+    if (matrixBytes == 0) return false;
+    CaretPointer<QFile> mapFile(new QFile());
+    mapFile->setFileName(m_fileName);
+    if (!mapFile->open(QIODevice::ReadOnly)) throw CiftiFileException("failed to open file '" + m_fileName + "' for reading");
+    if (mapFile->size() < m_matrixOffset + matrixBytes) throw CiftiFileException("file '" + m_fileName + "' is too short for its matrix dimensions, file may be truncated");
+    uchar* mapped = mapFile->map(m_matrixOffset, matrixBytes);//QFile handles the page alignment of the offset
+    if (mapped == NULL) return false;//on 32 bit, a large file may not fit in the address space
+    m_mapFile = mapFile;//unmapped when the last shallow copy releases the QFile
+    m_mappedMatrix = (const float*)mapped;
+    return true;
+}
+
+void CiftiMatrix::convertMappedToInMemory()
+{
+    CaretAssert(m_caching == MEMORY_MAPPED);
+    int64_t rowSize = m_dimensions[1];
+    int64_t columnSize = m_dimensions[0];
+    CaretArray<float> newMatrix(rowSize * columnSize);
+    for (int64_t i = 0; i < columnSize; ++i)
+    {
+        float* rowPtr = newMatrix.getArray() + i * rowSize;
+        memcpy((char *)rowPtr, (const char *)(m_mappedMatrix + i * rowSize), rowSize * sizeof(float));
+        if (m_needsSwapping) ByteSwapping::swapBytes(rowPtr, rowSize);
+    }
+    m_matrix = newMatrix;
+    m_needsSwapping = false;//memory is always native byte order
+    m_mapFile.grabNew(NULL);
+    m_mappedMatrix = NULL;
+    m_caching = IN_MEMORY;
+}
+
+const float* CiftiMatrix::getRowPointer(const int64_t& rowIndex) const
+{
+    if(!m_beenInitialized) throw CiftiFileException("Matrix needs to be initialized before using, or after the file name has been changed.");
+    if (m_caching != MEMORY_MAPPED || m_needsSwapping) return NULL;
+    if ((m_matrixOffset % sizeof(float)) != 0) return NULL;//don't hand out misaligned float pointers
+    CaretAssert(rowIndex >= 0 && rowIndex < m_dimensions[0]);
+    return m_mappedMatrix + rowIndex * m_dimensions[1];
+}
+
 void CiftiMatrix::setMatrixFile(const AString &fileNameIn, const AString &cacheFileIn)
 {
     deleteCache();
     m_file.grabNew(NULL);
     m_readFile.grabNew(NULL);
     m_cacheFile.grabNew(NULL);
+    m_mapFile.grabNew(NULL);
     
     init();
     m_fileName = fileNameIn;
@@ -201,9 +269,21 @@ void CiftiMatrix::getRow(float *rowOut, const int64_t &rowIndex, const bool& tol
     {
         memcpy((char *)rowOut, (char *)&m_matrix[rowIndex*m_dimensions[1]], m_dimensions[1]*sizeof(float));
     }
+    else if(m_caching == MEMORY_MAPPED)
+    {
+        memcpy((char *)rowOut, (const char *)(m_mappedMatrix + rowIndex*m_dimensions[1]), m_dimensions[1]*sizeof(float));
+        if(m_needsSwapping) ByteSwapping::swapBytes(rowOut,m_dimensions[1]);
+    }
     else if(m_caching == ON_DISK)
     {
         qint64 numRead;
+#ifndef CARET_OS_WINDOWS
+        if (m_readFile == m_file)//the original file is never written to, so use positional reads that don't share a file offset between threads
+        {
+            numRead = positionalRead(m_readFile->handle(), (char *)rowOut, m_dimensions[1]*sizeof(float), m_matrixOffset+rowIndex*m_dimensions[1]*sizeof(float));
+            if (numRead < 0) throw CiftiFileException("error reading from file");
+        } else
+#endif
         {
             CaretMutexLocker locked(&m_fileMutex);
             if (!m_readFile->seek(m_matrixOffset+rowIndex*m_dimensions[1]*sizeof(float))) throw CiftiFileException("error seeking in file, file may be truncated");
@@ -217,9 +297,62 @@ void CiftiMatrix::getRow(float *rowOut, const int64_t &rowIndex, const bool& tol
     }
 }
 
+void CiftiMatrix::getRows(float *rowsOut, const int64_t &firstRow, const int64_t &numRows) const throw (CiftiFileException)
+{
+    if(!m_beenInitialized) throw CiftiFileException("Matrix needs to be initialized before using, or after the file name has been changed.");
+    CaretAssert(firstRow >= 0 && numRows >= 0 && firstRow + numRows <= m_dimensions[0]);
+    const int64_t numValues = numRows * m_dimensions[1];
+    if(m_caching == IN_MEMORY)
+    {
+        memcpy((char *)rowsOut, (char *)&m_matrix[firstRow*m_dimensions[1]], numValues*sizeof(float));
+    }
+    else if(m_caching == MEMORY_MAPPED)
+    {
+        memcpy((char *)rowsOut, (const char *)(m_mappedMatrix + firstRow*m_dimensions[1]), numValues*sizeof(float));
+        if(m_needsSwapping) ByteSwapping::swapBytes(rowsOut,numValues);
+    }
+    else if(m_caching == ON_DISK)
+    {
+        qint64 numRead;
+#ifndef CARET_OS_WINDOWS
+        if (m_readFile == m_file)
+        {
+            numRead = positionalRead(m_readFile->handle(), (char *)rowsOut, numValues*sizeof(float), m_matrixOffset+firstRow*m_dimensions[1]*sizeof(float));
+            if (numRead < 0) throw CiftiFileException("error reading from file");
+        } else
+#endif
+        {
+            CaretMutexLocker locked(&m_fileMutex);
+            if (!m_readFile->seek(m_matrixOffset+firstRow*m_dimensions[1]*sizeof(float))) throw CiftiFileException("error seeking in file, file may be truncated");
+            numRead = m_readFile->read((char *)rowsOut,numValues*sizeof(float));
+        }
+        if (numRead != (qint64)(numValues*sizeof(float)))
+        {
+            throw CiftiFileException("error reading rows, file may be truncated");
+        }
+        if(m_needsSwapping) ByteSwapping::swapBytes(rowsOut,numValues);
+    }
+}
+
+#ifndef CARET_OS_WINDOWS
+int64_t CiftiMatrix::positionalRead(const int& fileHandle, char* dataOut, const int64_t& numBytes, const int64_t& offset)
+{
+    int64_t totalRead = 0;
+    while (totalRead < numBytes)//network filesystems may return short reads before the end of the file
+    {
+        ssize_t result = pread(fileHandle, dataOut + totalRead, numBytes - totalRead, offset + totalRead);
+        if (result < 0) return -1;
+        if (result == 0) break;//end of file
+        totalRead += result;
+    }
+    return totalRead;
+}
+#endif
+
 void CiftiMatrix::setRow(float *rowIn, const int64_t &rowIndex) throw (CiftiFileException)
 {
     if(!m_beenInitialized) throw CiftiFileException("Matrix needs to be initialized before using, or after the file name has been changed.");
+    if(m_caching == MEMORY_MAPPED) convertMappedToInMemory();//the mapping is read-only
     if(m_caching == IN_MEMORY)
     {
         memcpy((char *)&m_matrix[rowIndex*m_dimensions[1]], (char *)rowIn, m_dimensions[1]*sizeof(float));
@@ -274,6 +407,11 @@ void CiftiMatrix::getColumn(float *columnOut, const int64_t &columnIndex) const
     {
         for(int64_t i=0;i<columnSize;i++){ columnOut[i]=m_matrix[columnIndex+rowSize*i]; }
     }
+    else if(m_caching == MEMORY_MAPPED)
+    {
+        for(int64_t i=0;i<columnSize;i++){ columnOut[i]=m_mappedMatrix[columnIndex+rowSize*i]; }
+        if(m_needsSwapping) ByteSwapping::swapBytes(columnOut,columnSize);
+    }
     else if(m_caching == ON_DISK)
     {
         {
@@ -292,6 +430,7 @@ void CiftiMatrix::getColumn(float *columnOut, const int64_t &columnIndex) const
 void CiftiMatrix::setColumn(float *columnIn, const int64_t &columnIndex) throw (CiftiFileException)
 {
     if(!m_beenInitialized) throw CiftiFileException("Matrix needs to be initialized before using, or after the file name has been changed.");
+    if(m_caching == MEMORY_MAPPED) convertMappedToInMemory();
     int64_t rowSize = m_dimensions[1];
     int64_t columnSize = m_dimensions[0];
     if(m_caching == IN_MEMORY)
@@ -322,6 +461,11 @@ void CiftiMatrix::getMatrix(float *matrixOut) throw (CiftiFileException)
     {
         memcpy((char *)matrixOut,(char *)m_matrix.getArray(),matrixLength*sizeof(float));
     }
+    else if(m_caching == MEMORY_MAPPED)
+    {
+        memcpy((char *)matrixOut,(const char *)m_mappedMatrix,matrixLength*sizeof(float));
+        if(m_needsSwapping) ByteSwapping::swapBytes(matrixOut,matrixLength);
+    }
     else if(m_caching == ON_DISK)
     {//TODO, see if QT has fixed reading large files
         {
@@ -337,6 +481,14 @@ void CiftiMatrix::getMatrix(float *matrixOut) throw (CiftiFileException)
 void CiftiMatrix::setMatrix(float *matrixIn) throw (CiftiFileException)
 {
     if(!m_beenInitialized) throw CiftiFileException("Matrix needs to be initialized before using, or after the file name has been changed.");
+    if(m_caching == MEMORY_MAPPED)//no point in copying the old contents
+    {
+        m_matrix = CaretArray<float>(m_dimensions[0]*m_dimensions[1]);
+        m_needsSwapping = false;
+        m_mapFile.grabNew(NULL);
+        m_mappedMatrix = NULL;
+        m_caching = IN_MEMORY;
+    }
     int64_t matrixLength = m_dimensions[0]*m_dimensions[1];
     if(m_caching == IN_MEMORY)
     {
@@ -393,6 +545,23 @@ void CiftiMatrix::writeToNewFile(const AString &fileNameIn, const int64_t  &offs
         outFile.write((char *)m_matrix.getArray(),matrixLength*sizeof(float));
         outFile.close();
     }
+    else if(m_caching == MEMORY_MAPPED)
+    {//the file is being written in native byte order, so copy by row to swap if needed
+        int64_t rowSize = m_dimensions[1];
+        int64_t columnSize = m_dimensions[0];
+        vector<float> row(rowSize);
+        QFile outFile;
+        outFile.setFileName(fileNameIn);
+        if (!outFile.open(QIODevice::ReadWrite)) throw CiftiFileException("failed to open file '" + fileNameIn + "' for writing");
+        outFile.seek(offsetIn);
+        for(int64_t i =0;i<columnSize;i++)
+        {
+            memcpy((char *)row.data(), (const char *)(m_mappedMatrix + i*rowSize), rowSize*sizeof(float));
+            if (m_needsSwapping) ByteSwapping::swapBytes(row.data(),rowSize);
+            if (outFile.write((char *)row.data(), rowSize*sizeof(float)) != (qint64)(rowSize * sizeof(float))) throw CiftiFileException("error writing to file, file may be truncated");
+        }
+        outFile.close();
+    }
     else if(m_caching == ON_DISK)
     {
         CaretMutexLocker locked(&m_fileMutex);//not really sure what all in here needs to be protected, but lock anyway - DO NOT call getRow or setRow with this locked
@@ -37,7 +37,8 @@ namespace caret {
 
 enum CacheEnum {
     ON_DISK,
-    IN_MEMORY
+    IN_MEMORY,
+    MEMORY_MAPPED//read-only mapping of an existing uncompressed file, converts to IN_MEMORY on first write
 };
 
 //WARNING: this is a dumb shallow copy object!
@@ -63,11 +64,15 @@ public:
 
     //Matrix IO
     void getRow(float * rowOut,const int64_t &rowIndex, const bool& tolerateShortRead = false) const throw (CiftiFileException);
+    ///reads rows firstRow through firstRow + numRows - 1 with one read, into numRows consecutive rows of rowsOut
+    void getRows(float * rowsOut, const int64_t &firstRow, const int64_t &numRows) const throw (CiftiFileException);
     void setRow(float * rowIn, const int64_t &rowIndex) throw (CiftiFileException);
     void getColumn(float * columnOut, const int64_t &columnIndex) const throw (CiftiFileException);
     void setColumn(float * columnIn, const int64_t &columnIndex) throw (CiftiFileException);
     void getMatrix(float *matrixOut) throw (CiftiFileException);
     void setMatrix(float *matrixIn) throw (CiftiFileException);
+    ///returns a pointer directly into the mapped file, or NULL if not MEMORY_MAPPED or the data needs swapping
+    const float* getRowPointer(const int64_t& rowIndex) const;
 
     //Flush Cache
     //void flushCache() throw (CiftiFileException);
@@ -79,6 +84,11 @@ protected:
     void copyMatrix(QFile *output, QFile *input, const bool& needsSwapping);
     void updateCache();
     void copyHelper(const CiftiMatrix& rhs);
+    bool mapMatrix();
+#ifndef CARET_OS_WINDOWS
+    static int64_t positionalRead(const int& fileHandle, char* dataOut, const int64_t& numBytes, const int64_t& offset);
+#endif
+    void convertMappedToInMemory();
     CacheEnum m_caching;
     CaretArray<float> m_matrix;
     vector <int64_t> m_dimensions;//ideally just two, but can take the standard
@@ -88,6 +98,8 @@ protected:
     mutable CaretPointer<QFile> m_file;
     mutable CaretPointer<QFile> m_readFile;
     mutable CaretPointer<QFile> m_cacheFile;
+    CaretPointer<QFile> m_mapFile;//keeps the mapping alive, shared between shallow copies
+    const float* m_mappedMatrix;//start of the matrix inside the mapping, NULL when not mapped
     mutable CaretMutex m_fileMutex;//mutex to lock to avoid concurrent calls to file access functions
     bool m_needsSwapping;
     bool m_beenInitialized;
@@ -0,0 +1,407 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CiftiRowLoader.h"
+
+#include "CaretAssert.h"
+#include "CaretException.h"
+#include "CiftiFile.h"
+#include "CiftiInterface.h"
+
+#include <QThread>
+
+#include <algorithm>
+#include <exception>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    const int64_t MAX_READ_BYTES = 8 * 1024 * 1024;//largest block of rows read at once
+    const int64_t MAX_GAP_ROWS = 4;//read through gaps this small rather than starting a new read, the extra rows go into the cache
+}
+
+namespace caret
+{
+    ///thread that reads rows for the current request of a CiftiRowLoader until the loader is destroyed
+    class CiftiRowLoaderWorker : public QThread
+    {
+        CiftiRowLoader* m_loader;
+    public:
+        CiftiRowLoaderWorker(CiftiRowLoader* loader) { m_loader = loader; }
+        void run() { m_loader->workerLoop(); }
+    };
+}
+
+CiftiRowLoader::CiftiRowLoader(const CiftiInterface* input, const int& numWorkers, const int64_t& cacheMegabytes)
+{
+    CaretAssert(input != NULL);
+    m_input = input;
+    m_numCols = m_input->getNumberOfColumns();
+    m_requestID = 0;
+    m_nextRow = 0;
+    m_rowsDone = 0;
+    m_nextPrefetch = 0;
+    m_numReads = 0;
+    m_requestActive = false;
+    m_requestFailed = false;
+    m_stopping = false;
+    int64_t rowBytes = max((int64_t)1, m_numCols * (int64_t)sizeof(float));
+    m_maxCachedRows = max((int64_t)1, cacheMegabytes * 1024 * 1024 / rowBytes);
+    int useWorkers = max(1, numWorkers);
+    m_inputFile = dynamic_cast<const CiftiFile*>(m_input);
+    m_serializeReads = (m_inputFile == NULL);//other implementations (xnat) may not tolerate concurrent reads
+    m_maxRunRows = 1;
+    if (m_inputFile != NULL)
+    {
+        m_maxRunRows = max((int64_t)1, MAX_READ_BYTES / rowBytes);
+    }
+    if (m_serializeReads || m_inputFile->isInMemory())
+    {
+        useWorkers = 1;//in-memory reads are just a copy, more threads won't help
+    }
+    for (int i = 0; i < useWorkers; ++i)
+    {
+        CiftiRowLoaderWorker* worker = new CiftiRowLoaderWorker(this);
+        m_workers.push_back(worker);
+        worker->start();
+    }
+}
+
+CiftiRowLoader::~CiftiRowLoader()
+{
+    {
+        QMutexLocker locked(&m_mutex);
+        m_stopping = true;
+        m_workAvailable.wakeAll();
+    }
+    for (int i = 0; i < (int)m_workers.size(); ++i)
+    {//workers finish the row they are reading, so this may wait for one row read
+        m_workers[i]->wait();
+        delete m_workers[i];
+    }
+}
+
+void CiftiRowLoader::readRow(float* rowOut, const int64_t& rowIndex) const
+{
+    if (m_serializeReads)
+    {
+        QMutexLocker readLocked(&m_readMutex);
+        m_input->getRow(rowOut, rowIndex);
+    } else {
+        m_input->getRow(rowOut, rowIndex);
+    }
+}
+
+void CiftiRowLoader::readRows(float* rowsOut, const int64_t& firstRow, const int64_t& numRows) const
+{
+    if (m_inputFile != NULL)
+    {
+        m_inputFile->getRows(rowsOut, firstRow, numRows);
+    } else {
+        for (int64_t i = 0; i < numRows; ++i)
+        {
+            readRow(rowsOut + i * m_numCols, firstRow + i);
+        }
+    }
+}
+
+int64_t CiftiRowLoader::findRunEnd(const vector<int64_t>& sortedRows, const int64_t& start) const
+{
+    int64_t numRows = (int64_t)sortedRows.size();
+    CaretAssert(start < numRows);
+    int64_t firstRow = sortedRows[start], end = start + 1;
+    while (end < numRows && sortedRows[end] - firstRow < m_maxRunRows && sortedRows[end] - sortedRows[end - 1] <= MAX_GAP_ROWS + 1)
+    {
+        ++end;
+    }
+    return end;
+}
+
+const vector<float>* CiftiRowLoader::findInCache(const int64_t& rowIndex)
+{
+    map<int64_t, CacheEntry>::iterator iter = m_cache.find(rowIndex);
+    if (iter == m_cache.end()) return NULL;
+    m_cacheUseOrder.splice(m_cacheUseOrder.begin(), m_cacheUseOrder, iter->second.m_useIter);//iterators into a list stay valid through splice
+    return &(iter->second.m_data);
+}
+
+void CiftiRowLoader::addToCache(const int64_t& rowIndex, const float* data)
+{
+    if (m_cache.find(rowIndex) != m_cache.end()) return;//another thread read it at the same time
+    while ((int64_t)m_cache.size() >= m_maxCachedRows)
+    {
+        m_cache.erase(m_cacheUseOrder.back());
+        m_cacheUseOrder.pop_back();
+    }
+    m_cacheUseOrder.push_front(rowIndex);
+    CacheEntry& newEntry = m_cache[rowIndex];
+    newEntry.m_data.assign(data, data + m_numCols);
+    newEntry.m_useIter = m_cacheUseOrder.begin();
+}
+
+void CiftiRowLoader::accumulateRow(const float* data)
+{
+    double* sumData = m_requestSum.data();
+    for (int64_t i = 0; i < m_numCols; ++i)
+    {
+        sumData[i] += data[i];
+    }
+    ++m_rowsDone;
+    if (m_rowsDone == (int64_t)m_requestRows.size())
+    {
+        m_requestFinished.wakeAll();
+    }
+}
+
+int64_t CiftiRowLoader::startRequest(const vector<int64_t>& rowIndices, const vector<int64_t>& prefetchRows) throw (CiftiFileException)
+{
+    int64_t numRows = m_input->getNumberOfRows();
+    for (size_t i = 0; i < rowIndices.size(); ++i)
+    {
+        if (rowIndices[i] < 0 || rowIndices[i] >= numRows) throw CiftiFileException("row index out of range in row loader request");
+    }
+    vector<int64_t> sortedRows = rowIndices;//file order, so nearby rows can be read together
+    sort(sortedRows.begin(), sortedRows.end());
+    vector<int64_t> sortedPrefetch;
+    for (size_t i = 0; i < prefetchRows.size(); ++i)
+    {
+        if (prefetchRows[i] >= 0 && prefetchRows[i] < numRows) sortedPrefetch.push_back(prefetchRows[i]);
+    }
+    sort(sortedPrefetch.begin(), sortedPrefetch.end());
+    sortedPrefetch.erase(unique(sortedPrefetch.begin(), sortedPrefetch.end()), sortedPrefetch.end());
+    if ((int64_t)sortedPrefetch.size() > m_maxCachedRows / 2)
+    {//don't let prefetching push the requested rows out of the cache
+        sortedPrefetch.clear();
+    }
+    QMutexLocker locked(&m_mutex);
+    ++m_requestID;
+    m_requestRows.swap(sortedRows);
+    m_prefetchRows.swap(sortedPrefetch);
+    m_nextPrefetch = 0;
+    m_nextRow = 0;
+    m_rowsDone = 0;
+    m_requestSum.assign(m_numCols, 0.0);
+    m_requestActive = true;
+    m_requestFailed = false;
+    m_failMessage = "";
+    while (m_nextRow < (int64_t)m_requestRows.size())
+    {//take cached rows now, so clicking between recent rows doesn't wait on the workers
+        const vector<float>* cached = findInCache(m_requestRows[m_nextRow]);
+        if (cached == NULL) break;
+        ++m_nextRow;
+        accumulateRow(cached->data());
+    }
+    if (m_nextRow < (int64_t)m_requestRows.size() || !m_prefetchRows.empty())
+    {
+        m_workAvailable.wakeAll();
+    }
+    return m_requestID;
+}
+
+void CiftiRowLoader::workerLoop()
+{
+    vector<float> readBuffer;
+    vector<double> localSum(m_numCols);
+    vector<int64_t> myRows;
+    QMutexLocker locked(&m_mutex);
+    while (true)
+    {
+        if (m_stopping) return;
+        bool isPrefetch = false;
+        if (m_requestActive && !m_requestFailed && m_nextRow < (int64_t)m_requestRows.size())
+        {
+            const vector<float>* cached = findInCache(m_requestRows[m_nextRow]);
+            if (cached != NULL)
+            {//repeated rows in a request, or read by a previous request
+                ++m_nextRow;
+                accumulateRow(cached->data());
+                continue;
+            }
+            int64_t runEnd = findRunEnd(m_requestRows, m_nextRow);
+            myRows.assign(m_requestRows.begin() + m_nextRow, m_requestRows.begin() + runEnd);
+            m_nextRow = runEnd;
+        } else if (m_nextPrefetch < (int64_t)m_prefetchRows.size()) {
+            if (m_cache.find(m_prefetchRows[m_nextPrefetch]) != m_cache.end())
+            {
+                ++m_nextPrefetch;
+                continue;
+            }
+            int64_t runEnd = findRunEnd(m_prefetchRows, m_nextPrefetch);
+            myRows.assign(m_prefetchRows.begin() + m_nextPrefetch, m_prefetchRows.begin() + runEnd);
+            m_nextPrefetch = runEnd;
+            isPrefetch = true;
+        } else {
+            m_workAvailable.wait(&m_mutex);
+            continue;
+        }
+        int64_t myRequest = m_requestID;
+        locked.unlock();
+        int64_t firstRow = myRows[0], numRead = myRows.back() - firstRow + 1;
+        AString errorMessage;
+        bool ok = true;
+        try
+        {//nothing may escape, this runs directly under QThread::run
+            readBuffer.resize(numRead * m_numCols);
+            readRows(readBuffer.data(), firstRow, numRead);
+        } catch (CaretException& e) {
+            ok = false;
+            errorMessage = e.whatString();
+        } catch (std::exception& e) {
+            ok = false;
+            errorMessage = e.what();
+        } catch (...) {
+            ok = false;
+            errorMessage = "unknown exception type thrown";
+        }
+        if (ok && !isPrefetch)
+        {//sum outside the lock, one pass per row over contiguous memory
+            double* sumData = localSum.data();
+            for (int64_t i = 0; i < m_numCols; ++i)
+            {
+                sumData[i] = 0.0;
+            }
+            for (int64_t r = 0; r < (int64_t)myRows.size(); ++r)
+            {
+                const float* rowData = readBuffer.data() + (myRows[r] - firstRow) * m_numCols;
+                for (int64_t i = 0; i < m_numCols; ++i)
+                {
+                    sumData[i] += rowData[i];
+                }
+            }
+        }
+        locked.relock();
+        ++m_numReads;
+        if (!ok)
+        {
+            if (!isPrefetch && myRequest == m_requestID && !m_requestFailed)
+            {
+                m_requestFailed = true;
+                if (numRead == 1)
+                {
+                    m_failMessage = "error reading row " + AString::number(firstRow) + ": " + errorMessage;
+                } else {
+                    m_failMessage = "error reading rows " + AString::number(firstRow) + " to " + AString::number(firstRow + numRead - 1) + ": " + errorMessage;
+                }
+                m_requestFinished.wakeAll();
+            }
+            continue;
+        }
+        for (int64_t i = 0; i < numRead; ++i)
+        {//cache them even if the request was superseded, the user may click back
+            addToCache(firstRow + i, readBuffer.data() + i * m_numCols);
+        }
+        if (!isPrefetch && myRequest == m_requestID)
+        {
+            double* requestData = m_requestSum.data();
+            const double* sumData = localSum.data();
+            for (int64_t i = 0; i < m_numCols; ++i)
+            {
+                requestData[i] += sumData[i];
+            }
+            m_rowsDone += (int64_t)myRows.size();
+            if (m_rowsDone == (int64_t)m_requestRows.size())
+            {
+                m_requestFinished.wakeAll();
+            }
+        }
+    }
+}
+
+bool CiftiRowLoader::takeResultLocked(const int64_t& requestID, vector<float>& dataOut) throw (CiftiFileException)
+{
+    if (requestID != m_requestID || !m_requestActive) return false;
+    if (m_requestFailed)
+    {
+        m_requestActive = false;
+        throw CiftiFileException(m_failMessage);
+    }
+    int64_t numRequested = (int64_t)m_requestRows.size();
+    if (m_rowsDone < numRequested) return false;
+    dataOut.resize(m_numCols);
+    if (numRequested > 0)
+    {
+        for (int64_t i = 0; i < m_numCols; ++i)
+        {
+            dataOut[i] = (float)(m_requestSum[i] / numRequested);
+        }
+    } else {
+        fill(dataOut.begin(), dataOut.end(), 0.0f);
+    }
+    m_requestActive = false;
+    return true;
+}
+
+bool CiftiRowLoader::takeResult(const int64_t& requestID, vector<float>& dataOut) throw (CiftiFileException)
+{
+    QMutexLocker locked(&m_mutex);
+    return takeResultLocked(requestID, dataOut);
+}
+
+bool CiftiRowLoader::waitForResult(const int64_t& requestID, vector<float>& dataOut, const unsigned long& timeoutMilliseconds) throw (CiftiFileException)
+{
+    QMutexLocker locked(&m_mutex);
+    if (requestID == m_requestID && m_requestActive && !m_requestFailed && m_rowsDone < (int64_t)m_requestRows.size())
+    {
+        m_requestFinished.wait(&m_mutex, timeoutMilliseconds);
+    }
+    return takeResultLocked(requestID, dataOut);
+}
+
+void CiftiRowLoader::cancelRequest()
+{
+    QMutexLocker locked(&m_mutex);
+    ++m_requestID;//rows already being read still go into the cache
+    m_requestActive = false;
+    m_requestRows.clear();
+    m_nextRow = 0;
+    m_rowsDone = 0;
+}
+
+int64_t CiftiRowLoader::getRowsCompleted(const int64_t& requestID) const
+{
+    QMutexLocker locked(&m_mutex);
+    if (requestID != m_requestID) return 0;
+    return m_rowsDone;
+}
+
+void CiftiRowLoader::getRow(float* rowOut, const int64_t& rowIndex) throw (CiftiFileException)
+{
+    {
+        QMutexLocker locked(&m_mutex);
+        const vector<float>* cached = findInCache(rowIndex);
+        if (cached != NULL)
+        {
+            copy(cached->begin(), cached->end(), rowOut);
+            return;
+        }
+    }
+    readRow(rowOut, rowIndex);
+    QMutexLocker locked(&m_mutex);
+    ++m_numReads;
+    addToCache(rowIndex, rowOut);
+}
+
+int64_t CiftiRowLoader::getNumberOfReads() const
+{
+    QMutexLocker locked(&m_mutex);
+    return m_numReads;
+}
@@ -0,0 +1,123 @@
+#ifndef __CIFTI_ROW_LOADER_H__
+#define __CIFTI_ROW_LOADER_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CiftiFileException.h"
+
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <list>
+#include <map>
+#include <vector>
+
+namespace caret
+{
+    
+    class CiftiFile;
+    class CiftiInterface;
+    class CiftiRowLoaderWorker;
+    
+    ///loads single rows or averages of rows on a small pool of background threads, keeping recently read rows in an LRU cache
+    ///only the most recent request is worked on, starting a new request abandons the previous one
+    ///requested rows are read in file order, with nearby rows of an on-disk CiftiFile merged into single large reads
+    class CiftiRowLoader
+    {
+    public:
+        CiftiRowLoader(const CiftiInterface* input, const int& numWorkers = 2, const int64_t& cacheMegabytes = 256);
+        
+        ~CiftiRowLoader();
+        
+        ///start loading the average of the given rows, superseding any unfinished request - returns the id of the request
+        ///if the rows are all cached, the request is finished before this returns
+        ///prefetchRows are read into the cache after the request's rows, when they are likely to be requested next
+        int64_t startRequest(const std::vector<int64_t>& rowIndices, const std::vector<int64_t>& prefetchRows = std::vector<int64_t>()) throw (CiftiFileException);
+        
+        ///if the request has finished, put the average row in dataOut and return true, throws if reading failed
+        ///a request that was superseded or cancelled never finishes
+        bool takeResult(const int64_t& requestID, std::vector<float>& dataOut) throw (CiftiFileException);
+        
+        ///wait up to the timeout for the request to finish, then behave like takeResult
+        bool waitForResult(const int64_t& requestID, std::vector<float>& dataOut, const unsigned long& timeoutMilliseconds) throw (CiftiFileException);
+        
+        ///abandon the current request, if any
+        void cancelRequest();
+        
+        ///number of rows of the request that have been read so far
+        int64_t getRowsCompleted(const int64_t& requestID) const;
+        
+        ///read one row immediately, through the cache
+        void getRow(float* rowOut, const int64_t& rowIndex) throw (CiftiFileException);
+        
+        ///number of reads from the input so far, a block of merged rows counts as one read
+        int64_t getNumberOfReads() const;
+        
+    private:
+        CiftiRowLoader(const CiftiRowLoader&);
+        CiftiRowLoader& operator=(const CiftiRowLoader&);
+        
+        struct CacheEntry
+        {
+            std::vector<float> m_data;
+            std::list<int64_t>::iterator m_useIter;//position in m_cacheUseOrder
+        };
+        
+        void workerLoop();//called from the worker threads
+        void readRow(float* rowOut, const int64_t& rowIndex) const;//no locking, except to serialize reads on inputs that need it
+        void readRows(float* rowsOut, const int64_t& firstRow, const int64_t& numRows) const;//same, one read if the input allows
+        int64_t findRunEnd(const std::vector<int64_t>& sortedRows, const int64_t& start) const;//end of the block of nearby rows beginning at start
+        const std::vector<float>* findInCache(const int64_t& rowIndex);//caller must hold m_mutex, marks the row as most recently used
+        void addToCache(const int64_t& rowIndex, const float* data);//caller must hold m_mutex
+        void accumulateRow(const float* data);//caller must hold m_mutex
+        bool takeResultLocked(const int64_t& requestID, std::vector<float>& dataOut) throw (CiftiFileException);
+        
+        const CiftiInterface* m_input;
+        const CiftiFile* m_inputFile;//NULL if the input can't read blocks of rows
+        int64_t m_numCols;
+        int64_t m_maxRunRows;//most rows in one read
+        bool m_serializeReads;
+        mutable QMutex m_readMutex;
+        
+        int64_t m_requestID;//incremented on every new or cancelled request
+        std::vector<int64_t> m_requestRows;//sorted, may contain repeats
+        int64_t m_nextRow, m_rowsDone;
+        std::vector<int64_t> m_prefetchRows;//sorted, unique
+        int64_t m_nextPrefetch;
+        std::vector<double> m_requestSum;
+        bool m_requestActive, m_requestFailed, m_stopping;
+        AString m_failMessage;
+        
+        std::map<int64_t, CacheEntry> m_cache;
+        std::list<int64_t> m_cacheUseOrder;//front is most recently used
+        int64_t m_maxCachedRows;
+        int64_t m_numReads;
+        
+        mutable QMutex m_mutex;
+        QWaitCondition m_workAvailable, m_requestFinished;
+        std::vector<CiftiRowLoaderWorker*> m_workers;
+        
+        friend class CiftiRowLoaderWorker;
+    };
+    
+}
+
+#endif //__CIFTI_ROW_LOADER_H__
@@ -0,0 +1,197 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CiftiRowStream.h"
+
+#include "CaretAssert.h"
+#include "CaretException.h"
+#include "CiftiFile.h"
+#include "CiftiInterface.h"
+
+#include <QThread>
+
+#include <algorithm>
+#include <exception>
+
+using namespace caret;
+using namespace std;
+
+namespace caret
+{
+    ///thread that fills slots of a CiftiRowStream until it is finished or stopped
+    class CiftiRowStreamReader : public QThread
+    {
+        CiftiRowStream* m_stream;
+    public:
+        CiftiRowStreamReader(CiftiRowStream* stream) { m_stream = stream; }
+        void run() { m_stream->readerLoop(); }
+    };
+}
+
+CiftiRowStream::CiftiRowStream(const CiftiInterface* input, const int& readAheadDepth, const int& numReaders)
+{
+    CaretAssert(input != NULL);
+    m_input = input;
+    m_useRowList = false;
+    m_numToStream = m_input->getNumberOfRows();
+    init(readAheadDepth, numReaders);
+}
+
+CiftiRowStream::CiftiRowStream(const CiftiInterface* input, const vector<int64_t>& rowList, const int& readAheadDepth, const int& numReaders)
+{
+    CaretAssert(input != NULL);
+    m_input = input;
+    m_useRowList = true;
+    m_rowList = rowList;
+    m_numToStream = (int64_t)m_rowList.size();
+    int64_t numRows = m_input->getNumberOfRows();
+    for (int64_t i = 0; i < m_numToStream; ++i)
+    {
+        if (m_rowList[i] < 0 || m_rowList[i] >= numRows) throw CiftiFileException("row index out of range in row stream request");
+    }
+    init(readAheadDepth, numReaders);
+}
+
+void CiftiRowStream::init(const int& readAheadDepth, const int& numReaders)
+{
+    m_nextToRead = 0;
+    m_nextToReturn = 0;
+    m_haveReturned = false;
+    m_stopping = false;
+    m_failed = false;
+    int64_t numCols = m_input->getNumberOfColumns();
+    int depth = max(1, readAheadDepth);
+    if (depth > m_numToStream) depth = max((int64_t)1, m_numToStream);//don't allocate slots we will never use
+    m_slots.resize(depth);
+    for (int i = 0; i < depth; ++i)
+    {
+        m_slots[i].m_data.resize(numCols);
+        m_slots[i].m_listIndex = -1;
+        m_slots[i].m_state = SLOT_EMPTY;
+    }
+    int useReaders = max(1, min(numReaders, depth));
+    const CiftiFile* asFile = dynamic_cast<const CiftiFile*>(m_input);
+    if (asFile == NULL || asFile->isInMemory())
+    {
+        useReaders = 1;//other implementations (xnat) may not tolerate concurrent reads, and in-memory reads are just a copy
+    }
+    for (int i = 0; i < useReaders; ++i)
+    {
+        CiftiRowStreamReader* reader = new CiftiRowStreamReader(this);
+        m_readers.push_back(reader);
+        reader->start();
+    }
+}
+
+void CiftiRowStream::readerLoop()
+{
+    QMutexLocker locked(&m_mutex);
+    while (true)
+    {
+        if (m_stopping || m_failed || m_nextToRead >= m_numToStream) return;
+        int64_t listIndex = m_nextToRead;
+        Slot& mySlot = m_slots[listIndex % m_slots.size()];
+        if (mySlot.m_state != SLOT_EMPTY)
+        {
+            m_slotFreed.wait(&m_mutex);//the consumer hasn't released the row that was using this slot
+            continue;
+        }
+        ++m_nextToRead;
+        mySlot.m_state = SLOT_READING;
+        mySlot.m_listIndex = listIndex;
+        int64_t rowIndex = (m_useRowList ? m_rowList[listIndex] : listIndex);
+        locked.unlock();
+        AString errorMessage;
+        bool ok = true;
+        try
+        {
+            m_input->getRow(mySlot.m_data.data(), rowIndex);
+        } catch (CaretException& e) {
+            ok = false;
+            errorMessage = e.whatString();
+        } catch (std::exception& e) {
+            ok = false;
+            errorMessage = e.what();
+        }
+        locked.relock();
+        if (!ok)
+        {
+            if (!m_failed)
+            {
+                m_failed = true;
+                m_failMessage = "error reading row " + AString::number(rowIndex) + ": " + errorMessage;
+            }
+            m_slotReady.wakeAll();
+            m_slotFreed.wakeAll();//so other readers notice and exit
+            return;
+        }
+        mySlot.m_state = SLOT_READY;
+        m_slotReady.wakeAll();
+    }
+}
+
+const float* CiftiRowStream::nextRow(int64_t& rowIndexOut) throw (CiftiFileException)
+{
+    QMutexLocker locked(&m_mutex);
+    if (m_haveReturned)
+    {//release the slot from the previous call
+        Slot& oldSlot = m_slots[(m_nextToReturn - 1) % m_slots.size()];
+        oldSlot.m_state = SLOT_EMPTY;
+        m_haveReturned = false;
+        m_slotFreed.wakeAll();
+    }
+    if (m_nextToReturn >= m_numToStream) return NULL;
+    Slot& mySlot = m_slots[m_nextToReturn % m_slots.size()];
+    while (mySlot.m_state != SLOT_READY || mySlot.m_listIndex != m_nextToReturn)
+    {
+        if (m_failed) throw CiftiFileException(m_failMessage);
+        m_slotReady.wait(&m_mutex);
+    }
+    rowIndexOut = (m_useRowList ? m_rowList[m_nextToReturn] : m_nextToReturn);
+    ++m_nextToReturn;
+    m_haveReturned = true;
+    return mySlot.m_data.data();//readers won't touch it until it is released
+}
+
+bool CiftiRowStream::nextRow(float* rowOut, int64_t& rowIndexOut) throw (CiftiFileException)
+{
+    const float* row = nextRow(rowIndexOut);
+    if (row == NULL) return false;
+    int64_t numCols = m_input->getNumberOfColumns();
+    for (int64_t i = 0; i < numCols; ++i)
+    {
+        rowOut[i] = row[i];
+    }
+    return true;
+}
+
+CiftiRowStream::~CiftiRowStream()
+{
+    {
+        QMutexLocker locked(&m_mutex);
+        m_stopping = true;
+        m_slotFreed.wakeAll();
+    }
+    for (int i = 0; i < (int)m_readers.size(); ++i)
+    {
+        m_readers[i]->wait();
+        delete m_readers[i];
+    }
+}
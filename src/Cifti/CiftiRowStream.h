@@ -0,0 +1,96 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#ifndef __CIFTI_ROW_STREAM_H__
+#define __CIFTI_ROW_STREAM_H__
+
+#include "CiftiFileException.h"
+
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <vector>
+
+namespace caret
+{
+    
+    class CiftiInterface;
+    class CiftiRowStreamReader;
+    
+    ///reads rows of a cifti file ahead of the caller on background threads, so that disk IO overlaps computation
+    ///rows are returned in the order requested, the caller should not read from the same file while streaming
+    class CiftiRowStream
+    {
+    public:
+        ///stream all rows, in order
+        CiftiRowStream(const CiftiInterface* input, const int& readAheadDepth = 16, const int& numReaders = 2);
+        
+        ///stream only the specified rows, in the order given
+        CiftiRowStream(const CiftiInterface* input, const std::vector<int64_t>& rowList, const int& readAheadDepth = 16, const int& numReaders = 2);
+        
+        ~CiftiRowStream();
+        
+        ///get the next row, blocking until it has been read - returns NULL after the last row
+        ///the returned pointer is only valid until the next call
+        const float* nextRow(int64_t& rowIndexOut) throw (CiftiFileException);
+        
+        ///copy the next row into caller memory - returns false after the last row
+        bool nextRow(float* rowOut, int64_t& rowIndexOut) throw (CiftiFileException);
+        
+    private:
+        CiftiRowStream(const CiftiRowStream&);
+        CiftiRowStream& operator=(const CiftiRowStream&);
+        
+        enum SlotState
+        {
+            SLOT_EMPTY,
+            SLOT_READING,
+            SLOT_READY
+        };
+        
+        struct Slot
+        {
+            std::vector<float> m_data;
+            int64_t m_listIndex;
+            SlotState m_state;
+        };
+        
+        void init(const int& readAheadDepth, const int& numReaders);
+        void readerLoop();//called from the reader threads
+        
+        const CiftiInterface* m_input;
+        std::vector<int64_t> m_rowList;
+        bool m_useRowList;
+        int64_t m_numToStream;
+        std::vector<Slot> m_slots;
+        int64_t m_nextToRead, m_nextToReturn;
+        bool m_haveReturned, m_stopping;
+        bool m_failed;
+        AString m_failMessage;
+        QMutex m_mutex;
+        QWaitCondition m_slotFreed, m_slotReady;
+        std::vector<CiftiRowStreamReader*> m_readers;
+        
+        friend class CiftiRowStreamReader;
+    };
+    
+}
+
+#endif //__CIFTI_ROW_STREAM_H__
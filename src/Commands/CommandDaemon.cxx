@@ -0,0 +1,248 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+
+#include "CommandDaemon.h"
+
+#include "CaretCommandLine.h"
+#include "CaretLogger.h"
+#include "CaretPointer.h"
+#include "CommandOperationManager.h"
+#include "CommandParser.h"
+#include "CommandSurfaceCache.h"
+#include "ProgramParameters.h"
+
+#include <QDir>
+#include <QLocalServer>
+#include <QLocalSocket>
+
+#include <iostream>
+
+using namespace caret;
+using namespace std;
+
+/**
+ * Constructor.
+ */
+CommandDaemon::CommandDaemon()
+: CommandOperation("-daemon",
+                   "RUN COMMANDS SENT OVER A LOCAL SOCKET, CACHING SURFACES")
+{
+    
+}
+
+/**
+ * Destructor.
+ */
+CommandDaemon::~CommandDaemon()
+{
+    
+}
+
+/**
+ * @return The help information.
+ */
+AString
+CommandDaemon::getHelpInformation(const AString& programName)
+{
+    //guide for wrap, assuming 80 columns:                                                  |
+    AString helpInfo = ("RUN COMMANDS SENT OVER A LOCAL SOCKET, CACHING SURFACES\n"
+                        "   " + programName + " -daemon\n"
+                        "      <socket> - name or path of the local socket to listen on\n"
+                        "\n"
+                        "      [-surface-cache] - set how many surface files to keep\n"
+                        "         <count> - number of surfaces, default " + AString::number(DEFAULT_CACHED_SURFACES) + "\n"
+                        "\n"
+                        "   Stays running and executes commands sent to the socket, one at a time,\n"
+                        "   without the startup cost of a new process.  Input surfaces are kept in\n"
+                        "   memory, keyed by a hash of their file contents, along with any topology,\n"
+                        "   geodesic, signed distance, or point locator helpers built for them, so\n"
+                        "   later commands using an identical surface file skip both reading it and\n"
+                        "   building those helpers.  The least recently used surfaces are dropped\n"
+                        "   when the cache is full.\n"
+                        "\n"
+                        "   A request is a sequence of NUL-terminated fields: the number of\n"
+                        "   arguments, the working directory for relative file names, and then the\n"
+                        "   arguments as they would be given to " + programName + ".  For example:\n"
+                        "\n"
+                        "   printf '%s\\0' 3 \"$PWD\" -surface-vertex-areas in.surf.gii out.func.gii \\\n"
+                        "      | socat - UNIX-CONNECT:/tmp/wb.sock\n"
+                        "\n"
+                        "   The reply is a single line, either 'OK' or 'ERROR: ' and the message.\n"
+                        "   Text printed by commands goes to the daemon's own output.  Send the single\n"
+                        "   argument -stop-daemon to make it exit.\n");
+    return helpInfo;
+}
+
+/**
+ * Execute the operation.
+ * 
+ * @param parameters
+ *   Parameters for the operation.
+ * @throws CommandException
+ *   If the command failed.
+ * @throws ProgramParametersException
+ *   If there is an error in the parameters.
+ */
+void
+CommandDaemon::executeOperation(ProgramParameters& parameters) throw (CommandException,
+                                                                  ProgramParametersException)
+{
+    const AString socketName = parameters.nextString("Socket Name");
+    int cacheSize = DEFAULT_CACHED_SURFACES;
+    while (parameters.hasNext())
+    {
+        AString option = parameters.nextString("option");
+        if (option == "-surface-cache")
+        {
+            cacheSize = parameters.nextInt("Surface Count");
+            if (cacheSize < 1)
+            {
+                throw ProgramParametersException("surface cache must hold at least one surface");
+            }
+        } else {
+            throw ProgramParametersException("unknown option: " + option);
+        }
+    }
+    QLocalServer myServer;
+    QLocalServer::removeServer(socketName);//clean up after a daemon that didn't exit normally
+    if (!myServer.listen(socketName))
+    {
+        throw CommandException("failed to listen on socket '" + socketName + "': " + myServer.errorString());
+    }
+    CommandSurfaceCache myCache(cacheSize);
+    CommandParser::setSurfaceCache(&myCache);
+    const AString programName = parameters.getProgramName();
+    bool keepRunning = true;
+    while (keepRunning)
+    {
+        if (!myServer.waitForNewConnection(-1))
+        {
+            CommandParser::setSurfaceCache(NULL);
+            throw CommandException("error waiting for connection on socket '" + socketName + "': " + myServer.errorString());
+        }
+        CaretPointer<QLocalSocket> mySocket(myServer.nextPendingConnection());
+        if (mySocket == NULL) continue;
+        mySocket->setParent(NULL);//we manage its lifetime, not the server
+        AString workingDir, error;
+        vector<AString> arguments;
+        if (!readRequest(mySocket, workingDir, arguments, error))
+        {
+            sendReply(mySocket, "ERROR: " + error);
+            continue;
+        }
+        if (arguments.size() == 1 && arguments[0] == "-stop-daemon")
+        {
+            sendReply(mySocket, "OK");
+            keepRunning = false;
+            continue;
+        }
+        AString reply = runRequest(workingDir, arguments, programName);
+        myCache.keepHelpers();//the command is done with its copies, so helpers it built can serve later requests
+        CaretLogFine("surface cache hits: " + AString::number(myCache.getNumberOfHits()) + ", misses: " + AString::number(myCache.getNumberOfMisses()));
+        sendReply(mySocket, reply);
+    }
+    CommandParser::setSurfaceCache(NULL);
+    myServer.close();
+}
+
+AString CommandDaemon::runRequest(const AString& workingDir, const vector<AString>& arguments, const AString& programName)
+{
+    if (!arguments.empty() && (arguments[0] == "-daemon" || arguments[0] == "-stop-daemon"))
+    {
+        return "ERROR: '" + arguments[0] + "' can't be run by the daemon";
+    }
+    const AString startDir = QDir::currentPath();
+    if (!QDir::setCurrent(workingDir))
+    {
+        return "ERROR: working directory '" + workingDir + "' does not exist";
+    }
+    ProgramParameters requestParameters;
+    for (int i = 0; i < (int)arguments.size(); ++i)
+    {
+        requestParameters.addParameter(arguments[i]);
+    }
+    caret_global_commandLine = programName + " " + requestParameters.getAllParametersInString();//provenance of the outputs
+    CaretLogFine("Running: " + caret_global_commandLine);
+    AString reply = "OK";
+    try
+    {
+        CommandOperationManager::getCommandOperationManager()->runCommand(requestParameters);
+    } catch (CaretException& e) {
+        reply = "ERROR: " + e.whatString();
+    } catch (exception& e) {
+        reply = "ERROR: " + AString(e.what());
+    } catch (...) {
+        reply = "ERROR: unknown exception type thrown";
+    }
+    cout.flush();
+    QDir::setCurrent(startDir);
+    return reply;
+}
+
+bool CommandDaemon::readRequest(QLocalSocket* socket, AString& workingDirOut, vector<AString>& argumentsOut, AString& errorOut)
+{
+    QByteArray buffer;
+    vector<AString> fields;
+    int expectedFields = -1;//unknown until the count field arrives
+    int fieldStart = 0;
+    while (expectedFields < 0 || (int)fields.size() < expectedFields)
+    {
+        int fieldEnd = buffer.indexOf('\0', fieldStart);
+        if (fieldEnd < 0)
+        {
+            if (socket->bytesAvailable() == 0 && !socket->waitForReadyRead(REQUEST_TIMEOUT_MSEC))
+            {
+                errorOut = "incomplete request";
+                return false;
+            }
+            buffer.append(socket->readAll());
+            continue;
+        }
+        fields.push_back(AString::fromUtf8(buffer.constData() + fieldStart, fieldEnd - fieldStart));
+        fieldStart = fieldEnd + 1;
+        if (expectedFields < 0)
+        {
+            bool ok = false;
+            int numArgs = fields[0].toInt(&ok);
+            if (!ok || numArgs < 1)
+            {
+                errorOut = "request must start with the number of arguments";
+                return false;
+            }
+            expectedFields = numArgs + 2;//count and working directory come first
+        }
+    }
+    workingDirOut = fields[1];
+    argumentsOut = vector<AString>(fields.begin() + 2, fields.end());
+    return true;
+}
+
+void CommandDaemon::sendReply(QLocalSocket* socket, const AString& reply)
+{
+    socket->write((reply + "\n").toUtf8());
+    socket->flush();
+    socket->waitForBytesWritten(REQUEST_TIMEOUT_MSEC);
+    socket->disconnectFromServer();
+    if (socket->state() != QLocalSocket::UnconnectedState)
+    {
+        socket->waitForDisconnected(REQUEST_TIMEOUT_MSEC);
+    }
+}
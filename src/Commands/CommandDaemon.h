@@ -0,0 +1,71 @@
+#ifndef __COMMAND_DAEMON_H__
+#define __COMMAND_DAEMON_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+
+#include "CommandOperation.h"
+
+#include <vector>
+
+class QLocalSocket;
+
+namespace caret {
+
+    /// Command that stays running and executes commands sent over a local socket, keeping input surfaces cached between them
+    class CommandDaemon : public CommandOperation {
+        
+    public:
+        CommandDaemon();
+        
+        virtual ~CommandDaemon();
+        
+        virtual void executeOperation(ProgramParameters& parameters)
+            throw (CommandException,
+                   ProgramParametersException);
+        
+        AString getHelpInformation(const AString& programName);
+        
+        ///reads one request from the socket, returns false and sets errorOut if it is malformed
+        static bool readRequest(QLocalSocket* socket, AString& workingDirOut, std::vector<AString>& argumentsOut, AString& errorOut);
+        
+        ///sends the reply line and closes the connection
+        static void sendReply(QLocalSocket* socket, const AString& reply);
+        
+        ///runs one request's command in its working directory, returns the reply to send
+        static AString runRequest(const AString& workingDir, const std::vector<AString>& arguments, const AString& programName);
+        
+    private:
+        
+        CommandDaemon(const CommandDaemon&);
+        
+        CommandDaemon& operator=(const CommandDaemon&);
+        
+        enum
+        {
+            DEFAULT_CACHED_SURFACES = 20,
+            REQUEST_TIMEOUT_MSEC = 30000
+        };
+    };
+    
+} // namespace
+
+#endif // __COMMAND_DAEMON_H__
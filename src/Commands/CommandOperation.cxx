@@ -60,6 +60,8 @@ CommandOperation::execute(ProgramParameters& parameters, const bool& preventProv
         if (preventProvenance)
         {
             disableProvenance();//let provenance-ignorant commands not need to deal with an unused parameter
+        } else {
+            enableProvenance();//the same command object can be run more than once, see -daemon
         }
         this->executeOperation(parameters);
     }
@@ -72,6 +74,10 @@ void CommandOperation::disableProvenance()
 {
 }
 
+void CommandOperation::enableProvenance()
+{
+}
+
 bool CommandOperation::takesParameters()
 {
     return true;
@@ -57,6 +57,8 @@ namespace caret {
         
         virtual void disableProvenance();
         
+        virtual void enableProvenance();
+        
         CommandOperation(const AString& commandLineSwitch,
                          const AString& operationShortDescription);
         
@@ -183,8 +183,10 @@
 #include "CommandClassCreateEnum.h"
 #include "CommandClassCreateOperation.h"
 #include "CommandC11xTesting.h"
+#include "CommandDaemon.h"
 #include "CommandGiftiConvert.h"
 #include "CommandNiftiConvert.h"
+#include "CommandPipeline.h"
 #include "CommandUnitTest.h"
 #include "ProgramParameters.h"
 
@@ -389,6 +391,8 @@ CommandOperationManager::CommandOperationManager()
     this->commandOperations.push_back(new CommandGiftiConvert());
     this->commandOperations.push_back(new CommandUnitTest());
     this->commandOperations.push_back(new CommandNiftiConvert());
+    this->commandOperations.push_back(new CommandPipeline());
+    this->commandOperations.push_back(new CommandDaemon());
 }
 
 /**
@@ -27,6 +27,7 @@
 #include "CaretCommandLine.h"
 #include "CaretLogger.h"
 #include "CiftiFile.h"
+#include "CommandSurfaceCache.h"
 #include "DataFileException.h"
 #include "FileInformation.h"
 #include "FociFile.h"
@@ -48,12 +49,15 @@ const AString CommandParser::PROVENANCE_NAME = "Provenance";
 const AString CommandParser::PARENT_PROVENANCE_NAME = "ParentProvenance";
 const AString CommandParser::PROGRAM_PROVENANCE_NAME = "ProgramProvenance";
 const AString CommandParser::CWD_PROVENANCE_NAME = "WorkingDirectory";
+CommandSurfaceCache* CommandParser::s_surfaceCache = NULL;
 
 CommandParser::CommandParser(AutoOperationInterface* myAutoOper) :
     CommandOperation(myAutoOper->getCommandSwitch(), myAutoOper->getShortDescription()),
     OperationParserInterface(myAutoOper)
 {
     m_doProvenance = true;
+    m_memoryFiles = NULL;
+    m_planOnly = false;
 }
 
 void CommandParser::disableProvenance()
@@ -61,17 +65,37 @@ void CommandParser::disableProvenance()
     m_doProvenance = false;
 }
 
+void CommandParser::enableProvenance()
+{
+    m_doProvenance = true;
+}
+
 
 void CommandParser::executeOperation(ProgramParameters& parameters) throw (CommandException, ProgramParametersException)
+{
+    m_memoryFiles = NULL;
+    runOperation(parameters, caret_global_commandLine);
+}
+
+void CommandParser::executePipelineStep(ProgramParameters& parameters, const AString& stepProvenance, MemoryFileStore* memoryFiles) throw (CommandException, ProgramParametersException)
+{
+    CaretAssert(memoryFiles != NULL);
+    m_memoryFiles = memoryFiles;
+    runOperation(parameters, stepProvenance);
+    m_memoryFiles = NULL;
+}
+
+void CommandParser::runOperation(ProgramParameters& parameters, const AString& provenance)
 {
     try
     {
         CaretPointer<OperationParameters> myAlgParams(m_autoOper->getParameters());//could be an autopointer, but this is safer
         vector<OutputAssoc> myOutAssoc;
-        m_provenance = caret_global_commandLine;
+        m_provenance = provenance;
         //the idea is to have m_provenance set before the command executes, so it can be overridden, but have m_parentProvenance set AFTER the processing is complete
         //the parent provenance should never be generated manually
         m_parentProvenance = "";//in case someone tries to use the same instance more than once
+        m_inputCiftiNames.clear();//the same instance is reused by every pipeline step and daemon request that runs this command
         m_workingDir = QDir::currentPath();//get the current path, in case some stupid command changes the working directory
         //these get set on output files during writeOutput (and for on-disk in provenanceBeforeOperation)
         parseComponent(myAlgParams.getPointer(), parameters, myOutAssoc);//parsing block
@@ -104,6 +128,39 @@ void CommandParser::showParsedOperation(ProgramParameters& parameters) throw (Co
     //don't execute or write parsed output
 }
 
+void CommandParser::getPipelineFileNames(ProgramParameters& parameters, vector<AString>& inputsOut, vector<AString>& outputsOut) throw (CommandException, ProgramParametersException)
+{
+    CaretPointer<OperationParameters> myAlgParams(m_autoOper->getParameters());
+    vector<OutputAssoc> myOutAssoc;
+    m_plannedInputs.clear();
+    m_planOnly = true;
+    try
+    {
+        parseComponent(myAlgParams.getPointer(), parameters, myOutAssoc);
+        parameters.verifyAllParametersProcessed();
+    } catch (...) {
+        m_planOnly = false;
+        throw;
+    }
+    m_planOnly = false;
+    inputsOut = m_plannedInputs;
+    outputsOut.clear();
+    for (int i = 0; i < (int)myOutAssoc.size(); ++i)
+    {
+        outputsOut.push_back(myOutAssoc[i].m_fileName);
+    }
+}
+
+bool CommandParser::isMemoryFileName(const AString& name)
+{
+    return name.size() > 1 && name[0] == '@';
+}
+
+void CommandParser::setSurfaceCache(CommandSurfaceCache* surfaceCache)
+{
+    s_surfaceCache = surfaceCache;
+}
+
 void CommandParser::parseComponent(ParameterComponent* myComponent, ProgramParameters& parameters, vector<OutputAssoc>& outAssociation, bool debug)
 {
     uint32_t i;
@@ -131,6 +188,43 @@ void CommandParser::parseComponent(ParameterComponent* myComponent, ProgramParam
             }
         }
         switch (myComponent->m_paramList[i]->getType())
+        {//handle pipeline planning and in-memory inputs before the normal parsing
+            case OperationParametersEnum::BORDER:
+            case OperationParametersEnum::CIFTI:
+            case OperationParametersEnum::FOCI:
+            case OperationParametersEnum::LABEL:
+            case OperationParametersEnum::METRIC:
+            case OperationParametersEnum::SURFACE:
+            case OperationParametersEnum::VOLUME:
+                if (m_planOnly)
+                {
+                    m_plannedInputs.push_back(nextArg);
+                    continue;
+                }
+                if (m_memoryFiles != NULL && isMemoryFileName(nextArg))
+                {
+                    useMemoryInput(myComponent->m_paramList[i], nextArg);
+                    if (debug)
+                    {
+                        cout << "Parameter <" << myComponent->m_paramList[i]->m_shortName << "> using in-memory file ";
+                        cout << nextArg << endl;
+                    }
+                    continue;
+                }
+                break;
+            case OperationParametersEnum::STRING:
+                if (m_planOnly)
+                {
+                    if (isMemoryFileName(nextArg))
+                    {
+                        throw ProgramParametersException("Parameter <" + myComponent->m_paramList[i]->m_shortName + "> does not take a file, so it can't use in-memory file \"" + nextArg + "\"");
+                    }
+                }
+                break;
+            default:
+                break;
+        }
+        switch (myComponent->m_paramList[i]->getType())
         {
             case OperationParametersEnum::BOOL:
             {
@@ -171,8 +265,8 @@ void CommandParser::parseComponent(ParameterComponent* myComponent, ProgramParam
             {
                 FileInformation myInfo(nextArg);
                 CaretPointer<CiftiFile> myFile(new CiftiFile());
-                myFile->openFile(nextArg, ON_DISK);
-                m_inputCiftiNames.insert(myInfo.getCanonicalFilePath());//track only names of input cifti, because inputs are always on-disk
+                myFile->openFile(nextArg, MEMORY_MAPPED);//falls back to ON_DISK if mapping isn't possible
+                m_inputCiftiNames.insert(myInfo.getCanonicalFilePath());//track only names of input cifti, because inputs are always on-disk or mapped
                 if (m_doProvenance)//just an optimization, if we aren't going to write provenance, don't generate it, either
                 {
                     const GiftiMetaData* md = myFile->getCiftiXML().getFileMetaData();
@@ -302,8 +396,14 @@ void CommandParser::parseComponent(ParameterComponent* myComponent, ProgramParam
             }
             case OperationParametersEnum::SURFACE:
             {
-                CaretPointer<SurfaceFile> myFile(new SurfaceFile());
-                myFile->readFile(nextArg);
+                CaretPointer<SurfaceFile> myFile;
+                if (s_surfaceCache != NULL)
+                {
+                    myFile = s_surfaceCache->getSurface(nextArg);
+                } else {
+                    myFile.grabNew(new SurfaceFile());
+                    myFile->readFile(nextArg);
+                }
                 if (m_doProvenance)
                 {
                     const GiftiMetaData* md = myFile->getFileMetaData();
@@ -493,6 +593,105 @@ void CommandParser::parseRemainingOptions(ParameterComponent* myComponent, Progr
     }
 }
 
+void CommandParser::useMemoryInput(AbstractParameter* myParam, const AString& name)
+{
+    CaretAssert(m_memoryFiles != NULL);
+    MemoryFile myFile;
+    {
+        CaretMutexLocker locked(&(m_memoryFiles->m_mutex));
+        map<AString, MemoryFile>::iterator iter = m_memoryFiles->m_files.find(name);
+        if (iter == m_memoryFiles->m_files.end())
+        {
+            throw ProgramParametersException("in-memory file \"" + name + "\" was not created by an earlier step");
+        }
+        myFile = iter->second;//copy the pointers, so the file stays valid even if the pipeline releases it from the store
+    }
+    if (myFile.m_type != myParam->getType())
+    {
+        throw ProgramParametersException("in-memory file \"" + name + "\" is of type " + OperationParametersEnum::toName(myFile.m_type) +
+                                         ", but parameter <" + myParam->m_shortName + "> requires type " + OperationParametersEnum::toName(myParam->getType()));
+    }
+    const GiftiMetaData* md = NULL;
+    switch (myFile.m_type)
+    {
+        case OperationParametersEnum::BORDER:
+            ((BorderParameter*)myParam)->m_parameter = myFile.m_border;
+            md = myFile.m_border->getFileMetaData();
+            break;
+        case OperationParametersEnum::CIFTI:
+            ((CiftiParameter*)myParam)->m_parameter = myFile.m_cifti;
+            md = myFile.m_cifti->getCiftiXML().getFileMetaData();
+            break;
+        case OperationParametersEnum::FOCI:
+            ((FociParameter*)myParam)->m_parameter = myFile.m_foci;
+            md = myFile.m_foci->getFileMetaData();
+            break;
+        case OperationParametersEnum::LABEL:
+            ((LabelParameter*)myParam)->m_parameter = myFile.m_label;
+            md = myFile.m_label->getFileMetaData();
+            break;
+        case OperationParametersEnum::METRIC:
+            ((MetricParameter*)myParam)->m_parameter = myFile.m_metric;
+            md = myFile.m_metric->getFileMetaData();
+            break;
+        case OperationParametersEnum::SURFACE:
+            ((SurfaceParameter*)myParam)->m_parameter = myFile.m_surface;
+            md = myFile.m_surface->getFileMetaData();
+            break;
+        case OperationParametersEnum::VOLUME:
+            ((VolumeParameter*)myParam)->m_parameter = myFile.m_volume;
+            md = myFile.m_volume->getFileMetaData();
+            break;
+        default:
+            CaretAssertMessage(false, "in-memory file of unsupported type");
+            throw CommandException("Internal parsing error, please let the developers know what you just tried to do");
+    }
+    if (m_doProvenance && md != NULL)
+    {
+        AString prov = md->get(PROVENANCE_NAME);
+        if (prov != "")
+        {
+            m_parentProvenance += name + ":\n" + prov + "\n\n";
+        }
+    }
+}
+
+void CommandParser::keepMemoryOutput(const OutputAssoc& output)
+{
+    CaretAssert(m_memoryFiles != NULL);
+    AbstractParameter* myParam = output.m_param;
+    MemoryFile myFile;
+    myFile.m_type = myParam->getType();
+    switch (myFile.m_type)
+    {
+        case OperationParametersEnum::BORDER:
+            myFile.m_border = ((BorderParameter*)myParam)->m_parameter;
+            break;
+        case OperationParametersEnum::CIFTI:
+            myFile.m_cifti = ((CiftiParameter*)myParam)->m_parameter;
+            break;
+        case OperationParametersEnum::FOCI:
+            myFile.m_foci = ((FociParameter*)myParam)->m_parameter;
+            break;
+        case OperationParametersEnum::LABEL:
+            myFile.m_label = ((LabelParameter*)myParam)->m_parameter;
+            break;
+        case OperationParametersEnum::METRIC:
+            myFile.m_metric = ((MetricParameter*)myParam)->m_parameter;
+            break;
+        case OperationParametersEnum::SURFACE:
+            myFile.m_surface = ((SurfaceParameter*)myParam)->m_parameter;
+            break;
+        case OperationParametersEnum::VOLUME:
+            myFile.m_volume = ((VolumeParameter*)myParam)->m_parameter;
+            break;
+        default:
+            throw CommandException("output <" + myParam->m_shortName + "> is not a file, so it can't be kept in memory as \"" + output.m_fileName + "\"");
+    }
+    CaretMutexLocker locked(&(m_memoryFiles->m_mutex));
+    m_memoryFiles->m_files[output.m_fileName] = myFile;
+}
+
 void CommandParser::provenanceBeforeOperation(const vector<OutputAssoc>& outAssociation)
 {
     vector<AString> versionInfo;//need this for on-disk outputs, because we have to set it before the command executes
@@ -655,6 +854,11 @@ void CommandParser::makeOnDiskOutputs(const vector<OutputAssoc>& outAssociation)
             case OperationParametersEnum::CIFTI:
             {
                 CiftiParameter* myCiftiParam = (CiftiParameter*)myParam;
+                if (m_memoryFiles != NULL && isMemoryFileName(outAssociation[i].m_fileName))
+                {//pipeline intermediate, never goes to disk
+                    myCiftiParam->m_parameter.grabNew(new CiftiFile(IN_MEMORY));
+                    break;
+                }
                 FileInformation myInfo(outAssociation[i].m_fileName);
                 set<AString>::iterator iter = m_inputCiftiNames.find(myInfo.getCanonicalFilePath());
                 if (iter != m_inputCiftiNames.end())
@@ -678,6 +882,11 @@ void CommandParser::writeOutput(const vector<OutputAssoc>& outAssociation)
     for (uint32_t i = 0; i < outAssociation.size(); ++i)
     {
         AbstractParameter* myParam = outAssociation[i].m_param;
+        if (m_memoryFiles != NULL && isMemoryFileName(outAssociation[i].m_fileName))
+        {
+            keepMemoryOutput(outAssociation[i]);
+            continue;
+        }
         switch (myParam->getType())
         {
             case OperationParametersEnum::BOOL://ignores the name you give the output for now, but what gives primitive type output and how is it used?
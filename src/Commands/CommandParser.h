@@ -27,18 +27,44 @@
 #include "ProgramParameters.h"
 #include "CommandException.h"
 #include "ProgramParametersException.h"
+#include "CaretMutex.h"
+#include <map>
 #include <vector>
 #include <set>
 
 namespace caret {
 
+    class CommandSurfaceCache;
+    
     class CommandParser : public CommandOperation, OperationParserInterface
     {
+    public:
+        struct MemoryFile
+        {//a file kept in memory between steps of a pipeline, only the pointer matching m_type is set
+            OperationParametersEnum::Enum m_type;
+            CaretPointer<BorderFile> m_border;
+            CaretPointer<CiftiFile> m_cifti;
+            CaretPointer<FociFile> m_foci;
+            CaretPointer<LabelFile> m_label;
+            CaretPointer<MetricFile> m_metric;
+            CaretPointer<SurfaceFile> m_surface;
+            CaretPointer<VolumeFile> m_volume;
+        };
+        struct MemoryFileStore
+        {//shared by steps that may run concurrently, so lock m_mutex for any access to m_files
+            CaretMutex m_mutex;
+            std::map<AString, MemoryFile> m_files;
+        };
+    private:
         int m_minIndent, m_maxIndent, m_indentIncrement, m_maxWidth;
         AString m_provenance, m_parentProvenance, m_workingDir;
         bool m_doProvenance;
         const static AString PROVENANCE_NAME, PARENT_PROVENANCE_NAME, PROGRAM_PROVENANCE_NAME, CWD_PROVENANCE_NAME;//TODO: put this elsewhere?
         std::set<AString> m_inputCiftiNames;
+        static CommandSurfaceCache* s_surfaceCache;//shared by all commands, NULL unless set by -daemon
+        MemoryFileStore* m_memoryFiles;//NULL unless running as a pipeline step
+        bool m_planOnly;//parse without opening any inputs, to collect file names for pipeline scheduling
+        std::vector<AString> m_plannedInputs;
         struct OutputAssoc
         {//how the output is stored is up to the parser, in the GUI it should load into memory without writing to disk
             AString m_fileName;
@@ -47,6 +73,9 @@ namespace caret {
         void parseComponent(ParameterComponent* myComponent, ProgramParameters& parameters, std::vector<OutputAssoc>& outAssociation, bool debug = false);
         bool parseOption(const AString& mySwitch, ParameterComponent* myComponent, ProgramParameters& parameters, std::vector<OutputAssoc>& outAssociation, bool debug);
         void parseRemainingOptions(ParameterComponent* myAlgParams, ProgramParameters& parameters, std::vector<OutputAssoc>& outAssociation, bool debug);
+        void useMemoryInput(AbstractParameter* myParam, const AString& name);
+        void keepMemoryOutput(const OutputAssoc& output);
+        void runOperation(ProgramParameters& parameters, const AString& provenance);
         void provenanceBeforeOperation(const std::vector<OutputAssoc>& outAssociation);
         void provenanceAfterOperation(const std::vector<OutputAssoc>& outAssociation);
         void makeOnDiskOutputs(const std::vector<OutputAssoc>& outAssociation);//ensures on-disk inputs aren't used as on-disk outputs, converting outputs to in-memory when needed
@@ -61,8 +90,18 @@ namespace caret {
     public:
         CommandParser(AutoOperationInterface* myAutoOper);
         void disableProvenance();
+        void enableProvenance();
         void executeOperation(ProgramParameters& parameters) throw (CommandException, ProgramParametersException);
         void showParsedOperation(ProgramParameters& parameters) throw (CommandException, ProgramParametersException);
+        ///parse without opening inputs, returning the names of the file inputs and outputs - string parameters are not included, even when they name files
+        void getPipelineFileNames(ProgramParameters& parameters, std::vector<AString>& inputsOut, std::vector<AString>& outputsOut) throw (CommandException, ProgramParametersException);
+        ///run as a step of a pipeline, file names starting with '@' are read from and stored into memoryFiles instead of disk
+        void executePipelineStep(ProgramParameters& parameters, const AString& stepProvenance, MemoryFileStore* memoryFiles) throw (CommandException, ProgramParametersException);
+        static bool isMemoryFileName(const AString& name);
+        ///read input surfaces through a cache (which must outlive its use), or pass NULL to read them normally
+        static void setSurfaceCache(CommandSurfaceCache* surfaceCache);
+        ///canonical paths of the cifti inputs of the most recent run, which are never opened in place as outputs
+        const std::set<AString>& getInputCiftiNames() const { return m_inputCiftiNames; }
         AString getHelpInformation(const AString& programName);
         bool takesParameters();
     };
@@ -0,0 +1,492 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+
+#include "CommandPipeline.h"
+
+#include "BorderFile.h"
+#include "CaretAssert.h"
+#include "CaretLogger.h"
+#include "CaretOMP.h"
+#include "CiftiFile.h"
+#include "CommandOperationManager.h"
+#include "CommandParser.h"
+#include "FociFile.h"
+#include "LabelFile.h"
+#include "MetricFile.h"
+#include "ProgramParameters.h"
+#include "SurfaceFile.h"
+#include "VolumeFile.h"
+
+#include <QDir>
+#include <QFile>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <algorithm>
+#include <set>
+
+using namespace caret;
+using namespace std;
+
+struct CommandPipeline::RunState
+{
+    RunState(const vector<PipelineStep>& steps)
+    : m_steps(steps), m_stepDone(steps.size(), false), m_stepRunning(steps.size(), false)
+    {
+        m_numDone = 0;
+        m_numRunning = 0;
+        m_failedStep = -1;
+    }
+    const vector<PipelineStep>& m_steps;
+    vector<bool> m_stepDone, m_stepRunning;
+    set<CommandParser*> m_busyParsers;
+    int m_numDone, m_numRunning, m_failedStep;
+    AString m_error;
+    map<AString, int> m_memoryUses;//number of steps still to run that use each in-memory file
+    CommandParser::MemoryFileStore m_memoryFiles;//needs the complete file types included above, for releasing them
+    QMutex m_mutex;
+    QWaitCondition m_stepFinished;
+};
+
+/**
+ * Constructor.
+ */
+CommandPipeline::CommandPipeline()
+: CommandOperation("-pipeline",
+                   "RUN A SCRIPT OF COMMANDS, KEEPING INTERMEDIATE FILES IN MEMORY")
+{
+    m_doProvenance = true;
+}
+
+/**
+ * Destructor.
+ */
+CommandPipeline::~CommandPipeline()
+{
+    
+}
+
+void CommandPipeline::disableProvenance()
+{
+    m_doProvenance = false;
+}
+
+void CommandPipeline::enableProvenance()
+{
+    m_doProvenance = true;
+}
+
+/**
+ * @return The help information.
+ */
+AString
+CommandPipeline::getHelpInformation(const AString& programName)
+{
+    //guide for wrap, assuming 80 columns:                                                  |
+    AString helpInfo = ("RUN A SCRIPT OF COMMANDS, KEEPING INTERMEDIATE FILES IN MEMORY\n"
+                        "   " + programName + " -pipeline\n"
+                        "      <script> - text file of commands to run\n"
+                        "\n"
+                        "      [-parallel] - run steps that don't depend on each other at the same time\n"
+                        "         <steps> - the most steps to run at once\n"
+                        "\n"
+                        "   Each line of the script is one processing command, written as it would\n"
+                        "   be on the command line after '" + programName + "', for example:\n"
+                        "\n"
+                        "   -metric-smoothing left.surf.gii data.func.gii 2 @smooth\n"
+                        "   -metric-math 'x * 2' doubled.func.gii -var x @smooth\n"
+                        "\n"
+                        "   A file name starting with '@' is kept in memory instead of being written\n"
+                        "   to disk, and later steps can use it as an input by the same name.  Each\n"
+                        "   '@' name must be created exactly once, before any step that uses it, and\n"
+                        "   is released once the last step using it has finished.  All other\n"
+                        "   outputs are written to disk as usual.\n"
+                        "\n"
+                        "   Empty lines and lines starting with '#' are ignored, a line ending with\n"
+                        "   '\\' continues on the next line, and arguments containing spaces can be\n"
+                        "   quoted with single or double quotes.  Only processing commands (those\n"
+                        "   shown by -list-commands) can be used.\n"
+                        "\n"
+                        "   Every step is checked for correct arguments before any step runs.  By\n"
+                        "   default, steps run one at a time in script order, each using all\n"
+                        "   available threads, as it would when run by itself.  With -parallel, a\n"
+                        "   step starts as soon as the steps it depends on have finished, and each\n"
+                        "   running step gets an equal share of the threads.  Only file arguments\n"
+                        "   are used to find dependencies, so a step that reads a file given as a\n"
+                        "   plain string argument (such as a text file of names) may start before\n"
+                        "   the step that writes it, unless -parallel is left off.  When a step\n"
+                        "   fails, no more steps are started, and the error from the earliest\n"
+                        "   failed line is reported after the running steps finish.\n");
+    return helpInfo;
+}
+
+/**
+ * Execute the operation.
+ * 
+ * @param parameters
+ *   Parameters for the operation.
+ * @throws CommandException
+ *   If the command failed.
+ * @throws ProgramParametersException
+ *   If there is an error in the parameters.
+ */
+void
+CommandPipeline::executeOperation(ProgramParameters& parameters) throw (CommandException,
+                                                                    ProgramParametersException)
+{
+    const AString scriptName = parameters.nextString("Pipeline Script");
+    int parallelSteps = 1;
+    while (parameters.hasNext())
+    {
+        AString option = parameters.nextString("option");
+        if (option == "-parallel")
+        {
+            parallelSteps = (int)parameters.nextInt("Steps");
+            if (parallelSteps < 1)
+            {
+                throw ProgramParametersException("-parallel must allow at least one step at a time");
+            }
+        } else {
+            throw ProgramParametersException("unknown option: " + option);
+        }
+    }
+    vector<PipelineStep> steps;
+    readScript(scriptName, steps);
+    RunState myState(steps);
+    planSteps(steps, myState.m_memoryUses);
+    for (int i = 0; i < (int)steps.size(); ++i)
+    {
+        if (m_doProvenance)
+        {
+            steps[i].m_parser->enableProvenance();
+        } else {
+            steps[i].m_parser->disableProvenance();
+        }
+    }
+    const AString programName = parameters.getProgramName();
+    const int numRunners = min(parallelSteps, (int)steps.size());
+    if (numRunners == 1)
+    {
+        runSteps(myState, programName);
+    } else {
+#ifdef CARET_OMP
+        const int oldNested = omp_get_nested(), oldLevels = omp_get_max_active_levels();
+        const int stepThreads = max(1, omp_get_max_threads() / numRunners);
+        omp_set_nested(1);//so each step's own parallel loops get its share of the threads, rather than one thread
+        omp_set_max_active_levels(2);
+#pragma omp CARET_PAR num_threads(numRunners)
+        {
+            omp_set_num_threads(stepThreads);//only affects parallel regions started by this thread
+            runSteps(myState, programName);
+        }
+        omp_set_nested(oldNested);
+        omp_set_max_active_levels(oldLevels);
+#else
+        runSteps(myState, programName);
+#endif
+    }
+    if (myState.m_failedStep >= 0)
+    {
+        throw CommandException("pipeline line " + AString::number(steps[myState.m_failedStep].m_lineNumber) + " failed: " + myState.m_error);
+    }
+}
+
+void CommandPipeline::runSteps(RunState& state, const AString& programName)
+{//called by every thread running steps, nothing may be thrown out of it
+    while (true)
+    {
+        int stepIndex = claimStep(state);
+        if (stepIndex < 0) return;
+        const PipelineStep& myStep = state.m_steps[stepIndex];
+        AString error;
+        try
+        {
+            ProgramParameters stepParameters;
+            makeStepParameters(myStep, stepParameters);
+            AString stepCommand = programName;//provenance of this step is what it would have been as a separate command
+            for (int i = 0; i < (int)myStep.m_arguments.size(); ++i)
+            {
+                stepCommand += " " + myStep.m_arguments[i];
+            }
+            CaretLogFine("Running pipeline line " + AString::number(myStep.m_lineNumber) + ": " + stepCommand);
+            myStep.m_parser->executePipelineStep(stepParameters, stepCommand, &(state.m_memoryFiles));
+        } catch (CaretException& e) {
+            error = e.whatString();
+        } catch (exception& e) {
+            error = e.what();
+        } catch (...) {
+            error = "unknown exception type thrown";
+        }
+        finishStep(state, stepIndex, error);
+    }
+}
+
+int CommandPipeline::claimStep(RunState& state)
+{
+    QMutexLocker locked(&state.m_mutex);
+    const int numSteps = (int)state.m_steps.size();
+    while (true)
+    {
+        if (state.m_failedStep >= 0 || state.m_numDone == numSteps) return -1;
+        for (int i = 0; i < numSteps; ++i)
+        {//the lowest ready step, so running one step at a time follows the script order
+            if (state.m_stepDone[i] || state.m_stepRunning[i]) continue;
+            const PipelineStep& myStep = state.m_steps[i];
+            if (state.m_busyParsers.find(myStep.m_parser) != state.m_busyParsers.end()) continue;//a parser holds state while executing, so one command can't run twice at the same time
+            bool ready = true;
+            for (int j = 0; j < (int)myStep.m_dependsOn.size(); ++j)
+            {
+                if (!state.m_stepDone[myStep.m_dependsOn[j]])
+                {
+                    ready = false;
+                    break;
+                }
+            }
+            if (ready)
+            {
+                state.m_stepRunning[i] = true;
+                state.m_busyParsers.insert(myStep.m_parser);
+                ++state.m_numRunning;
+                return i;
+            }
+        }
+        CaretAssert(state.m_numRunning > 0);//dependencies only point to earlier steps, so the first unfinished step is ready unless something is running
+        if (state.m_numRunning == 0) return -1;
+        state.m_stepFinished.wait(&state.m_mutex);
+    }
+}
+
+void CommandPipeline::finishStep(RunState& state, const int& stepIndex, const AString& error)
+{
+    QMutexLocker locked(&state.m_mutex);
+    const PipelineStep& myStep = state.m_steps[stepIndex];
+    state.m_stepRunning[stepIndex] = false;
+    state.m_busyParsers.erase(myStep.m_parser);
+    --state.m_numRunning;
+    if (error != "")
+    {
+        if (state.m_failedStep < 0 || stepIndex < state.m_failedStep)
+        {//with steps running at the same time, report the same failure a serial run would
+            state.m_failedStep = stepIndex;
+            state.m_error = error;
+        }
+    } else {
+        state.m_stepDone[stepIndex] = true;
+        ++state.m_numDone;
+        for (int i = 0; i < (int)myStep.m_inputs.size(); ++i)
+        {
+            if (CommandParser::isMemoryFileName(myStep.m_inputs[i]))
+            {
+                --(state.m_memoryUses[myStep.m_inputs[i]]);
+            }
+        }
+        vector<AString> memoryNames = myStep.m_inputs;
+        memoryNames.insert(memoryNames.end(), myStep.m_outputs.begin(), myStep.m_outputs.end());
+        CaretMutexLocker memoryLocked(&(state.m_memoryFiles.m_mutex));
+        for (int i = 0; i < (int)memoryNames.size(); ++i)
+        {//release in-memory files that no remaining step uses, including outputs that nothing uses
+            if (CommandParser::isMemoryFileName(memoryNames[i]) && state.m_memoryUses[memoryNames[i]] == 0)
+            {
+                state.m_memoryFiles.m_files.erase(memoryNames[i]);
+            }
+        }
+    }
+    state.m_stepFinished.wakeAll();
+}
+
+void CommandPipeline::readScript(const AString& scriptName, vector<PipelineStep>& stepsOut)
+{
+    stepsOut.clear();
+    QFile scriptFile(scriptName);
+    if (!scriptFile.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        throw CommandException("failed to open pipeline script '" + scriptName + "'");
+    }
+    vector<CommandOperation*> allCommands = CommandOperationManager::getCommandOperationManager()->getCommandOperations();
+    int lineNumber = 0;
+    while (!scriptFile.atEnd())
+    {
+        ++lineNumber;
+        const int startLine = lineNumber;
+        AString line = AString(scriptFile.readLine()).trimmed();
+        while (line.endsWith('\\') && !scriptFile.atEnd())
+        {//continuation lines
+            ++lineNumber;
+            line = line.left(line.size() - 1) + " " + AString(scriptFile.readLine()).trimmed();
+        }
+        if (line.isEmpty() || line[0] == '#') continue;
+        PipelineStep myStep;
+        myStep.m_lineNumber = startLine;
+        myStep.m_parser = NULL;
+        splitLine(line, startLine, myStep.m_arguments);
+        CaretAssert(!myStep.m_arguments.empty());
+        for (int i = 0; i < (int)allCommands.size(); ++i)
+        {
+            if (allCommands[i]->getCommandLineSwitch() == myStep.m_arguments[0])
+            {
+                myStep.m_parser = dynamic_cast<CommandParser*>(allCommands[i]);//only processing commands use the parser
+                break;
+            }
+        }
+        if (myStep.m_parser == NULL)
+        {
+            throw CommandException("pipeline line " + AString::number(startLine) + ": '" + myStep.m_arguments[0] + "' is not a processing command");
+        }
+        stepsOut.push_back(myStep);
+    }
+    if (stepsOut.empty())
+    {
+        throw CommandException("pipeline script '" + scriptName + "' contains no commands");
+    }
+}
+
+void CommandPipeline::planSteps(vector<PipelineStep>& steps, map<AString, int>& memoryUsesOut)
+{
+    memoryUsesOut.clear();
+    map<AString, int> memoryCreator;//step that creates each in-memory file
+    map<AString, int> lastWriter;//on-disk names, so that steps sharing a file keep their script order
+    map<AString, vector<int> > readersSinceWrite;
+    for (int i = 0; i < (int)steps.size(); ++i)
+    {
+        PipelineStep& myStep = steps[i];
+        try
+        {//parse every step before running anything, so mistakes late in the script don't waste the earlier processing
+            ProgramParameters stepParameters;
+            makeStepParameters(myStep, stepParameters);
+            myStep.m_parser->getPipelineFileNames(stepParameters, myStep.m_inputs, myStep.m_outputs);
+        } catch (CaretException& e) {
+            throw CommandException("pipeline line " + AString::number(myStep.m_lineNumber) + ": " + e.whatString());
+        }
+        set<int> depends;
+        for (int j = 0; j < (int)myStep.m_inputs.size(); ++j)
+        {
+            const AString& name = myStep.m_inputs[j];
+            if (CommandParser::isMemoryFileName(name))
+            {
+                map<AString, int>::iterator iter = memoryCreator.find(name);
+                if (iter == memoryCreator.end())
+                {
+                    throw CommandException("pipeline line " + AString::number(myStep.m_lineNumber) + ": in-memory file '" + name + "' is used before any step creates it");
+                }
+                depends.insert(iter->second);
+                ++(memoryUsesOut[name]);
+            } else {
+                AString key = getFileKey(name);
+                map<AString, int>::iterator iter = lastWriter.find(key);
+                if (iter != lastWriter.end() && iter->second != i)
+                {
+                    depends.insert(iter->second);
+                }
+                readersSinceWrite[key].push_back(i);
+            }
+        }
+        for (int j = 0; j < (int)myStep.m_outputs.size(); ++j)
+        {
+            const AString& name = myStep.m_outputs[j];
+            if (CommandParser::isMemoryFileName(name))
+            {
+                if (memoryCreator.find(name) != memoryCreator.end())
+                {
+                    throw CommandException("pipeline line " + AString::number(myStep.m_lineNumber) + ": in-memory file '" + name + "' is created more than once");
+                }
+                memoryCreator[name] = i;
+                memoryUsesOut[name] = 0;
+            } else {
+                AString key = getFileKey(name);
+                map<AString, int>::iterator iter = lastWriter.find(key);
+                if (iter != lastWriter.end() && iter->second != i)
+                {
+                    depends.insert(iter->second);
+                }
+                vector<int>& readers = readersSinceWrite[key];
+                for (int k = 0; k < (int)readers.size(); ++k)
+                {//don't overwrite a file before earlier steps are done reading it
+                    if (readers[k] != i) depends.insert(readers[k]);
+                }
+                readers.clear();
+                lastWriter[key] = i;
+            }
+        }
+        myStep.m_dependsOn = vector<int>(depends.begin(), depends.end());
+    }
+    for (map<AString, int>::iterator iter = memoryUsesOut.begin(); iter != memoryUsesOut.end(); ++iter)
+    {
+        if (iter->second == 0)
+        {
+            CaretLogWarning("in-memory file '" + iter->first + "' is not used by any step, it will be discarded");
+        }
+    }
+}
+
+void CommandPipeline::splitLine(const AString& line, const int& lineNumber, vector<AString>& argumentsOut)
+{
+    argumentsOut.clear();
+    AString current;
+    bool inArgument = false;
+    QChar quote;//null when not inside quotes
+    for (int i = 0; i < line.size(); ++i)
+    {
+        QChar c = line[i];
+        if (!quote.isNull())
+        {
+            if (c == quote)
+            {
+                quote = QChar();
+            } else {
+                current += c;
+            }
+        } else if (c == '"' || c == '\'') {
+            quote = c;
+            inArgument = true;//allows an empty quoted argument
+        } else if (c.isSpace()) {
+            if (inArgument)
+            {
+                argumentsOut.push_back(current);
+                current = "";
+                inArgument = false;
+            }
+        } else {
+            current += c;
+            inArgument = true;
+        }
+    }
+    if (!quote.isNull())
+    {
+        throw CommandException("pipeline line " + AString::number(lineNumber) + ": unterminated quote");
+    }
+    if (inArgument)
+    {
+        argumentsOut.push_back(current);
+    }
+}
+
+void CommandPipeline::makeStepParameters(const PipelineStep& step, ProgramParameters& parametersOut)
+{
+    for (int i = 1; i < (int)step.m_arguments.size(); ++i)
+    {//first argument is the command switch, which the parser doesn't expect
+        parametersOut.addParameter(step.m_arguments[i]);
+    }
+}
+
+AString CommandPipeline::getFileKey(const AString& name)
+{
+    return QDir::cleanPath(QDir::current().absoluteFilePath(name));
+}
@@ -0,0 +1,91 @@
+#ifndef __COMMAND_PIPELINE_H__
+#define __COMMAND_PIPELINE_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+
+#include "CommandOperation.h"
+
+#include <map>
+#include <vector>
+
+namespace caret {
+
+    class CommandParser;
+    
+    /// Command that runs a script of processing commands in one process, keeping intermediate files in memory
+    class CommandPipeline : public CommandOperation {
+        
+    public:
+        CommandPipeline();
+        
+        virtual ~CommandPipeline();
+        
+        virtual void executeOperation(ProgramParameters& parameters)
+            throw (CommandException,
+                   ProgramParametersException);
+        
+        AString getHelpInformation(const AString& programName);
+        
+    protected:
+        virtual void disableProvenance();
+        
+        virtual void enableProvenance();
+        
+    private:
+        
+        CommandPipeline(const CommandPipeline&);
+        
+        CommandPipeline& operator=(const CommandPipeline&);
+        
+        struct PipelineStep
+        {
+            int m_lineNumber;
+            std::vector<AString> m_arguments;//starts with the command switch
+            CommandParser* m_parser;
+            std::vector<AString> m_inputs, m_outputs;
+            std::vector<int> m_dependsOn;//indices of earlier steps that must finish first
+        };
+        
+        struct RunState;//scheduling shared by the threads running steps
+        
+        void readScript(const AString& scriptName, std::vector<PipelineStep>& stepsOut);
+        
+        void planSteps(std::vector<PipelineStep>& steps, std::map<AString, int>& memoryUsesOut);
+        
+        static void splitLine(const AString& line, const int& lineNumber, std::vector<AString>& argumentsOut);
+        
+        static void makeStepParameters(const PipelineStep& step, ProgramParameters& parametersOut);
+        
+        static AString getFileKey(const AString& name);
+        
+        static void runSteps(RunState& state, const AString& programName);
+        
+        static int claimStep(RunState& state);//returns -1 when no more steps should start
+        
+        static void finishStep(RunState& state, const int& stepIndex, const AString& error);
+        
+        bool m_doProvenance;
+    };
+    
+} // namespace
+
+#endif // __COMMAND_PIPELINE_H__
@@ -0,0 +1,153 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+
+#include "CommandSurfaceCache.h"
+
+#include "CaretAssert.h"
+#include "CaretLogger.h"
+#include "FileInformation.h"
+#include "SurfaceFile.h"
+
+#include <QCryptographicHash>
+#include <QFile>
+
+using namespace caret;
+using namespace std;
+
+CommandSurfaceCache::CommandSurfaceCache(const int& maxSurfaces)
+{
+    CaretAssert(maxSurfaces > 0);
+    m_maxSurfaces = maxSurfaces;
+    m_useCounter = 0;
+    m_hits = 0;
+    m_misses = 0;
+}
+
+CaretPointer<SurfaceFile> CommandSurfaceCache::getSurface(const AString& fileName) throw (DataFileException)
+{
+    FileInformation myInfo(fileName);
+    if (myInfo.isRemoteFile())
+    {//can't hash without downloading it, so just read it
+        CaretPointer<SurfaceFile> ret(new SurfaceFile());
+        ret->readFile(fileName);
+        return ret;
+    }
+    QFile myFile(fileName);
+    if (!myFile.open(QIODevice::ReadOnly))
+    {
+        throw DataFileException("failed to open surface file '" + fileName + "'");
+    }
+    QCryptographicHash myHash(QCryptographicHash::Sha1);//key on contents, so a rewritten file with the same name is never stale
+    while (!myFile.atEnd())
+    {
+        QByteArray block = myFile.read(HASH_BLOCK_BYTES);
+        if (block.isEmpty())
+        {
+            throw DataFileException("error reading surface file '" + fileName + "'");
+        }
+        myHash.addData(block);
+    }
+    myFile.close();
+    QByteArray myKey = myHash.result();
+    CaretPointer<SurfaceFile> cached;
+    {
+        CaretMutexLocker locked(&m_mutex);
+        for (int i = 0; i < (int)m_entries.size(); ++i)
+        {
+            if (m_entries[i].m_hash == myKey)
+            {
+                m_entries[i].m_lastUsed = ++m_useCounter;
+                ++m_hits;
+                CaretLogFine("using cached surface for '" + fileName + "'");
+                cached = m_entries[i].m_surface;
+                break;
+            }
+        }
+    }
+    if (cached == NULL)
+    {
+        CaretPointer<SurfaceFile> newSurface(new SurfaceFile());
+        newSurface->readFile(fileName);//parse without the lock, so other surfaces can be found meanwhile
+        CaretMutexLocker locked(&m_mutex);
+        ++m_misses;
+        for (int i = 0; i < (int)m_entries.size(); ++i)
+        {
+            if (m_entries[i].m_hash == myKey)
+            {//another thread read the same file while we were parsing, use the one that may already have helpers
+                m_entries[i].m_lastUsed = ++m_useCounter;
+                cached = m_entries[i].m_surface;
+                break;
+            }
+        }
+        if (cached == NULL)
+        {
+            CacheEntry newEntry;
+            newEntry.m_hash = myKey;
+            newEntry.m_surface = newSurface;
+            newEntry.m_lastUsed = ++m_useCounter;
+            m_entries.push_back(newEntry);
+            cached = newSurface;
+            if ((int)m_entries.size() > m_maxSurfaces)
+            {
+                int oldest = 0;
+                for (int i = 1; i < (int)m_entries.size(); ++i)
+                {
+                    if (m_entries[i].m_lastUsed < m_entries[oldest].m_lastUsed)
+                    {
+                        oldest = i;
+                    }
+                }
+                m_entries.erase(m_entries.begin() + oldest);
+            }
+        }
+    }
+    //the cached surface itself is never handed out, so a command that modifies its input can't affect later requests
+    CaretPointer<SurfaceFile> ret(new SurfaceFile(*cached));
+    ret->setFileName(fileName);//the copy has the name of the file this request asked for, not of whichever file was read first
+    ret->clearModified();
+    ret->shareHelpers(*cached);
+    HandedOut myHandout;
+    myHandout.m_hash = myKey;
+    myHandout.m_surface = ret;
+    myHandout.m_geometryVersion = ret->getGeometryVersion();
+    CaretMutexLocker locked(&m_mutex);
+    m_handedOut.push_back(myHandout);
+    return ret;
+}
+
+void CommandSurfaceCache::keepHelpers()
+{
+    CaretMutexLocker locked(&m_mutex);
+    for (int i = 0; i < (int)m_handedOut.size(); ++i)
+    {
+        const HandedOut& myHandout = m_handedOut[i];
+        if (myHandout.m_surface->getGeometryVersion() != myHandout.m_geometryVersion) continue;//coordinates or topology were changed, so its helpers don't match the file
+        for (int j = 0; j < (int)m_entries.size(); ++j)
+        {
+            if (m_entries[j].m_hash == myHandout.m_hash)
+            {
+                m_entries[j].m_surface->shareHelpers(*(myHandout.m_surface));
+                break;
+            }
+        }
+    }
+    m_handedOut.clear();
+}
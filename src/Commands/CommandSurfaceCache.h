@@ -0,0 +1,84 @@
+#ifndef __COMMAND_SURFACE_CACHE_H__
+#define __COMMAND_SURFACE_CACHE_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "AString.h"
+#include "CaretMutex.h"
+#include "CaretPointer.h"
+#include "DataFileException.h"
+
+#include <QByteArray>
+
+#include <vector>
+
+namespace caret {
+
+    class SurfaceFile;
+    
+    /// Keeps recently used input surfaces, along with the helpers they build, for commands run repeatedly in one process
+    class CommandSurfaceCache
+    {
+        struct CacheEntry
+        {
+            QByteArray m_hash;
+            CaretPointer<SurfaceFile> m_surface;
+            int64_t m_lastUsed;
+        };
+        struct HandedOut
+        {//copies given to commands, so helpers they build can be kept after the command finishes
+            QByteArray m_hash;
+            CaretPointer<SurfaceFile> m_surface;
+            int64_t m_geometryVersion;
+        };
+        std::vector<CacheEntry> m_entries;
+        std::vector<HandedOut> m_handedOut;
+        int m_maxSurfaces;
+        int64_t m_useCounter;
+        int64_t m_hits, m_misses;
+        CaretMutex m_mutex;
+        
+        enum
+        {
+            HASH_BLOCK_BYTES = 1<<20
+        };
+        
+        CommandSurfaceCache(const CommandSurfaceCache&);
+        CommandSurfaceCache& operator=(const CommandSurfaceCache&);
+    public:
+        ///maxSurfaces is the number of distinct surface files to keep, least recently used are dropped first
+        CommandSurfaceCache(const int& maxSurfaces);
+        
+        ///returns a new copy of the surface, named fileName, made from a previously read surface with identical file contents when possible
+        ///the copy shares any helpers already built for those contents, and can be modified without affecting the cache
+        CaretPointer<SurfaceFile> getSurface(const AString& fileName) throw (DataFileException);
+        
+        ///call after the commands using the returned surfaces are done, keeps helpers they built on unmodified surfaces for later requests
+        void keepHelpers();
+        
+        int64_t getNumberOfHits() const { return m_hits; }
+        
+        int64_t getNumberOfMisses() const { return m_misses; }
+    };
+    
+} // namespace
+
+#endif // __COMMAND_SURFACE_CACHE_H__
@@ -22,7 +22,9 @@
 #include "CaretException.h"
 #include "CaretLogger.h"
 #include "CaretMathExpression.h"
+#include "CaretOMP.h"
 
+#include <algorithm>
 #include <cmath>
 
 using namespace caret;
@@ -36,6 +38,8 @@ CaretMathExpression::CaretMathExpression(const AString& expression)
         throw CaretException("error parsing expression '" + expression + "'");
     }
     CaretLogInfo("parsed '" + expression + "' as '" + toString() + "'");
+    m_numRegisters = 0;
+    compile(m_root, 0);
 }
 
 double CaretMathExpression::evaluate(const vector<float>& variableValues) const
@@ -44,6 +48,319 @@ double CaretMathExpression::evaluate(const vector<float>& variableValues) const
     return m_root.eval(variableValues);
 }
 
+/**
+ * Evaluate the expression for every element of a set of equal length arrays, giving
+ * the same results as calling evaluate() on each element, but without the per-element
+ * tree walk.  Elements are processed in chunks, in parallel.
+ *
+ * @param variableArrays
+ *    One array per variable, in the order of getVarNames().
+ * @param output
+ *    Array to put the results in.
+ * @param length
+ *    Number of elements in each array.
+ */
+void CaretMathExpression::evaluateArrays(const vector<const float*>& variableArrays, float* output, const int64_t& length) const
+{
+    CaretAssert(variableArrays.size() >= m_varNames.size());
+    const int64_t numChunks = (length + BATCH_CHUNK - 1) / BATCH_CHUNK;
+#pragma omp CARET_PAR
+    {
+        vector<double> registers(m_numRegisters * BATCH_CHUNK);
+#pragma omp CARET_FOR schedule(dynamic)
+        for (int64_t chunk = 0; chunk < numChunks; ++chunk)
+        {
+            int64_t start = chunk * BATCH_CHUNK;
+            int count = (int)min((int64_t)BATCH_CHUNK, length - start);
+            runProgram(variableArrays, start, count, registers.data());
+            for (int i = 0; i < count; ++i)
+            {
+                output[start + i] = (float)registers[i];//result is in register 0
+            }
+        }
+    }
+}
+
+CaretMathExpression::Instruction::Instruction(const OpCode& op, const int& dest, const int& arg1)
+{
+    m_op = op;
+    m_function = MathFunctionEnum::INVALID;
+    m_dest = dest;
+    m_arg1 = arg1;
+    m_arg2 = -1;
+    m_varIndex = -1;
+    m_constVal = 0.0;
+}
+
+///append instructions that leave the value of node in register dest, using only registers above dest as scratch
+void CaretMathExpression::compile(const MathNode& node, const int& dest)
+{
+    if (dest >= m_numRegisters) m_numRegisters = dest + 1;
+    int end = (int)node.m_arguments.size();
+    switch (node.m_type)
+    {
+        case MathNode::GREATERLESS:
+            CaretAssert(end > 0);
+            compile(node.m_arguments[0], dest);
+            for (int i = 1; i < end; ++i)
+            {
+                compile(node.m_arguments[i], dest + 1);
+                if (node.m_inclusive[i])
+                {
+                    m_program.push_back(Instruction(node.m_invert[i] ? Instruction::LESS_EQUAL : Instruction::GREATER_EQUAL, dest, dest + 1));
+                } else {
+                    m_program.push_back(Instruction(node.m_invert[i] ? Instruction::LESS : Instruction::GREATER, dest, dest + 1));
+                }
+            }
+            break;
+        case MathNode::ADDSUB:
+        {
+            Instruction zero(Instruction::CONST, dest);//start from 0.0 like eval, so signed zeros come out the same
+            m_program.push_back(zero);
+            for (int i = 0; i < end; ++i)
+            {
+                compile(node.m_arguments[i], dest + 1);
+                m_program.push_back(Instruction(node.m_invert[i] ? Instruction::SUBTRACT : Instruction::ADD, dest, dest + 1));
+            }
+            break;
+        }
+        case MathNode::MULTDIV:
+        {
+            Instruction one(Instruction::CONST, dest);
+            one.m_constVal = 1.0;
+            m_program.push_back(one);
+            for (int i = 0; i < end; ++i)
+            {
+                compile(node.m_arguments[i], dest + 1);
+                m_program.push_back(Instruction(node.m_invert[i] ? Instruction::DIVIDE : Instruction::MULTIPLY, dest, dest + 1));
+            }
+            break;
+        }
+        case MathNode::POW:
+            CaretAssert(end > 0);
+            compile(node.m_arguments[0], dest);
+            for (int i = 1; i < end; ++i)
+            {
+                compile(node.m_arguments[i], dest + 1);
+                m_program.push_back(Instruction(Instruction::POW, dest, dest + 1));
+            }
+            break;
+        case MathNode::FUNC:
+        {
+            if (node.m_function == MathFunctionEnum::INVALID)
+            {
+                throw CaretException("parsing problem in CaretMathExpression");
+            }
+            CaretAssert(end > 0 && end <= 3);
+            for (int i = 0; i < end; ++i)
+            {
+                compile(node.m_arguments[i], dest + i);
+            }
+            Instruction myFunc(Instruction::FUNC, dest, dest + 1);
+            myFunc.m_arg2 = dest + 2;
+            myFunc.m_function = node.m_function;
+            m_program.push_back(myFunc);
+            break;
+        }
+        case MathNode::VAR:
+        {
+            Instruction myVar(Instruction::VAR, dest);
+            myVar.m_varIndex = node.m_varIndex;
+            m_program.push_back(myVar);
+            break;
+        }
+        case MathNode::CONST:
+        {
+            Instruction myConst(Instruction::CONST, dest);
+            myConst.m_constVal = node.m_constVal;
+            m_program.push_back(myConst);
+            break;
+        }
+        case MathNode::INVALID:
+            throw CaretException("parsing problem in CaretMathExpression");
+    }
+    if (node.m_negate)
+    {
+        m_program.push_back(Instruction(Instruction::NEGATE, dest));
+    }
+}
+
+///run the program on count elements starting at start, the result ends up in the first count values of registers
+void CaretMathExpression::runProgram(const vector<const float*>& variableArrays, const int64_t& start, const int& count, double* registers) const
+{//the arithmetic here must stay identical to MathNode::eval, so that evaluateArrays matches evaluate exactly
+    int numInstructions = (int)m_program.size();
+    for (int p = 0; p < numInstructions; ++p)
+    {
+        const Instruction& myInst = m_program[p];
+        double* ret = registers + myInst.m_dest * BATCH_CHUNK;
+        const double* arg1 = (myInst.m_arg1 < 0 ? NULL : registers + myInst.m_arg1 * BATCH_CHUNK);
+        const double* arg2 = (myInst.m_arg2 < 0 ? NULL : registers + myInst.m_arg2 * BATCH_CHUNK);
+        switch (myInst.m_op)
+        {
+            case Instruction::VAR:
+            {
+                CaretAssertVectorIndex(variableArrays, myInst.m_varIndex);
+                const float* varData = variableArrays[myInst.m_varIndex] + start;
+                for (int i = 0; i < count; ++i) ret[i] = varData[i];
+                break;
+            }
+            case Instruction::CONST:
+                for (int i = 0; i < count; ++i) ret[i] = myInst.m_constVal;
+                break;
+            case Instruction::ADD:
+                for (int i = 0; i < count; ++i) ret[i] += arg1[i];
+                break;
+            case Instruction::SUBTRACT:
+                for (int i = 0; i < count; ++i) ret[i] -= arg1[i];
+                break;
+            case Instruction::MULTIPLY:
+                for (int i = 0; i < count; ++i) ret[i] *= arg1[i];
+                break;
+            case Instruction::DIVIDE:
+                for (int i = 0; i < count; ++i) ret[i] /= arg1[i];
+                break;
+            case Instruction::POW:
+                for (int i = 0; i < count; ++i) ret[i] = pow(ret[i], arg1[i]);
+                break;
+            case Instruction::GREATER:
+                for (int i = 0; i < count; ++i) ret[i] = (ret[i] > arg1[i] ? 1.0 : 0.0);
+                break;
+            case Instruction::LESS:
+                for (int i = 0; i < count; ++i) ret[i] = (ret[i] < arg1[i] ? 1.0 : 0.0);
+                break;
+            case Instruction::GREATER_EQUAL:
+                for (int i = 0; i < count; ++i)
+                {
+                    float adjust = min(abs(ret[i]), abs(arg1[i])) / (1<<20);
+                    ret[i] = (ret[i] >= arg1[i] - adjust ? 1.0 : 0.0);
+                }
+                break;
+            case Instruction::LESS_EQUAL:
+                for (int i = 0; i < count; ++i)
+                {
+                    float adjust = min(abs(ret[i]), abs(arg1[i])) / (1<<20);
+                    ret[i] = (ret[i] <= arg1[i] + adjust ? 1.0 : 0.0);
+                }
+                break;
+            case Instruction::NEGATE:
+                for (int i = 0; i < count; ++i) ret[i] = -ret[i];
+                break;
+            case Instruction::FUNC:
+                switch (myInst.m_function)
+                {
+                    case MathFunctionEnum::SIN:
+                        for (int i = 0; i < count; ++i) ret[i] = sin(ret[i]);
+                        break;
+                    case MathFunctionEnum::COS:
+                        for (int i = 0; i < count; ++i) ret[i] = cos(ret[i]);
+                        break;
+                    case MathFunctionEnum::TAN:
+                        for (int i = 0; i < count; ++i) ret[i] = tan(ret[i]);
+                        break;
+                    case MathFunctionEnum::ASIN:
+                        for (int i = 0; i < count; ++i) ret[i] = asin(ret[i]);
+                        break;
+                    case MathFunctionEnum::ACOS:
+                        for (int i = 0; i < count; ++i) ret[i] = acos(ret[i]);
+                        break;
+                    case MathFunctionEnum::ATAN:
+                        for (int i = 0; i < count; ++i) ret[i] = atan(ret[i]);
+                        break;
+                    case MathFunctionEnum::SINH:
+                        for (int i = 0; i < count; ++i) ret[i] = sinh(ret[i]);
+                        break;
+                    case MathFunctionEnum::COSH:
+                        for (int i = 0; i < count; ++i) ret[i] = cosh(ret[i]);
+                        break;
+                    case MathFunctionEnum::TANH:
+                        for (int i = 0; i < count; ++i) ret[i] = tanh(ret[i]);
+                        break;
+                    case MathFunctionEnum::ASINH:
+                        for (int i = 0; i < count; ++i)
+                        {
+                            double arg = ret[i];
+                            if (arg > 0)
+                            {
+                                ret[i] = log(arg + sqrt(arg * arg + 1));
+                            } else {
+                                ret[i] = -log(-arg + sqrt(arg * arg + 1));
+                            }
+                        }
+                        break;
+                    case MathFunctionEnum::ACOSH:
+                        for (int i = 0; i < count; ++i) ret[i] = log(ret[i] + sqrt(ret[i] * ret[i] - 1));
+                        break;
+                    case MathFunctionEnum::ATANH:
+                        for (int i = 0; i < count; ++i) ret[i] = 0.5 * log((1 + ret[i]) / (1 - ret[i]));
+                        break;
+                    case MathFunctionEnum::LN:
+                        for (int i = 0; i < count; ++i) ret[i] = log(ret[i]);
+                        break;
+                    case MathFunctionEnum::EXP:
+                        for (int i = 0; i < count; ++i) ret[i] = exp(ret[i]);
+                        break;
+                    case MathFunctionEnum::LOG:
+                        for (int i = 0; i < count; ++i) ret[i] = log10(ret[i]);
+                        break;
+                    case MathFunctionEnum::SQRT:
+                        for (int i = 0; i < count; ++i) ret[i] = sqrt(ret[i]);
+                        break;
+                    case MathFunctionEnum::ABS:
+                        for (int i = 0; i < count; ++i) ret[i] = abs(ret[i]);
+                        break;
+                    case MathFunctionEnum::FLOOR:
+                        for (int i = 0; i < count; ++i) ret[i] = floor(ret[i]);
+                        break;
+                    case MathFunctionEnum::ROUND:
+                        for (int i = 0; i < count; ++i)
+                        {
+                            if (ret[i] > 0.0)
+                            {
+                                ret[i] = floor(ret[i] + 0.5);
+                            } else {
+                                ret[i] = ceil(ret[i] - 0.5);
+                            }
+                        }
+                        break;
+                    case MathFunctionEnum::CEIL:
+                        for (int i = 0; i < count; ++i) ret[i] = ceil(ret[i]);
+                        break;
+                    case MathFunctionEnum::ATAN2:
+                        for (int i = 0; i < count; ++i) ret[i] = atan2(ret[i], arg1[i]);
+                        break;
+                    case MathFunctionEnum::MIN:
+                        for (int i = 0; i < count; ++i) if (ret[i] > arg1[i]) ret[i] = arg1[i];
+                        break;
+                    case MathFunctionEnum::MAX:
+                        for (int i = 0; i < count; ++i) if (ret[i] < arg1[i]) ret[i] = arg1[i];
+                        break;
+                    case MathFunctionEnum::MOD:
+                        for (int i = 0; i < count; ++i)
+                        {
+                            if (arg1[i] == 0.0)
+                            {
+                                ret[i] = 0.0;
+                            } else {
+                                ret[i] = ret[i] - arg1[i] * floor(ret[i] / arg1[i]);
+                            }
+                        }
+                        break;
+                    case MathFunctionEnum::CLAMP:
+                        for (int i = 0; i < count; ++i)
+                        {
+                            if (ret[i] < arg1[i]) ret[i] = arg1[i];
+                            if (ret[i] > arg2[i]) ret[i] = arg2[i];
+                        }
+                        break;
+                    case MathFunctionEnum::INVALID:
+                        CaretAssertMessage(0, "INVALID function in compiled CaretMathExpression");//compile() throws on this
+                        break;
+                }
+                break;
+        }
+    }
+}
+
 CaretMathExpression::MathNode::MathNode()
 {
     m_type = INVALID;
@@ -25,10 +25,24 @@
 #include "CaretObject.h"
 #undef __CARET_OBJECT_DECLARE_H__
 
+#include "CaretMutex.h"
 #include "SystemUtilities.h"
 
 using namespace caret;
 
+#ifndef NDEBUG
+/**
+ * @return Mutex for tracking of allocated objects since objects
+ * may be created and deleted on more than one thread.
+ */
+static CaretMutex&
+getAllocatedObjectsMutex()
+{
+    static CaretMutex allocatedObjectsMutex;
+    return allocatedObjectsMutex;
+}
+#endif
+
 /**
  * Constructor.
  *
@@ -58,6 +72,7 @@ CaretObject::~CaretObject()
      * Erase returns the number of objects deleted.
      * If zero, then the object has already been deleted.
      */
+    CaretMutexLocker locker(&getAllocatedObjectsMutex());
     uint64_t numDeleted = CaretObject::allocatedObjects.erase(this);
     if (numDeleted <= 0) {
         std::cerr << "Destructor for a CaretObject called but the object is not allocated "
@@ -81,6 +96,7 @@ CaretObject::initializeMembersCaretObject()
 #ifndef NDEBUG
     SystemBacktrace myBacktrace;
     SystemUtilities::getBackTrace(myBacktrace);
+    CaretMutexLocker locker(&getAllocatedObjectsMutex());
     CaretObject::allocatedObjects.insert(
                std::make_pair(this,
                               myBacktrace));
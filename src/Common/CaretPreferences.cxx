@@ -1252,6 +1252,30 @@ CaretPreferences::setVolumeMontageCoordinatePrecision(const int32_t volumeMontag
     this->qSettings->sync();
 }
 
+/**
+ * @return Are volume slices drawn from 3D textures of the voxel coloring
+ * (instead of a quadrilateral for each voxel)?
+ */
+bool
+CaretPreferences::isVolumeSliceTextureDrawingEnabled() const
+{
+    return this->volumeSliceTextureDrawingEnabled;
+}
+
+/**
+ * Set volume slices drawn from 3D textures of the voxel coloring.
+ * @param enabled
+ *   New status.
+ */
+void
+CaretPreferences::setVolumeSliceTextureDrawingEnabled(const bool enabled)
+{
+    this->volumeSliceTextureDrawingEnabled = enabled;
+    this->setBoolean(CaretPreferences::NAME_VOLUME_SLICE_TEXTURE_DRAWING,
+                     this->volumeSliceTextureDrawingEnabled);
+    this->qSettings->sync();
+}
+
 /**
  * @return The toolbox type.
  */
@@ -1433,6 +1457,9 @@ CaretPreferences::readPreferences()
     this->volumeMontageCoordinatePrecision = this->getInteger(CaretPreferences::NAME_VOLUME_MONTAGE_COORDINATE_PRECISION,
                                                               0);
     
+    this->volumeSliceTextureDrawingEnabled = this->getBoolean(CaretPreferences::NAME_VOLUME_SLICE_TEXTURE_DRAWING,
+                                                              false);
+    
     this->animationStartTime = 0.0;//this->qSettings->value(CaretPreferences::NAME_ANIMATION_START_TIME).toDouble();
 
     this->toolBoxType = this->getInteger(CaretPreferences::NAME_TOOLBOX_TYPE,
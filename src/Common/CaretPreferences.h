@@ -99,6 +99,10 @@ namespace caret {
         
         void setVolumeMontageCoordinatePrecision(const int32_t volumeMontageCoordinatePrecision);
         
+        bool isVolumeSliceTextureDrawingEnabled() const;
+        
+        void setVolumeSliceTextureDrawingEnabled(const bool enabled);
+        
         void setAnimationStartTime(const double &time);
         
         void getAnimationStartTime(double &time);
@@ -245,6 +249,8 @@ namespace caret {
         
         int32_t volumeMontageCoordinatePrecision;
         
+        bool volumeSliceTextureDrawingEnabled;
+        
         bool splashScreenEnabled;
         
         bool developMenuEnabled;
@@ -265,6 +271,7 @@ namespace caret {
         static const AString NAME_VOLUME_AXES_COORDINATE;
         static const AString NAME_VOLUME_MONTAGE_GAP;
         static const AString NAME_VOLUME_MONTAGE_COORDINATE_PRECISION;
+        static const AString NAME_VOLUME_SLICE_TEXTURE_DRAWING;
         static const AString NAME_COLOR_BACKGROUND;
         static const AString NAME_COLOR_FOREGROUND;
         static const AString NAME_DEVELOP_MENU;
@@ -291,6 +298,7 @@ namespace caret {
     const AString CaretPreferences::NAME_VOLUME_AXES_COORDINATE     = "volumeAxesCoordinates";
     const AString CaretPreferences::NAME_VOLUME_MONTAGE_GAP     = "volumeMontageGap";
     const AString CaretPreferences::NAME_VOLUME_MONTAGE_COORDINATE_PRECISION     = "volumeMontageCoordinatePrecision";
+    const AString CaretPreferences::NAME_VOLUME_SLICE_TEXTURE_DRAWING     = "volumeSliceTextureDrawing";
     const AString CaretPreferences::NAME_COLOR_BACKGROUND     = "colorBackground";
     const AString CaretPreferences::NAME_COLOR_FOREGROUND     = "colorForeground";
     const AString CaretPreferences::NAME_DEVELOP_MENU     = "developMenu";
@@ -33,8 +33,12 @@
 =========================================================================*/
 #include "DataCompressZLib.h"
 #include "MathFunctions.h"
+#include "ParallelDeflate.h"
 #include "zlib.h"
 
+#include <cstring>
+#include <vector>
+
 using namespace caret;
 
 //----------------------------------------------------------------------------
@@ -67,6 +71,27 @@ DataCompressZLib::compressData(const unsigned char* uncompressedData,
                                       unsigned char* compressedData,
                                       const uint64_t compressionSpace)
 {
+  // Large arrays are split into blocks and compressed on all cores, still a standard zlib stream.
+  if(uncompressedSize >= 2 * ParallelDeflate::BLOCK_SIZE)
+    {
+    std::vector<char> parallelData;
+    try
+      {
+      ParallelDeflate::compress(reinterpret_cast<const char*>(uncompressedData), uncompressedSize,
+                                parallelData, ParallelDeflate::FORMAT_ZLIB, this->compressionLevel);
+      }
+    catch (CaretException&)
+      {
+      return 0;
+      }
+    if(parallelData.size() <= compressionSpace)
+      {
+      memcpy(compressedData, parallelData.data(), parallelData.size());
+      return parallelData.size();
+      }
+    // otherwise the caller's buffer was sized for serial compression, so fall back to it
+    }
+
   uLongf compressedSize = compressionSpace;
   Bytef* cd = reinterpret_cast<Bytef*>(compressedData);
   const Bytef* ud = reinterpret_cast<const Bytef*>(uncompressedData);
@@ -115,5 +140,6 @@ unsigned long
 DataCompressZLib::getMaximumCompressionSpace(unsigned long size)
 {
   // ZLib specifies that destination buffer must be 0.1% larger + 12 bytes.
-  return size + (size+999)/1000 + 12;
+  // Parallel compression adds a flush marker and some bits per block.
+  return size + (size+999)/1000 + 12 + (size / ParallelDeflate::BLOCK_SIZE + 1) * 16;
 }
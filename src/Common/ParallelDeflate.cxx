@@ -0,0 +1,268 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "ParallelDeflate.h"
+
+#include "CaretAssert.h"
+#include "CaretOMP.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "zlib.h"
+
+using namespace caret;
+using namespace std;
+
+/**
+ * @param format
+ *    Whether to write a gzip (file) or zlib (in-memory, e.g. GIFTI) stream.
+ * @param level
+ *    zlib compression level, -1 for the zlib default.
+ */
+ParallelDeflate::ParallelDeflate(const Format& format, const int32_t& level)
+{
+    m_format = format;
+    m_level = level;
+    m_headerWritten = false;
+    m_finished = false;
+    m_totalIn = 0;
+    switch (m_format)
+    {
+        case FORMAT_GZIP:
+            m_check = crc32(0L, Z_NULL, 0);
+            break;
+        case FORMAT_ZLIB:
+            m_check = adler32(0L, Z_NULL, 0);
+            break;
+    }
+}
+
+/**
+ * Add uncompressed data to the stream.
+ *
+ * @param data
+ *    The data to compress.
+ * @param size
+ *    Number of bytes of data.
+ * @param compressedOut
+ *    Any compressed output that is complete is appended to this.
+ */
+void ParallelDeflate::write(const char* data, const int64_t& size, vector<char>& compressedOut)
+{
+    if (m_finished) throw CaretException("write called on finished compression stream");
+    int64_t used = 0;
+    while (used < size)
+    {
+        if (m_pending.empty() && size - used >= BATCH_SIZE)
+        {//large writes don't need to be copied
+            int64_t direct = (size - used) / BLOCK_SIZE * BLOCK_SIZE;
+            compressBlocks(data + used, direct, false, compressedOut);
+            used += direct;
+        } else {
+            int64_t toCopy = min(size - used, (int64_t)(BATCH_SIZE - m_pending.size()));
+            m_pending.insert(m_pending.end(), data + used, data + used + toCopy);
+            used += toCopy;
+            if (m_pending.size() == BATCH_SIZE)
+            {
+                compressBlocks(m_pending.data(), m_pending.size(), false, compressedOut);
+                m_pending.clear();
+            }
+        }
+    }
+}
+
+/**
+ * Compress any remaining data and end the stream.
+ *
+ * @param compressedOut
+ *    The rest of the compressed stream, including the trailer, is appended to this.
+ */
+void ParallelDeflate::finish(vector<char>& compressedOut)
+{
+    if (m_finished) throw CaretException("finish called on finished compression stream");
+    compressBlocks(m_pending.data(), m_pending.size(), true, compressedOut);
+    m_pending.clear();
+    writeTrailer(compressedOut);
+    m_finished = true;
+}
+
+/**
+ * Compress a complete buffer in one call.
+ *
+ * @param data
+ *    The data to compress.
+ * @param size
+ *    Number of bytes of data.
+ * @param compressedOut
+ *    Replaced with the compressed stream.
+ * @param format
+ *    gzip or zlib stream.
+ * @param level
+ *    zlib compression level, -1 for the zlib default.
+ */
+void ParallelDeflate::compress(const char* data, const int64_t& size, vector<char>& compressedOut, const Format& format, const int32_t& level)
+{
+    ParallelDeflate myDeflate(format, level);
+    compressedOut.clear();
+    myDeflate.compressBlocks(data, size, true, compressedOut);
+    myDeflate.writeTrailer(compressedOut);
+    myDeflate.m_finished = true;
+}
+
+void ParallelDeflate::writeHeader(vector<char>& compressedOut)
+{
+    switch (m_format)
+    {
+        case FORMAT_GZIP:
+        {
+            const unsigned char header[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3 };//deflate, no flags, no mtime, unix
+            compressedOut.insert(compressedOut.end(), (const char*)header, (const char*)header + 10);
+            break;
+        }
+        case FORMAT_ZLIB:
+        {
+            int flevel = 2;//what zlib writes for the default level
+            if (m_level >= 0 && m_level < 2)
+            {
+                flevel = 0;
+            } else if (m_level >= 2 && m_level < 6) {
+                flevel = 1;
+            } else if (m_level > 6) {
+                flevel = 3;
+            }
+            int cmf = 0x78;//deflate, 32KB window
+            int flg = flevel << 6;
+            flg += 31 - (cmf * 256 + flg) % 31;
+            compressedOut.push_back((char)cmf);
+            compressedOut.push_back((char)flg);
+            break;
+        }
+    }
+    m_headerWritten = true;
+}
+
+void ParallelDeflate::writeTrailer(vector<char>& compressedOut)
+{
+    switch (m_format)
+    {
+        case FORMAT_GZIP://little endian crc32, then length mod 2^32
+            for (int i = 0; i < 4; ++i) compressedOut.push_back((char)((m_check >> (8 * i)) & 0xff));
+            for (int i = 0; i < 4; ++i) compressedOut.push_back((char)((m_totalIn >> (8 * i)) & 0xff));
+            break;
+        case FORMAT_ZLIB://big endian adler32
+            for (int i = 3; i >= 0; --i) compressedOut.push_back((char)((m_check >> (8 * i)) & 0xff));
+            break;
+    }
+}
+
+///compress data as independent blocks in parallel, size must be a multiple of BLOCK_SIZE unless this is the end of the stream
+void ParallelDeflate::compressBlocks(const char* data, const int64_t& size, const bool& last, vector<char>& compressedOut)
+{
+    CaretAssert(last || size % BLOCK_SIZE == 0);
+    if (!m_headerWritten) writeHeader(compressedOut);
+    int64_t numBlocks = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    if (last && numBlocks == 0) numBlocks = 1;//need an empty final block
+    if (numBlocks == 0) return;
+    const int64_t WINDOW_SIZE = 32768;
+    vector<vector<char> > blockOut(numBlocks);
+    vector<unsigned long> blockCheck(numBlocks);
+    vector<char> blockFailed(numBlocks, 0);//one flag per block, so threads never write the same one
+#pragma omp CARET_PARFOR schedule(dynamic)
+    for (int64_t block = 0; block < numBlocks; ++block)
+    {
+        int64_t start = block * BLOCK_SIZE;
+        int64_t length = min((int64_t)BLOCK_SIZE, size - start);
+        const Bytef* blockData = (const Bytef*)(data + start);
+        z_stream strm;
+        memset(&strm, 0, sizeof(strm));
+        if (deflateInit2(&strm, m_level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            blockFailed[block] = 1;
+            continue;
+        }
+        int ret = Z_OK;
+        if (start > 0)
+        {//dictionary from the preceding input, so matches can reach back across the block boundary
+            int64_t dictLength = min(WINDOW_SIZE, start);
+            ret = deflateSetDictionary(&strm, blockData - dictLength, dictLength);
+        } else if (!m_dictionary.empty()) {
+            ret = deflateSetDictionary(&strm, (const Bytef*)m_dictionary.data(), m_dictionary.size());
+        }
+        vector<char>& myOut = blockOut[block];
+        myOut.resize(deflateBound(&strm, length) + 16);//sync flush marker isn't included in the bound
+        strm.next_in = (Bytef*)blockData;
+        strm.avail_in = length;
+        strm.next_out = (Bytef*)myOut.data();
+        strm.avail_out = myOut.size();
+        int flush = (last && block == numBlocks - 1) ? Z_FINISH : Z_SYNC_FLUSH;
+        while (ret == Z_OK)
+        {
+            ret = deflate(&strm, flush);
+            if (ret == Z_STREAM_END || (flush == Z_SYNC_FLUSH && ret == Z_OK && strm.avail_out > 0)) break;
+            if (ret == Z_OK || ret == Z_BUF_ERROR)
+            {//out of output space, shouldn't happen given the bound
+                int64_t used = myOut.size() - strm.avail_out;
+                myOut.resize(myOut.size() * 2);
+                strm.next_out = (Bytef*)myOut.data() + used;
+                strm.avail_out = myOut.size() - used;
+                ret = Z_OK;
+            }
+        }
+        if (ret != Z_OK && ret != Z_STREAM_END) blockFailed[block] = 1;
+        myOut.resize(myOut.size() - strm.avail_out);
+        deflateEnd(&strm);
+        switch (m_format)
+        {
+            case FORMAT_GZIP:
+                blockCheck[block] = crc32(0L, blockData, length);
+                break;
+            case FORMAT_ZLIB:
+                blockCheck[block] = adler32(1L, blockData, length);
+                break;
+        }
+    }
+    if (find(blockFailed.begin(), blockFailed.end(), 1) != blockFailed.end()) throw CaretException("zlib error while compressing data");
+    for (int64_t block = 0; block < numBlocks; ++block)
+    {
+        compressedOut.insert(compressedOut.end(), blockOut[block].begin(), blockOut[block].end());
+        int64_t length = min((int64_t)BLOCK_SIZE, size - block * BLOCK_SIZE);
+        switch (m_format)
+        {
+            case FORMAT_GZIP:
+                m_check = crc32_combine(m_check, blockCheck[block], length);
+                break;
+            case FORMAT_ZLIB:
+                m_check = adler32_combine(m_check, blockCheck[block], length);
+                break;
+        }
+    }
+    m_totalIn += size;
+    if (size >= WINDOW_SIZE)
+    {
+        m_dictionary.assign(data + size - WINDOW_SIZE, data + size);
+    } else {
+        m_dictionary.insert(m_dictionary.end(), data, data + size);
+        if ((int64_t)m_dictionary.size() > WINDOW_SIZE)
+        {
+            m_dictionary.erase(m_dictionary.begin(), m_dictionary.end() - WINDOW_SIZE);
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef __PARALLEL_DEFLATE_H__
+#define __PARALLEL_DEFLATE_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CaretException.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace caret {
+
+    /**
+     * Deflate compression that uses all available cores, producing a single
+     * standard gzip or zlib stream.
+     *
+     * Input is cut into fixed size blocks, each compressed independently on a
+     * worker thread, primed with the preceding 32KB of input as its dictionary
+     * so the ratio stays close to serial compression.  Every block but the last
+     * ends with a sync flush, so the compressed blocks can simply be
+     * concatenated, and the per-block checksums are combined for the trailer.
+     */
+    class ParallelDeflate
+    {
+    public:
+        enum Format
+        {
+            FORMAT_GZIP,
+            FORMAT_ZLIB
+        };
+
+        enum
+        {
+            BLOCK_SIZE = 128 * 1024,
+            BATCH_SIZE = 64 * BLOCK_SIZE//input is buffered up to this much before compressing
+        };
+
+        ParallelDeflate(const Format& format, const int32_t& level = -1);
+
+        void write(const char* data, const int64_t& size, std::vector<char>& compressedOut);
+
+        void finish(std::vector<char>& compressedOut);
+
+        ///total bytes of uncompressed data written so far
+        int64_t getUncompressedSize() const { return m_totalIn + (int64_t)m_pending.size(); }
+
+        static void compress(const char* data, const int64_t& size, std::vector<char>& compressedOut, const Format& format, const int32_t& level = -1);
+
+    private:
+        Format m_format;
+        int32_t m_level;
+        bool m_headerWritten, m_finished;
+        int64_t m_totalIn;
+        unsigned long m_check;//crc32 for gzip, adler32 for zlib
+        std::vector<char> m_pending;//input that doesn't fill a block yet
+        std::vector<char> m_dictionary;//last 32KB of compressed input
+
+        void writeHeader(std::vector<char>& compressedOut);
+
+        void writeTrailer(std::vector<char>& compressedOut);
+
+        void compressBlocks(const char* data, const int64_t& size, const bool& last, std::vector<char>& compressedOut);
+    };
+
+}
+
+#endif //__PARALLEL_DEFLATE_H__
@@ -0,0 +1,36 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "AdjacencyCSR.h"
+
+using namespace caret;
+using namespace std;
+
+void AdjacencyCSR::setRowSizes(const vector<int32_t>& rowSizes)
+{
+    int32_t numRows = (int32_t)rowSizes.size();
+    m_offsets.resize(numRows + 1);
+    m_offsets[0] = 0;
+    for (int32_t i = 0; i < numRows; ++i)
+    {
+        m_offsets[i + 1] = m_offsets[i] + rowSizes[i];
+    }
+    m_indices.resize(m_offsets[numRows]);
+}
@@ -0,0 +1,57 @@
+#ifndef __ADJACENCY_CSR_H__
+#define __ADJACENCY_CSR_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CaretAssert.h"
+
+#include "stdint.h"
+#include <vector>
+
+namespace caret {
+    
+    ///contiguous (compressed sparse row) adjacency, row i is entries [m_offsets[i], m_offsets[i + 1]) of m_indices, and of any value arrays kept alongside it
+    struct AdjacencyCSR
+    {
+        std::vector<int64_t> m_offsets;
+        std::vector<int32_t> m_indices;
+        
+        int32_t getNumberOfRows() const { return (m_offsets.empty() ? 0 : (int32_t)(m_offsets.size() - 1)); }
+        
+        int32_t getRowSize(const int32_t& row) const
+        {
+            CaretAssert(row >= 0 && row < getNumberOfRows());
+            return (int32_t)(m_offsets[row + 1] - m_offsets[row]);
+        }
+        
+        const int32_t* getRow(const int32_t& row) const
+        {
+            CaretAssert(row >= 0 && row < getNumberOfRows());
+            return m_indices.data() + m_offsets[row];
+        }
+        
+        ///allocate from the size of each row, so the rows can then be filled in place
+        void setRowSizes(const std::vector<int32_t>& rowSizes);
+    };
+    
+}
+
+#endif //__ADJACENCY_CSR_H__
@@ -30,42 +30,126 @@
 #include "ByteOrderEnum.h"
 #include "ByteSwapping.h"
 #include "CaretAssert.h"
+#include "CaretHeap.h"
+#include "CaretLogger.h"
 #include "FileInformation.h"
 #include <QByteArray>
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 
 using namespace caret;
 using namespace std;
 
 const char magic[] = "\0\0\0\0cst\0";
+const char magic2[] = "\0\0\0\0cs2\0";
+const int64_t ROW_OFFSETS_START = 8 + 3 * sizeof(int64_t);//version 2: magic, dimensions, column index offset, then row offsets
+
+static void appendVarint(vector<unsigned char>& bytes, uint64_t value)
+{
+    while (value >= 128)
+    {
+        bytes.push_back((unsigned char)(value | 128));
+        value >>= 7;
+    }
+    bytes.push_back((unsigned char)value);
+}
+
+static uint64_t readVarint(const unsigned char*& pos, const unsigned char* end)
+{
+    uint64_t ret = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (pos >= end) throw DataFileException("compressed row or column is truncated");
+        unsigned char byte = *pos;
+        ++pos;
+        ret |= ((uint64_t)(byte & 127)) << shift;
+        if ((byte & 128) == 0) return ret;
+    }
+    throw DataFileException("invalid variable length integer in file");
+}
+
+static void encodeEntries(const int64_t* indices, const int64_t* values, const int64_t& count, vector<unsigned char>& bytes)
+{//count, then gaps between indices (first index, then index - previous - 1), then the values as unsigned, which is how fibers are encoded
+    bytes.clear();
+    appendVarint(bytes, count);
+    int64_t lastIndex = -1;
+    for (int64_t i = 0; i < count; ++i)
+    {
+        appendVarint(bytes, indices[i] - lastIndex - 1);
+        lastIndex = indices[i];
+    }
+    for (int64_t i = 0; i < count; ++i)
+    {
+        appendVarint(bytes, (uint64_t)values[i]);
+    }
+}
+
+static void decodeEntries(const unsigned char* bytes, const int64_t& length, const int64_t& indexLimit, vector<int64_t>& indicesOut, vector<int64_t>& valuesOut)
+{
+    const unsigned char* pos = bytes, *end = bytes + length;
+    uint64_t count = readVarint(pos, end);
+    if (count > (uint64_t)indexLimit) throw DataFileException("impossible number of nonzero values found in file");
+    indicesOut.resize(count);
+    valuesOut.resize(count);
+    int64_t lastIndex = -1;
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        uint64_t gap = readVarint(pos, end);
+        if (gap >= (uint64_t)(indexLimit - lastIndex - 1)) throw DataFileException("impossible index value found in file");
+        lastIndex += gap + 1;
+        indicesOut[i] = lastIndex;
+    }
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        valuesOut[i] = (int64_t)readVarint(pos, end);
+    }
+    if (pos != end) throw DataFileException("compressed row or column has extra data");
+}
 
 CaretSparseFile::CaretSparseFile()
 {
     m_file = NULL;
+    m_mapped = NULL;
+    m_version = 0;
 }
 
 CaretSparseFile::CaretSparseFile(const AString& fileName)
 {
     m_file = NULL;
+    m_mapped = NULL;
+    m_version = 0;
     readFile(fileName);
 }
 
-void CaretSparseFile::readFile(const AString& filename)
+void CaretSparseFile::close()
 {
     if (m_file != NULL)
     {
         fclose(m_file);
         m_file = NULL;
     }
+    m_mapFile.grabNew(NULL);
+    m_mapped = NULL;
+    m_columnIndexArray.clear();
+}
+
+void CaretSparseFile::readFile(const AString& filename)
+{
+    close();
     FileInformation fileInfo(filename);
     if (!fileInfo.exists()) throw DataFileException("file doesn't exist");
     m_file = fopen(filename.toLocal8Bit().constData(), "rb");
     if (m_file == NULL) throw DataFileException("error opening file");
     char buf[8];
     if (fread(buf, 1, 8, m_file) != 8) throw DataFileException("error reading from file");
-    for (int i = 0; i < 8; ++i)
+    if (memcmp(buf, magic, 8) == 0)
     {
-        if (buf[i] != magic[i]) throw DataFileException("file has the wrong magic string");
+        m_version = 1;
+    } else if (memcmp(buf, magic2, 8) == 0) {
+        m_version = 2;
+    } else {
+        throw DataFileException("file has the wrong magic string");
     }
     if (fread(m_dims, sizeof(int64_t), 2, m_file) != 2) throw DataFileException("error reading from file");
     if (ByteOrderEnum::isSystemBigEndian())
@@ -73,21 +157,62 @@ void CaretSparseFile::readFile(const AString& filename)
         ByteSwapping::swapBytes(m_dims, 2);
     }
     if (m_dims[0] < 1 || m_dims[1] < 1) throw DataFileException("both dimensions must be positive");
-    m_indexArray.resize(m_dims[1] + 1);
-    vector<int64_t> lengthArray(m_dims[1]);
-    if (fread(lengthArray.data(), sizeof(int64_t), m_dims[1], m_file) != (size_t)m_dims[1]) throw DataFileException("error reading from file");
-    if (ByteOrderEnum::isSystemBigEndian())
-    {
-        ByteSwapping::swapBytes(lengthArray.data(), m_dims[1]);
-    }
-    m_indexArray[0] = 0;
-    for (int64_t i = 0; i < m_dims[1]; ++i)
+    int64_t xml_offset;
+    if (m_version == 1)
     {
-        if (lengthArray[i] > m_dims[0] || lengthArray[i] < 0) throw DataFileException("impossible value found in length array");
-        m_indexArray[i + 1] = m_indexArray[i] + lengthArray[i];
+        m_indexArray.resize(m_dims[1] + 1);
+        vector<int64_t> lengthArray(m_dims[1]);
+        if (fread(lengthArray.data(), sizeof(int64_t), m_dims[1], m_file) != (size_t)m_dims[1]) throw DataFileException("error reading from file");
+        if (ByteOrderEnum::isSystemBigEndian())
+        {
+            ByteSwapping::swapBytes(lengthArray.data(), m_dims[1]);
+        }
+        m_indexArray[0] = 0;
+        for (int64_t i = 0; i < m_dims[1]; ++i)
+        {
+            if (lengthArray[i] > m_dims[0] || lengthArray[i] < 0) throw DataFileException("impossible value found in length array");
+            m_indexArray[i + 1] = m_indexArray[i] + lengthArray[i];
+        }
+        m_valuesOffset = 8 + 2 * sizeof(int64_t) + m_dims[1] * sizeof(int64_t);
+        xml_offset = m_valuesOffset + m_indexArray[m_dims[1]] * 2 * sizeof(int64_t);
+    } else {
+        int64_t columnIndexOffset;
+        if (fread(&columnIndexOffset, sizeof(int64_t), 1, m_file) != 1) throw DataFileException("error reading from file");
+        if (ByteOrderEnum::isSystemBigEndian())
+        {
+            ByteSwapping::swapBytes(&columnIndexOffset, 1);
+        }
+        m_indexArray.resize(m_dims[1] + 1);
+        if (fread(m_indexArray.data(), sizeof(uint64_t), m_dims[1] + 1, m_file) != (size_t)(m_dims[1] + 1)) throw DataFileException("error reading from file");
+        if (ByteOrderEnum::isSystemBigEndian())
+        {
+            ByteSwapping::swapBytes(m_indexArray.data(), m_dims[1] + 1);
+        }
+        m_valuesOffset = ROW_OFFSETS_START + (m_dims[1] + 1) * sizeof(uint64_t);
+        if (m_indexArray[0] != (uint64_t)m_valuesOffset) throw DataFileException("impossible value found in row offsets");
+        for (int64_t i = 0; i < m_dims[1]; ++i)
+        {
+            if (m_indexArray[i + 1] <= m_indexArray[i]) throw DataFileException("impossible value found in row offsets");//every row has at least the count
+        }
+        xml_offset = m_indexArray[m_dims[1]];
+        if (columnIndexOffset != 0)
+        {
+            if (columnIndexOffset != xml_offset) throw DataFileException("impossible column index offset found in file");
+            if (MYSEEK(m_file, columnIndexOffset, SEEK_SET) != 0) throw DataFileException("error seeking to column index");
+            m_columnIndexArray.resize(m_dims[0] + 1);
+            if (fread(m_columnIndexArray.data(), sizeof(uint64_t), m_dims[0] + 1, m_file) != (size_t)(m_dims[0] + 1)) throw DataFileException("error reading from file");
+            if (ByteOrderEnum::isSystemBigEndian())
+            {
+                ByteSwapping::swapBytes(m_columnIndexArray.data(), m_dims[0] + 1);
+            }
+            if (m_columnIndexArray[0] != (uint64_t)(columnIndexOffset + (m_dims[0] + 1) * sizeof(uint64_t))) throw DataFileException("impossible value found in column offsets");
+            for (int64_t i = 0; i < m_dims[0]; ++i)
+            {
+                if (m_columnIndexArray[i + 1] <= m_columnIndexArray[i]) throw DataFileException("impossible value found in column offsets");
+            }
+            xml_offset = m_columnIndexArray[m_dims[0]];
+        }
     }
-    m_valuesOffset = 8 + 2 * sizeof(int64_t) + m_dims[1] * sizeof(int64_t);
-    int64_t xml_offset = m_valuesOffset + m_indexArray[m_dims[1]] * 2 * sizeof(int64_t);
     if (xml_offset >= fileInfo.size()) throw DataFileException("file is truncated");
     int64_t xml_length = fileInfo.size() - xml_offset;
     if (xml_length < 1) throw DataFileException("file is truncated");
@@ -108,37 +233,51 @@ void CaretSparseFile::readFile(const AString& filename)
     {
         throw DataFileException("cifti XML doesn't match dimensions of sparse file");
     }
+    CaretPointer<QFile> mapFile(new QFile());
+    mapFile->setFileName(filename);
+    if (mapFile->open(QIODevice::ReadOnly))
+    {
+        uchar* mapped = mapFile->map(0, xml_offset);
+        if (mapped != NULL)//on 32 bit, a large file may not fit in the address space, so keep reading with seeks
+        {
+            m_mapFile = mapFile;
+            m_mapped = mapped;
+            fclose(m_file);
+            m_file = NULL;
+        }
+    }
 }
 
 CaretSparseFile::~CaretSparseFile()
 {
-    if (m_file != NULL) fclose(m_file);
+    close();
+}
+
+const unsigned char* CaretSparseFile::getBytes(const int64_t& offset, const int64_t& length, vector<unsigned char>& scratch)
+{
+    if (m_mapped != NULL) return m_mapped + offset;
+    scratch.resize(length);
+    if (length == 0) return scratch.data();
+    CaretMutexLocker locked(&m_fileMutex);
+    if (MYSEEK(m_file, offset, SEEK_SET) != 0) throw DataFileException("failed to seek in file");
+    if (fread(scratch.data(), 1, length, m_file) != (size_t)length) throw DataFileException("error reading from file");
+    return scratch.data();
 }
 
 void CaretSparseFile::getRow(const int64_t& index, int64_t* rowOut)
 {
-    CaretAssert(index >= 0 && index < m_dims[1]);
-    int64_t start = m_indexArray[index], end = m_indexArray[index + 1];
-    int64_t numToRead = (end - start) * 2;
-    m_scratchArray.resize(numToRead);
-    if (MYSEEK(m_file, m_valuesOffset + start * sizeof(int64_t) * 2, SEEK_SET) != 0) throw DataFileException("failed to seek in file");
-    if (fread(m_scratchArray.data(), sizeof(int64_t), numToRead, m_file) != (size_t)numToRead) throw DataFileException("error reading from file");
-    if (ByteOrderEnum::isSystemBigEndian())
-    {
-        ByteSwapping::swapBytes(m_scratchArray.data(), numToRead);
-    }
-    int64_t curIndex = 0;
-    for (int64_t i = 0; i < numToRead; i += 2)
+    vector<int64_t> indices, values;
+    getRowSparse(index, indices, values);
+    int64_t curIndex = 0, numNonzero = (int64_t)indices.size();
+    for (int64_t i = 0; i < numNonzero; ++i)
     {
-        int64_t index = m_scratchArray[i];
-        if (index < curIndex || index >= m_dims[0]) throw DataFileException("impossible index value found in file");
-        while (curIndex < index)
+        while (curIndex < indices[i])
         {
             rowOut[curIndex] = 0;
             ++curIndex;
         }
+        rowOut[curIndex] = values[i];
         ++curIndex;
-        rowOut[index] = m_scratchArray[i + 1];
     }
     while (curIndex < m_dims[0])
     {
@@ -151,49 +290,79 @@ void CaretSparseFile::getRowSparse(const int64_t& index, vector<int64_t>& indice
 {
     CaretAssert(index >= 0 && index < m_dims[1]);
     int64_t start = m_indexArray[index], end = m_indexArray[index + 1];
+    vector<unsigned char> scratch;
+    if (m_version == 2)
+    {
+        decodeEntries(getBytes(start, end - start, scratch), end - start, m_dims[0], indicesOut, valuesOut);
+        return;
+    }
     int64_t numToRead = (end - start) * 2, numNonzero = end - start;
-    m_scratchArray.resize(numToRead);
-    if (MYSEEK(m_file, m_valuesOffset + start * sizeof(int64_t) * 2, SEEK_SET) != 0) throw DataFileException("failed to seek in file");
-    if (fread(m_scratchArray.data(), sizeof(int64_t), numToRead, m_file) != (size_t)numToRead) throw DataFileException("error reading from file");
+    vector<int64_t> scratchArray(numToRead);
+    if (numToRead > 0)
+    {
+        memcpy(scratchArray.data(), getBytes(m_valuesOffset + start * sizeof(int64_t) * 2, numToRead * sizeof(int64_t), scratch), numToRead * sizeof(int64_t));
+    }
     if (ByteOrderEnum::isSystemBigEndian())
     {
-        ByteSwapping::swapBytes(m_scratchArray.data(), numToRead);
+        ByteSwapping::swapBytes(scratchArray.data(), numToRead);
     }
     indicesOut.resize(numNonzero);
     valuesOut.resize(numNonzero);
     int64_t lastIndex = -1;
     for (int64_t i = 0; i < numNonzero; ++i)
     {
-        indicesOut[i] = m_scratchArray[i * 2];
-        valuesOut[i] = m_scratchArray[i * 2 + 1];
+        indicesOut[i] = scratchArray[i * 2];
+        valuesOut[i] = scratchArray[i * 2 + 1];
         if (indicesOut[i] <= lastIndex || indicesOut[i] >= m_dims[0]) throw DataFileException("impossible index value found in file");
         lastIndex = indicesOut[i];
     }
 }
 
+void CaretSparseFile::getColumnSparse(const int64_t& index, vector<int64_t>& indicesOut, vector<int64_t>& valuesOut)
+{
+    CaretAssert(index >= 0 && index < m_dims[0]);
+    if (!hasColumnIndex()) throw DataFileException("sparse file does not contain a column index");
+    int64_t start = m_columnIndexArray[index], end = m_columnIndexArray[index + 1];
+    vector<unsigned char> scratch;
+    decodeEntries(getBytes(start, end - start, scratch), end - start, m_dims[1], indicesOut, valuesOut);
+}
+
 void CaretSparseFile::getFibersRow(const int64_t& index, FiberFractions* rowOut)
 {
-    if (m_scratchRow.size() != (size_t)m_dims[0]) m_scratchRow.resize(m_dims[0]);
-    getRow(index, (int64_t*)m_scratchRow.data());
+    vector<int64_t> scratchRow(m_dims[0]);
+    getRow(index, scratchRow.data());
     for (int64_t i = 0; i < m_dims[0]; ++i)
     {
-        if (m_scratchRow[i] == 0)
+        if (scratchRow[i] == 0)
         {
             rowOut[i].zero();
         } else {
-             decodeFibers(m_scratchRow[i], rowOut[i]);
+             decodeFibers(scratchRow[i], rowOut[i]);
         }
     }
 }
 
 void CaretSparseFile::getFibersRowSparse(const int64_t& index, vector<int64_t>& indicesOut, vector<FiberFractions>& valuesOut)
 {
-    getRowSparse(index, indicesOut, m_scratchSparseRow);
-    size_t numNonzero = m_scratchSparseRow.size();
+    vector<int64_t> scratchSparseRow;
+    getRowSparse(index, indicesOut, scratchSparseRow);
+    size_t numNonzero = scratchSparseRow.size();
+    valuesOut.resize(numNonzero);
+    for (size_t i = 0; i < numNonzero; ++i)
+    {
+        decodeFibers(((uint64_t*)scratchSparseRow.data())[i], valuesOut[i]);
+    }
+}
+
+void CaretSparseFile::getFibersColumnSparse(const int64_t& index, vector<int64_t>& indicesOut, vector<FiberFractions>& valuesOut)
+{
+    vector<int64_t> scratchSparseColumn;
+    getColumnSparse(index, indicesOut, scratchSparseColumn);
+    size_t numNonzero = scratchSparseColumn.size();
     valuesOut.resize(numNonzero);
     for (size_t i = 0; i < numNonzero; ++i)
     {
-        decodeFibers(((uint64_t*)m_scratchSparseRow.data())[i], valuesOut[i]);
+        decodeFibers(((uint64_t*)scratchSparseColumn.data())[i], valuesOut[i]);
     }
 }
 
@@ -221,58 +390,64 @@ void FiberFractions::zero()
     distance = 0.0f;
 }
 
-CaretSparseFileWriter::CaretSparseFileWriter(const AString& fileName, const CiftiXMLOld& xml)
+CaretSparseFileWriter::CaretSparseFileWriter(const AString& fileName, const CiftiXMLOld& xml, const Format& format, const bool& writeColumnIndex)
 {
     m_file = NULL;
     m_finished = false;
+    m_version = format;
+    m_writeColumnIndex = writeColumnIndex;
+    if (m_writeColumnIndex && m_version != FORMAT_VERSION_2) throw DataFileException("a column index can only be written in version 2 of the sparse format");
     int64_t dimensions[2] = { xml.getNumberOfColumns(), xml.getNumberOfRows() };
     if (dimensions[0] < 1 || dimensions[1] < 1) throw DataFileException("both dimensions must be positive");
     m_xml = xml;
     m_dims[0] = dimensions[0];//CiftiXML doesn't support 3 dimensions yet, so we do this
     m_dims[1] = dimensions[1];
-    m_file = fopen(fileName.toLocal8Bit().constData(), "wb");
+    m_file = fopen(fileName.toLocal8Bit().constData(), (m_writeColumnIndex ? "w+b" : "wb"));//the column index is made by reading back the rows
     if (m_file == NULL) throw DataFileException("error opening file for writing");
-    if (fwrite(magic, 1, 8, m_file) != 8) throw DataFileException("error writing to file");
-    int64_t tempdims[2] = { m_dims[0], m_dims[1] };
+    m_nextRowIndex = 0;
+    if (m_version == FORMAT_VERSION_1)
+    {
+        if (fwrite(magic, 1, 8, m_file) != 8) throw DataFileException("error writing to file");
+        int64_t tempdims[2] = { m_dims[0], m_dims[1] };
+        if (ByteOrderEnum::isSystemBigEndian())
+        {
+            ByteSwapping::swapBytes(tempdims, 2);
+        }
+        if (fwrite(tempdims, sizeof(int64_t), 2, m_file) != 2) throw DataFileException("error writing to file");
+        m_indexArray.resize(m_dims[1], 0);//initialize the memory so that valgrind won't complain
+        if (fwrite(m_indexArray.data(), sizeof(uint64_t), m_dims[1], m_file) != (size_t)m_dims[1]) throw DataFileException("error writing to file");//write it to get the file to the correct length
+        m_curOffset = 8 + 2 * sizeof(int64_t) + m_dims[1] * sizeof(int64_t);
+        return;
+    }
+    if (fwrite(magic2, 1, 8, m_file) != 8) throw DataFileException("error writing to file");
+    int64_t tempdims[3] = { m_dims[0], m_dims[1], 0 };//the column index offset is written in finish()
     if (ByteOrderEnum::isSystemBigEndian())
     {
-        ByteSwapping::swapBytes(tempdims, 2);
+        ByteSwapping::swapBytes(tempdims, 3);
     }
-    if (fwrite(tempdims, sizeof(int64_t), 2, m_file) != 2) throw DataFileException("error writing to file");
-    m_lengthArray.resize(m_dims[1], 0);//initialize the memory so that valgrind won't complain
-    if (fwrite(m_lengthArray.data(), sizeof(uint64_t), m_dims[1], m_file) != (size_t)m_dims[1]) throw DataFileException("error writing to file");//write it to get the file to the correct length
-    m_nextRowIndex = 0;
-    m_valuesOffset = 8 + 2 * sizeof(int64_t) + m_dims[1] * sizeof(int64_t);
+    if (fwrite(tempdims, sizeof(int64_t), 3, m_file) != 3) throw DataFileException("error writing to file");
+    m_indexArray.resize(m_dims[1] + 1, 0);//initialize the memory so that valgrind won't complain
+    if (fwrite(m_indexArray.data(), sizeof(uint64_t), m_dims[1] + 1, m_file) != (size_t)(m_dims[1] + 1)) throw DataFileException("error writing to file");//write it to get the file to the correct length
+    if (m_writeColumnIndex)
+    {
+        m_columnCounts.resize(m_dims[0], 0);
+    }
+    m_curOffset = ROW_OFFSETS_START + (m_dims[1] + 1) * sizeof(uint64_t);
 }
 
 void CaretSparseFileWriter::writeRow(const int64_t& index, const int64_t* row)
 {
-    CaretAssert(index < m_dims[1]);
-    CaretAssert(index >= m_nextRowIndex);
-    while (m_nextRowIndex < index)
-    {
-        m_lengthArray[m_nextRowIndex] = 0;
-        ++m_nextRowIndex;
-    }
-    m_scratchArray.clear();
-    int64_t count = 0;
+    m_scratchIndices.clear();
+    m_scratchValues.clear();
     for (int64_t i = 0; i < m_dims[0]; ++i)
     {
         if (row[i] != 0)
         {
-            m_scratchArray.push_back(i);
-            m_scratchArray.push_back(row[i]);
-            ++count;
+            m_scratchIndices.push_back(i);
+            m_scratchValues.push_back(row[i]);
         }
     }
-    m_lengthArray[index] = count;
-    if (ByteOrderEnum::isSystemBigEndian())
-    {
-        ByteSwapping::swapBytes(m_scratchArray.data(), m_scratchArray.size());
-    }
-    if (fwrite(m_scratchArray.data(), sizeof(int64_t), m_scratchArray.size(), m_file) != m_scratchArray.size()) throw DataFileException("error writing to file");
-    m_nextRowIndex = index + 1;
-    if (m_nextRowIndex == m_dims[1]) finish();
+    writeRowSparse(index, m_scratchIndices, m_scratchValues);
 }
 
 void CaretSparseFileWriter::writeRowSparse(const int64_t& index, const vector<int64_t>& indices, const vector<int64_t>& values)
@@ -280,27 +455,48 @@ void CaretSparseFileWriter::writeRowSparse(const int64_t& index, const vector<in
     CaretAssert(index < m_dims[1]);
     CaretAssert(index >= m_nextRowIndex);
     CaretAssert(indices.size() == values.size());
-    while (m_nextRowIndex < index)
-    {
-        m_lengthArray[m_nextRowIndex] = 0;
-        ++m_nextRowIndex;
-    }
-    m_scratchArray.clear();
-    size_t numNonzero = indices.size();//assume no zeros
-    m_lengthArray[index] = numNonzero;
+    int64_t numNonzero = (int64_t)indices.size();//assume no zeros
     int64_t lastIndex = -1;
-    for (size_t i = 0; i < numNonzero; ++i)
+    for (int64_t i = 0; i < numNonzero; ++i)
     {
         if (indices[i] <= lastIndex || indices[i] >= m_dims[0]) throw DataFileException("indices must be sorted when writing sparse rows");
         lastIndex = indices[i];
-        m_scratchArray.push_back(indices[i]);
-        m_scratchArray.push_back(values[i]);
+        if (m_writeColumnIndex) ++m_columnCounts[indices[i]];
     }
-    if (ByteOrderEnum::isSystemBigEndian())
+    if (m_version == FORMAT_VERSION_1)
     {
-        ByteSwapping::swapBytes(m_scratchArray.data(), m_scratchArray.size());
+        while (m_nextRowIndex < index)
+        {
+            m_indexArray[m_nextRowIndex] = 0;
+            ++m_nextRowIndex;
+        }
+        m_scratchPairs.resize(numNonzero * 2);
+        for (int64_t i = 0; i < numNonzero; ++i)
+        {
+            m_scratchPairs[i * 2] = indices[i];
+            m_scratchPairs[i * 2 + 1] = values[i];
+        }
+        if (ByteOrderEnum::isSystemBigEndian())
+        {
+            ByteSwapping::swapBytes(m_scratchPairs.data(), m_scratchPairs.size());
+        }
+        if (fwrite(m_scratchPairs.data(), sizeof(int64_t), m_scratchPairs.size(), m_file) != m_scratchPairs.size()) throw DataFileException("error writing to file");
+        m_indexArray[index] = numNonzero;
+    } else {
+        vector<unsigned char> emptyRow;
+        encodeEntries(NULL, NULL, 0, emptyRow);
+        while (m_nextRowIndex < index)//empty rows still get a count, so that offsets are strictly increasing
+        {
+            m_indexArray[m_nextRowIndex] = m_curOffset;
+            if (fwrite(emptyRow.data(), 1, emptyRow.size(), m_file) != emptyRow.size()) throw DataFileException("error writing to file");
+            m_curOffset += emptyRow.size();
+            ++m_nextRowIndex;
+        }
+        encodeEntries(indices.data(), values.data(), numNonzero, m_scratchBytes);
+        m_indexArray[index] = m_curOffset;
+        if (fwrite(m_scratchBytes.data(), 1, m_scratchBytes.size(), m_file) != m_scratchBytes.size()) throw DataFileException("error writing to file");
+        m_curOffset += m_scratchBytes.size();
     }
-    if (fwrite(m_scratchArray.data(), sizeof(int64_t), m_scratchArray.size(), m_file) != m_scratchArray.size()) throw DataFileException("error writing to file");
     m_nextRowIndex = index + 1;
     if (m_nextRowIndex == m_dims[1]) finish();
 }
@@ -331,14 +527,100 @@ void CaretSparseFileWriter::writeFibersRowSparse(const int64_t& index, const vec
     writeRowSparse(index, indices, m_scratchSparseRow);
 }
 
+void CaretSparseFileWriter::writeColumnIndex()
+{//transpose by rereading the rows, once per range of columns that fits in the memory limit
+    const int64_t columnIndexOffset = m_curOffset;
+    vector<uint64_t> columnOffsets(m_dims[0] + 1, 0);
+    if (fwrite(columnOffsets.data(), sizeof(uint64_t), m_dims[0] + 1, m_file) != (size_t)(m_dims[0] + 1)) throw DataFileException("error writing to file");
+    m_curOffset += (m_dims[0] + 1) * sizeof(uint64_t);
+    vector<int64_t> chunkRows, chunkValues, columnStart, columnFill, rowIndices, rowValues;
+    vector<unsigned char> rowBytes;
+    int64_t colStart = 0;
+    while (colStart < m_dims[0])
+    {
+        int64_t colEnd = colStart, chunkEntries = 0;
+        while (colEnd < m_dims[0] && (colEnd == colStart || chunkEntries + m_columnCounts[colEnd] <= COLUMN_CHUNK_ENTRIES))
+        {
+            chunkEntries += m_columnCounts[colEnd];
+            ++colEnd;
+        }
+        columnStart.resize(colEnd - colStart + 1);
+        columnStart[0] = 0;
+        for (int64_t i = colStart; i < colEnd; ++i)
+        {
+            columnStart[i - colStart + 1] = columnStart[i - colStart] + m_columnCounts[i];
+        }
+        columnFill = columnStart;
+        chunkRows.resize(chunkEntries);
+        chunkValues.resize(chunkEntries);
+        if (MYSEEK(m_file, m_indexArray[0], SEEK_SET) != 0) throw DataFileException("error seeking in file");
+        for (int64_t row = 0; row < m_dims[1]; ++row)//rows are contiguous, so read them in order without seeking
+        {
+            int64_t length = m_indexArray[row + 1] - m_indexArray[row];
+            rowBytes.resize(length);
+            if (fread(rowBytes.data(), 1, length, m_file) != (size_t)length) throw DataFileException("error reading back rows from file");
+            decodeEntries(rowBytes.data(), length, m_dims[0], rowIndices, rowValues);
+            int64_t numNonzero = (int64_t)rowIndices.size();
+            for (int64_t i = 0; i < numNonzero; ++i)
+            {
+                if (rowIndices[i] >= colStart && rowIndices[i] < colEnd)
+                {
+                    int64_t& fillPos = columnFill[rowIndices[i] - colStart];
+                    chunkRows[fillPos] = row;//rows are visited in order, so each column comes out sorted
+                    chunkValues[fillPos] = rowValues[i];
+                    ++fillPos;
+                }
+            }
+        }
+        if (MYSEEK(m_file, m_curOffset, SEEK_SET) != 0) throw DataFileException("error seeking in file");
+        for (int64_t i = colStart; i < colEnd; ++i)
+        {
+            int64_t start = columnStart[i - colStart];
+            encodeEntries(chunkRows.data() + start, chunkValues.data() + start, m_columnCounts[i], m_scratchBytes);
+            columnOffsets[i] = m_curOffset;
+            if (fwrite(m_scratchBytes.data(), 1, m_scratchBytes.size(), m_file) != m_scratchBytes.size()) throw DataFileException("error writing to file");
+            m_curOffset += m_scratchBytes.size();
+        }
+        colStart = colEnd;
+    }
+    columnOffsets[m_dims[0]] = m_curOffset;
+    if (MYSEEK(m_file, columnIndexOffset, SEEK_SET) != 0) throw DataFileException("error seeking in file");
+    if (ByteOrderEnum::isSystemBigEndian())
+    {
+        ByteSwapping::swapBytes(columnOffsets.data(), columnOffsets.size());
+    }
+    if (fwrite(columnOffsets.data(), sizeof(uint64_t), columnOffsets.size(), m_file) != columnOffsets.size()) throw DataFileException("error writing to file");
+    if (MYSEEK(m_file, m_curOffset, SEEK_SET) != 0) throw DataFileException("error seeking in file");
+}
+
 void CaretSparseFileWriter::finish()
 {
     if (m_finished) return;
     m_finished = true;
-    while (m_nextRowIndex < m_dims[1])
+    int64_t columnIndexOffset = 0;
+    if (m_version == FORMAT_VERSION_1)
     {
-        m_lengthArray[m_nextRowIndex] = 0;
-        ++m_nextRowIndex;
+        while (m_nextRowIndex < m_dims[1])
+        {
+            m_indexArray[m_nextRowIndex] = 0;
+            ++m_nextRowIndex;
+        }
+    } else {
+        vector<unsigned char> emptyRow;
+        encodeEntries(NULL, NULL, 0, emptyRow);
+        while (m_nextRowIndex < m_dims[1])
+        {
+            m_indexArray[m_nextRowIndex] = m_curOffset;
+            if (fwrite(emptyRow.data(), 1, emptyRow.size(), m_file) != emptyRow.size()) throw DataFileException("error writing to file");
+            m_curOffset += emptyRow.size();
+            ++m_nextRowIndex;
+        }
+        m_indexArray[m_dims[1]] = m_curOffset;
+        if (m_writeColumnIndex)
+        {
+            columnIndexOffset = m_curOffset;
+            writeColumnIndex();
+        }
     }
     QByteArray myXMLBytes;
     m_xml.writeXML(myXMLBytes);
@@ -346,9 +628,14 @@ void CaretSparseFileWriter::finish()
     if (MYSEEK(m_file, 8 + 2 * sizeof(int64_t), SEEK_SET) != 0) throw DataFileException("error seeking in file");
     if (ByteOrderEnum::isSystemBigEndian())
     {
-        ByteSwapping::swapBytes(m_lengthArray.data(), m_lengthArray.size());
+        ByteSwapping::swapBytes(&columnIndexOffset, 1);
+        ByteSwapping::swapBytes(m_indexArray.data(), m_indexArray.size());
     }
-    if (fwrite(m_lengthArray.data(), sizeof(uint64_t), m_lengthArray.size(), m_file) != m_lengthArray.size()) throw DataFileException("error writing to file");
+    if (m_version == FORMAT_VERSION_2)
+    {
+        if (fwrite(&columnIndexOffset, sizeof(int64_t), 1, m_file) != 1) throw DataFileException("error writing to file");
+    }
+    if (fwrite(m_indexArray.data(), sizeof(uint64_t), m_indexArray.size(), m_file) != m_indexArray.size()) throw DataFileException("error writing to file");
     int ret = fclose(m_file);
     m_file = NULL;
     if (ret != 0) throw DataFileException("error closing file");
@@ -371,3 +658,170 @@ uint32_t CaretSparseFileWriter::myclamp(const int& x)
     if (x <= 0) return 0;
     return x;
 }
+
+CaretSparseFileUnorderedWriter::CaretSparseFileUnorderedWriter(const AString& fileName, const CiftiXMLOld& xml, const CaretSparseFileWriter::Format& format, const bool& writeColumnIndex) :
+    m_writer(fileName, xml, format, writeColumnIndex)
+{
+    m_fileName = fileName;
+    m_finished = false;
+    m_dims[0] = xml.getNumberOfColumns();
+    m_dims[1] = xml.getNumberOfRows();
+    m_rowWritten.resize(m_dims[1], false);
+}
+
+void CaretSparseFileUnorderedWriter::writeRow(const int64_t& index, const int64_t* row)
+{
+    vector<int64_t> indices, values;
+    for (int64_t i = 0; i < m_dims[0]; ++i)
+    {
+        if (row[i] != 0)
+        {
+            indices.push_back(i);
+            values.push_back(row[i]);
+        }
+    }
+    writeRowSparse(index, indices, values);
+}
+
+void CaretSparseFileUnorderedWriter::writeRowSparse(const int64_t& index, const vector<int64_t>& indices, const vector<int64_t>& values)
+{
+    CaretAssert(index >= 0 && index < m_dims[1]);
+    CaretAssert(indices.size() == values.size());
+    int64_t numNonzero = (int64_t)indices.size();//assume no zeros
+    int64_t lastIndex = -1;
+    for (int64_t i = 0; i < numNonzero; ++i)
+    {
+        if (indices[i] <= lastIndex || indices[i] >= m_dims[0]) throw DataFileException("indices must be sorted when writing sparse rows");
+        lastIndex = indices[i];
+    }
+    vector<unsigned char> bytes;//encode before locking, so threads only wait on the copy
+    encodeEntries(indices.data(), values.data(), numNonzero, bytes);
+    addEncodedRow(index, bytes);
+}
+
+void CaretSparseFileUnorderedWriter::writeFibersRow(const int64_t& index, const FiberFractions* row)
+{
+    vector<int64_t> indices;
+    vector<FiberFractions> values;
+    for (int64_t i = 0; i < m_dims[0]; ++i)
+    {
+        if (row[i].totalCount != 0)
+        {
+            indices.push_back(i);
+            values.push_back(row[i]);
+        }
+    }
+    writeFibersRowSparse(index, indices, values);
+}
+
+void CaretSparseFileUnorderedWriter::writeFibersRowSparse(const int64_t& index, const vector<int64_t>& indices, const vector<FiberFractions>& values)
+{
+    size_t numNonzero = values.size();//assume no zeros
+    vector<int64_t> coded(numNonzero);
+    for (size_t i = 0; i < numNonzero; ++i)
+    {
+        CaretSparseFileWriter::encodeFibers(values[i], ((uint64_t*)coded.data())[i]);
+    }
+    writeRowSparse(index, indices, coded);
+}
+
+void CaretSparseFileUnorderedWriter::addEncodedRow(const int64_t& index, const vector<unsigned char>& bytes)
+{
+    CaretMutexLocker locked(&m_mutex);
+    if (m_finished) throw DataFileException("cannot write rows after finish()");
+    if (m_rowWritten[index]) throw DataFileException("row " + AString::number(index) + " was written more than once");
+    m_rowWritten[index] = true;
+    PendingRow myRow;
+    myRow.m_row = index;
+    myRow.m_start = (int64_t)m_pendingBytes.size();
+    myRow.m_length = (int64_t)bytes.size();
+    m_pendingRows.push_back(myRow);
+    m_pendingBytes.insert(m_pendingBytes.end(), bytes.begin(), bytes.end());
+    if ((int64_t)m_pendingBytes.size() >= SPILL_BYTES) spillRun();
+}
+
+void CaretSparseFileUnorderedWriter::spillRun()
+{//called with the mutex locked
+    sort(m_pendingRows.begin(), m_pendingRows.end());
+    CaretPointer<QTemporaryFile> runFile(new QTemporaryFile(m_fileName + ".run.XXXXXX"));//next to the output, which has room for the data anyway
+    if (!runFile->open()) throw DataFileException("failed to create temporary file for sparse rows near '" + m_fileName + "'");
+    for (size_t i = 0; i < m_pendingRows.size(); ++i)
+    {
+        const PendingRow& myRow = m_pendingRows[i];
+        int64_t header[2] = { myRow.m_row, myRow.m_length };//temporary, so native byte order is fine
+        if (runFile->write((const char*)header, sizeof(header)) != sizeof(header) ||
+            runFile->write((const char*)(m_pendingBytes.data() + myRow.m_start), myRow.m_length) != myRow.m_length)
+        {
+            throw DataFileException("failed to write sparse rows to temporary file '" + runFile->fileName() + "'");
+        }
+    }
+    if (!runFile->flush()) throw DataFileException("failed to write sparse rows to temporary file '" + runFile->fileName() + "'");
+    m_runFiles.push_back(runFile);
+    m_pendingRows.clear();
+    m_pendingBytes.clear();
+}
+
+static bool readRunRecord(QFile* runFile, int64_t& rowOut, vector<unsigned char>& bytesOut)
+{
+    int64_t header[2];
+    qint64 numRead = runFile->read((char*)header, sizeof(header));
+    if (numRead == 0) return false;
+    if (numRead != sizeof(header)) throw DataFileException("failed to read sparse rows from temporary file '" + runFile->fileName() + "'");
+    rowOut = header[0];
+    bytesOut.resize(header[1]);
+    if (runFile->read((char*)bytesOut.data(), header[1]) != header[1]) throw DataFileException("failed to read sparse rows from temporary file '" + runFile->fileName() + "'");
+    return true;
+}
+
+void CaretSparseFileUnorderedWriter::finish()
+{
+    CaretMutexLocker locked(&m_mutex);
+    if (m_finished) return;
+    m_finished = true;
+    sort(m_pendingRows.begin(), m_pendingRows.end());//the rows still in memory are the last run
+    int numRuns = (int)m_runFiles.size();
+    vector<vector<unsigned char> > runBytes(numRuns);
+    vector<int64_t> runPosition(numRuns + 1, 0);//the memory run uses its position in m_pendingRows
+    CaretSimpleMinHeap<int, int64_t> myHeap;//merge by row, data is which run
+    for (int i = 0; i < numRuns; ++i)
+    {
+        if (!m_runFiles[i]->seek(0)) throw DataFileException("failed to seek in temporary file '" + m_runFiles[i]->fileName() + "'");
+        int64_t row;
+        if (readRunRecord(m_runFiles[i], row, runBytes[i])) myHeap.push(i, row);
+    }
+    if (!m_pendingRows.empty()) myHeap.push(numRuns, m_pendingRows[0].m_row);
+    vector<int64_t> indices, values;
+    while (!myHeap.isEmpty())
+    {
+        int64_t row;
+        int whichRun = myHeap.pop(&row);
+        if (whichRun == numRuns)
+        {
+            const PendingRow& myRow = m_pendingRows[runPosition[numRuns]];
+            decodeEntries(m_pendingBytes.data() + myRow.m_start, myRow.m_length, m_dims[0], indices, values);
+            ++runPosition[numRuns];
+            if (runPosition[numRuns] < (int64_t)m_pendingRows.size()) myHeap.push(numRuns, m_pendingRows[runPosition[numRuns]].m_row);
+        } else {
+            decodeEntries(runBytes[whichRun].data(), runBytes[whichRun].size(), m_dims[0], indices, values);
+            int64_t nextRow;
+            if (readRunRecord(m_runFiles[whichRun], nextRow, runBytes[whichRun])) myHeap.push(whichRun, nextRow);
+        }
+        m_writer.writeRowSparse(row, indices, values);
+    }
+    m_writer.finish();
+    m_runFiles.clear();//removes the temporary files
+    m_pendingRows.clear();
+    m_pendingBytes.clear();
+}
+
+CaretSparseFileUnorderedWriter::~CaretSparseFileUnorderedWriter()
+{
+    try
+    {//destructors must not throw, call finish() explicitly to get the error
+        finish();
+    } catch (CaretException& e) {
+        CaretLogWarning("failed to finish sparse file '" + m_fileName + "': " + e.whatString());
+    } catch (...) {
+        CaretLogWarning("failed to finish sparse file '" + m_fileName + "'");
+    }
+}
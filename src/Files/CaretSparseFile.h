@@ -25,9 +25,18 @@
 #include <vector>
 #include "stdint.h"
 #include "AString.h"
+#include "CaretMutex.h"
+#include "CaretPointer.h"
 #include "DataFile.h"
 #include "CiftiXMLOld.h"
 
+#include <QFile>
+#include <QTemporaryFile>
+
+//NOTE: version 1 of the format stores each row as raw index/value pairs after an array of row lengths, and is what the writer produces by default
+//      version 2 stores each row as a varint count, then varint deltas of the column indices, then varint values, with a byte offset index of the rows,
+//      and optionally the same encoding of every column for column access - the reader accepts both
+
 namespace caret {
     
     struct FiberFractions
@@ -41,12 +50,18 @@ namespace caret {
     class CaretSparseFile /* : public DataFile */
     {
         static void decodeFibers(const uint64_t& coded, FiberFractions& decoded);//takes a uint because right shift on signed is implementation dependent
-        FILE* m_file;
+        FILE* m_file;//only used for reading when the file couldn't be memory mapped
+        CaretMutex m_fileMutex;//protects m_file
+        CaretPointer<QFile> m_mapFile;//keeps the mapping alive
+        const unsigned char* m_mapped;//start of the file, NULL if not mapped
+        int m_version;
         int64_t m_dims[2], m_valuesOffset;
-        std::vector<uint64_t> m_indexArray, m_scratchRow;
-        std::vector<int64_t> m_scratchArray, m_scratchSparseRow;
+        std::vector<uint64_t> m_indexArray;//version 1: the first entry of each row, version 2: the byte offset of each row
+        std::vector<uint64_t> m_columnIndexArray;//version 2 only: the byte offset of each column, empty if the file has no column index
         CaretSparseFile(const CaretSparseFile& rhs);
         CiftiXMLOld m_xml;
+        void close();
+        const unsigned char* getBytes(const int64_t& offset, const int64_t& length, std::vector<unsigned char>& scratch);
     public:
         const int64_t* getDimensions() { return m_dims; }
 
@@ -61,6 +76,13 @@ namespace caret {
         ///get a reference to the XML data
         const CiftiXMLOld& getCiftiXML() const { return m_xml; }
         
+        ///the file format version, 1 for uncompressed, 2 for compressed
+        int getVersion() const { return m_version; }
+        
+        ///whether the file contains a column index, so that getColumnSparse can be used
+        bool hasColumnIndex() const { return !m_columnIndexArray.empty(); }
+        
+        //NOTE: reading functions may be called from multiple threads at once
         void getRow(const int64_t& index, int64_t* rowOut);
         
         void getRowSparse(const int64_t& index, std::vector<int64_t>& indicesOut, std::vector<int64_t>& valuesOut);
@@ -68,6 +90,12 @@ namespace caret {
         void getFibersRow(const int64_t& index, FiberFractions* rowOut);
         
         void getFibersRowSparse(const int64_t& index, std::vector<int64_t>& indicesOut, std::vector<FiberFractions>& valuesOut);
+        
+        ///requires a column index, indicesOut receives row indices
+        void getColumnSparse(const int64_t& index, std::vector<int64_t>& indicesOut, std::vector<int64_t>& valuesOut);
+        
+        ///requires a column index, indicesOut receives row indices
+        void getFibersColumnSparse(const int64_t& index, std::vector<int64_t>& indicesOut, std::vector<FiberFractions>& valuesOut);
 
         virtual ~CaretSparseFile();
     };
@@ -76,15 +104,30 @@ namespace caret {
     {
         static void encodeFibers(const FiberFractions& orig, uint64_t& coded);
         static uint32_t myclamp(const int& x);
+        enum
+        {
+            COLUMN_CHUNK_ENTRIES = 1<<24//limit on nonzeros held in memory at once while transposing for the column index
+        };
         FILE* m_file;
-        int64_t m_dims[2], m_valuesOffset, m_nextRowIndex;
-        bool m_finished;
-        std::vector<uint64_t> m_lengthArray, m_scratchRow;
-        std::vector<int64_t> m_scratchArray, m_scratchSparseRow;
+        int m_version;
+        int64_t m_dims[2], m_nextRowIndex, m_curOffset;
+        bool m_finished, m_writeColumnIndex;
+        std::vector<uint64_t> m_indexArray, m_scratchRow;//m_indexArray - version 1: the length of each row, version 2: the byte offset of each row
+        std::vector<int64_t> m_columnCounts, m_scratchIndices, m_scratchValues, m_scratchSparseRow, m_scratchPairs;
+        std::vector<unsigned char> m_scratchBytes;
         CaretSparseFileWriter(const CaretSparseFileWriter& rhs);
         CiftiXMLOld m_xml;
+        void writeColumnIndex();
+        friend class CaretSparseFileUnorderedWriter;//for encodeFibers
     public:
-        CaretSparseFileWriter(const AString& fileName, const CiftiXMLOld& xml);
+        enum Format
+        {
+            FORMAT_VERSION_1 = 1,//uncompressed, readable by older versions of workbench
+            FORMAT_VERSION_2 = 2//compressed, can also contain a column index
+        };
+        
+        ///a column index for column access can only be written in version 2
+        CaretSparseFileWriter(const AString& fileName, const CiftiXMLOld& xml, const Format& format = FORMAT_VERSION_1, const bool& writeColumnIndex = false);
         
         ~CaretSparseFileWriter();
         
@@ -104,6 +147,52 @@ namespace caret {
         void finish();
     };
     
+    ///accepts rows from multiple threads in any order, keeping sorted runs of encoded rows in temporary files until finish() merges them into the output
+    class CaretSparseFileUnorderedWriter
+    {
+        struct PendingRow
+        {
+            int64_t m_row, m_start, m_length;//start and length within m_pendingBytes
+            bool operator<(const PendingRow& rhs) const { return m_row < rhs.m_row; }
+        };
+        enum
+        {
+            SPILL_BYTES = 1<<28//encoded rows to hold in memory before writing them out as a sorted run
+        };
+        CaretSparseFileWriter m_writer;
+        AString m_fileName;
+        int64_t m_dims[2];
+        bool m_finished;
+        CaretMutex m_mutex;//protects everything below
+        std::vector<bool> m_rowWritten;
+        std::vector<PendingRow> m_pendingRows;
+        std::vector<unsigned char> m_pendingBytes;
+        std::vector<CaretPointer<QTemporaryFile> > m_runFiles;
+        CaretSparseFileUnorderedWriter(const CaretSparseFileUnorderedWriter& rhs);
+        void addEncodedRow(const int64_t& index, const std::vector<unsigned char>& bytes);
+        void spillRun();
+    public:
+        CaretSparseFileUnorderedWriter(const AString& fileName, const CiftiXMLOld& xml, const CaretSparseFileWriter::Format& format = CaretSparseFileWriter::FORMAT_VERSION_1,
+                                       const bool& writeColumnIndex = false);
+        
+        ~CaretSparseFileUnorderedWriter();
+        
+        ///may be called from multiple threads, in any row order, but each row may only be written once
+        void writeRow(const int64_t& index, const int64_t* row);
+        
+        ///may be called from multiple threads, in any row order, but each row may only be written once
+        void writeRowSparse(const int64_t& index, const std::vector<int64_t>& indices, const std::vector<int64_t>& values);
+        
+        ///may be called from multiple threads, in any row order, but each row may only be written once
+        void writeFibersRow(const int64_t& index, const FiberFractions* row);
+        
+        ///may be called from multiple threads, in any row order, but each row may only be written once
+        void writeFibersRowSparse(const int64_t& index, const std::vector<int64_t>& indices, const std::vector<FiberFractions>& values);
+        
+        ///merges the sorted runs into the output file, rows that were never written are empty
+        void finish();
+    };
+    
 }
 
 #endif //__CARET_SPARSE_FILE_H__
@@ -26,7 +26,9 @@
 #include "CaretAssert.h"
 #include "CiftiFacade.h"
 #include "CaretLogger.h"
+#include "CiftiFile.h"
 #include "CiftiInterface.h"
+#include "CiftiRowLoader.h"
 #include "ConnectivityDataLoaded.h"
 #include "EventManager.h"
 #include "EventProgressUpdate.h"
@@ -60,6 +62,8 @@ CiftiMappableConnectivityMatrixDataFile::CiftiMappableConnectivityMatrixDataFile
                         seriesDataAccess)
 {
     m_connectivityDataLoaded = new ConnectivityDataLoaded();
+    m_rowLoader = NULL;
+    m_rowLoaderInterface = NULL;
     
     clearPrivate();
 
@@ -76,6 +80,7 @@ CiftiMappableConnectivityMatrixDataFile::CiftiMappableConnectivityMatrixDataFile
  */
 CiftiMappableConnectivityMatrixDataFile::~CiftiMappableConnectivityMatrixDataFile()
 {
+    deleteRowLoader();
     clearPrivate();
     
     delete m_connectivityDataLoaded;
@@ -88,6 +93,11 @@ CiftiMappableConnectivityMatrixDataFile::~CiftiMappableConnectivityMatrixDataFil
 void
 CiftiMappableConnectivityMatrixDataFile::clear()
 {
+    /*
+     * The row loader's threads read from the CIFTI interface
+     * so the loader must go away before the interface does.
+     */
+    deleteRowLoader();
     CiftiMappableDataFile::clear();
     clearPrivate();
 }
@@ -104,6 +114,103 @@ CiftiMappableConnectivityMatrixDataFile::clearPrivate()
     m_rowLoadedText = "";
     m_dataLoadingEnabled = true;
     m_connectivityDataLoaded->reset();
+    m_backgroundRequestID = -1;
+    m_backgroundRowIndex = -1;
+    m_backgroundStructure = StructureEnum::INVALID;
+    m_backgroundSurfaceNumberOfNodes = -1;
+    m_backgroundNodeIndex = -1;
+}
+
+/**
+ * Delete the row loader, waiting for any rows its threads are reading.
+ */
+void
+CiftiMappableConnectivityMatrixDataFile::deleteRowLoader()
+{
+    if (m_rowLoader != NULL) {
+        delete m_rowLoader;
+        m_rowLoader = NULL;
+    }
+    m_rowLoaderInterface = NULL;
+    m_backgroundRequestID = -1;
+}
+
+/**
+ * @return The row loader for the file's CIFTI interface, created if needed.
+ * Returns NULL if the CIFTI interface is not valid.
+ */
+CiftiRowLoader*
+CiftiMappableConnectivityMatrixDataFile::getRowLoader()
+{
+    if (isCiftiInterfaceValid() == false) {
+        return NULL;
+    }
+    
+    const CiftiInterface* ciftiInterface = m_ciftiInterface;
+    if (m_rowLoaderInterface != ciftiInterface) {
+        deleteRowLoader();
+    }
+    
+    if (m_rowLoader == NULL) {
+        m_rowLoader = new CiftiRowLoader(ciftiInterface);
+        m_rowLoaderInterface = ciftiInterface;
+    }
+    
+    return m_rowLoader;
+}
+
+/**
+ * @return True if rows of this file are read by the row loader, which
+ * is done for dense CIFTI files whose data is on disk, since reading
+ * a row from those may take a long time.
+ */
+bool
+CiftiMappableConnectivityMatrixDataFile::isBackgroundLoadingSupported() const
+{
+    if (isCiftiInterfaceValid() == false) {
+        return false;
+    }
+    if (getDataFileType() != DataFileTypeEnum::CONNECTIVITY_DENSE) {
+        return false;
+    }
+    
+    const CiftiInterface* ciftiInterface = m_ciftiInterface;
+    const CiftiFile* ciftiFile = dynamic_cast<const CiftiFile*>(ciftiInterface);
+    if (ciftiFile == NULL) {
+        /*
+         * Other interfaces (xnat) read through the http manager,
+         * which must not be used from worker threads.
+         */
+        return false;
+    }
+    if (ciftiFile->isInMemory()) {
+        return false;
+    }
+    
+    return true;
+}
+
+/**
+ * Read a row, through the row loader's cache of recently read rows
+ * when background loading is supported.
+ *
+ * @param rowOut
+ *    Output containing the row's data.
+ * @param rowIndex
+ *    Index of the row.
+ */
+void
+CiftiMappableConnectivityMatrixDataFile::readRow(float* rowOut,
+                                                 const int64_t rowIndex)
+{
+    if (isBackgroundLoadingSupported()) {
+        getRowLoader()->getRow(rowOut,
+                               rowIndex);
+    }
+    else {
+        m_ciftiInterface->getRow(rowOut,
+                                 rowIndex);
+    }
 }
 
 /**
@@ -434,6 +541,11 @@ CiftiMappableConnectivityMatrixDataFile::getRowIndexForVoxelIndexWhenLoading(con
 void
 CiftiMappableConnectivityMatrixDataFile::setLoadedRowDataToAllZeros()
 {
+    /*
+     * Data being loaded now replaces any background load
+     */
+    cancelBackgroundLoading();
+    
     if (m_loadedRowData.empty() == false){
         std::fill(m_loadedRowData.begin(),
                   m_loadedRowData.end(),
@@ -475,8 +587,8 @@ CiftiMappableConnectivityMatrixDataFile::loadDataForRowIndex(const int64_t rowIn
             CaretAssert((rowIndex >= 0) && (rowIndex < m_ciftiInterface->getNumberOfRows()));
             m_loadedRowData.resize(dataCount);
             
-            m_ciftiInterface->getRow(&m_loadedRowData[0],
-                                     rowIndex);
+            readRow(&m_loadedRowData[0],
+                    rowIndex);
             
             CaretLogFine("Read row " + AString::number(rowIndex));
             m_connectivityDataLoaded->setRowLoading(rowIndex);
@@ -560,8 +672,8 @@ CiftiMappableConnectivityMatrixDataFile::loadMapDataForSurfaceNode(const int32_t
                                    + StructureEnum::toGuiName(structure));
                 CaretAssert((rowIndex >= 0) && (rowIndex < m_ciftiInterface->getNumberOfRows()));
                 m_loadedRowData.resize(dataCount);
-                m_ciftiInterface->getRow(&m_loadedRowData[0],
-                                         rowIndex);
+                readRow(&m_loadedRowData[0],
+                        rowIndex);
                 
                 CaretLogFine("Read row for node " + AString::number(nodeIndex));
                 
@@ -590,6 +702,170 @@ CiftiMappableConnectivityMatrixDataFile::loadMapDataForSurfaceNode(const int32_t
 }
 
 
+/**
+ * Start loading connectivity data for the surface's node on background
+ * threads.  The data currently displayed remains until the new row is
+ * installed by finishBackgroundLoading(), and a later load of this file
+ * supersedes this one.  If background loading is not supported for this
+ * file, the data is loaded immediately as with loadMapDataForSurfaceNode().
+ *
+ * @param mapIndex
+ *    Index of map.
+ * @param surfaceNumberOfNodes
+ *    Number of nodes in surface.
+ * @param structure
+ *    Surface's structure.
+ * @param nodeIndex
+ *    Index of node number.
+ * @return
+ *    Index of row that is loading or -1 if no data will be loaded.
+ * @throw
+ *    DataFileException if there is an error.
+ */
+int64_t
+CiftiMappableConnectivityMatrixDataFile::loadMapDataForSurfaceNodeInBackground(const int32_t mapIndex,
+                                                                               const int32_t surfaceNumberOfNodes,
+                                                                               const StructureEnum::Enum structure,
+                                                                               const int32_t nodeIndex) throw (DataFileException)
+{
+    if (isBackgroundLoadingSupported() == false) {
+        return loadMapDataForSurfaceNode(mapIndex,
+                                         surfaceNumberOfNodes,
+                                         structure,
+                                         nodeIndex);
+    }
+    
+    /*
+     * Loading of data disabled?
+     */
+    if (m_dataLoadingEnabled == false) {
+        return -1;
+    }
+    
+    const int64_t rowIndex = getRowIndexForNodeWhenLoading(structure,
+                                                           surfaceNumberOfNodes,
+                                                           nodeIndex);
+    if ((rowIndex < 0)
+        || (m_ciftiInterface->getNumberOfColumns() <= 0)) {
+        CaretLogFine("FAILED to read row for node " + AString::number(nodeIndex));
+        setLoadedRowDataToAllZeros();
+        CaretAssertVectorIndex(m_mapContent, 0);
+        m_mapContent[0]->invalidateColoring();
+        return -1;
+    }
+    
+    try {
+        std::vector<int64_t> rowIndices(1, rowIndex);
+        m_backgroundRequestID = getRowLoader()->startRequest(rowIndices);
+    }
+    catch (CiftiFileException& e) {
+        m_backgroundRequestID = -1;
+        throw DataFileException(e.whatString());
+    }
+    m_backgroundRowIndex = rowIndex;
+    m_backgroundStructure = structure;
+    m_backgroundSurfaceNumberOfNodes = surfaceNumberOfNodes;
+    m_backgroundNodeIndex = nodeIndex;
+    
+    /*
+     * Row may have been in the loader's cache
+     */
+    finishBackgroundLoading();
+    
+    return rowIndex;
+}
+
+/**
+ * @return True if a background load has been started and
+ * its data has not yet been installed.
+ */
+bool
+CiftiMappableConnectivityMatrixDataFile::isBackgroundLoadingPending() const
+{
+    return (m_backgroundRequestID >= 0);
+}
+
+/**
+ * If the pending background load has finished, make its row the
+ * loaded data.
+ *
+ * NOTE: Afterwards, when true is returned, it will be necessary to
+ * update this file's color mapping with updateScalarColoringForMap().
+ *
+ * @return
+ *    True if the loaded data changed, else false.
+ * @throw
+ *    DataFileException if reading the row failed.
+ */
+bool
+CiftiMappableConnectivityMatrixDataFile::finishBackgroundLoading() throw (DataFileException)
+{
+    if (isBackgroundLoadingPending() == false) {
+        return false;
+    }
+    CaretAssert(m_rowLoader != NULL);
+    
+    std::vector<float> rowData;
+    try {
+        if (m_rowLoader->takeResult(m_backgroundRequestID,
+                                    rowData) == false) {
+            return false;
+        }
+    }
+    catch (CiftiFileException& e) {
+        m_backgroundRequestID = -1;
+        setLoadedRowDataToAllZeros();
+        CaretAssertVectorIndex(m_mapContent, 0);
+        m_mapContent[0]->invalidateColoring();
+        throw DataFileException(e.whatString());
+    }
+    m_backgroundRequestID = -1;
+    
+    m_loadedRowData.swap(rowData);
+    
+    m_rowLoadedTextForMapName = ("Row: "
+                                 + AString::number(m_backgroundRowIndex)
+                                 + ", Node Index: "
+                                 + AString::number(m_backgroundNodeIndex)
+                                 + ", Structure: "
+                                 + StructureEnum::toName(m_backgroundStructure));
+    
+    m_rowLoadedText = ("Row_"
+                       + AString::number(m_backgroundRowIndex)
+                       + "_Node_Index_"
+                       + AString::number(m_backgroundNodeIndex)
+                       + "_Structure_"
+                       + StructureEnum::toGuiName(m_backgroundStructure));
+    
+    CaretLogFine("Read row for node " + AString::number(m_backgroundNodeIndex));
+    
+    m_connectivityDataLoaded->setSurfaceNodeLoading(m_backgroundStructure,
+                                                    m_backgroundSurfaceNumberOfNodes,
+                                                    m_backgroundNodeIndex,
+                                                    m_backgroundRowIndex);
+    
+    CaretAssertVectorIndex(m_mapContent, 0);
+    m_mapContent[0]->invalidateColoring();
+    
+    return true;
+}
+
+/**
+ * Abandon the pending background load, if any.  The loaded data
+ * is not changed.
+ */
+void
+CiftiMappableConnectivityMatrixDataFile::cancelBackgroundLoading()
+{
+    if (isBackgroundLoadingPending()) {
+        if (m_rowLoader != NULL) {
+            m_rowLoader->cancelRequest();
+        }
+        m_backgroundRequestID = -1;
+    }
+}
+
+
 /**
  * Load connectivity data for the given map index.
  *
@@ -620,7 +896,7 @@ CiftiMappableConnectivityMatrixDataFile::loadMapData(const int32_t selectionInde
         return false;
     }
     
-    
+    cancelBackgroundLoading();
     
     try {
         bool dataWasLoaded = false;
@@ -637,8 +913,8 @@ CiftiMappableConnectivityMatrixDataFile::loadMapData(const int32_t selectionInde
                                    );
                 CaretAssert((selectionIndex >= 0) && (selectionIndex < m_ciftiInterface->getNumberOfRows()));
                 m_loadedRowData.resize(dataCount);
-                m_ciftiInterface->getRow(&m_loadedRowData[0],
-                                         selectionIndex);
+                readRow(&m_loadedRowData[0],
+                        selectionIndex);
                 
                 CaretLogFine("Read row " + AString::number(selectionIndex+1));
                 
@@ -673,6 +949,10 @@ CiftiMappableConnectivityMatrixDataFile::loadMapData(const int32_t selectionInde
  *    Surface's structure.
  * @param nodeIndices
  *    Indices of nodes.
+ * @param prefetchNodeIndices
+ *    Indices of nodes likely to be averaged next, such as the nodes
+ *    surrounding the averaged nodes.  When background loading is
+ *    supported, their rows are read into the row cache afterwards.
  * @throw
  *    DataFileException if there is an error.
  */
@@ -680,7 +960,8 @@ void
 CiftiMappableConnectivityMatrixDataFile::loadMapAverageDataForSurfaceNodes(const int32_t /*mapIndex*/,
                                                                    const int32_t surfaceNumberOfNodes,
                                                                    const StructureEnum::Enum structure,
-                                                                   const std::vector<int32_t>& nodeIndices) throw (DataFileException)
+                                                                   const std::vector<int32_t>& nodeIndices,
+                                                                   const std::vector<int32_t>& prefetchNodeIndices) throw (DataFileException)
 {
     if (isCiftiInterfaceValid() == false) {
         setLoadedRowDataToAllZeros();
@@ -716,12 +997,27 @@ CiftiMappableConnectivityMatrixDataFile::loadMapAverageDataForSurfaceNodes(const
             float* dataAverage = &dataAverageVector[0];
             
             /*
-             * Contains row for a node
+             * Find the row for each node
              */
-            std::vector<float> dataRowVector(dataCount, 0.0);
-            float* dataRow = &dataRowVector[0];
+            std::vector<int64_t> rowIndices;
+            rowIndices.reserve(numberOfNodeIndices);
+            for (int32_t i = 0; i < numberOfNodeIndices; i++) {
+                const int32_t nodeIndex = nodeIndices[i];
+                const int64_t rowIndex = getRowIndexForNodeWhenLoading(structure,
+                                                                       surfaceNumberOfNodes,
+                                                                       nodeIndex);
+                if (rowIndex >= 0) {
+                    CaretAssert((rowIndex >= 0) && (rowIndex < m_ciftiInterface->getNumberOfRows()));
+                    rowIndices.push_back(rowIndex);
+                }
+                else {
+                    CaretLogFine("Failed reading row for node " + AString::number(nodeIndex));
+                }
+            }
+            const int64_t numberOfRows = static_cast<int64_t>(rowIndices.size());
             
             int64_t rowSuccessCount = 0;
+            bool dataIsAveraged = false;
             
             bool userCancelled = false;
             EventProgressUpdate progressEvent(0,
@@ -733,31 +1029,72 @@ CiftiMappableConnectivityMatrixDataFile::loadMapAverageDataForSurfaceNodes(const
                                               + getFileNameNoPath());
             EventManager::get()->sendEvent(progressEvent.getPointer());
             
-            /*
-             * Read rows for each node
-             */
-            for (int32_t i = 0; i < numberOfNodeIndices; i++) {
-                const int32_t nodeIndex = nodeIndices[i];
+            if (isBackgroundLoadingSupported()
+                && (numberOfRows > 0)) {
+                /*
+                 * Rows are read by the row loader's threads while
+                 * this thread keeps the progress dialog responsive.
+                 * The loader reads them in file order, merging
+                 * nearby rows into large reads.
+                 */
+                std::vector<int64_t> prefetchRowIndices;
+                const int32_t numberOfPrefetchNodes = static_cast<int32_t>(prefetchNodeIndices.size());
+                for (int32_t i = 0; i < numberOfPrefetchNodes; i++) {
+                    const int64_t rowIndex = getRowIndexForNodeWhenLoading(structure,
+                                                                           surfaceNumberOfNodes,
+                                                                           prefetchNodeIndices[i]);
+                    if (rowIndex >= 0) {
+                        prefetchRowIndices.push_back(rowIndex);
+                    }
+                }
                 
-                if (isDenseMatrix) {
-                    if ((i % progressUpdateInterval) == 0) {
-                        progressEvent.setProgress(i,
-                                                  "");
-                        EventManager::get()->sendEvent(progressEvent.getPointer());
-                        if (progressEvent.isCancelled()) {
-                            userCancelled = true;
-                            break;
-                        }
+                CiftiRowLoader* rowLoader = getRowLoader();
+                const int64_t requestID = rowLoader->startRequest(rowIndices,
+                                                                  prefetchRowIndices);
+                const unsigned long progressIntervalMilliseconds = 100;
+                while (rowLoader->waitForResult(requestID,
+                                                dataAverageVector,
+                                                progressIntervalMilliseconds) == false) {
+                    progressEvent.setProgress(rowLoader->getRowsCompleted(requestID),
+                                              "");
+                    EventManager::get()->sendEvent(progressEvent.getPointer());
+                    if (progressEvent.isCancelled()) {
+                        rowLoader->cancelRequest();
+                        userCancelled = true;
+                        break;
                     }
                 }
                 
-                const int64_t rowIndex = getRowIndexForNodeWhenLoading(structure,
-                                                                       surfaceNumberOfNodes,
-                                                                       nodeIndex);
+                if (userCancelled == false) {
+                    rowSuccessCount = numberOfRows;
+                    dataIsAveraged = true;
+                    CaretLogFine("Read row for node " + AString::fromNumbers(nodeIndices, ","));
+                }
+            }
+            else {
+                /*
+                 * Contains row for a node
+                 */
+                std::vector<float> dataRowVector(dataCount, 0.0);
+                float* dataRow = &dataRowVector[0];
                 
-                if (rowIndex >= 0) {
-                    CaretAssert((rowIndex >= 0) && (rowIndex < m_ciftiInterface->getNumberOfRows()));
-                    m_ciftiInterface->getRow(dataRow, rowIndex);
+                /*
+                 * Read rows for each node
+                 */
+                for (int64_t i = 0; i < numberOfRows; i++) {
+                    if (isDenseMatrix) {
+                        if ((i % progressUpdateInterval) == 0) {
+                            progressEvent.setProgress(i,
+                                                      "");
+                            EventManager::get()->sendEvent(progressEvent.getPointer());
+                            if (progressEvent.isCancelled()) {
+                                userCancelled = true;
+                                break;
+                            }
+                        }
+                    }
+                    
+                    readRow(dataRow, rowIndices[i]);
                     
                     for (int64_t j = 0; j < dataCount; j++) {
                         dataAverage[j] += dataRow[j];
@@ -766,9 +1103,6 @@ CiftiMappableConnectivityMatrixDataFile::loadMapAverageDataForSurfaceNodes(const
                     
                     CaretLogFine("Read row for node " + AString::fromNumbers(nodeIndices, ","));
                 }
-                else {
-                    CaretLogFine("Failed reading row for node " + AString::number(nodeIndex));
-                }
             }
             
             if (userCancelled) {
@@ -779,8 +1113,10 @@ CiftiMappableConnectivityMatrixDataFile::loadMapAverageDataForSurfaceNodes(const
                 /*
                  * Average the data
                  */
-                for (int64_t i = 0; i < dataCount; i++) {
-                    dataAverage[i] /= rowSuccessCount;
+                if (dataIsAveraged == false) {
+                    for (int64_t i = 0; i < dataCount; i++) {
+                        dataAverage[i] /= rowSuccessCount;
+                    }
                 }
                 
                 m_rowLoadedTextForMapName = ("Structure: "
@@ -876,7 +1212,7 @@ CiftiMappableConnectivityMatrixDataFile::loadMapDataForVoxelAtCoordinate(const i
             if (dataCount > 0) {
                 m_loadedRowData.resize(dataCount);
                 CaretAssert((rowIndex >= 0) && (rowIndex < m_ciftiInterface->getNumberOfRows()));
-                m_ciftiInterface->getRow(&m_loadedRowData[0], rowIndex);
+                readRow(&m_loadedRowData[0], rowIndex);
                 
                 m_rowLoadedTextForMapName = ("Row: "
                                          + AString::number(rowIndex)
@@ -1008,8 +1344,8 @@ CiftiMappableConnectivityMatrixDataFile::loadMapAverageDataForVoxelIndices(const
         const int64_t rowIndex = getRowIndexForVoxelIndexWhenLoading(voxelIJK.m_ijk);
         if (rowIndex >= 0) {
             CaretAssert((rowIndex >= 0) && (rowIndex < m_ciftiInterface->getNumberOfRows()));
-            m_ciftiInterface->getRow(&rowData[0],
-                                     rowIndex);
+            readRow(&rowData[0],
+                    rowIndex);
             
             for (int64_t j = 0; j < dataCount; j++) {
                 rowSum[j] += rowData[j];
@@ -27,6 +27,7 @@
 
 namespace caret {
 
+    class CiftiRowLoader;
     class ConnectivityDataLoaded;
     class SceneClassAssistant;
     
@@ -56,7 +57,19 @@ namespace caret {
         virtual void loadMapAverageDataForSurfaceNodes(const int32_t mapIndex,
                                                        const int32_t surfaceNumberOfNodes,
                                                        const StructureEnum::Enum structure,
-                                                       const std::vector<int32_t>& nodeIndices) throw (DataFileException);
+                                                       const std::vector<int32_t>& nodeIndices,
+                                                       const std::vector<int32_t>& prefetchNodeIndices = std::vector<int32_t>()) throw (DataFileException);
+        
+        int64_t loadMapDataForSurfaceNodeInBackground(const int32_t mapIndex,
+                                                      const int32_t surfaceNumberOfNodes,
+                                                      const StructureEnum::Enum structure,
+                                                      const int32_t nodeIndex) throw (DataFileException);
+        
+        bool isBackgroundLoadingPending() const;
+        
+        bool finishBackgroundLoading() throw (DataFileException);
+        
+        void cancelBackgroundLoading();
         
         virtual int64_t loadMapDataForVoxelAtCoordinate(const int32_t mapIndex,
                                                         const float xyz[3]) throw (DataFileException);
@@ -95,6 +108,8 @@ namespace caret {
         
         const ConnectivityDataLoaded* getConnectivityDataLoaded() const;
         
+        bool isBackgroundLoadingSupported() const;
+        
         bool getParcelNodesElementForSelectedParcel(std::set<int64_t> &parcelNodesOut,
                                                     const StructureEnum::Enum &structure) const;
         
@@ -127,6 +142,12 @@ namespace caret {
         
         int64_t getRowIndexForVoxelIndexWhenLoading(const int64_t ijk[3]);
         
+        void readRow(float* rowOut,
+                     const int64_t rowIndex);
+        
+        CiftiRowLoader* getRowLoader();
+        
+        void deleteRowLoader();
         
         // ADD_NEW_MEMBERS_HERE
         
@@ -142,6 +163,24 @@ namespace caret {
         
         ConnectivityDataLoaded* m_connectivityDataLoaded;
         
+        /** Reads rows on background threads and caches recent rows, created when first needed */
+        CiftiRowLoader* m_rowLoader;
+        
+        /** Interface that m_rowLoader reads from */
+        const CiftiInterface* m_rowLoaderInterface;
+        
+        /** Request of the pending background load, negative if none */
+        int64_t m_backgroundRequestID;
+        
+        /** Row, structure, and node of the pending background load */
+        int64_t m_backgroundRowIndex;
+        
+        StructureEnum::Enum m_backgroundStructure;
+        
+        int32_t m_backgroundSurfaceNumberOfNodes;
+        
+        int32_t m_backgroundNodeIndex;
+        
         friend class CiftiBrainordinateScalarFile;
 
     };
@@ -22,9 +22,11 @@
 #include "CaretAssert.h"
 #include "CaretHeap.h"
 #include "CaretMutex.h"
+#include "CaretOMP.h"
 #include "SurfaceFile.h"
 #include "TopologyHelper.h"
 #include <iostream>
+#include <limits>
 #include <stdint.h>
 
 using namespace caret;
@@ -35,36 +37,23 @@ GeodesicHelperBase::GeodesicHelperBase(const SurfaceFile* surfaceIn)
     CaretPointer<TopologyHelperBase> topoBase(new TopologyHelperBase(surfaceIn));
     TopologyHelper topoHelpIn(topoBase);//leave this building one privately, to not introduce even worse dependencies regarding SurfaceFile
     numNodes = surfaceIn->getNumberOfNodes();
-    //allocate
-    numNeighbors = new int32_t[numNodes];
-    nodeNeighbors = new int32_t*[numNodes];
-    distances = new float*[numNodes];
+    topoHelpIn.getNeighborCSR(m_neighbors);//the topology helper keeps per-node vectors, pack them once here
+    m_distances.resize(m_neighbors.m_indices.size());
     //const float* coords = surfaceIn->getCoordinate(0);//hack previously needed for old code, before it used edgeInfo
     float d[3], g[3], ac[3], abhat[3], abmag, ad[3], efhat[3], efmag, ea[3], cdmag, eg[3], eh[3], ah[3], tempvec[3], tempf;
     for (int32_t i = 0; i < numNodes; ++i)
-    {//get neighbors
-        const int32_t* neighbors = topoHelpIn.getNodeNeighbors(i, numNeighbors[i]);
+    {//precompute neighbor distances
         const float* baseCoord = surfaceIn->getCoordinate(i);
-        nodeNeighbors[i] = new int32_t[numNeighbors[i]];
-        distances[i] = new float[numNeighbors[i]];
-        for (int32_t j = 0; j < numNeighbors[i]; ++j)
+        for (int64_t j = m_neighbors.m_offsets[i]; j < m_neighbors.m_offsets[i + 1]; ++j)
         {
-            nodeNeighbors[i][j] = neighbors[j];
-            const float* neighCoord = surfaceIn->getCoordinate(neighbors[j]);
+            const float* neighCoord = surfaceIn->getCoordinate(m_neighbors.m_indices[j]);
             coordDiff(baseCoord, neighCoord, tempvec);
-            distances[i][j] = std::sqrt(tempvec[0] * tempvec[0] + tempvec[1] * tempvec[1] + tempvec[2] * tempvec[2]);//precompute for speed in other calls
+            m_distances[j] = std::sqrt(tempvec[0] * tempvec[0] + tempvec[1] * tempvec[1] + tempvec[2] * tempvec[2]);//precompute for speed in other calls
         }//so few floating point operations, this should turn out symmetric
     }
-    std::vector<int32_t> tempneigh2;
-    std::vector<float> tempdist2;
-    nodeNeighbors2 = new int32_t*[numNodes];
-    numNeighbors2 = new int32_t[numNodes];
-    distances2 = new float*[numNodes];
-    //begin edge info based code
-    vector<vector<int32_t> > nodeNeighbors2Vec;
-    vector<vector<float> > distances2Vec;
-    nodeNeighbors2Vec.resize(numNodes);
-    distances2Vec.resize(numNodes);
+    //begin edge info based code, first collect the valid 2 hop pairs in edge order, then pack them with a counting pass
+    vector<int32_t> pairBase, pairFar;
+    vector<float> pairDist;
     const vector<TopologyEdgeInfo>& myEdgeInfo = topoHelpIn.getEdgeInfo();
     int numEdges = myEdgeInfo.size();
     for (int i = 0; i < numEdges; ++i)
@@ -82,11 +71,6 @@ GeodesicHelperBase::GeodesicHelperBase(const SurfaceFile* surfaceIn)
         const float* neigh2Coord = surfaceIn->getCoordinate(neigh2Node);
         const float* baseCoord = surfaceIn->getCoordinate(baseNode);
         const float* farCoord = surfaceIn->getCoordinate(farNode);
-        const int32_t num_reserve = 8;//uses 8 in case it is used on a mesh with haphazard topology, these vectors go away when the constructor terminates anyway
-        nodeNeighbors2Vec[baseNode].reserve(num_reserve);//reserve should be fast if capacity is already num_reserve, and better than reallocating at 2 and 4, if vector allocation is naive doubling
-        nodeNeighbors2Vec[farNode].reserve(num_reserve);//in the extremely rare case of a node with more than num_reserve neighbors, a second allocation plus copy isn't much of a cost
-        distances2Vec[baseNode].reserve(num_reserve);
-        distances2Vec[farNode].reserve(num_reserve);
         coordDiff(neigh2Coord, neigh1Coord, abhat);//a is neigh1, b is neigh2, b - a = (vector)ab
         abmag = normalize(abhat);
         coordDiff(farCoord, neigh1Coord, ac);//c is farnode, c - a = (vector)ac
@@ -125,21 +109,28 @@ GeodesicHelperBase::GeodesicHelperBase(const SurfaceFile* surfaceIn)
         tempf = dotProd(ah, abhat);//get the component along ab so we can test that it is positive and less than |ab|
         if (tempf <= 0.0f || tempf >= abmag) continue;//tetralateral is concave or triangular (degenerate), our path is invalid or not shorter, so consider next edge
         tempf = normalize(eg);//this is our path length
-        nodeNeighbors2Vec[farNode].push_back(baseNode);
-        distances2Vec[farNode].push_back(tempf);
-        nodeNeighbors2Vec[baseNode].push_back(farNode);
-        distances2Vec[baseNode].push_back(tempf);
-    }
-    for (int i = 0; i < numNodes; ++i)
-    {//copy it from vector into straight dynamic array, because now it won't change again, to use a bit less memory
-        numNeighbors2[i] = nodeNeighbors2Vec[i].size();
-        nodeNeighbors2[i] = new int32_t[numNeighbors2[i]];
-        distances2[i] = new float[numNeighbors2[i]];
-        for (int32_t j = 0; j < numNeighbors2[i]; ++j)
-        {
-            nodeNeighbors2[i][j] = nodeNeighbors2Vec[i][j];
-            distances2[i][j] = distances2Vec[i][j];
-        }
+        pairBase.push_back(baseNode);
+        pairFar.push_back(farNode);
+        pairDist.push_back(tempf);
+    }
+    vector<int32_t> rowSizes(numNodes, 0);
+    int64_t numPairs = (int64_t)pairBase.size();
+    for (int64_t i = 0; i < numPairs; ++i)
+    {
+        ++rowSizes[pairBase[i]];
+        ++rowSizes[pairFar[i]];
+    }
+    m_neighbors2.setRowSizes(rowSizes);
+    m_distances2.resize(m_neighbors2.m_indices.size());
+    vector<int64_t> fillPos(m_neighbors2.m_offsets.begin(), m_neighbors2.m_offsets.end() - 1);
+    for (int64_t i = 0; i < numPairs; ++i)
+    {//fill in pair order, so each node's list is in edge order, same as appending to per-node lists
+        int64_t farPos = fillPos[pairFar[i]]++;
+        m_neighbors2.m_indices[farPos] = pairBase[i];
+        m_distances2[farPos] = pairDist[i];
+        int64_t basePos = fillPos[pairBase[i]]++;
+        m_neighbors2.m_indices[basePos] = pairFar[i];
+        m_distances2[basePos] = pairDist[i];
     }
 }
 
@@ -148,12 +139,12 @@ GeodesicHelper::GeodesicHelper(const CaretPointer<GeodesicHelperBase>& baseIn)
     m_myBase = baseIn;//copy the pointer so it doesn't get changed or deleted while we get its members
     //get references and info from base
     numNodes = m_myBase->numNodes;
-    distances = m_myBase->distances;
-    distances2 = m_myBase->distances2;
-    numNeighbors = m_myBase->numNeighbors;
-    numNeighbors2 = m_myBase->numNeighbors2;
-    nodeNeighbors = m_myBase->nodeNeighbors;
-    nodeNeighbors2 = m_myBase->nodeNeighbors2;
+    neighOffsets = m_myBase->m_neighbors.m_offsets.data();
+    neighOffsets2 = m_myBase->m_neighbors2.m_offsets.data();
+    nodeNeighbors = m_myBase->m_neighbors.m_indices.data();
+    nodeNeighbors2 = m_myBase->m_neighbors2.m_indices.data();
+    distances = m_myBase->m_distances.data();
+    distances2 = m_myBase->m_distances2.data();
     //allocate private scratch space
     m_heapIdent = CaretArray<int64_t>(numNodes);
     output = new float[numNodes];
@@ -195,7 +186,8 @@ void GeodesicHelper::getNodesToGeoDist(const int32_t node, const float maxdist,
 void GeodesicHelper::dijkstra(const int32_t root, const float maxdist, std::vector<int32_t>& nodes, std::vector<float>& dists, bool smooth)
 {
     int32_t i, j, whichnode, whichneigh, numNeigh, numChanged = 0;
-    int32_t* neighbors;
+    const int32_t* neighbors;
+    const float* neighDists;
     float tempf;
     output[root] = 0.0f;
     marked[root] |= 4;
@@ -212,14 +204,15 @@ void GeodesicHelper::dijkstra(const int32_t root, const float maxdist, std::vect
             nodes.push_back(whichnode);
             dists.push_back(output[whichnode]);
             marked[whichnode] |= 1;//anything pulled from stack will already be marked as having a valid value (flag 4)
-            neighbors = nodeNeighbors[whichnode];
-            numNeigh = numNeighbors[whichnode];
+            neighbors = nodeNeighbors + neighOffsets[whichnode];
+            neighDists = distances + neighOffsets[whichnode];
+            numNeigh = (int32_t)(neighOffsets[whichnode + 1] - neighOffsets[whichnode]);
             for (j = 0; j < numNeigh; ++j)
             {
                 whichneigh = neighbors[j];
                 if (!(marked[whichneigh] & 1))
                 {//skip floating point math if marked
-                    tempf = output[whichnode] + distances[whichnode][j];//isn't precomputation wonderful
+                    tempf = output[whichnode] + neighDists[j];//isn't precomputation wonderful
                     if (tempf <= maxdist)
                     {//keep it off the heap if it is too far
                         if (!(marked[whichneigh] & 4))
@@ -236,16 +229,17 @@ void GeodesicHelper::dijkstra(const int32_t root, const float maxdist, std::vect
                     }
                 }
             }
-            if (smooth)//repeat with numNeighbors2, nodeNeighbors2, distance2
+            if (smooth)//repeat with 2 hop neighbors
             {
-                neighbors = nodeNeighbors2[whichnode];
-                numNeigh = numNeighbors2[whichnode];
+                neighbors = nodeNeighbors2 + neighOffsets2[whichnode];
+                neighDists = distances2 + neighOffsets2[whichnode];
+                numNeigh = (int32_t)(neighOffsets2[whichnode + 1] - neighOffsets2[whichnode]);
                 for (j = 0; j < numNeigh; ++j)
                 {
                     whichneigh = neighbors[j];
                     if (!(marked[whichneigh] & 1))
                     {//skip floating point math if marked
-                        tempf = output[whichnode] + distances2[whichnode][j];//isn't precomputation wonderful
+                        tempf = output[whichnode] + neighDists[j];//isn't precomputation wonderful
                         if (tempf <= maxdist)
                         {//keep it off the heap if it is too far
                             if (!(marked[whichneigh] & 4))
@@ -274,7 +268,8 @@ void GeodesicHelper::dijkstra(const int32_t root, const float maxdist, std::vect
 void GeodesicHelper::dijkstra(const int32_t root, bool smooth)
 {//straightforward dijkstra, no cutoffs, full surface
     int32_t i, j, whichnode, whichneigh, numNeigh;
-    int32_t* neighbors;
+    const int32_t* neighbors;
+    const float* neighDists;
     float tempf;
     output[root] = 0.0f;
     parent[root] = -1;//idiom for end of path
@@ -286,14 +281,15 @@ void GeodesicHelper::dijkstra(const int32_t root, bool smooth)
         if (!(marked[whichnode] & 1))
         {
             marked[whichnode] |= 1;
-            neighbors = nodeNeighbors[whichnode];
-            numNeigh = numNeighbors[whichnode];
+            neighbors = nodeNeighbors + neighOffsets[whichnode];
+            neighDists = distances + neighOffsets[whichnode];
+            numNeigh = (int32_t)(neighOffsets[whichnode + 1] - neighOffsets[whichnode]);
             for (j = 0; j < numNeigh; ++j)
             {
                 whichneigh = neighbors[j];
                 if (!(marked[whichneigh] & 1))
                 {//skip floating point math if marked
-                    tempf = output[whichnode] + distances[whichnode][j];
+                    tempf = output[whichnode] + neighDists[j];
                     if (!(marked[whichneigh] & 4))
                     {
                         parent[whichneigh] = whichnode;
@@ -308,14 +304,15 @@ void GeodesicHelper::dijkstra(const int32_t root, bool smooth)
             }
             if (smooth)
             {
-                neighbors = nodeNeighbors2[whichnode];
-                numNeigh = numNeighbors2[whichnode];
+                neighbors = nodeNeighbors2 + neighOffsets2[whichnode];
+                neighDists = distances2 + neighOffsets2[whichnode];
+                numNeigh = (int32_t)(neighOffsets2[whichnode + 1] - neighOffsets2[whichnode]);
                 for (j = 0; j < numNeigh; ++j)
                 {
                     whichneigh = neighbors[j];
                     if (!(marked[whichneigh] & 1))
                     {//skip floating point math if marked
-                        tempf = output[whichnode] + distances2[whichnode][j];
+                        tempf = output[whichnode] + neighDists[j];
                         if (!(marked[whichneigh] & 4))
                         {
                             parent[whichneigh] = whichnode;
@@ -429,7 +426,8 @@ float** GeodesicHelper::getGeoAllToAll(const bool smooth)
 void GeodesicHelper::alltoall(float** out, int32_t** parents, bool smooth)
 {//propagates info about shortest paths not containing root to other roots, hopefully making the problem tractable
     int32_t root, i, j, whichnode, whichneigh, numNeigh, remain, midpoint, midrevparent, endparent, prevdots = 0, dots;
-    int32_t* neighbors;
+    const int32_t* neighbors;
+    const float* neighDists;
     float tempf, tempf2;
     for (i = 0; i < numNodes; ++i)
     {
@@ -476,8 +474,9 @@ void GeodesicHelper::alltoall(float** out, int32_t** parents, bool smooth)
             {
                 if (!(marked[whichnode] & 2)) --remain;
                 marked[whichnode] |= 1;
-                neighbors = nodeNeighbors[whichnode];
-                numNeigh = numNeighbors[whichnode];
+                neighbors = nodeNeighbors + neighOffsets[whichnode];
+                neighDists = distances + neighOffsets[whichnode];
+                numNeigh = (int32_t)(neighOffsets[whichnode + 1] - neighOffsets[whichnode]);
                 for (j = 0; j < numNeigh; ++j)
                 {
                     whichneigh = neighbors[j];
@@ -491,7 +490,7 @@ void GeodesicHelper::alltoall(float** out, int32_t** parents, bool smooth)
                     } else {
                         if (!(marked[whichneigh] & 1))
                         {//skip floating point math if marked
-                            tempf = out[root][whichnode] + distances[whichnode][j];
+                            tempf = out[root][whichnode] + neighDists[j];
                             if (!(marked[whichneigh] & 4))
                             {
                                 out[root][whichneigh] = tempf;
@@ -508,8 +507,9 @@ void GeodesicHelper::alltoall(float** out, int32_t** parents, bool smooth)
                 }
                 if (smooth)
                 {
-                    neighbors = nodeNeighbors2[whichnode];
-                    numNeigh = numNeighbors2[whichnode];
+                    neighbors = nodeNeighbors2 + neighOffsets2[whichnode];
+                    neighDists = distances2 + neighOffsets2[whichnode];
+                    numNeigh = (int32_t)(neighOffsets2[whichnode + 1] - neighOffsets2[whichnode]);
                     for (j = 0; j < numNeigh; ++j)
                     {
                         whichneigh = neighbors[j];
@@ -523,7 +523,7 @@ void GeodesicHelper::alltoall(float** out, int32_t** parents, bool smooth)
                         } else {
                             if (!(marked[whichneigh] & 1))
                             {//skip floating point math if marked
-                                tempf = out[root][whichnode] + distances2[whichnode][j];
+                                tempf = out[root][whichnode] + neighDists[j];
                                 if (!(marked[whichneigh] & 4))
                                 {
                                     out[root][whichneigh] = tempf;
@@ -648,7 +648,8 @@ void GeodesicHelper::getGeoFromNode(const int32_t node, std::vector<float>& valu
 void GeodesicHelper::dijkstra(const int32_t root, const std::vector<int32_t>& interested, bool smooth)
 {
     int32_t i, j, whichnode, whichneigh, numNeigh, numChanged = 0, remain = 0;
-    int32_t* neighbors;
+    const int32_t* neighbors;
+    const float* neighDists;
     float tempf;
     j = interested.size();
     for (i = 0; i < j; ++i)
@@ -680,14 +681,15 @@ void GeodesicHelper::dijkstra(const int32_t root, const std::vector<int32_t>& in
                 --remain;
             }
             marked[whichnode] |= 1;//anything pulled from stack will already be marked as having a valid value (flag 4), so already in changed list
-            neighbors = nodeNeighbors[whichnode];
-            numNeigh = numNeighbors[whichnode];
+            neighbors = nodeNeighbors + neighOffsets[whichnode];
+            neighDists = distances + neighOffsets[whichnode];
+            numNeigh = (int32_t)(neighOffsets[whichnode + 1] - neighOffsets[whichnode]);
             for (j = 0; j < numNeigh; ++j)
             {
                 whichneigh = neighbors[j];
                 if (!(marked[whichneigh] & 1))
                 {//skip floating point math if marked
-                    tempf = output[whichnode] + distances[whichnode][j];//isn't precomputation wonderful
+                    tempf = output[whichnode] + neighDists[j];//isn't precomputation wonderful
                     if (!(marked[whichneigh] & 4))
                     {
                         parent[whichneigh] = whichnode;
@@ -704,16 +706,17 @@ void GeodesicHelper::dijkstra(const int32_t root, const std::vector<int32_t>& in
                     }
                 }
             }
-            if (smooth)//repeat with numNeighbors2, nodeNeighbors2, distance2
+            if (smooth)//repeat with 2 hop neighbors
             {
-                neighbors = nodeNeighbors2[whichnode];
-                numNeigh = numNeighbors2[whichnode];
+                neighbors = nodeNeighbors2 + neighOffsets2[whichnode];
+                neighDists = distances2 + neighOffsets2[whichnode];
+                numNeigh = (int32_t)(neighOffsets2[whichnode + 1] - neighOffsets2[whichnode]);
                 for (j = 0; j < numNeigh; ++j)
                 {
                     whichneigh = neighbors[j];
                     if (!(marked[whichneigh] & 1))
                     {//skip floating point math if marked
-                        tempf = output[whichnode] + distances2[whichnode][j];//isn't precomputation wonderful
+                        tempf = output[whichnode] + neighDists[j];//isn't precomputation wonderful
                         if (!(marked[whichneigh] & 4))
                         {
                             parent[whichneigh] = whichnode;
@@ -742,7 +745,8 @@ void GeodesicHelper::dijkstra(const int32_t root, const std::vector<int32_t>& in
 int32_t GeodesicHelper::closest(const int32_t& root, const char* roi, const float& maxdist, float& distOut, bool smooth)
 {
     int32_t i, j, whichnode, whichneigh, numNeigh, numChanged = 0, ret = -1;
-    int32_t* neighbors;
+    const int32_t* neighbors;
+    const float* neighDists;
     float tempf;
     output[root] = 0.0f;
     changed[numChanged++] = root;
@@ -762,14 +766,15 @@ int32_t GeodesicHelper::closest(const int32_t& root, const char* roi, const floa
                 break;
             }
             marked[whichnode] |= 1;//anything pulled from stack will already be marked as having a valid value (flag 4), so already in changed list
-            neighbors = nodeNeighbors[whichnode];
-            numNeigh = numNeighbors[whichnode];
+            neighbors = nodeNeighbors + neighOffsets[whichnode];
+            neighDists = distances + neighOffsets[whichnode];
+            numNeigh = (int32_t)(neighOffsets[whichnode + 1] - neighOffsets[whichnode]);
             for (j = 0; j < numNeigh; ++j)
             {
                 whichneigh = neighbors[j];
                 if (!(marked[whichneigh] & 1))
                 {//skip floating point math if frozen
-                    tempf = output[whichnode] + distances[whichnode][j];//isn't precomputation wonderful
+                    tempf = output[whichnode] + neighDists[j];//isn't precomputation wonderful
                     if (tempf <= maxdist)
                     {
                         if (!(marked[whichneigh] & 4))
@@ -789,16 +794,17 @@ int32_t GeodesicHelper::closest(const int32_t& root, const char* roi, const floa
                     }
                 }
             }
-            if (smooth)//repeat with numNeighbors2, nodeNeighbors2, distance2
+            if (smooth)//repeat with 2 hop neighbors
             {
-                neighbors = nodeNeighbors2[whichnode];
-                numNeigh = numNeighbors2[whichnode];
+                neighbors = nodeNeighbors2 + neighOffsets2[whichnode];
+                neighDists = distances2 + neighOffsets2[whichnode];
+                numNeigh = (int32_t)(neighOffsets2[whichnode + 1] - neighOffsets2[whichnode]);
                 for (j = 0; j < numNeigh; ++j)
                 {
                     whichneigh = neighbors[j];
                     if (!(marked[whichneigh] & 1))
                     {//skip floating point math if frozen
-                        tempf = output[whichnode] + distances2[whichnode][j];//isn't precomputation wonderful
+                        tempf = output[whichnode] + neighDists[j];//isn't precomputation wonderful
                         if (tempf <= maxdist)
                         {
                             if (!(marked[whichneigh] & 4))
@@ -899,3 +905,214 @@ int32_t GeodesicHelper::getClosestNodeInRoi(const int32_t& root, const char* roi
     CaretMutexLocker locked(&inUse);//let sanity checks fail without locking
     return closest(root, roi, maxdist, distOut, smoothflag);
 }
+
+void GeodesicHelper::dijkstra(const vector<int32_t>& roots, const float maxdist, vector<int32_t>& nodes, vector<float>& dists, bool smooth)
+{//same as the single root restricted version, except all roots start at zero, and each node remembers which root its path came from
+    int32_t i, j, whichnode, whichneigh, numNeigh, numChanged = 0;
+    const int32_t* neighbors;
+    const float* neighDists;
+    float tempf;
+    if ((int32_t)m_rootIndex.size() != numNodes)
+    {
+        m_rootIndex.resize(numNodes);
+    }
+    m_active.clear();
+    int32_t numRoots = (int32_t)roots.size();
+    for (i = 0; i < numRoots; ++i)
+    {
+        int32_t root = roots[i];
+        if (marked[root] & 4) continue;//repeated root, the first index wins
+        output[root] = 0.0f;
+        marked[root] |= 4;
+        parent[root] = -1;//idiom for end of path
+        m_rootIndex[root] = i;
+        changed[numChanged++] = root;
+        m_heapIdent[root] = m_active.push(root, 0.0f);
+    }
+    while (!m_active.isEmpty())
+    {
+        whichnode = m_active.pop();
+        if (!(marked[whichnode] & 1))
+        {
+            nodes.push_back(whichnode);
+            dists.push_back(output[whichnode]);
+            marked[whichnode] |= 1;
+            neighbors = nodeNeighbors + neighOffsets[whichnode];
+            neighDists = distances + neighOffsets[whichnode];
+            numNeigh = (int32_t)(neighOffsets[whichnode + 1] - neighOffsets[whichnode]);
+            for (j = 0; j < numNeigh; ++j)
+            {
+                whichneigh = neighbors[j];
+                if (!(marked[whichneigh] & 1))
+                {
+                    tempf = output[whichnode] + neighDists[j];
+                    if (tempf <= maxdist)
+                    {
+                        if (!(marked[whichneigh] & 4))
+                        {
+                            parent[whichneigh] = whichnode;
+                            m_rootIndex[whichneigh] = m_rootIndex[whichnode];
+                            marked[whichneigh] |= 4;
+                            changed[numChanged++] = whichneigh;
+                            output[whichneigh] = tempf;
+                            m_heapIdent[whichneigh] = m_active.push(whichneigh, tempf);
+                        } else if (tempf < output[whichneigh]) {
+                            parent[whichneigh] = whichnode;
+                            m_rootIndex[whichneigh] = m_rootIndex[whichnode];
+                            output[whichneigh] = tempf;
+                            m_active.changekey(m_heapIdent[whichneigh], tempf);
+                        } else if (tempf == output[whichneigh] && m_rootIndex[whichnode] < m_rootIndex[whichneigh]) {//exact ties go to the lowest root index, to not depend on heap order
+                            parent[whichneigh] = whichnode;
+                            m_rootIndex[whichneigh] = m_rootIndex[whichnode];
+                        }
+                    }
+                }
+            }
+            if (smooth)//repeat with 2 hop neighbors
+            {
+                neighbors = nodeNeighbors2 + neighOffsets2[whichnode];
+                neighDists = distances2 + neighOffsets2[whichnode];
+                numNeigh = (int32_t)(neighOffsets2[whichnode + 1] - neighOffsets2[whichnode]);
+                for (j = 0; j < numNeigh; ++j)
+                {
+                    whichneigh = neighbors[j];
+                    if (!(marked[whichneigh] & 1))
+                    {
+                        tempf = output[whichnode] + neighDists[j];
+                        if (tempf <= maxdist)
+                        {
+                            if (!(marked[whichneigh] & 4))
+                            {
+                                parent[whichneigh] = whichnode;
+                                m_rootIndex[whichneigh] = m_rootIndex[whichnode];
+                                marked[whichneigh] |= 4;
+                                changed[numChanged++] = whichneigh;
+                                output[whichneigh] = tempf;
+                                m_heapIdent[whichneigh] = m_active.push(whichneigh, tempf);
+                            } else if (tempf < output[whichneigh]) {
+                                parent[whichneigh] = whichnode;
+                                m_rootIndex[whichneigh] = m_rootIndex[whichnode];
+                                output[whichneigh] = tempf;
+                                m_active.changekey(m_heapIdent[whichneigh], tempf);
+                            } else if (tempf == output[whichneigh] && m_rootIndex[whichnode] < m_rootIndex[whichneigh]) {
+                                parent[whichneigh] = whichnode;
+                                m_rootIndex[whichneigh] = m_rootIndex[whichnode];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    for (i = 0; i < numChanged; ++i)
+    {
+        marked[changed[i]] = 0;//minimize reinitialization of arrays
+    }
+}
+
+void GeodesicHelper::getNodesToGeoDist(const vector<int32_t>& roots, const float maxdist, vector<int32_t>& nodesOut, vector<float>& distsOut, vector<int32_t>& rootIndicesOut, const bool smoothflag)
+{
+    nodesOut.clear();
+    distsOut.clear();
+    rootIndicesOut.clear();
+    if (maxdist < 0.0f) return;
+    int32_t numRoots = (int32_t)roots.size();
+    for (int32_t i = 0; i < numRoots; ++i)
+    {
+        CaretAssert(roots[i] >= 0 && roots[i] < numNodes);
+        if (roots[i] < 0 || roots[i] >= numNodes) return;
+    }
+    CaretMutexLocker locked(&inUse);
+    dijkstra(roots, maxdist, nodesOut, distsOut, smoothflag);
+    int32_t mysize = (int32_t)nodesOut.size();
+    rootIndicesOut.resize(mysize);
+    for (int32_t i = 0; i < mysize; ++i)
+    {
+        rootIndicesOut[i] = m_rootIndex[nodesOut[i]];
+    }
+}
+
+void GeodesicHelper::getGeoFromNodes(const vector<int32_t>& roots, vector<float>& valuesOut, vector<int32_t>& rootIndicesOut, const bool smoothflag)
+{
+    int32_t numRoots = (int32_t)roots.size();
+    for (int32_t i = 0; i < numRoots; ++i)
+    {
+        CaretAssert(roots[i] >= 0 && roots[i] < numNodes);
+        if (roots[i] < 0 || roots[i] >= numNodes)
+        {
+            valuesOut.clear();//empty array is error condition
+            rootIndicesOut.clear();
+            return;
+        }
+    }
+    valuesOut.clear();
+    valuesOut.resize(numNodes, -1.0f);
+    rootIndicesOut.clear();
+    rootIndicesOut.resize(numNodes, -1);
+    vector<int32_t> nodes;
+    vector<float> dists;
+    CaretMutexLocker locked(&inUse);
+    dijkstra(roots, numeric_limits<float>::max(), nodes, dists, smoothflag);
+    int32_t mysize = (int32_t)nodes.size();
+    for (int32_t i = 0; i < mysize; ++i)
+    {
+        valuesOut[nodes[i]] = dists[i];
+        rootIndicesOut[nodes[i]] = m_rootIndex[nodes[i]];
+    }
+}
+
+void GeodesicHelper::getGeoFromNodesBatch(const CaretPointer<GeodesicHelperBase>& baseIn, const vector<int32_t>& roots, float* valuesOut, const bool smoothflag)
+{
+    CaretAssert(baseIn != NULL && valuesOut != NULL);
+    int64_t numNodes = baseIn->numNodes;
+    int32_t numRoots = (int32_t)roots.size();
+    for (int32_t i = 0; i < numRoots; ++i)
+    {
+        CaretAssert(roots[i] >= 0 && roots[i] < numNodes);
+        if (roots[i] < 0 || roots[i] >= numNodes) return;
+    }
+#pragma omp CARET_PAR
+    {
+        GeodesicHelper myHelp(baseIn);//the base is immutable, so each thread only needs its own scratch arrays
+#pragma omp CARET_FOR schedule(dynamic)
+        for (int32_t i = 0; i < numRoots; ++i)
+        {
+            float* myRow = valuesOut + numNodes * i;
+            for (int64_t j = 0; j < numNodes; ++j)
+            {
+                myRow[j] = -1.0f;//full surface dijkstra doesn't touch unreachable nodes
+            }
+            float* temp = myHelp.output;
+            myHelp.output = myRow;
+            myHelp.dijkstra(roots[i], smoothflag);
+            myHelp.output = temp;
+        }
+    }
+}
+
+void GeodesicHelper::getNodesToGeoDistBatch(const CaretPointer<GeodesicHelperBase>& baseIn, const vector<int32_t>& roots, const float maxdist, vector<vector<int32_t> >& nodesOut,
+                                            vector<vector<float> >& distsOut, const bool smoothflag)
+{
+    CaretAssert(baseIn != NULL);
+    int32_t numNodes = baseIn->numNodes;
+    int32_t numRoots = (int32_t)roots.size();
+    nodesOut.clear();
+    distsOut.clear();
+    nodesOut.resize(numRoots);
+    distsOut.resize(numRoots);
+    if (maxdist < 0.0f) return;
+    for (int32_t i = 0; i < numRoots; ++i)
+    {
+        CaretAssert(roots[i] >= 0 && roots[i] < numNodes);
+        if (roots[i] < 0 || roots[i] >= numNodes) return;
+    }
+#pragma omp CARET_PAR
+    {
+        GeodesicHelper myHelp(baseIn);
+#pragma omp CARET_FOR schedule(dynamic)
+        for (int32_t i = 0; i < numRoots; ++i)
+        {
+            myHelp.dijkstra(roots[i], maxdist, nodesOut[i], distsOut[i], smoothflag);
+        }
+    }
+}
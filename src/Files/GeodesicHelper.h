@@ -27,6 +27,7 @@
 #include <cmath>
 //for inlining
 
+#include "AdjacencyCSR.h"
 #include "CaretMutex.h"
 #include "CaretPointer.h"
 #include "CaretHeap.h"
@@ -39,15 +40,15 @@ namespace caret {
     //This is because it is designed to be fast on repeated calls on a single surface
     //For only a few calls, the constructor may take longer than simply using a well restricted BranModelSurfaceGeodesic
     //This is because it copies neighbors and precomputes all 1 hop and 2 hop shared edge distances in the constructor
+    //The neighbors and distances are stored in contiguous (CSR) arrays, so traversal doesn't chase a pointer per node
 
     class GeodesicHelperBase
     {//This does the neighbor computation, create a GeodesicHelper to contain the temporary arrays and actually do stuff
         GeodesicHelperBase();//can't construct without arguments
         GeodesicHelperBase& operator=(const GeodesicHelperBase& right);//can't assign
         GeodesicHelperBase(const GeodesicHelperBase& right);//can't use copy constructor
-        float** distances, **distances2;//use primitives for speed, and they don't need to change size
-        int32_t** nodeNeighbors, **nodeNeighbors2;//copy neighbors at constructor, because I don't want to mess with inheritance, and I want speed of repeated calls
-        int32_t* numNeighbors, *numNeighbors2;
+        AdjacencyCSR m_neighbors, m_neighbors2;//1 hop neighbors, and 2 hop neighbors found by unfolding pairs of triangles that share an edge
+        std::vector<float> m_distances, m_distances2;//matched with the packed indices of m_neighbors and m_neighbors2
         int32_t numNodes;
         static void crossProd(const float in1[3], const float in2[3], float out[3]);//DO NOT PASS AN INPUT AS OUT
         static float dotProd(const float in1[3], const float in2[3]);
@@ -55,32 +56,17 @@ namespace caret {
         static void coordDiff(const float* coord1, const float* coord2, float out[3]);
     public:
         GeodesicHelperBase(const SurfaceFile* surfaceIn);
-        ~GeodesicHelperBase() {
-            if (numNeighbors) {
-                delete[] numNeighbors;
-                delete[] numNeighbors2;
-                for (int32_t i = 0; i < numNodes; ++i)
-                {
-                    delete[] nodeNeighbors[i];
-                    delete[] nodeNeighbors2[i];
-                    delete[] distances[i];
-                    delete[] distances2[i];
-                }
-                delete[] nodeNeighbors;
-                delete[] nodeNeighbors2;
-                delete[] distances;
-                delete[] distances2;
-            }
-        }
         friend class GeodesicHelper;//let it grab the private variables it needs
     };
 
     class GeodesicHelper
     {
         CaretMinHeap<int32_t, float> m_active;//save and reuse the allocated space
-        float* output, **distances, **distances2;//use primitives for speed, and they don't need to change size
-        int32_t** nodeNeighbors, **nodeNeighbors2;//copy neighbors at constructor, because I don't want to mess with inheritance, and I want speed of repeated calls
-        int32_t* numNeighbors, *numNeighbors2, *marked, *changed, *parent;
+        float* output;
+        const int64_t* neighOffsets, *neighOffsets2;//raw pointers into the packed arrays of the base, for speed
+        const int32_t* nodeNeighbors, *nodeNeighbors2;
+        const float* distances, *distances2;
+        int32_t* marked, *changed, *parent;
         CaretArray<int64_t> m_heapIdent;
         int32_t numNodes;
         GeodesicHelper();//Don't allow construction without arguments
@@ -91,6 +77,8 @@ namespace caret {
         void alltoall(float** out, int32_t** parents, bool smooth);//must be fully allocated
         void dijkstra(const int32_t root, const std::vector<int32_t>& interested, bool smooth);//partial surface
         int32_t closest(const int32_t& root, const char* roi, const float& maxdist, float& distOut, bool smooth);//just closest node
+        void dijkstra(const std::vector<int32_t>& roots, const float maxdist, std::vector<int32_t>& nodes, std::vector<float>& dists, bool smooth);//multiple roots, fills m_rootIndex for the nodes it reaches
+        std::vector<int32_t> m_rootIndex;//only allocated when multiple roots are used
         CaretPointer<GeodesicHelperBase> m_myBase;//mostly just for automatic memory management
         CaretMutex inUse;//could add a function and a locker pointer to be able to lock to thread once, then call repeatedly without locking, if mutex overhead is actually a factor
     public:
@@ -132,6 +120,19 @@ namespace caret {
         
         ///get just the closest node in the region and max distance given, returns -1 if no such node found - roi value of 0 means not in region, anything else is in region
         int32_t getClosestNodeInRoi(const int32_t& root, const char* roi, const float& maxdist, float& distOut, bool smoothflag = true);
+        
+        /// Get distances from the closest of several root nodes, up to a geodesic distance cutoff, and the index within roots of that closest root (ties go to the lowest index)
+        void getNodesToGeoDist(const std::vector<int32_t>& roots, const float maxdist, std::vector<int32_t>& nodesOut, std::vector<float>& distsOut, std::vector<int32_t>& rootIndicesOut, const bool smoothflag = true);
+        
+        /// Get distances from the closest of several root nodes to entire surface, and the index within roots of that closest root, -1 for both where unreachable
+        void getGeoFromNodes(const std::vector<int32_t>& roots, std::vector<float>& valuesOut, std::vector<int32_t>& rootIndicesOut, const bool smoothflag = true);
+        
+        /// Get distances from each root to entire surface, computed in parallel with one helper per thread - valuesOut MUST be allocated to roots.size() * number of nodes, row i is root i, -1 where unreachable
+        static void getGeoFromNodesBatch(const CaretPointer<GeodesicHelperBase>& baseIn, const std::vector<int32_t>& roots, float* valuesOut, const bool smoothflag = true);
+        
+        /// Get distances from each root up to a geodesic distance cutoff, computed in parallel with one helper per thread - output vectors are resized to roots.size()
+        static void getNodesToGeoDistBatch(const CaretPointer<GeodesicHelperBase>& baseIn, const std::vector<int32_t>& roots, const float maxdist, std::vector<std::vector<int32_t> >& nodesOut,
+                                           std::vector<std::vector<float> >& distsOut, const bool smoothflag = true);
     };
 
     inline void GeodesicHelperBase::crossProd(const float in1[3], const float in2[3], float out[3])
@@ -17,36 +17,195 @@
  *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 /*LICENSE_END*/
-
 #include "MetricSmoothingObject.h"
 
 #include "CaretAssert.h"
 #include "CaretException.h"
+#include "CaretLogger.h"
 #include "SurfaceFile.h"
 #include "MetricFile.h"
 #include "GeodesicHelper.h"
 #include "TopologyHelper.h"
 #include "CaretOMP.h"
+#include "WeightOperatorFile.h"
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
 #include <cmath>
 
 using namespace std;
 using namespace caret;
 
-MetricSmoothingObject::MetricSmoothingObject(const SurfaceFile* mySurf, const float& kernel, const MetricFile* myRoi, Method myMethod)
+const char MetricSmoothingObject::s_cacheFileMagic[] = "WBSMTH01";
+
+MetricSmoothingObject::MetricSmoothingObject(const SurfaceFile* mySurf, const float& kernel, const MetricFile* myRoi, Method myMethod, const AString& cacheDirectory)
 {
     CaretAssert(mySurf != NULL);
     if (myRoi != NULL && mySurf->getNumberOfNodes() != myRoi->getNumberOfNodes())
     {
         throw CaretException("roi number of nodes doesn't match the surface");
     }
+    m_numNodes = mySurf->getNumberOfNodes();
+    if (cacheDirectory == "")
+    {
+        precomputeWeights(mySurf, kernel, myRoi, myMethod);
+        return;
+    }
+    AString key = getWeightCacheKey(mySurf, kernel, myRoi, myMethod);
+    AString cacheFileName = QDir(cacheDirectory).filePath(key + ".wbsmooth");
+    if (readWeightFile(cacheFileName, key))
+    {
+        CaretLogFine("loaded smoothing weights from '" + cacheFileName + "'");
+        return;
+    }
     precomputeWeights(mySurf, kernel, myRoi, myMethod);
+    writeWeightFile(cacheFileName, key);
+}
+
+AString MetricSmoothingObject::getWeightCacheKey(const SurfaceFile* mySurf, const float& kernel, const MetricFile* myRoi, Method myMethod)
+{
+    CaretAssert(mySurf != NULL);
+    QCryptographicHash myHash(QCryptographicHash::Sha1);
+    int32_t numNodes = mySurf->getNumberOfNodes(), numTiles = mySurf->getNumberOfTriangles();
+    int32_t methodNum = (int32_t)myMethod;
+    myHash.addData(s_cacheFileMagic, sizeof(s_cacheFileMagic));//so that a format change also changes every key
+    myHash.addData((const char*)&numNodes, sizeof(numNodes));
+    myHash.addData((const char*)&numTiles, sizeof(numTiles));
+    myHash.addData((const char*)&kernel, sizeof(kernel));
+    myHash.addData((const char*)&methodNum, sizeof(methodNum));
+    myHash.addData((const char*)mySurf->getCoordinateData(), sizeof(float) * 3 * numNodes);
+    if (numTiles > 0)
+    {
+        myHash.addData((const char*)mySurf->getTriangle(0), sizeof(int32_t) * 3 * numTiles);
+    }
+    if (myRoi != NULL)
+    {//only whether each node is in the roi matters to the weights, so hash the mask rather than the values
+        CaretAssert(myRoi->getNumberOfNodes() == numNodes);
+        const float* roiColumn = myRoi->getValuePointerForColumn(0);
+        QByteArray mask(numNodes, '\0');
+        for (int32_t i = 0; i < numNodes; ++i)
+        {
+            if (roiColumn[i] > 0.0f) mask[i] = 1;
+        }
+        myHash.addData(mask);
+    }
+    return AString(myHash.result().toHex());
+}
+
+///returns false if the file doesn't exist or doesn't hold the operator for this key
+bool MetricSmoothingObject::readWeightFile(const AString& fileName, const AString& key)
+{
+    WeightOperatorFile myFile;
+    if (!myFile.openRead(fileName, s_cacheFileMagic))
+    {
+        if (QFile::exists(fileName)) CaretLogInfo("ignoring invalid smoothing weight file '" + fileName + "'");
+        return false;
+    }
+    QDataStream& myStream = myFile.getStream();
+    QByteArray storedKey;
+    qint32 numNodes;
+    qint64 numEntries;
+    myStream >> storedKey >> numNodes >> numEntries;
+    if (myStream.status() != QDataStream::Ok || AString(storedKey) != key || numNodes != m_numNodes || numEntries < 0)
+    {
+        CaretLogInfo("ignoring mismatched smoothing weight file '" + fileName + "'");
+        return false;
+    }
+    if (!myFile.readByteOrderCheck())
+    {
+        CaretLogInfo("ignoring smoothing weight file '" + fileName + "' written with different byte order");
+        return false;
+    }
+    m_rowStart.resize(numNodes + 1);
+    m_rowNodes.resize(numEntries);
+    m_rowWeights.resize(numEntries);
+    m_weightSums.resize(numNodes);
+    bool ok = (myFile.readRawData(m_rowStart.data(), sizeof(int64_t) * (numNodes + 1)) &&
+               myFile.readRawData(m_weightSums.data(), sizeof(float) * numNodes) &&
+               myFile.readRawData(m_rowNodes.data(), sizeof(int32_t) * numEntries) &&
+               myFile.readRawData(m_rowWeights.data(), sizeof(float) * numEntries));
+    if (ok)
+    {//a truncated or corrupted file must not lead to out of range accesses
+        ok = (m_rowStart[0] == 0 && m_rowStart[numNodes] == numEntries);
+        for (int32_t i = 0; ok && i < numNodes; ++i)
+        {
+            if (m_rowStart[i + 1] < m_rowStart[i]) ok = false;
+        }
+        for (int64_t j = 0; ok && j < numEntries; ++j)
+        {
+            if (m_rowNodes[j] < 0 || m_rowNodes[j] >= numNodes) ok = false;
+        }
+    }
+    if (!ok)
+    {
+        CaretLogWarning("smoothing weight file '" + fileName + "' is truncated or corrupt, recomputing weights");
+        m_rowStart.clear();
+        m_rowNodes.clear();
+        m_rowWeights.clear();
+        m_weightSums.clear();
+        return false;
+    }
+    return true;
+}
+
+void MetricSmoothingObject::writeWeightFile(const AString& fileName, const AString& key) const
+{//the cache is only an optimization, so failures here are warnings
+    WeightOperatorFile myFile;
+    if (!myFile.openWrite(fileName, s_cacheFileMagic))
+    {
+        CaretLogWarning("failed to create temporary file for smoothing weights in '" + QFileInfo(fileName).absolutePath() + "'");
+        return;
+    }
+    int64_t numEntries = (int64_t)m_rowNodes.size();
+    myFile.getStream() << key.toAscii() << (qint32)m_numNodes << (qint64)numEntries;
+    myFile.writeByteOrderCheck();
+    myFile.writeRawData(m_rowStart.data(), sizeof(int64_t) * (m_numNodes + 1));
+    myFile.writeRawData(m_weightSums.data(), sizeof(float) * m_numNodes);
+    myFile.writeRawData(m_rowNodes.data(), sizeof(int32_t) * numEntries);
+    myFile.writeRawData(m_rowWeights.data(), sizeof(float) * numEntries);
+    if (!myFile.finishWrite())
+    {
+        CaretLogWarning("failed to write smoothing weight file '" + fileName + "'");
+    }
+}
+
+void MetricSmoothingObject::buildOperator(const vector<WeightList>& gatherLists)
+{
+    CaretAssert((int32_t)gatherLists.size() == m_numNodes);
+    m_rowStart.resize(m_numNodes + 1);
+    m_weightSums.resize(m_numNodes);
+    m_rowStart[0] = 0;
+    for (int32_t i = 0; i < m_numNodes; ++i)
+    {
+        m_rowStart[i + 1] = m_rowStart[i] + (int64_t)gatherLists[i].m_nodes.size();
+    }
+    m_rowNodes.resize(m_rowStart[m_numNodes]);
+    m_rowWeights.resize(m_rowStart[m_numNodes]);
+#pragma omp CARET_PARFOR schedule(dynamic)
+    for (int32_t i = 0; i < m_numNodes; ++i)
+    {
+        const WeightList& myList = gatherLists[i];
+        int64_t base = m_rowStart[i];
+        int32_t numWeights = (int32_t)myList.m_nodes.size();
+        for (int32_t j = 0; j < numWeights; ++j)
+        {
+            m_rowNodes[base + j] = myList.m_nodes[j];
+            m_rowWeights[base + j] = myList.m_weights[j];
+        }
+        m_weightSums[i] = (numWeights == 0 ? 0.0f : myList.m_weightSum);//lists outside the roi never set their sum
+    }
 }
 
 void MetricSmoothingObject::smoothColumn(const MetricFile* metricIn, const int& whichColumn, MetricFile* columnOut, const MetricFile* roi, const bool& fixZeros) const
 {
     CaretAssert(metricIn != NULL);
     CaretAssert(columnOut != NULL);
-    if (metricIn->getNumberOfNodes() != (int32_t)m_weightLists.size())
+    if (metricIn->getNumberOfNodes() != m_numNodes)
     {
         throw CaretException("metric does not match surface number of nodes");
     }
@@ -54,36 +213,39 @@ void MetricSmoothingObject::smoothColumn(const MetricFile* metricIn, const int&
     {
         throw CaretException("invalid column number");
     }
-    if (columnOut->getNumberOfNodes() != (int32_t)m_weightLists.size() || columnOut->getNumberOfColumns() != 1)
+    if (columnOut->getNumberOfNodes() != m_numNodes || columnOut->getNumberOfColumns() != 1)
     {
-        columnOut->setNumberOfNodesAndColumns(m_weightLists.size(), 1);
+        columnOut->setNumberOfNodesAndColumns(m_numNodes, 1);
     }
-    vector<float> scratch(metricIn->getNumberOfNodes());
+    const float* roiColumn = NULL;
     if (roi != NULL)
     {
-        if (roi->getNumberOfNodes() != (int32_t)m_weightLists.size())
+        if (roi->getNumberOfNodes() != m_numNodes)
         {
             throw CaretException("roi does not match surface number of nodes");
         }
-        smoothColumnInternal(scratch.data(), metricIn, whichColumn, columnOut, 0, roi, 0, fixZeros);
-    } else {
-        smoothColumnInternal(scratch.data(), metricIn, whichColumn, columnOut, 0, fixZeros);
+        roiColumn = roi->getValuePointerForColumn(0);
     }
+    vector<float> scratch(m_numNodes);
+    const float* myColumn = metricIn->getValuePointerForColumn(whichColumn);
+    float* scratchPtr = scratch.data();
+    applyOperator(&myColumn, &scratchPtr, 1, roiColumn, fixZeros);
+    columnOut->setValuesForColumn(0, scratchPtr);
 }
 
 void MetricSmoothingObject::smoothColumn(const MetricFile* metricIn, const int& whichColumn, MetricFile* metricOut, const int& whichOutColumn, const MetricFile* roi, const int& whichRoiColumn, const bool& fixZeros) const
 {
     CaretAssert(metricIn != NULL);
     CaretAssert(metricOut != NULL);
-    if (metricIn->getNumberOfNodes() != (int32_t)m_weightLists.size())
+    if (metricIn->getNumberOfNodes() != m_numNodes)
     {
         throw CaretException("metric does not match surface number of nodes");
     }
-    if (metricOut->getNumberOfNodes() != (int32_t)m_weightLists.size())
+    if (metricOut->getNumberOfNodes() != m_numNodes)
     {
         throw CaretException("output metric does not match surface number of nodes");
     }
-    if (roi != NULL && (roi->getNumberOfNodes() != (int32_t)m_weightLists.size()))
+    if (roi != NULL && (roi->getNumberOfNodes() != m_numNodes))
     {
         throw CaretException("roi does not match surface number of nodes");
     }
@@ -99,13 +261,12 @@ void MetricSmoothingObject::smoothColumn(const MetricFile* metricIn, const int&
     {
         throw CaretException("invalid input column number");
     }
-    vector<float> scratch(metricIn->getNumberOfNodes());
-    if (roi != NULL)
-    {
-        smoothColumnInternal(scratch.data(), metricIn, whichColumn, metricOut, whichOutColumn, roi, whichRoiColumn, fixZeros);
-    } else {
-        smoothColumnInternal(scratch.data(), metricIn, whichColumn, metricOut, whichOutColumn, fixZeros);
-    }
+    vector<float> scratch(m_numNodes);
+    const float* myColumn = metricIn->getValuePointerForColumn(whichColumn);
+    const float* roiColumn = (roi != NULL ? roi->getValuePointerForColumn(whichRoiColumn) : NULL);
+    float* scratchPtr = scratch.data();
+    applyOperator(&myColumn, &scratchPtr, 1, roiColumn, fixZeros);
+    metricOut->setValuesForColumn(whichOutColumn, scratchPtr);
 }
 
 void MetricSmoothingObject::smoothMetric(const MetricFile* metricIn, MetricFile* metricOut, const MetricFile* roi, const bool& fixZeros) const
@@ -113,176 +274,135 @@ void MetricSmoothingObject::smoothMetric(const MetricFile* metricIn, MetricFile*
     CaretAssert(metricIn != NULL);
     CaretAssert(metricOut != NULL);
     int32_t numCols = metricIn->getNumberOfColumns();
-    if (metricIn->getNumberOfNodes() != (int32_t)m_weightLists.size())
+    if (metricIn->getNumberOfNodes() != m_numNodes)
     {
         throw CaretException("metric does not match surface number of nodes");
     }
-    if (metricOut->getNumberOfNodes() != (int32_t)m_weightLists.size() || metricOut->getNumberOfColumns() != numCols)
+    if (metricOut->getNumberOfNodes() != m_numNodes || metricOut->getNumberOfColumns() != numCols)
     {
-        metricOut->setNumberOfNodesAndColumns(m_weightLists.size(), numCols);
+        metricOut->setNumberOfNodesAndColumns(m_numNodes, numCols);
     }
-    vector<float> scratch(metricIn->getNumberOfNodes());
+    const float* roiColumn = NULL;
     if (roi != NULL)
     {
-        if (roi->getNumberOfNodes() != (int32_t)m_weightLists.size())
+        if (roi->getNumberOfNodes() != m_numNodes)
         {
             throw CaretException("roi does not match surface number of nodes");
         }
-        for (int32_t i = 0; i < numCols; ++i)
+        roiColumn = roi->getValuePointerForColumn(0);
+    }
+    int32_t blockCols = min(numCols, (int32_t)WeightOperatorFile::COLUMN_BLOCK);
+    vector<float> scratch((int64_t)m_numNodes * blockCols);
+    vector<const float*> inputs(blockCols);
+    vector<float*> outputs(blockCols);
+    for (int32_t start = 0; start < numCols; start += blockCols)
+    {//smooth several columns per pass, so each row of the operator is read once per block rather than once per column
+        int32_t numThisBlock = min(blockCols, numCols - start);
+        for (int32_t c = 0; c < numThisBlock; ++c)
         {
-            smoothColumnInternal(scratch.data(), metricIn, i, metricOut, i, roi, 0, fixZeros);
+            inputs[c] = metricIn->getValuePointerForColumn(start + c);
+            outputs[c] = scratch.data() + (int64_t)m_numNodes * c;
         }
-    } else {
-        for (int32_t i = 0; i < numCols; ++i)
+        applyOperator(inputs.data(), outputs.data(), numThisBlock, roiColumn, fixZeros);
+        for (int32_t c = 0; c < numThisBlock; ++c)
         {
-            smoothColumnInternal(scratch.data(), metricIn, i, metricOut, i, fixZeros);
+            metricOut->setValuesForColumn(start + c, outputs[c]);
         }
     }
 }
 
-void MetricSmoothingObject::smoothColumnInternal(float* scratch, const MetricFile* metricIn, const int& whichColumn, MetricFile* metricOut, const int& whichOutColumn, const bool& fixZeros) const
-{
-    CaretAssert(metricIn != NULL);//asserts only, and only basic checks, these functions are private
-    CaretAssert(metricOut != NULL);
-    CaretAssert(scratch != NULL);
-    CaretAssert(whichColumn >= 0 && whichColumn < metricIn->getNumberOfColumns());
-    CaretAssert(whichOutColumn >= 0 && whichOutColumn < metricOut->getNumberOfColumns());
-    const float* myColumn = metricIn->getValuePointerForColumn(whichColumn);
-    int32_t numNodes = metricIn->getNumberOfNodes();
-    if (fixZeros)//special case early to keep branching down
-    {
+void MetricSmoothingObject::applyOperator(const float* const* inputs, float* const* outputs, const int32_t& numColumns, const float* roiColumn, const bool& fixZeros) const
+{//each column accumulates in the same order as smoothing it alone would, so blocking columns doesn't change the results
+    CaretAssert(numColumns > 0 && numColumns <= WeightOperatorFile::COLUMN_BLOCK);
 #pragma omp CARET_PARFOR schedule(dynamic)
-        for (int32_t i = 0; i < numNodes; ++i)
+    for (int32_t i = 0; i < m_numNodes; ++i)
+    {
+        float sum[WeightOperatorFile::COLUMN_BLOCK], weightsum[WeightOperatorFile::COLUMN_BLOCK];
+        if ((roiColumn != NULL && !(roiColumn[i] > 0.0f)) || m_weightSums[i] == 0.0f)//skip nodes with no neighbors quickly
         {
-            const WeightList& myWeightRef = m_weightLists[i];
-            if (myWeightRef.m_weightSum != 0.0f)//skip nodes with no neighbors quickly
+            for (int32_t c = 0; c < numColumns; ++c)
             {
-                float sum = 0.0f, weightsum = 0.0f;
-                int32_t numWeights = myWeightRef.m_nodes.size();
-                for (int32_t j = 0; j < numWeights; ++j)
-                {
-                    float value = myColumn[myWeightRef.m_nodes[j]];
-                    if (value != 0.0f)
-                    {
-                        float weight = myWeightRef.m_weights[j];
-                        sum += weight * value;
-                        weightsum += weight;
-                    }
-                }
-                if (weightsum != 0.0f)
-                {
-                    scratch[i] = sum / weightsum;
-                } else {
-                    scratch[i] = 0.0f;
-                }
-            } else {
-                scratch[i] = 0.0f;//but we do need to zero what we skip, so a list of nodes to check may not help
+                outputs[c][i] = 0.0f;//but we do need to zero what we skip, so a list of nodes to check may not help
             }
+            continue;
         }
-    } else {
-#pragma omp CARET_PARFOR schedule(dynamic)
-        for (int32_t i = 0; i < numNodes; ++i)
+        for (int32_t c = 0; c < numColumns; ++c)
         {
-            const WeightList& myWeightRef = m_weightLists[i];
-            if (myWeightRef.m_weightSum != 0.0f)
-            {
-                float sum = 0.0f;
-                int32_t numWeights = myWeightRef.m_nodes.size();
-                for (int32_t j = 0; j < numWeights; ++j)
-                {
-                    sum += myWeightRef.m_weights[j] * myColumn[myWeightRef.m_nodes[j]];
-                }
-                scratch[i] = sum / myWeightRef.m_weightSum;
-            } else {
-                scratch[i] = 0.0f;
-            }
+            sum[c] = 0.0f;
+            weightsum[c] = 0.0f;
         }
-    }
-    metricOut->setValuesForColumn(whichOutColumn, scratch);
-}
-
-void MetricSmoothingObject::smoothColumnInternal(float* scratch, const MetricFile* metricIn, const int& whichColumn, MetricFile* metricOut, const int& whichOutColumn, const MetricFile* roi, const int& whichRoiColumn, const bool& fixZeros) const
-{
-    CaretAssert(metricIn != NULL);//asserts only, and only basic checks, these functions are private
-    CaretAssert(metricOut != NULL);
-    CaretAssert(scratch != NULL);
-    CaretAssert(roi != NULL);
-    CaretAssert(whichColumn >= 0 && whichColumn < metricIn->getNumberOfColumns());
-    CaretAssert(whichOutColumn >= 0 && whichOutColumn < metricOut->getNumberOfColumns());
-    CaretAssert(whichRoiColumn >= 0 && whichRoiColumn < roi->getNumberOfColumns());
-    const float* myColumn = metricIn->getValuePointerForColumn(whichColumn);
-    const float* roiColumn = roi->getValuePointerForColumn(whichRoiColumn);
-    int32_t numNodes = metricIn->getNumberOfNodes();
-    if (fixZeros)//special case early to keep branching down
-    {
-#pragma omp CARET_PARFOR schedule(dynamic)
-        for (int32_t i = 0; i < numNodes; ++i)
+        int64_t rowEnd = m_rowStart[i + 1];
+        if (roiColumn == NULL)
         {
-            const WeightList& myWeightRef = m_weightLists[i];
-            if (roiColumn[i] > 0.0f && myWeightRef.m_weightSum != 0.0f)//skip nodes with no neighbors quickly
+            if (fixZeros)
             {
-                float sum = 0.0f, weightsum = 0.0f;
-                int32_t numWeights = myWeightRef.m_nodes.size();
-                for (int32_t j = 0; j < numWeights; ++j)
+                for (int64_t j = m_rowStart[i]; j < rowEnd; ++j)
                 {
-                    int32_t neighbor = myWeightRef.m_nodes[j];
-                    float value = myColumn[neighbor];
-                    if (roiColumn[neighbor] > 0.0f && value != 0.0f)
+                    int32_t neighbor = m_rowNodes[j];
+                    float weight = m_rowWeights[j];
+                    for (int32_t c = 0; c < numColumns; ++c)
                     {
-                        float weight = myWeightRef.m_weights[j];
-                        sum += weight * value;
-                        weightsum += weight;
+                        float value = inputs[c][neighbor];
+                        if (value != 0.0f)
+                        {
+                            sum[c] += weight * value;
+                            weightsum[c] += weight;
+                        }
                     }
                 }
-                if (weightsum != 0.0f)
+            } else {//the common case, the precomputed row sum is the normalization
+                for (int64_t j = m_rowStart[i]; j < rowEnd; ++j)
                 {
-                    scratch[i] = sum / weightsum;
-                } else {
-                    scratch[i] = 0.0f;
+                    int32_t neighbor = m_rowNodes[j];
+                    float weight = m_rowWeights[j];
+                    for (int32_t c = 0; c < numColumns; ++c)
+                    {
+                        sum[c] += weight * inputs[c][neighbor];
+                    }
                 }
-            } else {
-                scratch[i] = 0.0f;//but we do need to zero what we skip, so a list of nodes to check may not help
+                for (int32_t c = 0; c < numColumns; ++c)
+                {
+                    outputs[c][i] = sum[c] / m_weightSums[i];
+                }
+                continue;
             }
-        }
-    } else {
-#pragma omp CARET_PARFOR schedule(dynamic)
-        for (int32_t i = 0; i < numNodes; ++i)
-        {
-            const WeightList& myWeightRef = m_weightLists[i];
-            if (roiColumn[i] > 0.0f && myWeightRef.m_weightSum != 0.0f)
+        } else {
+            for (int64_t j = m_rowStart[i]; j < rowEnd; ++j)
             {
-                float sum = 0.0f, weightsum = 0.0f;
-                int32_t numWeights = myWeightRef.m_nodes.size();
-                for (int32_t j = 0; j < numWeights; ++j)
+                int32_t neighbor = m_rowNodes[j];
+                if (roiColumn[neighbor] > 0.0f)
                 {
-                    int32_t neighbor = myWeightRef.m_nodes[j];
-                    if (roiColumn[neighbor] > 0.0f)
+                    float weight = m_rowWeights[j];
+                    for (int32_t c = 0; c < numColumns; ++c)
                     {
-                        float weight = myWeightRef.m_weights[j];
-                        sum += weight * myColumn[neighbor];
-                        weightsum += weight;
+                        float value = inputs[c][neighbor];
+                        if (!fixZeros || value != 0.0f)
+                        {
+                            sum[c] += weight * value;
+                            weightsum[c] += weight;
+                        }
                     }
                 }
-                if (weightsum != 0.0f)
-                {
-                    scratch[i] = sum / weightsum;
-                } else {
-                    scratch[i] = 0.0f;
-                }
+            }
+        }
+        for (int32_t c = 0; c < numColumns; ++c)
+        {
+            if (weightsum[c] != 0.0f)
+            {
+                outputs[c][i] = sum[c] / weightsum[c];
             } else {
-                scratch[i] = 0.0f;
+                outputs[c][i] = 0.0f;
             }
         }
     }
-    metricOut->setValuesForColumn(whichOutColumn, scratch);
 }
 
-void MetricSmoothingObject::precomputeWeightsGeoGauss(const SurfaceFile* mySurf, float myKernel)
+void MetricSmoothingObject::precomputeWeightsGeoGauss(const SurfaceFile* mySurf, float myKernel, vector<WeightList>& weightsOut)
 {
     int32_t numNodes = mySurf->getNumberOfNodes();
     float myGeoDist = myKernel * 3.0f;
     float gaussianDenom = -0.5f / myKernel / myKernel;
-    m_weightLists.resize(numNodes);
+    weightsOut.resize(numNodes);
 #pragma omp CARET_PAR
     {
         CaretPointer<TopologyHelper> myTopoHelp = mySurf->getTopologyHelper();//don't really need one per thread here, but good practice in case we want getNeighborsToDepth
@@ -291,32 +411,32 @@ void MetricSmoothingObject::precomputeWeightsGeoGauss(const SurfaceFile* mySurf,
 #pragma omp CARET_FOR schedule(dynamic)
         for (int32_t i = 0; i < numNodes; ++i)
         {
-            myGeoHelp->getNodesToGeoDist(i, myGeoDist, m_weightLists[i].m_nodes, distances, true);
+            myGeoHelp->getNodesToGeoDist(i, myGeoDist, weightsOut[i].m_nodes, distances, true);
             if (distances.size() < 7)
             {
-                m_weightLists[i].m_nodes = myTopoHelp->getNodeNeighbors(i);
-                m_weightLists[i].m_nodes.push_back(i);
-                myGeoHelp->getGeoToTheseNodes(i, m_weightLists[i].m_nodes, distances, true);
+                weightsOut[i].m_nodes = myTopoHelp->getNodeNeighbors(i);
+                weightsOut[i].m_nodes.push_back(i);
+                myGeoHelp->getGeoToTheseNodes(i, weightsOut[i].m_nodes, distances, true);
             }
             int32_t numNeigh = (int32_t)distances.size();
-            m_weightLists[i].m_weights.resize(numNeigh);
-            m_weightLists[i].m_weightSum = 0.0f;
+            weightsOut[i].m_weights.resize(numNeigh);
+            weightsOut[i].m_weightSum = 0.0f;
             for (int32_t j = 0; j < numNeigh; ++j)
             {
                 float weight = exp(distances[j] * distances[j] * gaussianDenom);//exp(- dist ^ 2 / (2 * sigma ^ 2))
-                m_weightLists[i].m_weights[j] = weight;
-                m_weightLists[i].m_weightSum += weight;
+                weightsOut[i].m_weights[j] = weight;
+                weightsOut[i].m_weightSum += weight;
             }
         }
     }
 }
 
-void MetricSmoothingObject::precomputeWeightsROIGeoGauss(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi)
+void MetricSmoothingObject::precomputeWeightsROIGeoGauss(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi, vector<WeightList>& weightsOut)
 {
     int32_t numNodes = mySurf->getNumberOfNodes();
     float myGeoDist = myKernel * 3.0f;
     float gaussianDenom = -0.5f / myKernel / myKernel;
-    m_weightLists.resize(numNodes);
+    weightsOut.resize(numNodes);
     const float* myRoiColumn = theRoi->getValuePointerForColumn(0);
 #pragma omp CARET_PAR
     {
@@ -337,17 +457,17 @@ void MetricSmoothingObject::precomputeWeightsROIGeoGauss(const SurfaceFile* mySu
                     myGeoHelp->getGeoToTheseNodes(i, nodes, distances, true);
                 }
                 int32_t numNeigh = (int32_t)distances.size();
-                m_weightLists[i].m_weights.reserve(numNeigh);
-                m_weightLists[i].m_nodes.reserve(numNeigh);
-                m_weightLists[i].m_weightSum = 0.0f;
+                weightsOut[i].m_weights.reserve(numNeigh);
+                weightsOut[i].m_nodes.reserve(numNeigh);
+                weightsOut[i].m_weightSum = 0.0f;
                 for (int32_t j = 0; j < numNeigh; ++j)
                 {
                     if (myRoiColumn[nodes[j]] > 0.0f)
                     {
                         float weight = exp(distances[j] * distances[j] * gaussianDenom);//exp(- dist ^ 2 / (2 * sigma ^ 2))
-                        m_weightLists[i].m_weights.push_back(weight);
-                        m_weightLists[i].m_nodes.push_back(nodes[j]);
-                        m_weightLists[i].m_weightSum += weight;
+                        weightsOut[i].m_weights.push_back(weight);
+                        weightsOut[i].m_nodes.push_back(nodes[j]);
+                        weightsOut[i].m_weightSum += weight;
                     }
                 }
             }
@@ -355,7 +475,7 @@ void MetricSmoothingObject::precomputeWeightsROIGeoGauss(const SurfaceFile* mySu
     }
 }
 
-void MetricSmoothingObject::precomputeWeightsGeoGaussArea(const SurfaceFile* mySurf, float myKernel)
+void MetricSmoothingObject::precomputeWeightsGeoGaussArea(const SurfaceFile* mySurf, float myKernel, vector<WeightList>& weightsOut)
 {//this method is normalized in two ways to provide evenly diffusing smoothing with equivalent sum of areas * values as input
     int32_t numNodes = mySurf->getNumberOfNodes();
     float myGeoDist = myKernel * 3.0f;
@@ -397,13 +517,13 @@ void MetricSmoothingObject::precomputeWeightsGeoGaussArea(const SurfaceFile* myS
             tempList[i].m_weightSum = nodeAreas[i];
         }
     }
-    m_weightLists.resize(numNodes);//now convert it to gathering kernels
+    weightsOut.resize(numNodes);//now convert it to gathering kernels
     for (int32_t i = 0; i < numNodes; ++i)//sadly, this is VERY hard to parallelize in a manner that is efficient, since it needs random access modification
     {
-        m_weightLists[i].m_weightSum = 0.0f;//memory initialization may not go much faster in parallel
+        weightsOut[i].m_weightSum = 0.0f;//memory initialization may not go much faster in parallel
         size_t neighborCount = tempList[i].m_nodes.size();
-        m_weightLists[i].m_nodes.reserve(neighborCount);//also preallocate the expected number of nodes (geodesic distance should be symmetric except for rounding errors, so it should usually be exact)
-        m_weightLists[i].m_weights.reserve(neighborCount);
+        weightsOut[i].m_nodes.reserve(neighborCount);//also preallocate the expected number of nodes (geodesic distance should be symmetric except for rounding errors, so it should usually be exact)
+        weightsOut[i].m_weights.reserve(neighborCount);
     }
     for (int32_t i = 0; i < numNodes; ++i)//and this needs to push onto random vectors in the weight list
     {
@@ -412,14 +532,14 @@ void MetricSmoothingObject::precomputeWeightsGeoGaussArea(const SurfaceFile* myS
         {
             int32_t node = tempList[i].m_nodes[j];
             float weight = tempList[i].m_weights[j];
-            m_weightLists[node].m_nodes.push_back(i);
-            m_weightLists[node].m_weights.push_back(weight);
-            m_weightLists[node].m_weightSum += weight;
+            weightsOut[node].m_nodes.push_back(i);
+            weightsOut[node].m_weights.push_back(weight);
+            weightsOut[node].m_weightSum += weight;
         }
     }
 }
 
-void MetricSmoothingObject::precomputeWeightsROIGeoGaussArea(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi)
+void MetricSmoothingObject::precomputeWeightsROIGeoGaussArea(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi, vector<WeightList>& weightsOut)
 {
     int32_t numNodes = mySurf->getNumberOfNodes();
     float myGeoDist = myKernel * 3.0f;
@@ -470,13 +590,13 @@ void MetricSmoothingObject::precomputeWeightsROIGeoGaussArea(const SurfaceFile*
             }
         }
     }
-    m_weightLists.resize(numNodes);//now convert it to gathering kernels
+    weightsOut.resize(numNodes);//now convert it to gathering kernels
     for (int32_t i = 0; i < numNodes; ++i)//sadly, this is VERY hard to parallelize in a manner that is efficient, since it needs random access modification
     {
-        m_weightLists[i].m_weightSum = 0.0f;//memory initialization may not go much faster in parallel
+        weightsOut[i].m_weightSum = 0.0f;//memory initialization may not go much faster in parallel
         size_t neighborCount = tempList[i].m_nodes.size();
-        m_weightLists[i].m_nodes.reserve(neighborCount);//also preallocate the expected number of nodes, again, should be exact except for rounding errors in geodesic distance
-        m_weightLists[i].m_weights.reserve(neighborCount);
+        weightsOut[i].m_nodes.reserve(neighborCount);//also preallocate the expected number of nodes, again, should be exact except for rounding errors in geodesic distance
+        weightsOut[i].m_weights.reserve(neighborCount);
     }
     for (int32_t i = 0; i < numNodes; ++i)//and this needs to push onto random vectors in the weight list
     {
@@ -485,14 +605,14 @@ void MetricSmoothingObject::precomputeWeightsROIGeoGaussArea(const SurfaceFile*
         {
             int32_t node = tempList[i].m_nodes[j];
             float weight = tempList[i].m_weights[j];
-            m_weightLists[node].m_nodes.push_back(i);
-            m_weightLists[node].m_weights.push_back(weight);
-            m_weightLists[node].m_weightSum += weight;
+            weightsOut[node].m_nodes.push_back(i);
+            weightsOut[node].m_weights.push_back(weight);
+            weightsOut[node].m_weightSum += weight;
         }
     }
 }
 
-void MetricSmoothingObject::precomputeWeightsGeoGaussEqual(const SurfaceFile* mySurf, float myKernel)
+void MetricSmoothingObject::precomputeWeightsGeoGaussEqual(const SurfaceFile* mySurf, float myKernel, vector<WeightList>& weightsOut)
 {//this method is normalized in two ways to provide evenly diffusing smoothing with equivalent sum of values as input - this special purpose smoothing is for things that should not be integrated across the surface
     int32_t numNodes = mySurf->getNumberOfNodes();
     float myGeoDist = myKernel * 3.0f;
@@ -532,13 +652,13 @@ void MetricSmoothingObject::precomputeWeightsGeoGaussEqual(const SurfaceFile* my
             tempList[i].m_weightSum = 1.0f;
         }
     }
-    m_weightLists.resize(numNodes);//now convert it to gathering kernels
+    weightsOut.resize(numNodes);//now convert it to gathering kernels
     for (int32_t i = 0; i < numNodes; ++i)//sadly, this is VERY hard to parallelize in a manner that is efficient, since it needs random access modification
     {
-        m_weightLists[i].m_weightSum = 0.0f;//memory initialization may not go much faster in parallel
+        weightsOut[i].m_weightSum = 0.0f;//memory initialization may not go much faster in parallel
         size_t neighborCount = tempList[i].m_nodes.size();
-        m_weightLists[i].m_nodes.reserve(neighborCount);//also preallocate the expected number of nodes (geodesic distance should be symmetric except for rounding errors, so it should usually be exact)
-        m_weightLists[i].m_weights.reserve(neighborCount);
+        weightsOut[i].m_nodes.reserve(neighborCount);//also preallocate the expected number of nodes (geodesic distance should be symmetric except for rounding errors, so it should usually be exact)
+        weightsOut[i].m_weights.reserve(neighborCount);
     }
     for (int32_t i = 0; i < numNodes; ++i)//and this needs to push onto random vectors in the weight list
     {
@@ -547,14 +667,14 @@ void MetricSmoothingObject::precomputeWeightsGeoGaussEqual(const SurfaceFile* my
         {
             int32_t node = tempList[i].m_nodes[j];
             float weight = tempList[i].m_weights[j];
-            m_weightLists[node].m_nodes.push_back(i);
-            m_weightLists[node].m_weights.push_back(weight);
-            m_weightLists[node].m_weightSum += weight;
+            weightsOut[node].m_nodes.push_back(i);
+            weightsOut[node].m_weights.push_back(weight);
+            weightsOut[node].m_weightSum += weight;
         }
     }
 }
 
-void MetricSmoothingObject::precomputeWeightsROIGeoGaussEqual(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi)
+void MetricSmoothingObject::precomputeWeightsROIGeoGaussEqual(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi, vector<WeightList>& weightsOut)
 {
     int32_t numNodes = mySurf->getNumberOfNodes();
     float myGeoDist = myKernel * 3.0f;
@@ -603,13 +723,13 @@ void MetricSmoothingObject::precomputeWeightsROIGeoGaussEqual(const SurfaceFile*
             }
         }
     }
-    m_weightLists.resize(numNodes);//now convert it to gathering kernels
+    weightsOut.resize(numNodes);//now convert it to gathering kernels
     for (int32_t i = 0; i < numNodes; ++i)//sadly, this is VERY hard to parallelize in a manner that is efficient, since it needs random access modification
     {
-        m_weightLists[i].m_weightSum = 0.0f;//memory initialization may not go much faster in parallel
+        weightsOut[i].m_weightSum = 0.0f;//memory initialization may not go much faster in parallel
         size_t neighborCount = tempList[i].m_nodes.size();
-        m_weightLists[i].m_nodes.reserve(neighborCount);//also preallocate the expected number of nodes, again, should be exact except for rounding errors in geodesic distance
-        m_weightLists[i].m_weights.reserve(neighborCount);
+        weightsOut[i].m_nodes.reserve(neighborCount);//also preallocate the expected number of nodes, again, should be exact except for rounding errors in geodesic distance
+        weightsOut[i].m_weights.reserve(neighborCount);
     }
     for (int32_t i = 0; i < numNodes; ++i)//and this needs to push onto random vectors in the weight list
     {
@@ -618,27 +738,28 @@ void MetricSmoothingObject::precomputeWeightsROIGeoGaussEqual(const SurfaceFile*
         {
             int32_t node = tempList[i].m_nodes[j];
             float weight = tempList[i].m_weights[j];
-            m_weightLists[node].m_nodes.push_back(i);
-            m_weightLists[node].m_weights.push_back(weight);
-            m_weightLists[node].m_weightSum += weight;
+            weightsOut[node].m_nodes.push_back(i);
+            weightsOut[node].m_weights.push_back(weight);
+            weightsOut[node].m_weightSum += weight;
         }
     }
 }
 
 void MetricSmoothingObject::precomputeWeights(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi, Method myMethod)
 {
+    vector<WeightList> gatherLists;
     if (theRoi != NULL)
     {
         switch (myMethod)
         {
             case GEO_GAUSS_AREA:
-                precomputeWeightsROIGeoGaussArea(mySurf, myKernel, theRoi);
+                precomputeWeightsROIGeoGaussArea(mySurf, myKernel, theRoi, gatherLists);
                 break;
             case GEO_GAUSS_EQUAL:
-                precomputeWeightsROIGeoGaussEqual(mySurf, myKernel, theRoi);
+                precomputeWeightsROIGeoGaussEqual(mySurf, myKernel, theRoi, gatherLists);
                 break;
             case GEO_GAUSS:
-                precomputeWeightsROIGeoGauss(mySurf, myKernel, theRoi);
+                precomputeWeightsROIGeoGauss(mySurf, myKernel, theRoi, gatherLists);
                 break;
             default:
                 throw CaretException("unknown smoothing method specified");
@@ -647,16 +768,17 @@ void MetricSmoothingObject::precomputeWeights(const SurfaceFile* mySurf, float m
         switch (myMethod)
         {
             case GEO_GAUSS_AREA:
-                precomputeWeightsGeoGaussArea(mySurf, myKernel);
+                precomputeWeightsGeoGaussArea(mySurf, myKernel, gatherLists);
                 break;
             case GEO_GAUSS_EQUAL:
-                precomputeWeightsGeoGaussEqual(mySurf, myKernel);
+                precomputeWeightsGeoGaussEqual(mySurf, myKernel, gatherLists);
                 break;
             case GEO_GAUSS:
-                precomputeWeightsGeoGauss(mySurf, myKernel);
+                precomputeWeightsGeoGauss(mySurf, myKernel, gatherLists);
                 break;
             default:
                 throw CaretException("unknown smoothing method specified");
         };
     }
+    buildOperator(gatherLists);
 }
@@ -29,6 +29,11 @@
 //
 //NOTE: for a static ROI, it is (sometimes much) more efficient to use it in the constructor, and provide no ROI (NULL) to the functions, using both an ROI in constructor and in method
 //      will result in the effective ROI being the logical AND of the two (intersection).
+//
+//NOTE: the weights are stored as a sparse gathering operator in CSR form (one row per output node), if a cache directory is given to the constructor, the operator is saved there
+//      under a hash of the surface geometry, kernel, method and ROI, and later constructions with identical inputs load it instead of recomputing geodesic distances.
+
+#include "AString.h"
 
 #include "stdint.h"
 #include "stddef.h"
@@ -48,10 +53,12 @@ namespace caret {
             GEO_GAUSS_EQUAL,
             GEO_GAUSS
         };
-        MetricSmoothingObject(const SurfaceFile* mySurf, const float& kernel, const MetricFile* myRoi = NULL, Method myMethod = GEO_GAUSS_AREA);
+        MetricSmoothingObject(const SurfaceFile* mySurf, const float& kernel, const MetricFile* myRoi = NULL, Method myMethod = GEO_GAUSS_AREA, const AString& cacheDirectory = "");
         void smoothColumn(const MetricFile* metricIn, const int& whichColumn, MetricFile* columnOut, const MetricFile* roi = NULL, const bool& fixZeros = false) const;
         void smoothColumn(const MetricFile* metricIn, const int& whichColumn, MetricFile* metricOut, const int& whichOutColumn, const MetricFile* roi = NULL, const int& whichRoiColumn = 0, const bool& fixZeros = false) const;
         void smoothMetric(const MetricFile* metricIn, MetricFile* metricOut, const MetricFile* roi = NULL, const bool& fixZeros = false) const;
+        ///hex digest identifying the weights that a given surface, kernel, roi and method produce, used to name cache files
+        static AString getWeightCacheKey(const SurfaceFile* mySurf, const float& kernel, const MetricFile* myRoi = NULL, Method myMethod = GEO_GAUSS_AREA);
     private:
         struct WeightList
         {
@@ -59,16 +66,23 @@ namespace caret {
             std::vector<float> m_weights;
             float m_weightSum;
         };
-        std::vector<WeightList> m_weightLists;
-        void smoothColumnInternal(float* scratch, const MetricFile* metricIn, const int& whichColumn, MetricFile* metricOut, const int& whichOutColumn, const bool& fixZeros) const;
-        void smoothColumnInternal(float* scratch, const MetricFile* metricIn, const int& whichColumn, MetricFile* metricOut, const int& whichOutColumn, const MetricFile* roi, const int& whichRoiColumn, const bool& fixZeros) const;
+        int32_t m_numNodes;
+        std::vector<int64_t> m_rowStart;//row i of the operator is entries [m_rowStart[i], m_rowStart[i + 1])
+        std::vector<int32_t> m_rowNodes;
+        std::vector<float> m_rowWeights;
+        std::vector<float> m_weightSums;
+        static const char s_cacheFileMagic[];
+        void applyOperator(const float* const* inputs, float* const* outputs, const int32_t& numColumns, const float* roiColumn, const bool& fixZeros) const;
+        void buildOperator(const std::vector<WeightList>& gatherLists);
+        bool readWeightFile(const AString& fileName, const AString& key);
+        void writeWeightFile(const AString& fileName, const AString& key) const;
         void precomputeWeights(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi, Method myMethod);
-        void precomputeWeightsGeoGauss(const SurfaceFile* mySurf, float myKernel);
-        void precomputeWeightsROIGeoGauss(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi);
-        void precomputeWeightsGeoGaussArea(const SurfaceFile* mySurf, float myKernel);
-        void precomputeWeightsROIGeoGaussArea(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi);
-        void precomputeWeightsGeoGaussEqual(const SurfaceFile* mySurf, float myKernel);
-        void precomputeWeightsROIGeoGaussEqual(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi);
+        void precomputeWeightsGeoGauss(const SurfaceFile* mySurf, float myKernel, std::vector<WeightList>& weightsOut);
+        void precomputeWeightsROIGeoGauss(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi, std::vector<WeightList>& weightsOut);
+        void precomputeWeightsGeoGaussArea(const SurfaceFile* mySurf, float myKernel, std::vector<WeightList>& weightsOut);
+        void precomputeWeightsROIGeoGaussArea(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi, std::vector<WeightList>& weightsOut);
+        void precomputeWeightsGeoGaussEqual(const SurfaceFile* mySurf, float myKernel, std::vector<WeightList>& weightsOut);
+        void precomputeWeightsROIGeoGaussEqual(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi, std::vector<WeightList>& weightsOut);
         MetricSmoothingObject();
     };
     
@@ -46,136 +46,239 @@ DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. */
 
 #include "BoundingBox.h"
-#include "CaretHeap.h"
 #include "SignedDistanceHelper.h"
 #include "SurfaceFile.h"
 #include "TopologyHelper.h"
+
+#include <algorithm>
 #include <cmath>
+#include <limits>
 
 using namespace std;
 using namespace caret;
 
+namespace
+{
+    void boxDistSqr(const float* minCoord, const float* maxCoord, const float* px, const float* py, const float* pz, const int& numPoints, float* distSqrOut)
+    {//no branches, so the loop over the packet can be vectorized
+        for (int p = 0; p < numPoints; ++p)
+        {
+            float dx = max(max(minCoord[0] - px[p], px[p] - maxCoord[0]), 0.0f);
+            float dy = max(max(minCoord[1] - py[p], py[p] - maxCoord[1]), 0.0f);
+            float dz = max(max(minCoord[2] - pz[p], pz[p] - maxCoord[2]), 0.0f);
+            distSqrOut[p] = dx * dx + dy * dy + dz * dz;
+        }
+    }
+    
+    bool anyCloser(const float* distSqr, const float* bestSqr, const int& numPoints)
+    {
+        for (int p = 0; p < numPoints; ++p)
+        {
+            if (distSqr[p] < bestSqr[p]) return true;
+        }
+        return false;
+    }
+    
+    float minValue(const float* values, const int& numPoints)
+    {
+        float ret = values[0];
+        for (int p = 1; p < numPoints; ++p)
+        {
+            if (values[p] < ret) ret = values[p];
+        }
+        return ret;
+    }
+    
+    struct CentroidCompare
+    {
+        const float* m_centroids;
+        int m_axis;
+        CentroidCompare(const float* centroids, const int& axis) : m_centroids(centroids), m_axis(axis) { }
+        bool operator()(const int32_t& left, const int32_t& right) const
+        {
+            return m_centroids[left * 3 + m_axis] < m_centroids[right * 3 + m_axis];
+        }
+    };
+    
+    uint32_t spreadBits(uint32_t value)
+    {//put 2 zero bits between each of the low 10 bits, for interleaving into a morton code
+        value &= 0x3FF;
+        value = (value | (value << 16)) & 0x030000FF;
+        value = (value | (value << 8)) & 0x0300F00F;
+        value = (value | (value << 4)) & 0x030C30C3;
+        value = (value | (value << 2)) & 0x09249249;
+        return value;
+    }
+}
+
 float SignedDistanceHelper::dist(const float coord[3], WindingLogic myWinding)
 {
     CaretMutexLocker locked(&m_mutex);
-    CaretSimpleMinHeap<Oct<SignedDistanceHelperBase::TriVector>*, float> myHeap;
-    myHeap.push(m_base->m_indexRoot, m_base->m_indexRoot->distToPoint(coord));
-    ClosestPointInfo tempInfo, bestInfo;
-    float tempf = -1.0f, bestTriDist = -1.0f;
-    bool first = true;
-    int numChanged = 0;
-    while (!myHeap.isEmpty())
+    ClosestPointInfo bestInfo;
+    float bestTriDist;
+    closestTriangles(coord, 1, &bestInfo, &bestTriDist);
+    if (bestInfo.triangle < 0) return bestTriDist;//no triangles, nothing to take the sign from
+    return bestTriDist * computeSign(coord, bestInfo, myWinding);
+}
+
+void SignedDistanceHelper::dist(const float* coordList, const int64_t& numPoints, WindingLogic myWinding, float* distOut)
+{
+    CaretMutexLocker locked(&m_mutex);
+    vector<int64_t> order;
+    m_base->getSpatialOrder(coordList, numPoints, order);
+    float packetCoords[PACKET_SIZE * 3], packetDists[PACKET_SIZE];
+    ClosestPointInfo packetInfo[PACKET_SIZE];
+    for (int64_t start = 0; start < numPoints; start += PACKET_SIZE)
     {
-        Oct<SignedDistanceHelperBase::TriVector>* curOct = myHeap.pop(&tempf);
-        if (first || tempf < bestTriDist)
+        int packetCount = (int)min((int64_t)PACKET_SIZE, numPoints - start);
+        for (int p = 0; p < packetCount; ++p)
+        {
+            const float* thisCoord = coordList + order[start + p] * 3;
+            packetCoords[p * 3] = thisCoord[0];
+            packetCoords[p * 3 + 1] = thisCoord[1];
+            packetCoords[p * 3 + 2] = thisCoord[2];
+        }
+        closestTriangles(packetCoords, packetCount, packetInfo, packetDists);
+        for (int p = 0; p < packetCount; ++p)
         {
-            if (curOct->m_leaf)
+            if (packetInfo[p].triangle < 0)
             {
-                vector<int32_t>& myVecRef = *(curOct->m_data.m_triList);
-                int numTris = (int)myVecRef.size();
-                for (int i = 0; i < numTris; ++i)
-                {
-                    if (m_triMarked[myVecRef[i]] != 1)
-                    {
-                        m_triMarked[myVecRef[i]] = 1;
-                        m_triMarkChanged[numChanged++] = myVecRef[i];
-                        tempf = unsignedDistToTri(coord, myVecRef[i], tempInfo);
-                        if (first || tempf < bestTriDist)
-                        {
-                            bestInfo = tempInfo;
-                            bestTriDist = tempf;
-                            first = false;
-                        }
-                    }
-                }
+                distOut[order[start + p]] = packetDists[p];
             } else {
-                for (int ci = 0; ci < 2; ++ci)
-                {
-                    for (int cj = 0; cj < 2; ++cj)
-                    {
-                        for (int ck = 0; ck < 2; ++ck)
-                        {
-                            tempf = curOct->m_children[ci][cj][ck]->distToPoint(coord);
-                            if (first || tempf < bestTriDist)
-                            {
-                                myHeap.push(curOct->m_children[ci][cj][ck], tempf);
-                            }
-                        }
-                    }
-                }
+                distOut[order[start + p]] = packetDists[p] * computeSign(packetCoords + p * 3, packetInfo[p], myWinding);
             }
         }
     }
-    while (numChanged)
-    {
-        m_triMarked[m_triMarkChanged[--numChanged]] = 0;//need to do this before computeSign
-    }
-    return bestTriDist * computeSign(coord, bestInfo, myWinding);
 }
 
 void SignedDistanceHelper::barycentricWeights(const float coord[3], BarycentricInfo& baryInfoOut)
 {
     CaretMutexLocker locked(&m_mutex);
-    CaretSimpleMinHeap<Oct<SignedDistanceHelperBase::TriVector>*, float> myHeap;
-    myHeap.push(m_base->m_indexRoot, m_base->m_indexRoot->distToPoint(coord));
-    ClosestPointInfo tempInfo, bestInfo;
-    float tempf = -1.0f, bestTriDist = -1.0f;
-    bool first = true;
-    int numChanged = 0;
-    while (!myHeap.isEmpty())
+    ClosestPointInfo bestInfo;
+    float bestTriDist;
+    closestTriangles(coord, 1, &bestInfo, &bestTriDist);
+    fillBarycentricInfo(bestInfo, bestTriDist, baryInfoOut);
+}
+
+void SignedDistanceHelper::barycentricWeights(const float* coordList, const int64_t& numPoints, BarycentricInfo* baryInfoOut)
+{
+    CaretMutexLocker locked(&m_mutex);
+    vector<int64_t> order;
+    m_base->getSpatialOrder(coordList, numPoints, order);
+    float packetCoords[PACKET_SIZE * 3], packetDists[PACKET_SIZE];
+    ClosestPointInfo packetInfo[PACKET_SIZE];
+    for (int64_t start = 0; start < numPoints; start += PACKET_SIZE)
     {
-        Oct<SignedDistanceHelperBase::TriVector>* curOct = myHeap.pop(&tempf);
-        if (first || tempf < bestTriDist)
+        int packetCount = (int)min((int64_t)PACKET_SIZE, numPoints - start);
+        for (int p = 0; p < packetCount; ++p)
         {
-            if (curOct->m_leaf)
+            const float* thisCoord = coordList + order[start + p] * 3;
+            packetCoords[p * 3] = thisCoord[0];
+            packetCoords[p * 3 + 1] = thisCoord[1];
+            packetCoords[p * 3 + 2] = thisCoord[2];
+        }
+        closestTriangles(packetCoords, packetCount, packetInfo, packetDists);
+        for (int p = 0; p < packetCount; ++p)
+        {
+            fillBarycentricInfo(packetInfo[p], packetDists[p], baryInfoOut[order[start + p]]);
+        }
+    }
+}
+
+void SignedDistanceHelper::closestTriangles(const float* coordList, const int& numPoints, ClosestPointInfo* infoOut, float* distOut)
+{//a node is opened if it could contain a closer triangle for any point in the packet, so nearby points share most of the traversal
+    CaretAssert(numPoints > 0 && numPoints <= PACKET_SIZE);
+    float px[PACKET_SIZE], py[PACKET_SIZE], pz[PACKET_SIZE], bestSqr[PACKET_SIZE], tempSqr[PACKET_SIZE], tempSqr2[PACKET_SIZE];
+    for (int p = 0; p < numPoints; ++p)
+    {
+        px[p] = coordList[p * 3];
+        py[p] = coordList[p * 3 + 1];
+        pz[p] = coordList[p * 3 + 2];
+        bestSqr[p] = numeric_limits<float>::infinity();
+        distOut[p] = -1.0f;
+        infoOut[p].triangle = -1;
+    }
+    if (m_base->m_bvhNodes.empty()) return;//surface has no triangles, so the tree was never built, report no hit
+    const SignedDistanceHelperBase::BVHNode* nodes = m_base->m_bvhNodes.data();
+    const int32_t* bvhTris = m_base->m_bvhTris.data();
+    const float* bvhTriBounds = m_base->m_bvhTriBounds.data();
+    ClosestPointInfo tempInfo;
+    int32_t nodeStack[SignedDistanceHelperBase::BVH_MAX_DEPTH];
+    int stackSize = 0;
+    nodeStack[stackSize++] = 0;
+    while (stackSize > 0)
+    {
+        int32_t curIndex = nodeStack[--stackSize];
+        const SignedDistanceHelperBase::BVHNode& curNode = nodes[curIndex];
+        boxDistSqr(curNode.m_minCoord, curNode.m_maxCoord, px, py, pz, numPoints, tempSqr);//retest, the best distances may have improved since it was pushed
+        if (!anyCloser(tempSqr, bestSqr, numPoints)) continue;
+        if (curNode.m_count > 0)
+        {
+            int32_t leafEnd = curNode.m_start + curNode.m_count;
+            for (int32_t t = curNode.m_start; t < leafEnd; ++t)
             {
-                vector<int32_t>& myVecRef = *(curOct->m_data.m_triList);
-                int numTris = (int)myVecRef.size();
-                for (int i = 0; i < numTris; ++i)
+                const float* triBounds = bvhTriBounds + t * 6;
+                boxDistSqr(triBounds, triBounds + 3, px, py, pz, numPoints, tempSqr);
+                for (int p = 0; p < numPoints; ++p)
                 {
-                    if (m_triMarked[myVecRef[i]] != 1)
+                    if (tempSqr[p] < bestSqr[p])//the exact test is expensive, only do it when the triangle's bounding box is closer than the current best
                     {
-                        m_triMarked[myVecRef[i]] = 1;
-                        m_triMarkChanged[numChanged++] = myVecRef[i];
-                        tempf = unsignedDistToTri(coord, myVecRef[i], tempInfo);
-                        if (first || tempf < bestTriDist)
+                        float tempf = unsignedDistToTri(coordList + p * 3, bvhTris[t], tempInfo);
+                        if (tempf * tempf < bestSqr[p])
                         {
-                            bestInfo = tempInfo;
-                            bestTriDist = tempf;
-                            first = false;
+                            bestSqr[p] = tempf * tempf;
+                            distOut[p] = tempf;
+                            infoOut[p] = tempInfo;
                         }
                     }
                 }
-            } else {
-                for (int ci = 0; ci < 2; ++ci)
+            }
+        } else {
+            int32_t firstChild = curIndex + 1;
+            int32_t secondChild = curNode.m_secondChild;
+            boxDistSqr(nodes[firstChild].m_minCoord, nodes[firstChild].m_maxCoord, px, py, pz, numPoints, tempSqr);
+            boxDistSqr(nodes[secondChild].m_minCoord, nodes[secondChild].m_maxCoord, px, py, pz, numPoints, tempSqr2);
+            bool firstUseful = anyCloser(tempSqr, bestSqr, numPoints), secondUseful = anyCloser(tempSqr2, bestSqr, numPoints);
+            CaretAssert(stackSize + 2 <= SignedDistanceHelperBase::BVH_MAX_DEPTH);
+            if (firstUseful && secondUseful)
+            {
+                if (minValue(tempSqr, numPoints) <= minValue(tempSqr2, numPoints))//push the farther child first, so the nearer one gets searched first
                 {
-                    for (int cj = 0; cj < 2; ++cj)
-                    {
-                        for (int ck = 0; ck < 2; ++ck)
-                        {
-                            tempf = curOct->m_children[ci][cj][ck]->distToPoint(coord);
-                            if (first || tempf < bestTriDist)
-                            {
-                                myHeap.push(curOct->m_children[ci][cj][ck], tempf);
-                            }
-                        }
-                    }
+                    nodeStack[stackSize++] = secondChild;
+                    nodeStack[stackSize++] = firstChild;
+                } else {
+                    nodeStack[stackSize++] = firstChild;
+                    nodeStack[stackSize++] = secondChild;
                 }
+            } else if (firstUseful) {
+                nodeStack[stackSize++] = firstChild;
+            } else if (secondUseful) {
+                nodeStack[stackSize++] = secondChild;
             }
         }
     }
-    while (numChanged)
-    {
-        m_triMarked[m_triMarkChanged[--numChanged]] = 0;//clean up
+}
+
+void SignedDistanceHelper::fillBarycentricInfo(const ClosestPointInfo& myInfo, const float& absDist, BarycentricInfo& baryInfoOut)
+{
+    baryInfoOut.triangle = myInfo.triangle;
+    baryInfoOut.absDistance = absDist;
+    if (myInfo.triangle < 0)
+    {//no triangles were searched
+        baryInfoOut.type = BarycentricInfo::NODE;
+        for (int i = 0; i < 3; ++i)
+        {
+            baryInfoOut.nodes[i] = -1;
+            baryInfoOut.baryWeights[i] = 0.0f;
+        }
+        return;
     }
-    baryInfoOut.triangle = bestInfo.triangle;
-    baryInfoOut.point = bestInfo.tempPoint;
-    baryInfoOut.absDistance = bestTriDist;
-    const int32_t* triNodes = m_base->getTriangle(bestInfo.triangle);
+    baryInfoOut.point = myInfo.tempPoint;
+    const int32_t* triNodes = m_base->getTriangle(myInfo.triangle);
     baryInfoOut.nodes[0] = triNodes[0];
     baryInfoOut.nodes[1] = triNodes[1];
     baryInfoOut.nodes[2] = triNodes[2];
-    switch (bestInfo.type)
+    switch (myInfo.type)
     {
         case 2:
             {
@@ -183,9 +286,9 @@ void SignedDistanceHelper::barycentricWeights(const float coord[3], BarycentricI
                 Vector3D vert1 = m_base->getCoordinate(triNodes[0]);
                 Vector3D vert2 = m_base->getCoordinate(triNodes[1]);
                 Vector3D vert3 = m_base->getCoordinate(triNodes[2]);
-                Vector3D vp1 = vert1 - bestInfo.tempPoint;
-                Vector3D vp2 = vert2 - bestInfo.tempPoint;
-                Vector3D vp3 = vert3 - bestInfo.tempPoint;
+                Vector3D vp1 = vert1 - myInfo.tempPoint;
+                Vector3D vp2 = vert2 - myInfo.tempPoint;
+                Vector3D vp3 = vert3 - myInfo.tempPoint;
                 float weight1 = vp2.cross(vp3).length();
                 float weight2 = vp1.cross(vp3).length();
                 float weight3 = vp1.cross(vp2).length();
@@ -198,20 +301,20 @@ void SignedDistanceHelper::barycentricWeights(const float coord[3], BarycentricI
         case 1:
             {
                 baryInfoOut.type = BarycentricInfo::EDGE;
-                Vector3D vert1 = m_base->getCoordinate(bestInfo.node1);
-                Vector3D vert2 = m_base->getCoordinate(bestInfo.node2);
+                Vector3D vert1 = m_base->getCoordinate(myInfo.node1);
+                Vector3D vert2 = m_base->getCoordinate(myInfo.node2);
                 Vector3D v21hat = vert2 - vert1;
                 float origLength;
                 v21hat = v21hat.normal(&origLength);
-                float tempf = v21hat.dot(bestInfo.tempPoint - vert1);
+                float tempf = v21hat.dot(myInfo.tempPoint - vert1);
                 float weight2 = tempf / origLength;
                 float weight1 = 1.0f - weight2;
                 for (int i = 0; i < 3; ++i)
                 {
-                    if (triNodes[i] == bestInfo.node1)
+                    if (triNodes[i] == myInfo.node1)
                     {
                         baryInfoOut.baryWeights[i] = weight1;
-                    } else if (triNodes[i] == bestInfo.node2) {
+                    } else if (triNodes[i] == myInfo.node2) {
                         baryInfoOut.baryWeights[i] = weight2;
                     } else {
                         baryInfoOut.baryWeights[i] = 0.0f;
@@ -223,7 +326,7 @@ void SignedDistanceHelper::barycentricWeights(const float coord[3], BarycentricI
             baryInfoOut.type = BarycentricInfo::NODE;
                 for (int i = 0; i < 3; ++i)
                 {
-                    if (triNodes[i] == bestInfo.node1)
+                    if (triNodes[i] == myInfo.node1)
                     {
                         baryInfoOut.baryWeights[i] = 1.0f;
                     } else {
@@ -723,6 +826,8 @@ SignedDistanceHelperBase::SignedDistanceHelperBase(const SurfaceFile* mySurf)
     minCoord[0] = myBB[0]; maxCoord[0] = myBB[1];
     minCoord[1] = myBB[2]; maxCoord[1] = myBB[3];
     minCoord[2] = myBB[4]; maxCoord[2] = myBB[5];
+    m_minCoord = minCoord;
+    m_maxCoord = maxCoord;
     m_indexRoot.grabNew(new Oct<TriVector>(minCoord, maxCoord));
     const float* myCoordData = mySurf->getCoordinateData();
     m_numNodes = mySurf->getNumberOfNodes();
@@ -734,6 +839,7 @@ SignedDistanceHelperBase::SignedDistanceHelperBase(const SurfaceFile* mySurf)
     }
     m_numTris = mySurf->getNumberOfTriangles();
     m_triangleList.resize(m_numTris * 3);
+    vector<float> triBounds(m_numTris * 6), centroids(m_numTris * 3);
     for (int32_t i = 0; i < m_numTris; ++i)
     {
         int32_t i3 = i * 3;
@@ -753,6 +859,109 @@ SignedDistanceHelperBase::SignedDistanceHelperBase(const SurfaceFile* mySurf)
             if (myCoordData[thisNode3 + 2] > maxCoord[2]) maxCoord[2] = myCoordData[thisNode3 + 2];
         }
         addTriangle(m_indexRoot, i, minCoord, maxCoord);//use bounding box for now as an easy test to capture any chance of the triangle intersecting the Oct
+        for (int j = 0; j < 3; ++j)
+        {
+            triBounds[i * 6 + j] = minCoord[j];
+            triBounds[i * 6 + 3 + j] = maxCoord[j];
+            centroids[i3 + j] = (minCoord[j] + maxCoord[j]) * 0.5f;
+        }
+    }
+    if (m_numTris > 0)
+    {
+        m_bvhTris.resize(m_numTris);
+        for (int32_t i = 0; i < m_numTris; ++i)
+        {
+            m_bvhTris[i] = i;
+        }
+        m_bvhNodes.reserve(2 * (m_numTris / BVH_LEAF_TRIS + 1));
+        buildBVH(triBounds.data(), centroids.data(), 0, m_numTris);
+        m_bvhTriBounds.resize(m_numTris * 6);//copy bounds into leaf order, so a leaf reads them contiguously
+        for (int32_t i = 0; i < m_numTris; ++i)
+        {
+            for (int j = 0; j < 6; ++j)
+            {
+                m_bvhTriBounds[i * 6 + j] = triBounds[m_bvhTris[i] * 6 + j];
+            }
+        }
+    }
+}
+
+int32_t SignedDistanceHelperBase::buildBVH(const float* triBounds, const float* centroids, const int32_t start, const int32_t end)
+{//median split on the longest axis of the centroids, nodes are added depth-first
+    CaretAssert(end > start);
+    int32_t nodeIndex = (int32_t)m_bvhNodes.size();
+    m_bvhNodes.push_back(BVHNode());//reserve the slot before recursing, fill it in afterwards since push_back may reallocate
+    BVHNode tempNode;
+    float centMin[3], centMax[3];
+    for (int j = 0; j < 3; ++j)
+    {
+        tempNode.m_minCoord[j] = triBounds[m_bvhTris[start] * 6 + j];
+        tempNode.m_maxCoord[j] = triBounds[m_bvhTris[start] * 6 + 3 + j];
+        centMin[j] = centMax[j] = centroids[m_bvhTris[start] * 3 + j];
+    }
+    for (int32_t i = start + 1; i < end; ++i)
+    {
+        const float* thisBounds = triBounds + m_bvhTris[i] * 6;
+        const float* thisCent = centroids + m_bvhTris[i] * 3;
+        for (int j = 0; j < 3; ++j)
+        {
+            if (thisBounds[j] < tempNode.m_minCoord[j]) tempNode.m_minCoord[j] = thisBounds[j];
+            if (thisBounds[3 + j] > tempNode.m_maxCoord[j]) tempNode.m_maxCoord[j] = thisBounds[3 + j];
+            if (thisCent[j] < centMin[j]) centMin[j] = thisCent[j];
+            if (thisCent[j] > centMax[j]) centMax[j] = thisCent[j];
+        }
+    }
+    if (end - start <= BVH_LEAF_TRIS)
+    {
+        tempNode.m_start = start;
+        tempNode.m_count = end - start;
+        tempNode.m_secondChild = -1;
+    } else {
+        int axis = 0;
+        if (centMax[1] - centMin[1] > centMax[axis] - centMin[axis]) axis = 1;
+        if (centMax[2] - centMin[2] > centMax[axis] - centMin[axis]) axis = 2;
+        int32_t mid = start + (end - start) / 2;//split by count even if centroids coincide, so depth stays logarithmic
+        nth_element(m_bvhTris.begin() + start, m_bvhTris.begin() + mid, m_bvhTris.begin() + end, CentroidCompare(centroids, axis));
+        tempNode.m_start = start;
+        tempNode.m_count = 0;
+        buildBVH(triBounds, centroids, start, mid);//first child is always nodeIndex + 1
+        tempNode.m_secondChild = buildBVH(triBounds, centroids, mid, end);
+    }
+    m_bvhNodes[nodeIndex] = tempNode;
+    return nodeIndex;
+}
+
+void SignedDistanceHelperBase::getSpatialOrder(const float* coordList, const int64_t& numPoints, vector<int64_t>& orderOut) const
+{//morton order within the surface bounding box, so consecutive points are near each other, points outside get clamped to the box faces
+    vector<pair<uint32_t, int64_t> > sortKeys(numPoints);
+    float scale[3];
+    for (int j = 0; j < 3; ++j)
+    {
+        float range = m_maxCoord[j] - m_minCoord[j];
+        if (range > 0.0f)
+        {
+            scale[j] = 1023.0f / range;
+        } else {
+            scale[j] = 0.0f;
+        }
+    }
+    for (int64_t i = 0; i < numPoints; ++i)
+    {
+        uint32_t code = 0;
+        for (int j = 0; j < 3; ++j)
+        {
+            float cell = (coordList[i * 3 + j] - m_minCoord[j]) * scale[j];
+            if (!(cell > 0.0f)) cell = 0.0f;//also catches NaN
+            if (cell > 1023.0f) cell = 1023.0f;
+            code |= spreadBits((uint32_t)cell) << j;
+        }
+        sortKeys[i] = make_pair(code, i);
+    }
+    sort(sortKeys.begin(), sortKeys.end());
+    orderOut.resize(numPoints);
+    for (int64_t i = 0; i < numPoints; ++i)
+    {
+        orderOut[i] = sortKeys[i].second;
     }
 }
 
@@ -48,15 +48,29 @@ namespace caret {
                 }
             }
         };
+        struct BVHNode
+        {//flattened in depth-first order, so the first child of an internal node is always the next node
+            float m_minCoord[3], m_maxCoord[3];
+            int32_t m_start, m_count;//range of m_bvhTris for leaves, m_count is 0 for internal nodes
+            int32_t m_secondChild;
+        };
         static const int NUM_TRIS_TO_TEST = 50;//test for whether to split leaf at this number
         static const int NUM_TRIS_TEST_INCR = 50;//and again at further multiples of this
-        CaretPointer<Oct<TriVector> > m_indexRoot;
+        static const int BVH_LEAF_TRIS = 4;//stop splitting bounding volumes at this many triangles
+        static const int BVH_MAX_DEPTH = 64;//median splits keep depth logarithmic, this is far more than int32_t triangles can need
+        CaretPointer<Oct<TriVector> > m_indexRoot;//used for ray and segment tests in computeSign
+        std::vector<BVHNode> m_bvhNodes;//used for closest triangle searches
+        std::vector<int32_t> m_bvhTris;//triangle indices, in leaf order
+        std::vector<float> m_bvhTriBounds;//min and max coords of each triangle, in leaf order, for cheap rejection before the exact test
+        Vector3D m_minCoord, m_maxCoord;//surface bounding box, for sorting query points
         int32_t m_numTris, m_numNodes;
         std::vector<float> m_coordList;//make a copy of what we need from SurfaceFile so that if the SurfaceFile gets destroyed, we don't crash
         std::vector<int32_t> m_triangleList;
         CaretPointer<TopologyHelper> m_topoHelp;
         SignedDistanceHelperBase();
         void addTriangle(Oct<TriVector>* thisOct, int32_t triangle, float minCoord[3], float maxCoord[3]);
+        int32_t buildBVH(const float* triBounds, const float* centroids, const int32_t start, const int32_t end);
+        void getSpatialOrder(const float* coordList, const int64_t& numPoints, std::vector<int64_t>& orderOut) const;
         const float* getCoordinate(const int32_t nodeIndex) const;//make these public? probably don't want them to be widely used, that is what SurfaceFile is for (but we don't want to store a SurfaceFile pointer)
         const int32_t* getTriangle(const int32_t tileIndex) const;
     public:
@@ -92,6 +106,7 @@ namespace caret {
             NORMALS
         };
     private:
+        static const int PACKET_SIZE = 8;//number of nearby query points that share one tree traversal
         CaretMutex m_mutex;
         CaretPointer<SignedDistanceHelperBase> m_base;
         CaretArray<int> m_triMarked;
@@ -104,17 +119,27 @@ namespace caret {
             Vector3D tempPoint;
         };
         float unsignedDistToTri(const float coord[3], int32_t triangle, ClosestPointInfo& myInfo);
+        void closestTriangles(const float* coordList, const int& numPoints, ClosestPointInfo* infoOut, float* distOut);
+        void fillBarycentricInfo(const ClosestPointInfo& myInfo, const float& absDist, BarycentricInfo& baryInfoOut);
         int computeSign(const float coord[3], ClosestPointInfo myInfo, WindingLogic myWinding);
         bool pointInTri(Vector3D verts[3], Vector3D inPlane, int majAxis, int midAxis);
+        friend class SignedDistanceHelperTest;
     public:
         SignedDistanceHelper(CaretPointer<SignedDistanceHelperBase> myBase);
         
-        ///return the signed distance value at the point
+        ///return the signed distance value at the point, -1 if the surface has no triangles
         float dist(const float coord[3], WindingLogic myWinding);
         
         ///find the closest point ON the surface, and return information about it
         ///will never have negative barycentric weights, or a point outside the triangle
+        ///if the surface has no triangles, triangle and nodes are -1 and absDistance is -1
         void barycentricWeights(const float coordIn[3], BarycentricInfo& baryInfoOut);
+        
+        ///signed distance for many points (3 floats each), searched in spatially sorted packets - much faster than one at a time
+        void dist(const float* coordList, const int64_t& numPoints, WindingLogic myWinding, float* distOut);
+        
+        ///closest surface point info for many points (3 floats each), searched in spatially sorted packets
+        void barycentricWeights(const float* coordList, const int64_t& numPoints, BarycentricInfo* baryInfoOut);
     };
 
 }
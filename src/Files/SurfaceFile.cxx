@@ -45,6 +45,9 @@
 
 using namespace caret;
 
+static CaretMutex s_drawingVersionMutex;
+static int64_t s_drawingVersionCounter = 0;
+
 /**
  * Constructor.
  */
@@ -497,6 +500,20 @@ SurfaceFile::initializeMembersSurfaceFile()
     m_geoHelperIndex = 0;
     m_topoHelperIndex = 0;
     m_normalsComputed = false;
+    m_geometryVersion = newDrawingVersion();
+    m_nodeColoringVersion = newDrawingVersion();
+}
+
+/**
+ * @return A new value for the geometry or coloring versions, unique across
+ * all surfaces so that a new surface at the address of a deleted one
+ * never matches its cached drawing data.
+ */
+int64_t
+SurfaceFile::newDrawingVersion()
+{
+    CaretMutexLocker locked(&s_drawingVersionMutex);
+    return ++s_drawingVersionCounter;
 }
 
 /**
@@ -550,6 +567,7 @@ SurfaceFile::computeNormals(const bool averageNormals)
     }
     m_normalsComputed = true;
     m_normalsAveraged = averageNormals;
+    m_geometryVersion = newDrawingVersion();
     int32_t numCoords = this->getNumberOfNodes();
     if (numCoords > 0) {
         this->normalVectors.resize(numCoords * 3);
@@ -792,6 +810,19 @@ void SurfaceFile::getGeodesicHelper(CaretPointer<GeodesicHelper>& helpOut) const
     helpOut = ret;
 }
 
+CaretPointer<GeodesicHelperBase> SurfaceFile::getGeodesicHelperBase() const
+{
+    CaretMutexLocker myLock(&m_geoHelperMutex);
+    if (m_geoBase == NULL)
+    {
+        m_geoHelpers.clear();
+        m_geoHelperIndex = 0;
+        m_geoBase.grabNew(new GeodesicHelperBase(this));
+    }
+    CaretPointer<GeodesicHelperBase> ret = m_geoBase;//copy while locked, same as for helpers
+    return ret;
+}
+
 CaretPointer<GeodesicHelper> SurfaceFile::getGeodesicHelper() const
 {//this convenience function is here because in order to guarantee thread safety, the real function explicitly copies to a reference argument before letting the mutex unlock
     CaretPointer<GeodesicHelper> ret;//the copy of a return should take place before destructors (including the locker for the helper mutex), but just to be safe
@@ -869,8 +900,73 @@ CaretPointer<SignedDistanceHelper> SurfaceFile::getSignedDistanceHelper() const
     return ret;
 }
 
+void SurfaceFile::shareHelpers(const SurfaceFile& other) const
+{//the helper bases take a snapshot of the surface when built, so nothing in them refers back to the surface that built them
+    CaretAssert(getNumberOfNodes() == other.getNumberOfNodes() && getNumberOfTriangles() == other.getNumberOfTriangles());
+    if (&other == this) return;
+    CaretPointer<GeodesicHelperBase> geoBase;
+    CaretPointer<TopologyHelperBase> topoBase;
+    CaretPointer<SignedDistanceHelperBase> distBase;
+    CaretPointer<CaretPointLocator> locator;
+    {//copy from the other surface first, so that the two surfaces' mutexes are never held at the same time
+        CaretMutexLocker myLock(&other.m_geoHelperMutex);
+        geoBase = other.m_geoBase;
+    }
+    {
+        CaretMutexLocker myLock(&other.m_topoHelperMutex);
+        topoBase = other.m_topoBase;
+    }
+    {
+        CaretMutexLocker myLock(&other.m_distHelperMutex);
+        distBase = other.m_distBase;
+    }
+    {
+        CaretMutexLocker myLock(&other.m_locatorMutex);
+        locator = other.m_locator;
+    }
+    if (geoBase != NULL)
+    {
+        CaretMutexLocker myLock(&m_geoHelperMutex);
+        if (m_geoBase == NULL)
+        {
+            m_geoHelpers.clear();
+            m_geoHelperIndex = 0;
+            m_geoBase = geoBase;
+        }
+    }
+    if (topoBase != NULL)
+    {
+        CaretMutexLocker myLock(&m_topoHelperMutex);
+        if (m_topoBase == NULL)
+        {
+            m_topoHelpers.clear();
+            m_topoHelperIndex = 0;
+            m_topoBase = topoBase;
+        }
+    }
+    if (distBase != NULL)
+    {
+        CaretMutexLocker myLock(&m_distHelperMutex);
+        if (m_distBase == NULL)
+        {
+            m_distHelpers.clear();
+            m_distHelperIndex = 0;
+            m_distBase = distBase;
+        }
+    }
+    if (locator != NULL)
+    {
+        CaretMutexLocker myLock(&m_locatorMutex);
+        if (m_locator == NULL)
+        {
+            m_locator = locator;
+        }
+    }
+}
+
 void SurfaceFile::invalidateHelpers()
 {
+    m_geometryVersion = newDrawingVersion();//helpers are invalidated whenever coordinates or triangles change
     if (m_geoBase != NULL)
     {
         CaretMutexLocker myLock(&m_geoHelperMutex);//make this function threadsafe
@@ -1001,6 +1097,7 @@ SurfaceFile::applyMatrix(const Matrix4x4& matrix)
             matrix.multiplyPoint3(&coordinatePointer[i*3]);
         }
     }
+    m_geometryVersion = newDrawingVersion();
     
     computeNormals();
     
@@ -1307,6 +1404,8 @@ SurfaceFile::getNodesSpacingStatistics(DescriptiveStatistics& statsOut) const
 void
 SurfaceFile::invalidateNodeColoringForBrowserTabs()
 {
+    m_nodeColoringVersion = newDrawingVersion();
+    
     /*
      * Free memory since could have many tabs and many surfaces equals lots of memory
      */
@@ -1443,6 +1542,7 @@ SurfaceFile::setSurfaceNodeColoringRgbaForBrowserTab(const int32_t browserTabInd
     for (int32_t i = 0; i < numberOfComponentsRGBA; i++) {
         rgba[i] = rgbaNodeColorComponents[i];
     }
+    m_nodeColoringVersion = newDrawingVersion();
 }
 
 /**
@@ -1490,6 +1590,7 @@ SurfaceFile::setSurfaceMontageNodeColoringRgbaForBrowserTab(const int32_t browse
     for (int32_t i = 0; i < numberOfComponentsRGBA; i++) {
         rgba[i] = rgbaNodeColorComponents[i];
     }
+    m_nodeColoringVersion = newDrawingVersion();
 }
 
 
@@ -1537,6 +1638,7 @@ SurfaceFile::setWholeBrainNodeColoringRgbaForBrowserTab(const int32_t browserTab
     for (int32_t i = 0; i < numberOfComponentsRGBA; i++) {
         rgba[i] = rgbaNodeColorComponents[i];
     }
+    m_nodeColoringVersion = newDrawingVersion();
 }
 
 /**
@@ -131,12 +131,18 @@ namespace caret {
         
         void getGeodesicHelper(CaretPointer<GeodesicHelper>& helpOut) const;
         
+        ///for the parallel batch functions of GeodesicHelper, which make their own per-thread helpers
+        CaretPointer<GeodesicHelperBase> getGeodesicHelperBase() const;
+        
         CaretPointer<SignedDistanceHelper> getSignedDistanceHelper() const;
         
         void getSignedDistanceHelper(CaretPointer<SignedDistanceHelper>& helpOut) const;
         
         CaretPointer<const CaretPointLocator> getPointLocator() const;
         
+        ///use any helpers already built by a surface with identical coordinates and topology, instead of building them again
+        void shareHelpers(const SurfaceFile& other) const;
+        
         const BoundingBox* getBoundingBox() const;
         
         void matchSurfaceBoundingBox(const SurfaceFile* surfaceFile);
@@ -171,6 +177,12 @@ namespace caret {
 
         void invalidateNormals();
         
+        ///changes whenever coordinates, triangles, or normals may have changed, never repeats across surfaces, so drawing can cache them
+        int64_t getGeometryVersion() const { return m_geometryVersion; }
+        
+        ///changes whenever the node coloring for any tab is set or invalidated, never repeats across surfaces
+        int64_t getNodeColoringVersion() const { return m_nodeColoringVersion; }
+        
         void translateToCenterOfMass();
         
         void flipNormals();
@@ -251,6 +263,10 @@ namespace caret {
         std::vector<float> normalVectors;
         
         bool m_normalsAveraged, m_normalsComputed;
+        
+        int64_t m_geometryVersion, m_nodeColoringVersion;
+        
+        static int64_t newDrawingVersion();
 
         /** The node coloring. */
         std::vector<float> nodeColoring;
@@ -22,26 +22,35 @@
 
 #include "CaretAssert.h"
 #include "CaretException.h"
+#include "CaretLogger.h"
 #include "CaretOMP.h"
+#include "CaretPointer.h"
 #include "GeodesicHelper.h"
 #include "SignedDistanceHelper.h"
 #include "SurfaceFile.h"
 #include "TopologyHelper.h"
 #include "Vector3D.h"
+#include "WeightOperatorFile.h"
 
-#include <set>
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include <algorithm>
 #include <map>
 
 using namespace std;
 using namespace caret;
 
+const char SurfaceResamplingHelper::s_cacheFileMagic[] = "WBRSMP01";
+
 SurfaceResamplingHelper::SurfaceResamplingHelper(const SurfaceResamplingMethodEnum::Enum& myMethod, const SurfaceFile* currentSphere, const SurfaceFile* newSphere,
-                                                 const SurfaceFile* currentAreaSurf, const SurfaceFile* newAreaSurf, const float* currentRoi)
+                                                 const SurfaceFile* currentAreaSurf, const SurfaceFile* newAreaSurf, const float* currentRoi, const AString& cacheDirectory)
 {
     if (!checkSphere(currentSphere) || !checkSphere(newSphere)) throw CaretException("input surfaces to SurfaceResamplingHelper must be spheres");
-    SurfaceFile currentSphereMod, newSphereMod;
-    changeRadius(100.0f, currentSphere, &currentSphereMod);
-    changeRadius(100.0f, newSphere, &newSphereMod);
     if (currentAreaSurf != NULL && currentAreaSurf->getNumberOfNodes() != currentSphere->getNumberOfNodes())
     {
         throw CaretException("area surfaces must have the same number of nodes as the spheres");
@@ -50,32 +59,95 @@ SurfaceResamplingHelper::SurfaceResamplingHelper(const SurfaceResamplingMethodEn
     {
         throw CaretException("area surfaces must have the same number of nodes as the spheres");
     }
+    if (myMethod == SurfaceResamplingMethodEnum::ADAP_BARY_AREA)
+    {
+        CaretAssert(currentAreaSurf != NULL && newAreaSurf != NULL);
+        if (currentAreaSurf == NULL || newAreaSurf == NULL) throw CaretException("ADAP_BARY_AREA method requires area surfaces");
+    }
+    m_numNodes = newSphere->getNumberOfNodes();
+    m_numSourceNodes = currentSphere->getNumberOfNodes();
+    AString key, cacheFileName;
+    if (cacheDirectory != "")
+    {
+        key = getWeightCacheKey(myMethod, currentSphere, newSphere, currentAreaSurf, newAreaSurf, currentRoi);
+        cacheFileName = QDir(cacheDirectory).filePath(key + ".wbresample");
+        if (readWeightFile(cacheFileName, key))
+        {
+            CaretLogFine("loaded resampling weights from '" + cacheFileName + "'");
+            return;
+        }
+    }
+    SurfaceFile currentSphereMod, newSphereMod;
+    changeRadius(100.0f, currentSphere, &currentSphereMod);
+    changeRadius(100.0f, newSphere, &newSphereMod);
     switch (myMethod)
     {
         case SurfaceResamplingMethodEnum::ADAP_BARY_AREA:
-            CaretAssert(currentAreaSurf != NULL && newAreaSurf != NULL);
-            if (currentAreaSurf == NULL || newAreaSurf == NULL) throw CaretException("ADAP_BARY_AREA method requires area surfaces");
             computeWeightsAdapBaryArea(&currentSphereMod, &newSphereMod, currentAreaSurf, newAreaSurf, currentRoi);
             break;
         case SurfaceResamplingMethodEnum::BARYCENTRIC:
             computeWeightsBarycentric(&currentSphereMod, &newSphereMod, currentRoi);
             break;
     }
+    if (cacheDirectory != "")
+    {
+        writeWeightFile(cacheFileName, key);
+    }
+}
+
+AString SurfaceResamplingHelper::getWeightCacheKey(const SurfaceResamplingMethodEnum::Enum& myMethod, const SurfaceFile* currentSphere, const SurfaceFile* newSphere,
+                                                   const SurfaceFile* currentAreaSurf, const SurfaceFile* newAreaSurf, const float* currentRoi)
+{
+    CaretAssert(currentSphere != NULL && newSphere != NULL);
+    QCryptographicHash myHash(QCryptographicHash::Sha1);
+    int32_t methodNum = (int32_t)myMethod;
+    myHash.addData(s_cacheFileMagic, sizeof(s_cacheFileMagic));//so that a format change also changes every key
+    myHash.addData((const char*)&methodNum, sizeof(methodNum));
+    addSurfaceToHash(myHash, currentSphere);
+    addSurfaceToHash(myHash, newSphere);
+    if (myMethod == SurfaceResamplingMethodEnum::ADAP_BARY_AREA)
+    {//BARYCENTRIC ignores the area surfaces, so they shouldn't change its key
+        CaretAssert(currentAreaSurf != NULL && newAreaSurf != NULL);
+        addSurfaceToHash(myHash, currentAreaSurf);
+        addSurfaceToHash(myHash, newAreaSurf);
+    }
+    if (currentRoi != NULL)
+    {//only whether each node is in the roi matters to the weights, so hash the mask rather than the values
+        int32_t numNodes = currentSphere->getNumberOfNodes();
+        QByteArray mask(numNodes, '\0');
+        for (int32_t i = 0; i < numNodes; ++i)
+        {
+            if (currentRoi[i] > 0.0f) mask[i] = 1;
+        }
+        myHash.addData(mask);
+    }
+    return AString(myHash.result().toHex());
+}
+
+void SurfaceResamplingHelper::addSurfaceToHash(QCryptographicHash& myHash, const SurfaceFile* mySurf)
+{
+    int32_t numNodes = mySurf->getNumberOfNodes(), numTiles = mySurf->getNumberOfTriangles();
+    myHash.addData((const char*)&numNodes, sizeof(numNodes));
+    myHash.addData((const char*)&numTiles, sizeof(numTiles));
+    myHash.addData((const char*)mySurf->getCoordinateData(), sizeof(float) * 3 * numNodes);
+    if (numTiles > 0)
+    {
+        myHash.addData((const char*)mySurf->getTriangle(0), sizeof(int32_t) * 3 * numTiles);
+    }
 }
 
 void SurfaceResamplingHelper::resampleNormal(const float* input, float* output, const float& invalidVal) const
 {
-    int numNodes = (int)m_weights.size() - 1;
 #pragma omp CARET_PARFOR schedule(dynamic)
-    for (int i = 0; i < numNodes; ++i)
+    for (int i = 0; i < m_numNodes; ++i)
     {
-        WeightElem* end = m_weights[i + 1], *elem = m_weights[i];
-        if (elem != end)
+        int64_t rowEnd = m_rowStart[i + 1];
+        if (m_rowStart[i] != rowEnd)
         {
             double accum = 0.0;
-            for (; elem != end; ++elem)
+            for (int64_t j = m_rowStart[i]; j < rowEnd; ++j)
             {
-                accum += input[elem->node] * elem->weight;//don't need to divide afterwards, because the weights already sum to 1
+                accum += input[m_rowNodes[j]] * m_rowWeights[j];//don't need to divide afterwards, because the weights already sum to 1
             }
             output[i] = accum;
         } else {
@@ -84,20 +156,61 @@ void SurfaceResamplingHelper::resampleNormal(const float* input, float* output,
     }
 }
 
+void SurfaceResamplingHelper::resampleNormal(const float* const* inputs, float* const* outputs, const int32_t& numColumns, const float& invalidVal) const
+{//each column accumulates in the same order as resampling it alone would, so blocking columns doesn't change the results
+    for (int32_t start = 0; start < numColumns; start += WeightOperatorFile::COLUMN_BLOCK)
+    {
+        int32_t numThisBlock = min((int32_t)WeightOperatorFile::COLUMN_BLOCK, numColumns - start);
+        const float* const* blockIn = inputs + start;
+        float* const* blockOut = outputs + start;
+#pragma omp CARET_PARFOR schedule(dynamic)
+        for (int i = 0; i < m_numNodes; ++i)
+        {
+            int64_t rowEnd = m_rowStart[i + 1];
+            if (m_rowStart[i] != rowEnd)
+            {
+                double accum[WeightOperatorFile::COLUMN_BLOCK];
+                for (int32_t c = 0; c < numThisBlock; ++c)
+                {
+                    accum[c] = 0.0;
+                }
+                for (int64_t j = m_rowStart[i]; j < rowEnd; ++j)
+                {
+                    int32_t node = m_rowNodes[j];
+                    float weight = m_rowWeights[j];
+                    for (int32_t c = 0; c < numThisBlock; ++c)
+                    {
+                        accum[c] += blockIn[c][node] * weight;
+                    }
+                }
+                for (int32_t c = 0; c < numThisBlock; ++c)
+                {
+                    blockOut[c][i] = accum[c];
+                }
+            } else {
+                for (int32_t c = 0; c < numThisBlock; ++c)
+                {
+                    blockOut[c][i] = invalidVal;
+                }
+            }
+        }
+    }
+}
+
 void SurfaceResamplingHelper::resample3DCoord(const float* input, float* output) const
 {
-    int numNodes = (int)m_weights.size() - 1;
 #pragma omp CARET_PARFOR schedule(dynamic)
-    for (int i = 0; i < numNodes; ++i)
+    for (int i = 0; i < m_numNodes; ++i)
     {
         double tempvec[3] = { 0.0, 0.0, 0.0 };
-        WeightElem* end = m_weights[i + 1];
-        for (WeightElem* elem = m_weights[i]; elem != end; ++elem)
+        int64_t rowEnd = m_rowStart[i + 1];
+        for (int64_t j = m_rowStart[i]; j < rowEnd; ++j)
         {
-            const float* coord = input + elem->node * 3;
-            tempvec[0] += coord[0] * elem->weight;//don't need to divide afterwards, because the weights already sum to 1
-            tempvec[1] += coord[1] * elem->weight;
-            tempvec[2] += coord[2] * elem->weight;
+            const float* coord = input + m_rowNodes[j] * 3;
+            float weight = m_rowWeights[j];
+            tempvec[0] += coord[0] * weight;//don't need to divide afterwards, because the weights already sum to 1
+            tempvec[1] += coord[1] * weight;
+            tempvec[2] += coord[2] * weight;
         }
         int i3 = i * 3;
         output[i3] = tempvec[0];
@@ -108,28 +221,28 @@ void SurfaceResamplingHelper::resample3DCoord(const float* input, float* output)
 
 void SurfaceResamplingHelper::resamplePopular(const int32_t* input, int32_t* output, const int32_t& invalidVal) const
 {
-    int numNodes = (int)m_weights.size() - 1;
 #pragma omp CARET_PARFOR schedule(dynamic)
-    for (int i = 0; i < numNodes; ++i)
+    for (int i = 0; i < m_numNodes; ++i)
     {
         map<int32_t, float> accum;
         float maxweight = -1.0f;
         int32_t bestlabel = invalidVal;
-        WeightElem* end = m_weights[i + 1];
-        for (WeightElem* elem = m_weights[i]; elem != end; ++elem)
+        int64_t rowEnd = m_rowStart[i + 1];
+        for (int64_t j = m_rowStart[i]; j < rowEnd; ++j)
         {
-            int32_t label = input[elem->node];
+            int32_t label = input[m_rowNodes[j]];
+            float weight = m_rowWeights[j];
             map<int, float>::iterator iter = accum.find(label);
             if (iter == accum.end())
             {
-                accum[label] = elem->weight;
-                if (elem->weight > maxweight)
+                accum[label] = weight;
+                if (weight > maxweight)
                 {
-                    maxweight = elem->weight;
+                    maxweight = weight;
                     bestlabel = label;
                 }
             } else {
-                iter->second += elem->weight;
+                iter->second += weight;
                 if (iter->second > maxweight)
                 {
                     maxweight = iter->second;
@@ -143,19 +256,18 @@ void SurfaceResamplingHelper::resamplePopular(const int32_t* input, int32_t* out
 
 void SurfaceResamplingHelper::resampleLargest(const float* input, float* output, const float& invalidVal) const
 {
-    int numNodes = (int)m_weights.size() - 1;
 #pragma omp CARET_PARFOR schedule(dynamic)
-    for (int i = 0; i < numNodes; ++i)
+    for (int i = 0; i < m_numNodes; ++i)
     {
-        WeightElem* end = m_weights[i + 1];
+        int64_t rowEnd = m_rowStart[i + 1];
         float largest = -1.0f;
         int largestNode = -1;
-        for (WeightElem* elem = m_weights[i]; elem != end; ++elem)
+        for (int64_t j = m_rowStart[i]; j < rowEnd; ++j)
         {
-            if (elem->weight > largest)
+            if (m_rowWeights[j] > largest)
             {
-                largest = elem->weight;
-                largestNode = elem->node;
+                largest = m_rowWeights[j];
+                largestNode = m_rowNodes[j];
             }
         }
         if (largestNode != -1)
@@ -169,19 +281,18 @@ void SurfaceResamplingHelper::resampleLargest(const float* input, float* output,
 
 void SurfaceResamplingHelper::resampleLargest(const int32_t* input, int32_t* output, const int32_t& invalidVal) const
 {
-    int numNodes = (int)m_weights.size() - 1;
 #pragma omp CARET_PARFOR schedule(dynamic)
-    for (int i = 0; i < numNodes; ++i)
+    for (int i = 0; i < m_numNodes; ++i)
     {
-        WeightElem* end = m_weights[i + 1];
+        int64_t rowEnd = m_rowStart[i + 1];
         float largest = -1.0f;
         int largestNode = -1;
-        for (WeightElem* elem = m_weights[i]; elem != end; ++elem)
+        for (int64_t j = m_rowStart[i]; j < rowEnd; ++j)
         {
-            if (elem->weight > largest)
+            if (m_rowWeights[j] > largest)
             {
-                largest = elem->weight;
-                largestNode = elem->node;
+                largest = m_rowWeights[j];
+                largestNode = m_rowNodes[j];
             }
         }
         if (largestNode != -1)
@@ -195,10 +306,9 @@ void SurfaceResamplingHelper::resampleLargest(const int32_t* input, int32_t* out
 
 void SurfaceResamplingHelper::getResampleValidROI(float* output) const
 {
-    int numNodes = (int)m_weights.size() - 1;
-    for (int i = 0; i < numNodes; ++i)
+    for (int i = 0; i < m_numNodes; ++i)
     {
-        if (m_weights[i] != m_weights[i + 1])
+        if (m_rowStart[i] != m_rowStart[i + 1])
         {
             output[i] = 1.0f;
         } else {
@@ -217,16 +327,8 @@ void SurfaceResamplingHelper::resampleCutSurface(const SurfaceFile* cutSurfaceIn
     SurfaceFile cutCurSphere = *cutSurfaceIn;
     cutCurSphere.setCoordinates(currentSphereMod.getCoordinateData());
     int newNodes = newSphere->getNumberOfNodes();
-    vector<BarycentricInfo> newInfo(newSphere->getNumberOfNodes());
-#pragma omp CARET_PAR
-    {
-        CaretPointer<SignedDistanceHelper> mySignedHelp = cutCurSphere.getSignedDistanceHelper();
-#pragma omp CARET_FOR schedule(dynamic)
-        for (int i = 0; i < newNodes; ++i)
-        {
-            mySignedHelp->barycentricWeights(newSphereMod.getCoordinate(i), newInfo[i]);
-        }
-    }
+    vector<BarycentricInfo> newInfo;
+    computeBarycentricInfo(&cutCurSphere, newSphereMod.getCoordinateData(), newNodes, newInfo);
     vector<int> isOnEdge(newNodes, 0);//really used as bool, but avoid bitpacking so it can be modified in parallel
     CaretPointer<TopologyHelper> cutTopoHelp = cutSurfaceIn->getTopologyHelper();//because topology didn't change, and it might have one already - also, don't need separate helpers per thread, not using neighbors to depth
     CaretPointer<TopologyHelper> closedTopoHelp = currentSphere->getTopologyHelper();//ditto
@@ -404,94 +506,157 @@ void SurfaceResamplingHelper::resampleCutSurface(const SurfaceFile* cutSurfaceIn
 void SurfaceResamplingHelper::computeWeightsAdapBaryArea(const SurfaceFile* currentSphere, const SurfaceFile* newSphere,
                                                          const SurfaceFile* currentAreaSurf, const SurfaceFile* newAreaSurf, const float* currentRoi)
 {
-    vector<map<int, float> > forward, reverse, reverse_gather;
+    vector<BaryWeights> forward, reverse;
     makeBarycentricWeights(currentSphere, newSphere, forward, NULL);//don't use an roi until after we have done area correction, because area correction MUST ignore ROI
     makeBarycentricWeights(newSphere, currentSphere, reverse, NULL);
     int numNewNodes = (int)forward.size(), numOldNodes = currentSphere->getNumberOfNodes();
-    reverse_gather.resize(numNewNodes);
+    vector<int64_t> gatherStart(numNewNodes + 1, 0);//convert scattering weights to gathering weights, by counting, then filling in old node order so each row is sorted
+    for (int oldNode = 0; oldNode < numOldNodes; ++oldNode)
+    {
+        for (int j = 0; j < reverse[oldNode].m_count; ++j)
+        {
+            ++gatherStart[reverse[oldNode].m_nodes[j] + 1];
+        }
+    }
+    for (int newNode = 0; newNode < numNewNodes; ++newNode)
+    {
+        gatherStart[newNode + 1] += gatherStart[newNode];
+    }
+    vector<int32_t> gatherNodes(gatherStart[numNewNodes]);
+    vector<float> gatherWeights(gatherStart[numNewNodes]);
+    vector<int64_t> fillPos(gatherStart.begin(), gatherStart.end() - 1);
     for (int oldNode = 0; oldNode < numOldNodes; ++oldNode)//this loop can't be parallelized
     {
-        for (map<int, float>::iterator iter = reverse[oldNode].begin(); iter != reverse[oldNode].end(); ++iter)//convert scattering weights to gathering weights
+        for (int j = 0; j < reverse[oldNode].m_count; ++j)
         {
-            reverse_gather[iter->first][oldNode] = iter->second;
+            int64_t pos = fillPos[reverse[oldNode].m_nodes[j]]++;
+            gatherNodes[pos] = oldNode;
+            gatherWeights[pos] = reverse[oldNode].m_weights[j];
         }
     }
-    vector<map<int, float> > adap_gather(numNewNodes);
     vector<float> currentAreas, newAreas;
     currentAreaSurf->computeNodeAreas(currentAreas);
     newAreaSurf->computeNodeAreas(newAreas);
+    vector<int> useForward(numNewNodes);//really used as bool, but avoid bitpacking so it can be modified in parallel
 #pragma omp CARET_PARFOR schedule(dynamic)
     for (int newNode = 0; newNode < numNewNodes; ++newNode)
     {
-        set<int> forwardused;//build set of all nodes used by forward weights (really only 3, but this is a bit cleaner and more generic)
-        for (map<int, float>::iterator iter = forward[newNode].begin(); iter != forward[newNode].end(); ++iter)
+        const BaryWeights& myForward = forward[newNode];
+        useForward[newNode] = 1;
+        for (int64_t j = gatherStart[newNode]; j < gatherStart[newNode + 1]; ++j)
         {
-            forwardused.insert(iter->first);
-        }
-        bool useforward = true;
-        for (map<int, float>::iterator iter = reverse_gather[newNode].begin(); iter != reverse_gather[newNode].end(); ++iter)
-        {
-            if (forwardused.find(iter->first) == forwardused.end())
+            if (find(myForward.m_nodes, myForward.m_nodes + myForward.m_count, gatherNodes[j]) == myForward.m_nodes + myForward.m_count)
             {
-                useforward = false;//if the reverse scatter weights include something the forward gather weights don't, use reverse scatter
+                useForward[newNode] = 0;//if the reverse scatter weights include something the forward gather weights don't, use reverse scatter
                 break;
             }
         }
-        if (useforward)
+    }
+    m_rowStart.resize(numNewNodes + 1);
+    m_rowStart[0] = 0;
+    for (int newNode = 0; newNode < numNewNodes; ++newNode)
+    {
+        if (useForward[newNode])
         {
-            adap_gather[newNode] = forward[newNode];
+            m_rowStart[newNode + 1] = m_rowStart[newNode] + forward[newNode].m_count;
         } else {
-            adap_gather[newNode] = reverse_gather[newNode];
+            m_rowStart[newNode + 1] = m_rowStart[newNode] + (gatherStart[newNode + 1] - gatherStart[newNode]);
         }
-        for (map<int, float>::iterator iter = adap_gather[newNode].begin(); iter != adap_gather[newNode].end(); ++iter)//begin area correction by multiplying by target node area
+    }
+    m_rowNodes.resize(m_rowStart[numNewNodes]);
+    m_rowWeights.resize(m_rowStart[numNewNodes]);
+#pragma omp CARET_PARFOR schedule(dynamic)
+    for (int newNode = 0; newNode < numNewNodes; ++newNode)
+    {
+        int64_t outPos = m_rowStart[newNode];
+        if (useForward[newNode])
         {
-            iter->second *= newAreas[newNode];//begin the process of area correction by multiplying by gathering node areas
+            for (int j = 0; j < forward[newNode].m_count; ++j, ++outPos)
+            {
+                m_rowNodes[outPos] = forward[newNode].m_nodes[j];
+                m_rowWeights[outPos] = forward[newNode].m_weights[j] * newAreas[newNode];//begin the process of area correction by multiplying by gathering node areas
+            }
+        } else {
+            for (int64_t j = gatherStart[newNode]; j < gatherStart[newNode + 1]; ++j, ++outPos)
+            {
+                m_rowNodes[outPos] = gatherNodes[j];
+                m_rowWeights[outPos] = gatherWeights[j] * newAreas[newNode];
+            }
         }
     }
     vector<float> correctionSum(numOldNodes, 0.0f);
-    for (int newNode = 0; newNode < numNewNodes; ++newNode)//this loop is separate because it can't be parallelized
+    int64_t numEntries = m_rowStart[numNewNodes];
+    for (int64_t j = 0; j < numEntries; ++j)//this loop is separate because it can't be parallelized
     {
-        for (map<int, float>::iterator iter = adap_gather[newNode].begin(); iter != adap_gather[newNode].end(); ++iter)
-        {
-            correctionSum[iter->first] += iter->second;//now, sum the scattering weights to prepare for first normalization
-        }
+        correctionSum[m_rowNodes[j]] += m_rowWeights[j];//now, sum the scattering weights to prepare for first normalization
     }
+    vector<int64_t> keptCount(numNewNodes);
 #pragma omp CARET_PARFOR schedule(dynamic)
     for (int newNode = 0; newNode < numNewNodes; ++newNode)
     {
         double weightsum = 0.0f;
-        vector<map<int, float>::iterator> toRemove;
-        for (map<int, float>::iterator iter = adap_gather[newNode].begin(); iter != adap_gather[newNode].end(); ++iter)
+        int64_t rowBegin = m_rowStart[newNode], rowEnd = m_rowStart[newNode + 1], keepPos = rowBegin;
+        for (int64_t j = rowBegin; j < rowEnd; ++j)
         {
-            if (currentRoi == NULL || currentRoi[iter->first] > 0.0f)
+            int32_t oldNode = m_rowNodes[j];
+            if (currentRoi == NULL || currentRoi[oldNode] > 0.0f)
             {
-                iter->second *= currentAreas[iter->first] / correctionSum[iter->first];//divide the weights by their scatter sum, then multiply by current areas
-                weightsum += iter->second;//and compute the sum
-            } else {
-                toRemove.push_back(iter);
+                m_rowNodes[keepPos] = oldNode;//compact the row in place, dropping nodes outside the roi
+                m_rowWeights[keepPos] = m_rowWeights[j] * (currentAreas[oldNode] / correctionSum[oldNode]);//divide the weights by their scatter sum, then multiply by current areas
+                weightsum += m_rowWeights[keepPos];//and compute the sum
+                ++keepPos;
             }
         }
-        int numToRemove = (int)toRemove.size();
-        for (int i = 0; i < numToRemove; ++i)
+        keptCount[newNode] = keepPos - rowBegin;
+        if (weightsum != 0.0f)//this shouldn't happen unless no nodes remain due to roi, or node areas can be zero
         {
-            adap_gather[newNode].erase(toRemove[i]);
+            for (int64_t j = rowBegin; j < keepPos; ++j)
+            {
+                m_rowWeights[j] /= weightsum;//and normalize to a sum of 1
+            }
         }
-        if (weightsum != 0.0f)//this shouldn't happen unless no nodes remain due to roi, or node areas can be zero
+    }
+    if (currentRoi != NULL)
+    {//close the gaps left by dropped nodes, moving rows forward in order so nothing is overwritten before it is moved
+        int64_t outPos = 0;
+        for (int newNode = 0; newNode < numNewNodes; ++newNode)
         {
-            for (map<int, float>::iterator iter = adap_gather[newNode].begin(); iter != adap_gather[newNode].end(); ++iter)
+            int64_t rowBegin = m_rowStart[newNode];
+            m_rowStart[newNode] = outPos;
+            for (int64_t j = 0; j < keptCount[newNode]; ++j, ++outPos)
             {
-                iter->second /= weightsum;//and normalize to a sum of 1
+                m_rowNodes[outPos] = m_rowNodes[rowBegin + j];
+                m_rowWeights[outPos] = m_rowWeights[rowBegin + j];
             }
         }
+        m_rowStart[numNewNodes] = outPos;
+        m_rowNodes.resize(outPos);
+        m_rowWeights.resize(outPos);
     }
-    compactWeights(adap_gather);//and compact them into the internal weight storage
 }
 
 void SurfaceResamplingHelper::computeWeightsBarycentric(const SurfaceFile* currentSphere, const SurfaceFile* newSphere, const float* currentRoi)
 {
-    vector<map<int, float> > forward;
+    vector<BaryWeights> forward;
     makeBarycentricWeights(currentSphere, newSphere, forward, currentRoi);//this should ensure they sum to 1, so we are done
-    compactWeights(forward);
+    int numNewNodes = (int)forward.size();
+    m_rowStart.resize(numNewNodes + 1);
+    m_rowStart[0] = 0;
+    for (int newNode = 0; newNode < numNewNodes; ++newNode)
+    {
+        m_rowStart[newNode + 1] = m_rowStart[newNode] + forward[newNode].m_count;
+    }
+    m_rowNodes.resize(m_rowStart[numNewNodes]);
+    m_rowWeights.resize(m_rowStart[numNewNodes]);
+    for (int newNode = 0; newNode < numNewNodes; ++newNode)
+    {
+        int64_t outPos = m_rowStart[newNode];
+        for (int j = 0; j < forward[newNode].m_count; ++j, ++outPos)
+        {
+            m_rowNodes[outPos] = forward[newNode].m_nodes[j];
+            m_rowWeights[outPos] = forward[newNode].m_weights[j];
+        }
+    }
 }
 
 bool SurfaceResamplingHelper::checkSphere(const SurfaceFile* surface)
@@ -539,83 +704,154 @@ void SurfaceResamplingHelper::changeRadius(const float& radius, const SurfaceFil
     output->setCoordinates(newCoordData.data());
 }
 
-void SurfaceResamplingHelper::compactWeights(const vector<map<int, float> >& weights)
-{
-    int compactsize = 0;
-    int numNodes = (int)weights.size();
-    m_weights = CaretArray<WeightElem*>(numNodes + 1);//include a "one-after" pointer
-    for (int i = 0; i < numNodes; ++i)
+void SurfaceResamplingHelper::BaryWeights::setWeight(const int32_t& node, const float& weight)
+{//replaces the weight if the node is already present, otherwise inserts it in sorted order
+    int pos = 0;
+    while (pos < m_count && m_nodes[pos] < node) ++pos;
+    if (pos < m_count && m_nodes[pos] == node)
     {
-        compactsize += (int)weights[i].size();
+        m_weights[pos] = weight;
+        return;
     }
-    m_storagechunk = CaretArray<WeightElem>(compactsize);
-    int curpos = 0;
-    for (int i = 0; i < numNodes; ++i)
+    CaretAssert(m_count < 3);
+    for (int j = m_count; j > pos; --j)
     {
-        m_weights[i] = m_storagechunk + curpos;
-        for (map<int, float>::const_iterator iter = weights[i].begin(); iter != weights[i].end(); ++iter)
-        {
-            m_storagechunk[curpos] = WeightElem(iter->first, iter->second);
-            ++curpos;
+        m_nodes[j] = m_nodes[j - 1];
+        m_weights[j] = m_weights[j - 1];
+    }
+    m_nodes[pos] = node;
+    m_weights[pos] = weight;
+    ++m_count;
+}
+
+void SurfaceResamplingHelper::computeBarycentricInfo(const SurfaceFile* from, const float* coordList, const int32_t& numPoints, vector<BarycentricInfo>& infoOut)
+{
+    infoOut.resize(numPoints);
+    int32_t numBatches = (numPoints + BARYCENTRIC_BATCH - 1) / BARYCENTRIC_BATCH;
+#pragma omp CARET_PAR
+    {
+        CaretPointer<SignedDistanceHelper> mySignedHelp = from->getSignedDistanceHelper();
+#pragma omp CARET_FOR schedule(dynamic)
+        for (int32_t batch = 0; batch < numBatches; ++batch)
+        {//batch queries sort their points spatially, so nearby points share tree searches
+            int32_t batchStart = batch * BARYCENTRIC_BATCH;
+            int32_t batchCount = min((int32_t)BARYCENTRIC_BATCH, numPoints - batchStart);
+            mySignedHelp->barycentricWeights(coordList + batchStart * 3, batchCount, infoOut.data() + batchStart);
         }
     }
-    CaretAssert(curpos == compactsize);
-    m_weights[numNodes] = m_storagechunk + compactsize;
 }
 
-void SurfaceResamplingHelper::makeBarycentricWeights(const SurfaceFile* from, const SurfaceFile* to, vector<map<int, float> >& weights, const float* currentRoi)
+void SurfaceResamplingHelper::makeBarycentricWeights(const SurfaceFile* from, const SurfaceFile* to, vector<BaryWeights>& weights, const float* currentRoi)
 {
     int numToNodes = to->getNumberOfNodes();
+    weights.clear();
     weights.resize(numToNodes);
-    const float* toCoordData = to->getCoordinateData();
+    vector<BarycentricInfo> allInfo;
+    computeBarycentricInfo(from, to->getCoordinateData(), numToNodes, allInfo);
     if (currentRoi == NULL)
     {
-#pragma omp CARET_PAR
+#pragma omp CARET_PARFOR
+        for (int i = 0; i < numToNodes; ++i)
         {
-            CaretPointer<SignedDistanceHelper> mySignedHelp = from->getSignedDistanceHelper();
-#pragma omp CARET_FOR schedule(dynamic)
-            for (int i = 0; i < numToNodes; ++i)
-            {
-                BarycentricInfo myInfo;
-                mySignedHelp->barycentricWeights(toCoordData + i * 3, myInfo);
-                if (myInfo.baryWeights[0] != 0.0f) weights[i][myInfo.nodes[0]] = myInfo.baryWeights[0];
-                if (myInfo.baryWeights[1] != 0.0f) weights[i][myInfo.nodes[1]] = myInfo.baryWeights[1];
-                if (myInfo.baryWeights[2] != 0.0f) weights[i][myInfo.nodes[2]] = myInfo.baryWeights[2];
-            }
+            const BarycentricInfo& myInfo = allInfo[i];
+            if (myInfo.baryWeights[0] != 0.0f) weights[i].setWeight(myInfo.nodes[0], myInfo.baryWeights[0]);
+            if (myInfo.baryWeights[1] != 0.0f) weights[i].setWeight(myInfo.nodes[1], myInfo.baryWeights[1]);
+            if (myInfo.baryWeights[2] != 0.0f) weights[i].setWeight(myInfo.nodes[2], myInfo.baryWeights[2]);
         }
     } else {
-#pragma omp CARET_PAR
+#pragma omp CARET_PARFOR
+        for (int i = 0; i < numToNodes; ++i)
         {
-            CaretPointer<SignedDistanceHelper> mySignedHelp = from->getSignedDistanceHelper();
-#pragma omp CARET_FOR schedule(dynamic)
-            for (int i = 0; i < numToNodes; ++i)
+            const BarycentricInfo& myInfo = allInfo[i];
+            float weightsum = 0.0f;//there are only 3 weights, so don't bother with double precision
+            for (int j = 0; j < 3; ++j)
             {
-                BarycentricInfo myInfo;
-                float weightsum = 0.0f;//there are only 3 weights, so don't bother with double precision
-                mySignedHelp->barycentricWeights(toCoordData + i * 3, myInfo);
-                if (myInfo.baryWeights[0] != 0.0f && currentRoi[myInfo.nodes[0]] > 0.0f)
+                if (myInfo.baryWeights[j] != 0.0f && currentRoi[myInfo.nodes[j]] > 0.0f)
                 {
-                    weights[i][myInfo.nodes[0]] = myInfo.baryWeights[0];
-                    weightsum += myInfo.baryWeights[0];
+                    weights[i].setWeight(myInfo.nodes[j], myInfo.baryWeights[j]);
+                    weightsum += myInfo.baryWeights[j];
                 }
-                if (myInfo.baryWeights[1] != 0.0f && currentRoi[myInfo.nodes[1]] > 0.0f)
-                {
-                    weights[i][myInfo.nodes[1]] = myInfo.baryWeights[1];
-                    weightsum += myInfo.baryWeights[1];
-                }
-                if (myInfo.baryWeights[2] != 0.0f && currentRoi[myInfo.nodes[2]] > 0.0f)
-                {
-                    weights[i][myInfo.nodes[2]] = myInfo.baryWeights[2];
-                    weightsum += myInfo.baryWeights[2];
-                }
-                if (weightsum != 0.0f)
+            }
+            if (weightsum != 0.0f)
+            {
+                for (int j = 0; j < weights[i].m_count; ++j)
                 {
-                    for (map<int, float>::iterator iter = weights[i].begin(); iter != weights[i].end(); ++iter)
-                    {
-                        iter->second /= weightsum;
-                    }
+                    weights[i].m_weights[j] /= weightsum;
                 }
             }
         }
     }
 }
+
+///returns false if the file doesn't exist or doesn't hold the operator for this key
+bool SurfaceResamplingHelper::readWeightFile(const AString& fileName, const AString& key)
+{
+    WeightOperatorFile myFile;
+    if (!myFile.openRead(fileName, s_cacheFileMagic))
+    {
+        if (QFile::exists(fileName)) CaretLogInfo("ignoring invalid resampling weight file '" + fileName + "'");
+        return false;
+    }
+    QDataStream& myStream = myFile.getStream();
+    QByteArray storedKey;
+    qint32 numNodes, numSourceNodes;
+    qint64 numEntries;
+    myStream >> storedKey >> numNodes >> numSourceNodes >> numEntries;
+    if (myStream.status() != QDataStream::Ok || AString(storedKey) != key || numNodes != m_numNodes || numSourceNodes != m_numSourceNodes || numEntries < 0)
+    {
+        CaretLogInfo("ignoring mismatched resampling weight file '" + fileName + "'");
+        return false;
+    }
+    if (!myFile.readByteOrderCheck())
+    {
+        CaretLogInfo("ignoring resampling weight file '" + fileName + "' written with different byte order");
+        return false;
+    }
+    m_rowStart.resize(numNodes + 1);
+    m_rowNodes.resize(numEntries);
+    m_rowWeights.resize(numEntries);
+    bool ok = (myFile.readRawData(m_rowStart.data(), sizeof(int64_t) * (numNodes + 1)) &&
+               myFile.readRawData(m_rowNodes.data(), sizeof(int32_t) * numEntries) &&
+               myFile.readRawData(m_rowWeights.data(), sizeof(float) * numEntries));
+    if (ok)
+    {//a truncated or corrupted file must not lead to out of range accesses
+        ok = (m_rowStart[0] == 0 && m_rowStart[numNodes] == numEntries);
+        for (int32_t i = 0; ok && i < numNodes; ++i)
+        {
+            if (m_rowStart[i + 1] < m_rowStart[i]) ok = false;
+        }
+        for (int64_t j = 0; ok && j < numEntries; ++j)
+        {
+            if (m_rowNodes[j] < 0 || m_rowNodes[j] >= numSourceNodes) ok = false;
+        }
+    }
+    if (!ok)
+    {
+        CaretLogWarning("resampling weight file '" + fileName + "' is truncated or corrupt, recomputing weights");
+        m_rowStart.clear();
+        m_rowNodes.clear();
+        m_rowWeights.clear();
+        return false;
+    }
+    return true;
+}
+
+void SurfaceResamplingHelper::writeWeightFile(const AString& fileName, const AString& key) const
+{//the cache is only an optimization, so failures here are warnings
+    WeightOperatorFile myFile;
+    if (!myFile.openWrite(fileName, s_cacheFileMagic))
+    {
+        CaretLogWarning("failed to create temporary file for resampling weights in '" + QFileInfo(fileName).absolutePath() + "'");
+        return;
+    }
+    int64_t numEntries = (int64_t)m_rowNodes.size();
+    myFile.getStream() << key.toAscii() << (qint32)m_numNodes << (qint32)m_numSourceNodes << (qint64)numEntries;
+    myFile.writeByteOrderCheck();
+    myFile.writeRawData(m_rowStart.data(), sizeof(int64_t) * (m_numNodes + 1));
+    myFile.writeRawData(m_rowNodes.data(), sizeof(int32_t) * numEntries);
+    myFile.writeRawData(m_rowWeights.data(), sizeof(float) * numEntries);
+    if (!myFile.finishWrite())
+    {
+        CaretLogWarning("failed to write resampling weight file '" + fileName + "'");
+    }
+}
@@ -21,39 +21,63 @@
  */
 /*LICENSE_END*/
 
-#include "CaretPointer.h"
+#include "AString.h"
 #include "SurfaceResamplingMethodEnum.h"
 
-#include <map>
+#include "stdint.h"
 #include <vector>
 
+class QCryptographicHash;
+
+//NOTE: the weights are stored as a sparse gathering operator in CSR form (one row per new node), if a cache directory is given to the constructor,
+//      the operator is saved there under a hash of both spheres, the area surfaces, the method and the ROI, and later constructions with identical
+//      inputs load it instead of recomputing the barycentric projections.
+
 namespace caret {
 
     class SurfaceFile;
+    struct BarycentricInfo;
     
     class SurfaceResamplingHelper
     {
-        struct WeightElem
+        enum
+        {
+            BARYCENTRIC_BATCH = 4096//number of points per batch closest triangle query
+        };
+        struct BaryWeights//up to 3 nonzero barycentric weights for one node, sorted by source node
         {
-            int node;
-            float weight;
-            WeightElem() { }
-            WeightElem(const int& nodeIn, const float& weightIn) : node(nodeIn), weight(weightIn) { }
+            int32_t m_nodes[3];
+            float m_weights[3];
+            int m_count;
+            BaryWeights() : m_count(0) { }
+            void setWeight(const int32_t& node, const float& weight);
         };
-        CaretArray<WeightElem> m_storagechunk;
-        CaretArray<WeightElem*> m_weights;
+        int32_t m_numNodes, m_numSourceNodes;
+        std::vector<int64_t> m_rowStart;//row i of the operator is entries [m_rowStart[i], m_rowStart[i + 1])
+        std::vector<int32_t> m_rowNodes;
+        std::vector<float> m_rowWeights;
+        static const char s_cacheFileMagic[];
         static bool checkSphere(const SurfaceFile* surface);
+        static void addSurfaceToHash(QCryptographicHash& myHash, const SurfaceFile* mySurf);
         static void changeRadius(const float& radius, const SurfaceFile* input, SurfaceFile* output);
         void computeWeightsAdapBaryArea(const SurfaceFile* currentSphere, const SurfaceFile* newSphere, const SurfaceFile* currentAreaSurf, const SurfaceFile* newAreaSurf, const float* currentRoi);
         void computeWeightsBarycentric(const SurfaceFile* currentSphere, const SurfaceFile* newSphere, const float* currentRoi);
-        static void makeBarycentricWeights(const SurfaceFile* from, const SurfaceFile* to, std::vector<std::map<int, float> >& weights, const float* currentRoi);
-        void compactWeights(const std::vector<std::map<int, float> >& weights);
+        static void computeBarycentricInfo(const SurfaceFile* from, const float* coordList, const int32_t& numPoints, std::vector<BarycentricInfo>& infoOut);
+        static void makeBarycentricWeights(const SurfaceFile* from, const SurfaceFile* to, std::vector<BaryWeights>& weights, const float* currentRoi);
+        bool readWeightFile(const AString& fileName, const AString& key);
+        void writeWeightFile(const AString& fileName, const AString& key) const;
     public:
-        SurfaceResamplingHelper() { }
+        SurfaceResamplingHelper() : m_numNodes(0), m_numSourceNodes(0) { }
         SurfaceResamplingHelper(const SurfaceResamplingMethodEnum::Enum& myMethod, const SurfaceFile* currentSphere, const SurfaceFile* newSphere,
-                                const SurfaceFile* currentAreaSurf = NULL, const SurfaceFile* newAreaSurf = NULL, const float* currentRoi = NULL);
+                                const SurfaceFile* currentAreaSurf = NULL, const SurfaceFile* newAreaSurf = NULL, const float* currentRoi = NULL,
+                                const AString& cacheDirectory = "");
+        ///hex digest identifying the weights that the given inputs produce, used to name cache files
+        static AString getWeightCacheKey(const SurfaceResamplingMethodEnum::Enum& myMethod, const SurfaceFile* currentSphere, const SurfaceFile* newSphere,
+                                         const SurfaceFile* currentAreaSurf = NULL, const SurfaceFile* newAreaSurf = NULL, const float* currentRoi = NULL);
         ///resample real-valued data by means of weights
         void resampleNormal(const float* input, float* output, const float& invalidVal = 0.0f) const;
+        ///resample several columns of real-valued data in one pass over the weights
+        void resampleNormal(const float* const* inputs, float* const* outputs, const int32_t& numColumns, const float& invalidVal = 0.0f) const;
         ///resample 3D coordinate data by means of weights
         void resample3DCoord(const float* input, float* output) const;
         ///resample label-like data according to which value gets the largest weight sum
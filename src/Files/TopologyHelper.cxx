@@ -20,7 +20,9 @@
 
 #include "SurfaceFile.h"
 #include "TopologyHelper.h"
+#include "AdjacencyCSR.h"
 #include "CaretAssert.h"
+#include <algorithm>
 #include <cmath>
 
 using namespace caret;
@@ -305,6 +307,20 @@ const vector<int32_t>& TopologyHelper::getNodeEdges(const int32_t nodeNum) const
     return m_nodeInfo[nodeNum].m_edges;
 }
 
+void TopologyHelper::getNeighborCSR(AdjacencyCSR& csrOut) const
+{//built on request rather than kept, so the neighbor lists aren't stored twice
+    vector<int32_t> rowSizes(m_numNodes);
+    for (int32_t i = 0; i < m_numNodes; ++i)
+    {
+        rowSizes[i] = (int32_t)m_nodeInfo[i].m_neighbors.size();
+    }
+    csrOut.setRowSizes(rowSizes);
+    for (int32_t i = 0; i < m_numNodes; ++i)
+    {
+        std::copy(m_nodeInfo[i].m_neighbors.begin(), m_nodeInfo[i].m_neighbors.end(), csrOut.m_indices.begin() + csrOut.m_offsets[i]);
+    }
+}
+
 void TopologyHelper::checkArrays() const
 {
     if (m_markNodes.size() != m_numNodes)
@@ -27,6 +27,7 @@
 namespace caret {
 
     class SurfaceFile;
+    struct AdjacencyCSR;
     
     struct TopologyEdgeInfo
     {
@@ -194,6 +195,9 @@ namespace caret {
         int32_t getNumberOfEdges() const {
             return m_edgeInfo.size();
         }
+        
+        /// Pack the neighbors of all nodes into contiguous arrays, in the same order as getNodeNeighbors
+        void getNeighborCSR(AdjacencyCSR& csrOut) const;
 
     };
 
@@ -181,6 +181,21 @@ VolumeFile::clear()
     m_dataRangeValid = false;
 }
 
+/**
+ * Read the data file.
+ *
+ * Every map is read into memory: the voxel data is one contiguous block
+ * that getFrame() hands out pointers into, and map statistics, palettes
+ * that use all maps, and the map selection in the GUI need all of it.
+ * A compressed (.nii.gz) file is therefore decompressed in one sequential
+ * pass.  Reading single frames through the gzip index is done by
+ * NiftiFile::getFrame().
+ *
+ * @param filename
+ *    Name of the data file.
+ * @throws DataFileException
+ *    If the file was not successfully read.
+ */
 void VolumeFile::readFile(const AString& filename) throw (DataFileException)
 {
     clear();
@@ -1282,6 +1297,47 @@ VolumeFile::clearVoxelColoringForMap(const int64_t mapIndex)
     m_voxelColorizer->clearVoxelColoringForMap(mapIndex);
 }
 
+/**
+ * Get the voxel RGBA coloring of an entire map, four components per voxel
+ * in the same order as the map's data.  Label display selections are not
+ * applied.
+ *
+ * @param mapIndex
+ *    Index of the map.
+ * @return
+ *    The coloring, or NULL if coloring is not enabled or the map has
+ *    not been colored.
+ */
+const uint8_t*
+VolumeFile::getVoxelColorsForMap(const int32_t mapIndex) const
+{
+    if (s_voxelColoringEnabled == false) {
+        return NULL;
+    }
+    CaretAssert(m_voxelColorizer);
+    
+    return m_voxelColorizer->getVoxelColorsForMap(mapIndex);
+}
+
+/**
+ * @return A value that changes whenever the voxel coloring of the map
+ * changes and is never repeated by other maps or files, or -1 if coloring
+ * is not enabled.
+ *
+ * @param mapIndex
+ *    Index of the map.
+ */
+int64_t
+VolumeFile::getVoxelColoringVersionForMap(const int32_t mapIndex) const
+{
+    if (s_voxelColoringEnabled == false) {
+        return -1;
+    }
+    CaretAssert(m_voxelColorizer);
+    
+    return m_voxelColorizer->getVoxelColoringVersionForMap(mapIndex);
+}
+
 /**
  * Set the RGBA coloring for a voxel in a map.
  * Does nothing if coloring is not enabled.
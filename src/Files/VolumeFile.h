@@ -283,6 +283,10 @@ namespace caret {
         
         void clearVoxelColoringForMap(const int64_t mapIndex);
         
+        const uint8_t* getVoxelColorsForMap(const int32_t mapIndex) const;
+        
+        int64_t getVoxelColoringVersionForMap(const int32_t mapIndex) const;
+        
 //        void setVoxelColorInMap(const int64_t i,
 //                                 const int64_t j,
 //                                 const int64_t k,
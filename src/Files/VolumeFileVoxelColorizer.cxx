@@ -25,6 +25,7 @@
 
 #include "CaretAssert.h"
 #include "CaretLogger.h"
+#include "CaretMutex.h"
 #include "ElapsedTimer.h"
 #include "GiftiLabel.h"
 #include "GroupAndNameHierarchyItem.h"
@@ -33,6 +34,8 @@
 
 using namespace caret;
 
+static CaretMutex s_coloringVersionMutex;
+static int64_t s_coloringVersionCounter = 0;
 
     
 /**
@@ -66,6 +69,7 @@ VolumeFileVoxelColorizer::VolumeFileVoxelColorizer(VolumeFile* volumeFile)
     for (int64_t i = 0; i < m_mapCount; i++) {
         m_mapRGBA.push_back(new uint8_t[m_mapRGBACount]);
         m_mapColoringValid.push_back(false);
+        m_mapColoringVersion.push_back(newColoringVersion());
     }
 }
 
@@ -176,6 +180,8 @@ VolumeFileVoxelColorizer::assignVoxelColorsForMap(const int32_t mapIndex,
             break;
     }
     
+    m_mapColoringVersion[mapIndex] = newColoringVersion();
+    
     CaretLogFine("Time to color map named \""
                    + m_volumeFile->getMapName(mapIndex)
                    + " in volume file "
@@ -220,6 +226,9 @@ VolumeFileVoxelColorizer::invalidateColoring()
     std::fill(m_mapColoringValid.begin(),
               m_mapColoringValid.end(),
               false);
+    for (int64_t i = 0; i < m_mapCount; i++) {
+        m_mapColoringVersion[i] = newColoringVersion();
+    }
 }
 
 /**
@@ -416,6 +425,53 @@ VolumeFileVoxelColorizer::clearVoxelColoringForMap(const int64_t mapIndex)
     for (int64_t i = 0; i < m_mapRGBACount; i++) {
         mapRGBA[i] = 0.0;
     }
+    m_mapColoringVersion[mapIndex] = newColoringVersion();
+}
+
+/**
+ * Get the voxel coloring of an entire map, four components per voxel
+ * with voxel (i, j, k) at offset 4 * (i + dimI * (j + dimJ * k)).  Label
+ * display selections are NOT applied, use getVoxelColorsForSliceInMap()
+ * for label data.
+ *
+ * @param mapIndex
+ *    Index of map.
+ * @return
+ *    RGBA coloring of the map or NULL if the map has not been colored.
+ */
+const uint8_t*
+VolumeFileVoxelColorizer::getVoxelColorsForMap(const int32_t mapIndex) const
+{
+    CaretAssertVectorIndex(m_mapRGBA, mapIndex);
+    if ( ! m_mapColoringValid[mapIndex]) {
+        return NULL;
+    }
+    return m_mapRGBA[mapIndex];
+}
+
+/**
+ * @return A value that changes whenever the coloring of the map changes so
+ * that copies of the coloring (such as OpenGL textures) can be updated.
+ * The value is never used by any other map or colorizer.
+ *
+ * @param mapIndex
+ *    Index of map.
+ */
+int64_t
+VolumeFileVoxelColorizer::getVoxelColoringVersionForMap(const int32_t mapIndex) const
+{
+    CaretAssertVectorIndex(m_mapColoringVersion, mapIndex);
+    return m_mapColoringVersion[mapIndex];
+}
+
+/**
+ * @return A new coloring version.
+ */
+int64_t
+VolumeFileVoxelColorizer::newColoringVersion()
+{
+    CaretMutexLocker locked(&s_coloringVersionMutex);
+    return ++s_coloringVersionCounter;
 }
 
 /**
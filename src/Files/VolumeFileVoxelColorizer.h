@@ -65,6 +65,10 @@ namespace caret {
         
         void clearVoxelColoringForMap(const int64_t mapIndex);
         
+        const uint8_t* getVoxelColorsForMap(const int32_t mapIndex) const;
+        
+        int64_t getVoxelColoringVersionForMap(const int32_t mapIndex) const;
+        
 //        void setVoxelColorInMap(const int64_t i,
 //                                 const int64_t j,
 //                                 const int64_t k,
@@ -89,6 +93,8 @@ namespace caret {
                          + ((k * m_dimI * m_dimJ))));
         }
 
+        static int64_t newColoringVersion();
+        
         // ADD_NEW_MEMBERS_HERE
 
         VolumeFile* m_volumeFile;
@@ -102,6 +108,9 @@ namespace caret {
         
         std::vector<bool> m_mapColoringValid;
         std::vector<uint8_t*> m_mapRGBA;
+        
+        /** Changes whenever a map's coloring changes, never repeats across colorizers */
+        std::vector<int64_t> m_mapColoringVersion;
     };
     
 #ifdef __VOLUME_FILE_VOXEL_COLORIZER_DECLARE__
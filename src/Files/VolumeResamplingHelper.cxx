@@ -0,0 +1,160 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "VolumeResamplingHelper.h"
+
+#include "CaretAssert.h"
+#include "CaretLogger.h"
+#include "CaretOMP.h"
+#include "VolumeSpline.h"
+
+#include <cmath>
+
+using namespace std;
+using namespace caret;
+
+VolumeResamplingHelper::VolumeResamplingHelper(const VolumeSpace& inputSpace, const int64_t& numOutputVoxels, const VolumeFile::InterpType& method)
+{
+    m_method = method;
+    m_inputSpace = inputSpace;
+    m_numVoxels = numOutputVoxels;
+    m_sourceIndex.resize(m_numVoxels, -1);
+    if (m_method != VolumeFile::ENCLOSING_VOXEL)
+    {
+        m_offsets.resize(m_numVoxels * 3);
+    }
+}
+
+void VolumeResamplingHelper::setSourceCoordinate(const int64_t& outputIndex, const float coordIn[3])
+{//mirrors the validity tests and index math of VolumeFile::interpolateValue, so results are identical
+    CaretAssert(outputIndex >= 0 && outputIndex < m_numVoxels);
+    const int64_t* dims = m_inputSpace.getDims();
+    switch (m_method)
+    {
+        case VolumeFile::ENCLOSING_VOXEL:
+        {
+            int64_t index[3];
+            m_inputSpace.enclosingVoxel(coordIn, index);
+            if (m_inputSpace.indexValid(index))
+            {
+                m_sourceIndex[outputIndex] = index[0] + dims[0] * (index[1] + dims[1] * index[2]);
+            }
+            break;
+        }
+        case VolumeFile::TRILINEAR:
+        case VolumeFile::CUBIC:
+        {
+            float indexSpace[3];
+            m_inputSpace.spaceToIndex(coordIn, indexSpace);
+            int64_t ind1low = floor(indexSpace[0]);
+            int64_t ind2low = floor(indexSpace[1]);
+            int64_t ind3low = floor(indexSpace[2]);
+            if (m_inputSpace.indexValid(ind1low, ind2low, ind3low) && m_inputSpace.indexValid(ind1low + 1, ind2low + 1, ind3low + 1))
+            {
+                m_sourceIndex[outputIndex] = ind1low + dims[0] * (ind2low + dims[1] * ind3low);
+                float* offsets = m_offsets.data() + outputIndex * 3;
+                if (m_method == VolumeFile::TRILINEAR)
+                {
+                    offsets[0] = indexSpace[0] - ind1low;
+                    offsets[1] = indexSpace[1] - ind2low;
+                    offsets[2] = indexSpace[2] - ind3low;
+                } else {
+                    offsets[0] = indexSpace[0];
+                    offsets[1] = indexSpace[1];
+                    offsets[2] = indexSpace[2];
+                }
+            }
+            break;
+        }
+    }
+}
+
+void VolumeResamplingHelper::resampleFrame(const VolumeFile* inVol, const int64_t& brickIndex, const int64_t& component, float* frameOut) const
+{
+    CaretAssert(inVol->matchesVolumeSpace(m_inputSpace));
+    const float* inFrame = inVol->getFrame(brickIndex, component);
+    const int64_t* dims = m_inputSpace.getDims();
+    switch (m_method)
+    {
+        case VolumeFile::ENCLOSING_VOXEL:
+        {
+#pragma omp CARET_PARFOR
+            for (int64_t i = 0; i < m_numVoxels; ++i)
+            {
+                if (m_sourceIndex[i] < 0)
+                {
+                    frameOut[i] = VolumeFile::INVALID_INTERP_VALUE;
+                } else {
+                    frameOut[i] = inFrame[m_sourceIndex[i]];
+                }
+            }
+            break;
+        }
+        case VolumeFile::TRILINEAR:
+        {
+            const int64_t jStep = dims[0], kStep = dims[0] * dims[1];
+#pragma omp CARET_PARFOR
+            for (int64_t i = 0; i < m_numVoxels; ++i)
+            {
+                if (m_sourceIndex[i] < 0)
+                {
+                    frameOut[i] = VolumeFile::INVALID_INTERP_VALUE;
+                    continue;
+                }
+                const float* corner = inFrame + m_sourceIndex[i];
+                const float* offsets = m_offsets.data() + i * 3;
+                float xhighWeight = offsets[0];
+                float xlowWeight = 1.0f - xhighWeight;
+                float xinterp[2][2];
+                xinterp[0][0] = xlowWeight * corner[0] + xhighWeight * corner[1];
+                xinterp[1][0] = xlowWeight * corner[jStep] + xhighWeight * corner[jStep + 1];
+                xinterp[0][1] = xlowWeight * corner[kStep] + xhighWeight * corner[kStep + 1];
+                xinterp[1][1] = xlowWeight * corner[jStep + kStep] + xhighWeight * corner[jStep + kStep + 1];
+                float yhighWeight = offsets[1];
+                float ylowWeight = 1.0f - yhighWeight;
+                float yinterp[2];
+                yinterp[0] = ylowWeight * xinterp[0][0] + yhighWeight * xinterp[1][0];
+                yinterp[1] = ylowWeight * xinterp[0][1] + yhighWeight * xinterp[1][1];
+                float zhighWeight = offsets[2];
+                float zlowWeight = 1.0f - zhighWeight;
+                frameOut[i] = zlowWeight * yinterp[0] + zhighWeight * yinterp[1];
+            }
+            break;
+        }
+        case VolumeFile::CUBIC:
+        {//deconvolve just this frame, rather than letting the input volume cache splines for every frame
+            VolumeSpline mySpline(inFrame, dims);
+            if (mySpline.ignoredNonNumeric())
+            {
+                CaretLogWarning("ignored non-numeric input value when calculating cubic splines in volume '" + inVol->getFileName() + "', frame #" + AString::number(brickIndex + 1));
+            }
+            mySpline.sample(m_offsets.data(), frameOut, m_numVoxels);
+#pragma omp CARET_PARFOR
+            for (int64_t i = 0; i < m_numVoxels; ++i)
+            {
+                if (m_sourceIndex[i] < 0)
+                {
+                    frameOut[i] = VolumeFile::INVALID_INTERP_VALUE;
+                }
+            }
+            break;
+        }
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef __VOLUME_RESAMPLING_HELPER_H__
+#define __VOLUME_RESAMPLING_HELPER_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "VolumeFile.h"
+#include "VolumeSpace.h"
+
+#include "stdint.h"
+#include <vector>
+
+//NOTE: where each output voxel samples the input (enclosing voxel, trilinear corner and weights, or spline index coordinates) doesn't depend on
+//      the frame, so it is computed once, and then every frame of the input is resampled by gathering through it.
+
+namespace caret {
+    
+    class VolumeResamplingHelper
+    {
+        VolumeFile::InterpType m_method;
+        VolumeSpace m_inputSpace;
+        int64_t m_numVoxels;
+        std::vector<int64_t> m_sourceIndex;//index within an input frame of the enclosing voxel or the low trilinear corner, -1 if there is no valid input
+        std::vector<float> m_offsets;//3 per output voxel, the trilinear high weights, or the index space coordinates for cubic
+        VolumeResamplingHelper();
+    public:
+        ///all output voxels start with no valid input, use setSourceCoordinate on each one that has a location in the input
+        VolumeResamplingHelper(const VolumeSpace& inputSpace, const int64_t& numOutputVoxels, const VolumeFile::InterpType& method);
+        ///set the input space coordinate that an output voxel takes its value from, may be called in parallel for different voxels
+        void setSourceCoordinate(const int64_t& outputIndex, const float coordIn[3]);
+        ///resample one frame of a volume in the input space, giving the same values as VolumeFile::interpolateValue at each source coordinate
+        void resampleFrame(const VolumeFile* inVol, const int64_t& brickIndex, const int64_t& component, float* frameOut) const;
+    };
+    
+}
+
+#endif //__VOLUME_RESAMPLING_HELPER_H__
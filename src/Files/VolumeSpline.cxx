@@ -44,117 +44,54 @@ VolumeSpline::VolumeSpline(const float* frame, const int64_t framedims[3])
     m_dims[0] = framedims[0];
     m_dims[1] = framedims[1];
     m_dims[2] = framedims[2];
-    m_deconv = CaretArray<float>(m_dims[0] * m_dims[1] * m_dims[2]);
-    CaretArray<float> scratchArray(m_dims[0] * max(m_dims[1], m_dims[2])), deconvScratch(max(m_dims[0], max(m_dims[1], m_dims[2])));//allocate as much as we will need, even if we don't use it all yet
-    predeconvolve(deconvScratch, m_dims[0]);
-    for (int k = 0; k < m_dims[2]; ++k)
+    const int64_t rowSize = m_dims[0], sliceSize = m_dims[0] * m_dims[1];
+    m_deconv = CaretArray<float>(sliceSize * m_dims[2]);
+    if (sliceSize * m_dims[2] < 1) return;
+    CaretArray<float> iBacksubs(m_dims[0]), jBacksubs(m_dims[1]), kBacksubs(m_dims[2]);
+    predeconvolve(iBacksubs, m_dims[0]);
+    predeconvolve(jBacksubs, m_dims[1]);
+    predeconvolve(kBacksubs, m_dims[2]);
+    //deconvolve in place, one axis at a time - for j and k, do all the lines of a slice or slab together instead of transposing them,
+    //so that every step of the recurrence is a contiguous loop across lines, and slices/slabs are independent work for threads
+#pragma omp CARET_PAR
     {
-        int64_t index = m_dims[0] * m_dims[1] * k;
-        int64_t index2 = 0;
-        for (int j = 0; j < m_dims[1]; ++j)
+        bool privIgnored = false;
+#pragma omp CARET_FOR schedule(dynamic)
+        for (int64_t k = 0; k < m_dims[2]; ++k)
         {
-            for (int i = 0; i < m_dims[0]; ++i)
+            for (int64_t j = 0; j < m_dims[1]; ++j)
             {
-                float tempf = frame[index];
-                if (MathFunctions::isNumeric(tempf))
+                int64_t index = k * sliceSize + j * rowSize;
+                float* row = m_deconv.getArray() + index;
+                for (int64_t i = 0; i < m_dims[0]; ++i)
                 {
-                    scratchArray[index2] = tempf;
-                } else {
-                    scratchArray[index2] = 0.0f;
-                    m_ignoredNonNumeric = true;
+                    float tempf = frame[index + i];
+                    if (MathFunctions::isNumeric(tempf))
+                    {
+                        row[i] = tempf;
+                    } else {
+                        row[i] = 0.0f;
+                        privIgnored = true;
+                    }
                 }
-                ++index;
-                ++index2;
+                deconvolveLines(row, iBacksubs, m_dims[0], 1, 1);
             }
+            deconvolveLines(m_deconv.getArray() + k * sliceSize, jBacksubs, m_dims[1], rowSize, rowSize);
         }
-#pragma omp CARET_PARFOR schedule(dynamic)
-        for (int j = 0; j < m_dims[1]; ++j)
+        if (privIgnored)
         {
-            int64_t privIndex = j * m_dims[0];
-            deconvolve(scratchArray.getArray() + privIndex, deconvScratch, m_dims[0]);
+#pragma omp critical
+            m_ignoredNonNumeric = true;
         }
-        index = m_dims[0] * m_dims[1] * k;
-        index2 = 0;
-        for (int j = 0; j < m_dims[1]; ++j)
+#pragma omp CARET_FOR schedule(dynamic)
+        for (int64_t j = 0; j < m_dims[1]; ++j)
         {
-            for (int i = 0; i < m_dims[0]; ++i)
-            {
-                m_deconv[index] = scratchArray[index2];
-                ++index;
-                ++index2;
-            }
-        }
-    }
-    predeconvolve(deconvScratch, m_dims[1]);
-    for (int k = 0; k < m_dims[2]; ++k)
-    {
-        int64_t indexbase = k * m_dims[1] * m_dims[0];
-        int64_t index = indexbase;
-        for (int j = 0; j < m_dims[1]; ++j)
-        {
-            int64_t index2 = j;
-            for (int i = 0; i < m_dims[0]; ++i)
-            {
-                scratchArray[index2] = m_deconv[index];//read linearly from frame while writing transposed should be slightly faster, because cache can stay dirty?
-                index2 += m_dims[1];
-                ++index;
-            }
-        }
-#pragma omp CARET_PARFOR schedule(dynamic)
-        for (int i = 0; i < m_dims[0]; ++i)
-        {
-            int64_t privindex = i * m_dims[1];
-            deconvolve(scratchArray.getArray() + privindex, deconvScratch, m_dims[1]);
-        }
-        index = 0;
-        for (int i = 0; i < m_dims[0]; ++i)
-        {
-            int64_t index2 = i + indexbase;
-            for (int j = 0; j < m_dims[1]; ++j)
-            {
-                m_deconv[index2] = scratchArray[index];//even though scratch should be cached now, if writing to frame collides, reading linearly should give better behavior
-                ++index;
-                index2 += m_dims[0];
-            }
-        }
-    }
-    predeconvolve(deconvScratch, m_dims[2]);
-    for (int j = 0; j < m_dims[1]; ++j)//finally, use a similar strategy to do linear reads instead of widely interleaved reads for k-rows
-    {
-        int64_t indexbase = j * m_dims[0];
-        int64_t increment = m_dims[1] * m_dims[0];
-        for (int k = 0; k < m_dims[2]; ++k)
-        {
-            int64_t index = indexbase + k * increment;
-            int64_t index2 = k;
-            for (int i = 0; i < m_dims[0]; ++i)
-            {
-                scratchArray[index2] = m_deconv[index];
-                index2 += m_dims[2];
-                ++index;
-            }
-        }
-#pragma omp CARET_PARFOR schedule(dynamic)
-        for (int i = 0; i < m_dims[0]; ++i)
-        {
-            int64_t privindex = i * m_dims[2];
-            deconvolve(scratchArray.getArray() + privindex, deconvScratch, m_dims[2]);
-        }
-        for (int i = 0; i < m_dims[0]; ++i)
-        {
-            int64_t index = indexbase + i;
-            int64_t index2 = i * m_dims[2];
-            for (int k = 0; k < m_dims[2]; ++k)
-            {
-                m_deconv[index] = scratchArray[index2];
-                index += increment;
-                ++index2;
-            }
+            deconvolveLines(m_deconv.getArray() + j * rowSize, kBacksubs, m_dims[2], sliceSize, rowSize);
         }
     }
 }
 
-float VolumeSpline::sample(const float& ifloat, const float& jfloat, const float& kfloat)
+float VolumeSpline::sample(const float& ifloat, const float& jfloat, const float& kfloat) const
 {
     if (m_dims[0] < 1 || ifloat < 0.0f || jfloat < 0.0f || kfloat < 0.0f || ifloat > m_dims[0] - 1 || jfloat > m_dims[1] - 1 || kfloat > m_dims[2] - 1) return 0.0f;//yeesh
     const int64_t zstep = m_dims[0] * m_dims[1];
@@ -230,19 +167,43 @@ float VolumeSpline::sample(const float& ifloat, const float& jfloat, const float
     }
 }
 
-void VolumeSpline::deconvolve(float* data, const float* backsubs, const int64_t& length)
+void VolumeSpline::sample(const float* ijkList, float* valuesOut, const int64_t& numPoints) const
+{
+#pragma omp CARET_PARFOR
+    for (int64_t i = 0; i < numPoints; ++i)
+    {
+        valuesOut[i] = sample(ijkList + i * 3);
+    }
+}
+
+void VolumeSpline::deconvolveLines(float* data, const float* backsubs, const int64_t& length, const int64_t& stride, const int64_t& numLines)
 {
     if (length < 1) return;
     const float A = 1.0f / 6.0f, B = 2.0f / 3.0f;//the coefficients of a bspline at center and +/-1
     //forward pass simulating gaussian elimination on matrix of bspline kernels and data
-    data[0] /= B;
-    for (int i = 1; i < length; ++i)//the first row is handled slightly differently
+    for (int64_t line = 0; line < numLines; ++line)//the first row is handled slightly differently
+    {
+        data[line] /= B;
+    }
+    for (int64_t i = 1; i < length; ++i)
     {
-        data[i] = (data[i] - A * data[i - 1]) / (B - A * backsubs[i - 1]);
+        float* cur = data + i * stride;
+        const float* prev = cur - stride;
+        const float denom = B - A * backsubs[i - 1];
+        for (int64_t line = 0; line < numLines; ++line)
+        {
+            cur[line] = (cur[line] - A * prev[line]) / denom;
+        }
     }//back substitution, making it gauss-jordan
-    for (int i = length - 2; i >= 0; --i)//the last row doesn't need back-substitution
+    for (int64_t i = length - 2; i >= 0; --i)//the last row doesn't need back-substitution
     {
-        data[i] -= backsubs[i] * data[i + 1];
+        float* cur = data + i * stride;
+        const float* next = cur + stride;
+        const float backsub = backsubs[i];
+        for (int64_t line = 0; line < numLines; ++line)
+        {
+            cur[line] -= backsub * next[line];
+        }
     }
 }
 
@@ -0,0 +1,142 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "WeightOperatorFile.h"
+
+#include "CaretAssert.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryFile>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+using namespace caret;
+
+WeightOperatorFile::WeightOperatorFile()
+{
+    m_writeFailed = false;
+}
+
+WeightOperatorFile::~WeightOperatorFile()
+{//an unfinished write leaves nothing behind, QTemporaryFile removes itself
+    m_stream.setDevice(NULL);
+}
+
+bool WeightOperatorFile::openRead(const AString& fileName, const char* magic)
+{
+    CaretAssert(strlen(magic) == MAGIC_LENGTH);
+    m_stream.setDevice(NULL);
+    m_writeFile.grabNew(NULL);
+    m_fileName = fileName;
+    m_readFile.grabNew(new QFile(fileName));
+    if (!m_readFile->exists() || !m_readFile->open(QIODevice::ReadOnly)) return false;
+    m_stream.setDevice(m_readFile.getPointer());
+    m_stream.setByteOrder(QDataStream::LittleEndian);
+    char fileMagic[MAGIC_LENGTH];
+    return (readRawData(fileMagic, MAGIC_LENGTH) && memcmp(fileMagic, magic, MAGIC_LENGTH) == 0);
+}
+
+bool WeightOperatorFile::readByteOrderCheck()
+{
+    if (m_stream.status() != QDataStream::Ok) return false;
+    int32_t byteOrderCheck = 0;
+    return (readRawData(&byteOrderCheck, sizeof(byteOrderCheck)) && byteOrderCheck == (int32_t)BYTE_ORDER_CHECK);
+}
+
+bool WeightOperatorFile::readRawData(void* data, const int64_t& numBytes)
+{
+    char* dataChar = (char*)data;
+    int64_t total = 0;
+    while (total < numBytes)
+    {
+        int request = (int)min(numBytes - total, (int64_t)RAW_CHUNK);
+        int ret = m_stream.readRawData(dataChar + total, request);
+        if (ret < 1) return false;
+        total += ret;
+    }
+    return true;
+}
+
+int64_t WeightOperatorFile::getRemainingBytes() const
+{
+    if (m_readFile == NULL) return 0;
+    return m_readFile->size() - m_readFile->pos();
+}
+
+bool WeightOperatorFile::openWrite(const AString& fileName, const char* magic)
+{
+    CaretAssert(strlen(magic) == MAGIC_LENGTH);
+    m_stream.setDevice(NULL);
+    m_readFile.grabNew(NULL);
+    m_fileName = fileName;
+    m_writeFailed = false;
+    QFileInfo myInfo(fileName);
+    QDir myDir = myInfo.absoluteDir();
+    if (!myDir.exists() && !myDir.mkpath(".")) return false;
+    m_writeFile.grabNew(new QTemporaryFile(myDir.filePath(myInfo.fileName() + ".XXXXXX")));
+    if (!m_writeFile->open()) return false;
+    m_stream.setDevice(m_writeFile.getPointer());
+    m_stream.setByteOrder(QDataStream::LittleEndian);
+    writeRawData(magic, MAGIC_LENGTH);
+    return true;
+}
+
+void WeightOperatorFile::writeByteOrderCheck()
+{
+    const int32_t byteOrderCheck = BYTE_ORDER_CHECK;
+    writeRawData(&byteOrderCheck, sizeof(byteOrderCheck));
+}
+
+void WeightOperatorFile::writeRawData(const void* data, const int64_t& numBytes)
+{
+    const char* dataChar = (const char*)data;
+    int64_t total = 0;
+    while (total < numBytes)
+    {
+        int request = (int)min(numBytes - total, (int64_t)RAW_CHUNK);
+        int ret = m_stream.writeRawData(dataChar + total, request);
+        if (ret < 1)
+        {
+            m_writeFailed = true;
+            return;
+        }
+        total += ret;
+    }
+}
+
+bool WeightOperatorFile::finishWrite()
+{
+    CaretAssert(m_writeFile != NULL);
+    bool ok = (!m_writeFailed && m_stream.status() == QDataStream::Ok && m_writeFile->flush());
+    m_stream.setDevice(NULL);
+    if (ok)
+    {
+        m_writeFile->close();
+        QFile::remove(m_fileName);//if another job finished the same operator first, replacing it with an identical one is harmless
+        ok = m_writeFile->rename(m_fileName);
+        if (ok) m_writeFile->setAutoRemove(false);
+    }
+    m_writeFile.grabNew(NULL);
+    return ok;
+}
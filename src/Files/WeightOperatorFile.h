@@ -0,0 +1,81 @@
+#ifndef __WEIGHT_OPERATOR_FILE_H__
+#define __WEIGHT_OPERATOR_FILE_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "AString.h"
+#include "CaretPointer.h"
+
+#include <QDataStream>
+
+#include "stdint.h"
+
+class QFile;
+class QTemporaryFile;
+
+//NOTE: the precomputed sparse weight operators (surface resampling, smoothing, ribbon mapping) share one file layout: an 8 character magic string,
+//      header fields written through getStream() (key, sizes), a byte order check, then the raw arrays in the byte order of the machine that wrote them
+
+namespace caret {
+
+    class WeightOperatorFile
+    {
+        enum
+        {
+            BYTE_ORDER_CHECK = 0x01020304,
+            RAW_CHUNK = 1 << 30//QDataStream raw IO takes int lengths, so larger arrays go in pieces
+        };
+        CaretPointer<QFile> m_readFile;
+        CaretPointer<QTemporaryFile> m_writeFile;
+        QDataStream m_stream;
+        AString m_fileName;
+        bool m_writeFailed;
+        WeightOperatorFile(const WeightOperatorFile&);
+        WeightOperatorFile& operator=(const WeightOperatorFile&);
+    public:
+        enum
+        {
+            MAGIC_LENGTH = 8,
+            COLUMN_BLOCK = 16//number of data columns applied per pass over a weight operator, so each pass over the operator serves several columns
+        };
+        WeightOperatorFile();
+        ~WeightOperatorFile();
+        ///returns false if the file doesn't exist, can't be opened, or doesn't start with the magic string
+        bool openRead(const AString& fileName, const char* magic);
+        ///returns false if the header fields were truncated, or the arrays were written with a different byte order
+        bool readByteOrderCheck();
+        ///returns false if the file ends before numBytes were read
+        bool readRawData(void* data, const int64_t& numBytes);
+        ///bytes left after the current read position, so array sizes from the header can be checked before allocating
+        int64_t getRemainingBytes() const;
+        ///writes to a temporary file in the same directory (creating it if needed), finishWrite() renames it so other readers never see a partial file
+        bool openWrite(const AString& fileName, const char* magic);
+        void writeByteOrderCheck();
+        void writeRawData(const void* data, const int64_t& numBytes);
+        ///returns false if any write or the rename failed, the temporary file is then removed
+        bool finishWrite();
+        ///for the header fields, always little endian
+        QDataStream& getStream() { return m_stream; }
+    };
+
+}
+
+#endif //__WEIGHT_OPERATOR_FILE_H__
@@ -26,6 +26,7 @@
 #include <QAction>
 #include <QApplication>
 #include <QDesktopWidget>
+#include <QTimer>
 #include <QWebView>
 
 #define __GUI_MANAGER_DEFINE__
@@ -128,6 +129,16 @@ GuiManager::GuiManager(QObject* parent)
     
     this->cursorManager = new CursorManager();
     
+    /*
+     * Rows of large connectivity files are read on background
+     * threads so that the user interface does not freeze, this
+     * timer installs and displays the rows once they arrive.
+     */
+    m_backgroundConnectivityLoadingTimer = new QTimer(this);
+    m_backgroundConnectivityLoadingTimer->setInterval(50);
+    QObject::connect(m_backgroundConnectivityLoadingTimer, SIGNAL(timeout()),
+                     this, SLOT(backgroundConnectivityLoadingTimerTimeout()));
+    
     /*
      * Information window.
      */
@@ -1106,6 +1117,33 @@ GuiManager::sceneDialogWasClosed()
     m_sceneDialogDisplayAction->blockSignals(false);
 }
 
+/**
+ * Called periodically while connectivity rows are being read on
+ * background threads.  Displays the rows that have arrived and
+ * stops when no rows are pending.
+ */
+void
+GuiManager::backgroundConnectivityLoadingTimerTimeout()
+{
+    Brain* brain = getBrain();
+    CiftiConnectivityMatrixDataFileManager* ciftiConnectivityManager = SessionManager::get()->getCiftiConnectivityMatrixDataFileManager();
+    
+    try {
+        if (ciftiConnectivityManager->finishBackgroundLoading(brain)) {
+            EventManager::get()->sendEvent(EventGraphicsUpdateAllWindows().getPointer());
+            EventManager::get()->sendEvent(EventUserInterfaceUpdate().addToolBar().addToolBox().getPointer());
+        }
+    }
+    catch (const DataFileException& e) {
+        m_backgroundConnectivityLoadingTimer->stop();
+        QMessageBox::critical(getActiveBrowserWindow(), "", e.whatString());
+    }
+    
+    if (ciftiConnectivityManager->isBackgroundLoadingPending(brain) == false) {
+        m_backgroundConnectivityLoadingTimer->stop();
+    }
+}
+
 /**
  * Show or hide the scene dialog.
  *
@@ -1843,10 +1881,15 @@ GuiManager::processIdentification(SelectionManager* selectionManager,
                 try {
                     triedToLoadSurfaceODemandData = true;
                     
+                    const bool backgroundLoadingFlag = true;
                     ciftiConnectivityManager->loadDataForSurfaceNode(brain,
                                                                      surface,
                                                                      nodeIndex,
-                                                                     ciftiLoadingInfo);
+                                                                     ciftiLoadingInfo,
+                                                                     backgroundLoadingFlag);
+                    if (ciftiConnectivityManager->isBackgroundLoadingPending(brain)) {
+                        m_backgroundConnectivityLoadingTimer->start();
+                    }
                     
                     ciftiFiberTrajectoryManager->loadDataForSurfaceNode(brain,
                                                                         surface,
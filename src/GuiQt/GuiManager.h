@@ -35,6 +35,7 @@
 
 class QAction;
 class QDialog;
+class QTimer;
 class QWidget;
 class MovieDialog;
 namespace caret {
@@ -160,6 +161,8 @@ namespace caret {
     private slots:
         void sceneDialogWasClosed();
         
+        void backgroundConnectivityLoadingTimerTimeout();
+        
     private:
         GuiManager(QObject* parent = 0);
         
@@ -230,6 +233,9 @@ namespace caret {
         
         BugReportDialog* m_bugReportDialog;
         
+        /** Polls for connectivity rows read on background threads */
+        QTimer* m_backgroundConnectivityLoadingTimer;
+        
         /** 
          * Tracks non-modal dialogs that are created only one time
          * and may need to be reparented if the original parent, a
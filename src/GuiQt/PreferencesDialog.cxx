@@ -191,6 +191,7 @@ PreferencesDialog::updateDialog()
     this->volumeAxesMontageCoordinatesComboBox->setStatus(prefs->isVolumeMontageAxesCoordinatesDisplayed());
     this->volumeMontageGapSpinBox->setValue(prefs->getVolumeMontageGap());
     this->volumeMontageCoordinatePrecisionSpinBox->setValue(prefs->getVolumeMontageCoordinatePrecision());
+    this->volumeSliceTextureDrawingComboBox->setStatus(prefs->isVolumeSliceTextureDrawingEnabled());
     this->splashScreenShowAtStartupComboBox->setStatus(prefs->isSplashScreenEnabled());
     this->developMenuEnabledComboBox->setStatus(prefs->isDevelopMenuEnabled());
     
@@ -397,11 +398,16 @@ PreferencesDialog::addVolumeItems()
                                                                                   this,
                                                                                   SLOT(volumeMontageCoordinatePrecisionChanged(int)));
     
+    this->volumeSliceTextureDrawingComboBox = new WuQTrueFalseComboBox("On", "Off", this);
+    QObject::connect(this->volumeSliceTextureDrawingComboBox, SIGNAL(statusChanged(bool)),
+                     this, SLOT(volumeSliceTextureDrawingComboBoxToggled(bool)));
+    
     this->allWidgets->add(this->volumeAxesCrosshairsComboBox);
     this->allWidgets->add(this->volumeAxesLabelsComboBox);
     this->allWidgets->add(this->volumeAxesMontageCoordinatesComboBox);
     this->allWidgets->add(this->volumeMontageGapSpinBox);
     this->allWidgets->add(this->volumeMontageCoordinatePrecisionSpinBox);
+    this->allWidgets->add(this->volumeSliceTextureDrawingComboBox);
     
     this->addWidgetToLayout("Volume Axes Crosshairs: ", 
                             this->volumeAxesCrosshairsComboBox->getWidget());
@@ -413,6 +419,8 @@ PreferencesDialog::addVolumeItems()
                              this->volumeMontageGapSpinBox);
     this->addWidgetToLayout("Volume Montage Precision: ",
                             this->volumeMontageCoordinatePrecisionSpinBox);
+    this->addWidgetToLayout("Volume Slice Textures: ",
+                            this->volumeSliceTextureDrawingComboBox->getWidget());
 }
 
 /**
@@ -476,6 +484,19 @@ PreferencesDialog::volumeMontageCoordinatePrecisionChanged(int value)
     EventManager::get()->sendEvent(EventGraphicsUpdateAllWindows().getPointer());
 }
 
+/**
+ * Called when volume slice texture drawing is toggled.
+ * @param value
+ *    New value.
+ */
+void
+PreferencesDialog::volumeSliceTextureDrawingComboBoxToggled(bool value)
+{
+    CaretPreferences* prefs = SessionManager::get()->getCaretPreferences();
+    prefs->setVolumeSliceTextureDrawingEnabled(value);
+    EventManager::get()->sendEvent(EventGraphicsUpdateAllWindows().getPointer());
+}
+
 /**
  * Add splash screen items.
  */
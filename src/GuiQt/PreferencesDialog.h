@@ -61,6 +61,7 @@ namespace caret {
         void volumeAxesMontageCoordinatesComboBoxToggled(bool value);
         void volumeMontageGapValueChanged(int value);
         void volumeMontageCoordinatePrecisionChanged(int value);
+        void volumeSliceTextureDrawingComboBoxToggled(bool value);
         
         void splashScreenShowAtStartupComboBoxChanged(bool value);
         
@@ -98,6 +99,7 @@ namespace caret {
         WuQTrueFalseComboBox* volumeAxesMontageCoordinatesComboBox;
         QSpinBox* volumeMontageGapSpinBox;
         QSpinBox* volumeMontageCoordinatePrecisionSpinBox;
+        WuQTrueFalseComboBox* volumeSliceTextureDrawingComboBox;
         
         WuQTrueFalseComboBox* splashScreenShowAtStartupComboBox;
         
@@ -0,0 +1,490 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "GZipIndexedReader.h"
+
+#include "CaretAssert.h"
+#include "CaretLogger.h"
+
+#include <QDataStream>
+#include <QFileInfo>
+#include <QTemporaryFile>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace caret;
+using namespace std;
+
+std::map<AString, GZipIndexedReader::CacheEntry> GZipIndexedReader::s_indexCache;
+int64_t GZipIndexedReader::s_indexCacheUseCounter = 0;
+CaretMutex GZipIndexedReader::s_indexCacheMutex;
+const char GZipIndexedReader::s_indexFileMagic[INDEX_MAGIC_LENGTH] = { 'W', 'B', 'G', 'Z', 'I', 'D', 'X', '2' };
+
+/**
+ * Open a gzip file for random access, reusing an index from this process or a
+ * valid sidecar index file when available, otherwise scanning the file once.
+ *
+ * @param fileName
+ *    Name of the gzip file.
+ * @param span
+ *    Approximate uncompressed distance between access points when a new index is built.
+ */
+GZipIndexedReader::GZipIndexedReader(const AString& fileName, const int64_t& span) throw (NiftiException)
+{
+    m_fileName = fileName;
+    QFileInfo myInfo(fileName);
+    if (!myInfo.exists()) throw NiftiException("file '" + fileName + "' not found");
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly)) throw NiftiException("failed to open file '" + fileName + "' for reading");
+    Fingerprint myFingerprint = getFingerprint(m_file, myInfo);
+    AString cacheKey = myInfo.canonicalFilePath();
+    {
+        CaretMutexLocker locked(&s_indexCacheMutex);
+        map<AString, CacheEntry>::iterator iter = s_indexCache.find(cacheKey);
+        if (iter != s_indexCache.end())
+        {
+            if (iter->second.m_index->m_fingerprint == myFingerprint)
+            {
+                m_index = iter->second.m_index;
+                iter->second.m_lastUsed = ++s_indexCacheUseCounter;
+                return;
+            }
+            s_indexCache.erase(iter);
+        }
+    }
+    m_index = readIndexFile(getIndexFileName(fileName), myFingerprint);
+    if (m_index == NULL)
+    {//no sidecar, or it doesn't match this file, so scan it
+        m_index = buildIndex(m_file, span);
+        m_index->m_fingerprint = myFingerprint;
+        if (m_file.size() != myFingerprint.m_fileSize) throw NiftiException("file '" + fileName + "' changed while it was being indexed");
+        CaretLogFine("indexed gzip file '" + fileName + "' with " + AString::number(m_index->m_points.size()) + " access points");
+        if (m_index->m_uncompressedSize >= PERSIST_MIN_SIZE)
+        {//replaces a stale sidecar too
+            try
+            {
+                writeIndexFile();
+            } catch (NiftiException& e) {//the directory may not be writable, later processes just scan again
+                CaretLogFine(e.whatString());
+            }
+        }
+    }
+    CaretMutexLocker locked(&s_indexCacheMutex);
+    if ((int)s_indexCache.size() >= MAX_CACHED_INDEXES && s_indexCache.find(cacheKey) == s_indexCache.end())
+    {//evict the least recently used index
+        map<AString, CacheEntry>::iterator oldest = s_indexCache.begin();
+        for (map<AString, CacheEntry>::iterator iter = s_indexCache.begin(); iter != s_indexCache.end(); ++iter)
+        {
+            if (iter->second.m_lastUsed < oldest->second.m_lastUsed) oldest = iter;
+        }
+        s_indexCache.erase(oldest);
+    }
+    CacheEntry& myEntry = s_indexCache[cacheKey];
+    myEntry.m_index = m_index;
+    myEntry.m_lastUsed = ++s_indexCacheUseCounter;
+}
+
+/**
+ * Forget all indexes shared in this process, so later readers use the sidecar
+ * file or rescan.
+ */
+void GZipIndexedReader::clearIndexCache()
+{
+    CaretMutexLocker locked(&s_indexCacheMutex);
+    s_indexCache.clear();
+}
+
+GZipIndexedReader::~GZipIndexedReader()
+{
+}
+
+/**
+ * @return the sidecar index file name used for a gzip file
+ */
+AString GZipIndexedReader::getIndexFileName(const AString& fileName)
+{
+    return fileName + ".gzidx";
+}
+
+/**
+ * Read a range of decompressed bytes.
+ *
+ * @param dataOut
+ *    Output buffer, must hold numBytes.
+ * @param uncompressedOffset
+ *    Offset into the decompressed data to start at.
+ * @param numBytes
+ *    Number of bytes to read.
+ */
+void GZipIndexedReader::read(char* dataOut, const int64_t& uncompressedOffset, const int64_t& numBytes) throw (NiftiException)
+{
+    if (numBytes <= 0) return;
+    if (uncompressedOffset < 0 || uncompressedOffset + numBytes > m_index->m_uncompressedSize)
+    {
+        throw NiftiException("requested bytes are outside the decompressed data of file '" + m_fileName + "'");
+    }
+    const vector<AccessPoint>& points = m_index->m_points;
+    CaretAssert(!points.empty() && points[0].m_outOffset == 0);
+    int64_t low = 0, high = (int64_t)points.size();//binary search for the last point at or before the offset
+    while (high - low > 1)
+    {
+        int64_t mid = (low + high) / 2;
+        if (points[mid].m_outOffset <= uncompressedOffset)
+        {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    const AccessPoint& myPoint = points[low];
+    if (!m_file.seek(myPoint.m_inOffset - (myPoint.m_bits ? 1 : 0)))
+    {
+        throw NiftiException("failed to seek in file '" + m_fileName + "'");
+    }
+    vector<unsigned char> input(INPUT_CHUNK), discard(INPUT_CHUNK);
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    bool raw = !myPoint.m_memberStart;
+    if (inflateInit2(&strm, raw ? -15 : 47) != Z_OK) throw NiftiException("failed to initialize zlib");
+    try
+    {
+        if (myPoint.m_bits)
+        {
+            char partialByte;
+            if (m_file.read(&partialByte, 1) != 1) throw NiftiException("failed to read from file '" + m_fileName + "'");
+            checkInflateReturn(inflatePrime(&strm, myPoint.m_bits, ((unsigned char)partialByte) >> (8 - myPoint.m_bits)), m_fileName);
+        }
+        if (raw && !myPoint.m_window.empty())
+        {
+            checkInflateReturn(inflateSetDictionary(&strm, &(myPoint.m_window[0]), myPoint.m_window.size()), m_fileName);
+        }
+        int64_t toSkip = uncompressedOffset - myPoint.m_outOffset, done = 0;
+        while (toSkip > 0 || done < numBytes)
+        {
+            bool atEnd = (strm.avail_in == 0 && !fillInput(m_file, strm, input, 1));//inflate may still have buffered output
+            if (toSkip > 0)
+            {
+                strm.next_out = &(discard[0]);
+                strm.avail_out = (uInt)min(toSkip, (int64_t)discard.size());
+            } else {
+                strm.next_out = (Bytef*)(dataOut + done);
+                strm.avail_out = (uInt)min(numBytes - done, (int64_t)(1 << 30));
+            }
+            uInt outBefore = strm.avail_out;
+            int ret = inflate(&strm, Z_NO_FLUSH);
+            checkInflateReturn(ret, m_fileName);
+            int64_t produced = outBefore - strm.avail_out;
+            if (atEnd && produced == 0 && ret != Z_STREAM_END)
+            {
+                throw NiftiException("unexpected end of compressed data in file '" + m_fileName + "'");
+            }
+            if (toSkip > 0)
+            {
+                toSkip -= produced;
+            } else {
+                done += produced;
+            }
+            if (ret == Z_STREAM_END && (toSkip > 0 || done < numBytes))
+            {//continue into the next gzip member
+                if (raw)
+                {//raw inflate stops before the member trailer (crc32 and size)
+                    for (int i = 0; i < 8; ++i)
+                    {
+                        if (strm.avail_in == 0 && !fillInput(m_file, strm, input, 1))
+                        {
+                            throw NiftiException("unexpected end of compressed data in file '" + m_fileName + "'");
+                        }
+                        ++strm.next_in;
+                        --strm.avail_in;
+                    }
+                }
+                if (!fillInput(m_file, strm, input, 2) || strm.next_in[0] != 0x1f || strm.next_in[1] != 0x8b)
+                {
+                    throw NiftiException("unexpected end of compressed data in file '" + m_fileName + "'");
+                }
+                Bytef* nextIn = strm.next_in;
+                uInt availIn = strm.avail_in;
+                inflateEnd(&strm);
+                memset(&strm, 0, sizeof(strm));
+                strm.next_in = nextIn;
+                strm.avail_in = availIn;
+                if (inflateInit2(&strm, 47) != Z_OK) throw NiftiException("failed to initialize zlib");
+                raw = false;
+            }
+        }
+    } catch (...) {
+        inflateEnd(&strm);
+        throw;
+    }
+    inflateEnd(&strm);
+}
+
+/**
+ * Save the index as a sidecar file next to the gzip file, so that other processes
+ * can skip scanning it.  Done automatically after scanning a large file.
+ */
+void GZipIndexedReader::writeIndexFile() const throw (NiftiException)
+{
+    AString indexFileName = getIndexFileName(m_fileName);
+    QTemporaryFile indexFile(indexFileName + ".XXXXXX");//renamed when complete, so other processes never read a partial index
+    if (!indexFile.open())
+    {
+        throw NiftiException("failed to open index file '" + indexFileName + "' for writing");
+    }
+    indexFile.setPermissions(QFile::ReadOwner | QFile::WriteOwner | QFile::ReadGroup | QFile::ReadOther);//temporary files are private, the index is not
+    QDataStream myStream(&indexFile);
+    myStream.setByteOrder(QDataStream::LittleEndian);
+    myStream.writeRawData(s_indexFileMagic, INDEX_MAGIC_LENGTH);
+    const Fingerprint& myFingerprint = m_index->m_fingerprint;
+    myStream << (qint64)myFingerprint.m_fileSize << (qint64)myFingerprint.m_modifiedTime << (quint32)myFingerprint.m_headCrc
+             << (quint32)myFingerprint.m_trailerCrc << (quint32)myFingerprint.m_trailerSize;
+    myStream << (qint64)m_index->m_uncompressedSize << (qint64)m_index->m_points.size();
+    for (size_t i = 0; i < m_index->m_points.size(); ++i)
+    {
+        const AccessPoint& myPoint = m_index->m_points[i];
+        myStream << (qint64)myPoint.m_outOffset << (qint64)myPoint.m_inOffset << (qint32)myPoint.m_bits << (qint32)(myPoint.m_memberStart ? 1 : 0) << (qint32)myPoint.m_window.size();
+        if (!myPoint.m_window.empty())
+        {
+            myStream.writeRawData((const char*)&(myPoint.m_window[0]), myPoint.m_window.size());
+        }
+    }
+    if (myStream.status() != QDataStream::Ok || !indexFile.flush())
+    {
+        throw NiftiException("failed to write index file '" + indexFileName + "'");
+    }
+    indexFile.close();
+    QFile::remove(indexFileName);
+    if (!indexFile.rename(indexFileName))
+    {
+        throw NiftiException("failed to write index file '" + indexFileName + "'");
+    }
+    indexFile.setAutoRemove(false);
+}
+
+///returns NULL if the index file doesn't exist or doesn't match the gzip file
+CaretPointer<GZipIndexedReader::Index> GZipIndexedReader::readIndexFile(const AString& indexFileName, const Fingerprint& fingerprint)
+{
+    CaretPointer<Index> ret;
+    QFile indexFile(indexFileName);
+    if (!indexFile.exists() || !indexFile.open(QIODevice::ReadOnly)) return ret;
+    QDataStream myStream(&indexFile);
+    myStream.setByteOrder(QDataStream::LittleEndian);
+    char magic[INDEX_MAGIC_LENGTH];
+    if (myStream.readRawData(magic, sizeof(magic)) != (int)sizeof(magic) || memcmp(magic, s_indexFileMagic, sizeof(magic)) != 0)
+    {
+        CaretLogInfo("ignoring invalid gzip index file '" + indexFileName + "'");
+        return ret;
+    }
+    qint64 indexedSize, indexedTime, uncompressedSize, numPoints;
+    quint32 headCrc, trailerCrc, trailerSize;
+    myStream >> indexedSize >> indexedTime >> headCrc >> trailerCrc >> trailerSize >> uncompressedSize >> numPoints;
+    Fingerprint indexedFingerprint;
+    indexedFingerprint.m_fileSize = indexedSize;
+    indexedFingerprint.m_modifiedTime = indexedTime;
+    indexedFingerprint.m_headCrc = headCrc;
+    indexedFingerprint.m_trailerCrc = trailerCrc;
+    indexedFingerprint.m_trailerSize = trailerSize;
+    if (myStream.status() != QDataStream::Ok || !(indexedFingerprint == fingerprint) || numPoints < 1)
+    {
+        CaretLogFine("ignoring stale gzip index file '" + indexFileName + "'");
+        return ret;
+    }
+    CaretPointer<Index> myIndex(new Index());
+    myIndex->m_fingerprint = indexedFingerprint;
+    myIndex->m_uncompressedSize = uncompressedSize;
+    myIndex->m_points.resize(numPoints);
+    for (qint64 i = 0; i < numPoints; ++i)
+    {
+        AccessPoint& myPoint = myIndex->m_points[i];
+        qint64 outOffset, inOffset;
+        qint32 bits, memberStart, windowSize;
+        myStream >> outOffset >> inOffset >> bits >> memberStart >> windowSize;
+        if (myStream.status() != QDataStream::Ok || bits < 0 || bits > 7 || windowSize < 0 || windowSize > WINDOW_SIZE)
+        {
+            CaretLogInfo("ignoring invalid gzip index file '" + indexFileName + "'");
+            return ret;
+        }
+        myPoint.m_outOffset = outOffset;
+        myPoint.m_inOffset = inOffset;
+        myPoint.m_bits = bits;
+        myPoint.m_memberStart = (memberStart != 0);
+        myPoint.m_window.resize(windowSize);
+        if (windowSize > 0 && myStream.readRawData((char*)&(myPoint.m_window[0]), windowSize) != windowSize)
+        {
+            CaretLogInfo("ignoring truncated gzip index file '" + indexFileName + "'");
+            return ret;
+        }
+    }
+    if (myIndex->m_points[0].m_outOffset != 0)
+    {
+        CaretLogInfo("ignoring invalid gzip index file '" + indexFileName + "'");
+        return ret;
+    }
+    return myIndex;
+}
+
+///read the parts of the file that identify its contents, without decompressing anything
+GZipIndexedReader::Fingerprint GZipIndexedReader::getFingerprint(QFile& file, const QFileInfo& fileInfo)
+{
+    Fingerprint ret;
+    ret.m_fileSize = fileInfo.size();
+    ret.m_modifiedTime = fileInfo.lastModified().toTime_t();
+    ret.m_headCrc = crc32(0L, Z_NULL, 0);
+    int64_t headSize = min((int64_t)HEAD_CHECK_SIZE, ret.m_fileSize);
+    if (headSize > 0)
+    {
+        vector<unsigned char> head(headSize);
+        if (!file.seek(0) || file.read((char*)&(head[0]), headSize) != headSize)
+        {
+            throw NiftiException("failed to read from file '" + file.fileName() + "'");
+        }
+        ret.m_headCrc = crc32(ret.m_headCrc, &(head[0]), headSize);
+    }
+    ret.m_trailerCrc = 0;
+    ret.m_trailerSize = 0;
+    if (ret.m_fileSize >= 8)
+    {
+        unsigned char trailer[8];
+        if (!file.seek(ret.m_fileSize - 8) || file.read((char*)trailer, 8) != 8)
+        {
+            throw NiftiException("failed to read from file '" + file.fileName() + "'");
+        }
+        for (int i = 3; i >= 0; --i)
+        {//little endian
+            ret.m_trailerCrc = (ret.m_trailerCrc << 8) | trailer[i];
+            ret.m_trailerSize = (ret.m_trailerSize << 8) | trailer[i + 4];
+        }
+    }
+    return ret;
+}
+
+///decompress the whole file once, recording an access point at a deflate block boundary whenever span bytes have been output since the last one
+CaretPointer<GZipIndexedReader::Index> GZipIndexedReader::buildIndex(QFile& file, const int64_t& span)
+{
+    CaretPointer<Index> ret(new Index());
+    if (!file.seek(0)) throw NiftiException("failed to seek in file '" + file.fileName() + "'");
+    AccessPoint firstPoint;
+    firstPoint.m_outOffset = 0;
+    firstPoint.m_inOffset = 0;
+    firstPoint.m_bits = 0;
+    firstPoint.m_memberStart = true;
+    ret->m_points.push_back(firstPoint);
+    vector<unsigned char> input(INPUT_CHUNK), window(WINDOW_SIZE);
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    if (inflateInit2(&strm, 47) != Z_OK) throw NiftiException("failed to initialize zlib");
+    int64_t totalIn = 0, totalOut = 0, lastPointOut = 0, memberStartOut = 0;
+    try
+    {
+        while (true)
+        {
+            bool atEnd = (strm.avail_in == 0 && !fillInput(file, strm, input, 1));//inflate may still have buffered output
+            if (strm.avail_out == 0)
+            {//window is a ring buffer of the most recent output
+                strm.next_out = &(window[0]);
+                strm.avail_out = WINDOW_SIZE;
+            }
+            uInt inBefore = strm.avail_in, outBefore = strm.avail_out;
+            int result = inflate(&strm, Z_BLOCK);
+            checkInflateReturn(result, file.fileName());
+            totalIn += inBefore - strm.avail_in;
+            totalOut += outBefore - strm.avail_out;
+            if (atEnd && outBefore == strm.avail_out && result != Z_STREAM_END)
+            {
+                throw NiftiException("unexpected end of compressed data in file '" + file.fileName() + "'");
+            }
+            if (result == Z_STREAM_END)
+            {//concatenated members are legal gzip, anything else after the end is ignored like gzread does
+                if (!fillInput(file, strm, input, 2) || strm.next_in[0] != 0x1f || strm.next_in[1] != 0x8b) break;
+                checkInflateReturn(inflateReset(&strm), file.fileName());
+                memberStartOut = totalOut;
+                if (totalOut - lastPointOut > span)
+                {
+                    AccessPoint myPoint;
+                    myPoint.m_outOffset = totalOut;
+                    myPoint.m_inOffset = totalIn;
+                    myPoint.m_bits = 0;
+                    myPoint.m_memberStart = true;
+                    ret->m_points.push_back(myPoint);
+                    lastPointOut = totalOut;
+                }
+                continue;
+            }
+            if ((strm.data_type & 128) && !(strm.data_type & 64) && totalOut - lastPointOut > span)
+            {
+                AccessPoint myPoint;
+                myPoint.m_outOffset = totalOut;
+                myPoint.m_inOffset = totalIn;
+                myPoint.m_bits = strm.data_type & 7;
+                myPoint.m_memberStart = false;
+                int64_t windowUsed = min((int64_t)WINDOW_SIZE, totalOut - memberStartOut);
+                int ringPos = WINDOW_SIZE - strm.avail_out;//oldest data starts here
+                vector<unsigned char> ordered(WINDOW_SIZE);
+                memcpy(&(ordered[0]), &(window[0]) + ringPos, WINDOW_SIZE - ringPos);
+                memcpy(&(ordered[0]) + WINDOW_SIZE - ringPos, &(window[0]), ringPos);
+                myPoint.m_window.assign(ordered.end() - windowUsed, ordered.end());
+                ret->m_points.push_back(myPoint);
+                lastPointOut = totalOut;
+            }
+        }
+    } catch (...) {
+        inflateEnd(&strm);
+        throw;
+    }
+    inflateEnd(&strm);
+    ret->m_uncompressedSize = totalOut;
+    return ret;
+}
+
+///move unconsumed input to the front of the buffer and read until at least minAvailable bytes are available, returns false on end of file
+bool GZipIndexedReader::fillInput(QFile& file, z_stream& strm, vector<unsigned char>& buffer, const uInt& minAvailable)
+{
+    CaretAssert(minAvailable <= buffer.size());
+    if (strm.avail_in >= minAvailable) return true;
+    if (strm.avail_in > 0 && strm.next_in != &(buffer[0]))
+    {
+        memmove(&(buffer[0]), strm.next_in, strm.avail_in);
+    }
+    strm.next_in = &(buffer[0]);
+    while (strm.avail_in < minAvailable)
+    {
+        qint64 numRead = file.read((char*)&(buffer[0]) + strm.avail_in, buffer.size() - strm.avail_in);
+        if (numRead < 0) throw NiftiException("failed to read from file '" + file.fileName() + "'");
+        if (numRead == 0) return false;
+        strm.avail_in += numRead;
+    }
+    return true;
+}
+
+void GZipIndexedReader::checkInflateReturn(const int& ret, const AString& fileName)
+{
+    switch (ret)
+    {
+        case Z_OK:
+        case Z_STREAM_END:
+        case Z_BUF_ERROR://no progress possible, only happens when more input is needed
+            return;
+        case Z_MEM_ERROR:
+            throw NiftiException("out of memory while decompressing file '" + fileName + "'");
+        default:
+            throw NiftiException("invalid or corrupt compressed data in file '" + fileName + "'");
+    }
+}
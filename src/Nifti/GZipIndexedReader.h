@@ -0,0 +1,152 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#ifndef __GZIP_INDEXED_READER_H__
+#define __GZIP_INDEXED_READER_H__
+
+#include "AString.h"
+#include "CaretMutex.h"
+#include "CaretPointer.h"
+#include "NiftiException.h"
+
+#include <QFile>
+#include <QFileInfo>
+
+#include <map>
+#include <stdint.h>
+#include <vector>
+
+#include "zlib.h"
+
+namespace caret {
+
+    /**
+     * Random access reader for gzip files.
+     *
+     * A single scan of the file records decompressor access points (bit offset
+     * plus the preceding 32KB of output) roughly every span bytes of uncompressed
+     * data, so that any byte range can later be read by decompressing at most one
+     * span before it.  Indexes are shared by all readers of the same unmodified
+     * file in the process.  Indexes of large files are also saved as a sidecar
+     * file after the scan, so later processes skip it.  A single reader is not
+     * thread safe.
+     */
+    class GZipIndexedReader
+    {
+    public:
+        enum
+        {
+            DEFAULT_SPAN = 4 * 1024 * 1024
+        };
+
+        GZipIndexedReader(const AString& fileName, const int64_t& span = DEFAULT_SPAN) throw (NiftiException);
+
+        ~GZipIndexedReader();
+
+        void read(char* dataOut, const int64_t& uncompressedOffset, const int64_t& numBytes) throw (NiftiException);
+
+        ///total bytes of decompressed data in the file
+        int64_t getUncompressedSize() const { return m_index->m_uncompressedSize; }
+
+        ///number of places decompression can start from
+        int64_t getNumberOfAccessPoints() const { return (int64_t)m_index->m_points.size(); }
+
+        void writeIndexFile() const throw (NiftiException);
+
+        static AString getIndexFileName(const AString& fileName);
+
+        static void clearIndexCache();
+
+    private:
+        enum
+        {
+            INPUT_CHUNK = 65536,
+            WINDOW_SIZE = 32768,//maximum deflate distance
+            MAX_CACHED_INDEXES = 16,
+            INDEX_MAGIC_LENGTH = 8,
+            PERSIST_MIN_SIZE = 1 << 28,//uncompressed size above which a new index is saved as a sidecar file, smaller files rescan quickly
+            HEAD_CHECK_SIZE = 65536//compressed bytes at the start of the file covered by the fingerprint crc
+        };
+
+        GZipIndexedReader(const GZipIndexedReader&);
+        GZipIndexedReader& operator=(const GZipIndexedReader&);
+
+        struct AccessPoint
+        {
+            int64_t m_outOffset;//uncompressed offset
+            int64_t m_inOffset;//compressed byte offset, the first full byte after the bits below
+            int32_t m_bits;//number of bits from the byte before m_inOffset that belong to the next deflate block
+            bool m_memberStart;//true if m_inOffset is the start of a gzip member header, no window needed
+            std::vector<unsigned char> m_window;
+        };
+
+        ///identifies the exact file an index was built from, size and whole second modification time alone miss a quick rewrite of the same size
+        struct Fingerprint
+        {
+            int64_t m_fileSize, m_modifiedTime;
+            uint32_t m_headCrc;//crc32 of the first HEAD_CHECK_SIZE compressed bytes
+            uint32_t m_trailerCrc, m_trailerSize;//last 8 bytes, the gzip trailer (crc32 and size mod 2^32 of the data) of the last member
+            bool operator==(const Fingerprint& rhs) const
+            {
+                return m_fileSize == rhs.m_fileSize && m_modifiedTime == rhs.m_modifiedTime && m_headCrc == rhs.m_headCrc &&
+                       m_trailerCrc == rhs.m_trailerCrc && m_trailerSize == rhs.m_trailerSize;
+            }
+        };
+
+        struct Index
+        {
+            Fingerprint m_fingerprint;
+            int64_t m_uncompressedSize;
+            std::vector<AccessPoint> m_points;
+        };
+
+        AString m_fileName;
+        QFile m_file;
+        CaretPointer<Index> m_index;
+
+        struct CacheEntry
+        {
+            CaretPointer<Index> m_index;
+            int64_t m_lastUsed;//value of the use counter when the index was last handed out
+            CacheEntry() { m_lastUsed = 0; }
+        };
+
+        static std::map<AString, CacheEntry> s_indexCache;//keyed by canonical path
+
+        static int64_t s_indexCacheUseCounter;
+
+        static CaretMutex s_indexCacheMutex;
+
+        static const char s_indexFileMagic[INDEX_MAGIC_LENGTH];
+
+        static CaretPointer<Index> buildIndex(QFile& file, const int64_t& span);
+
+        static Fingerprint getFingerprint(QFile& file, const QFileInfo& fileInfo);
+
+        static CaretPointer<Index> readIndexFile(const AString& indexFileName, const Fingerprint& fingerprint);
+
+        static bool fillInput(QFile& file, z_stream& strm, std::vector<unsigned char>& buffer, const uInt& minAvailable);
+
+        static void checkInflateReturn(const int& ret, const AString& fileName);
+    };
+
+}
+
+#endif //__GZIP_INDEXED_READER_H__
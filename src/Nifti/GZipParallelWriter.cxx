@@ -0,0 +1,79 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "GZipParallelWriter.h"
+
+#include "CaretLogger.h"
+
+using namespace caret;
+using namespace std;
+
+GZipParallelWriter::GZipParallelWriter(const AString& fileName) throw (NiftiException) : m_deflate(ParallelDeflate::FORMAT_GZIP)
+{
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        throw NiftiException("failed to open file '" + fileName + "' for writing");
+    }
+}
+
+GZipParallelWriter::~GZipParallelWriter()
+{
+    if (m_file.isOpen())
+    {
+        CaretLogWarning("gzip file '" + m_file.fileName() + "' was not closed, output is incomplete");
+    }
+}
+
+void GZipParallelWriter::write(const char* data, const int64_t& size) throw (NiftiException)
+{
+    if (!m_file.isOpen()) throw NiftiException("write called on closed gzip writer");
+    try {
+        m_deflate.write(data, size, m_compressed);
+    } catch (CaretException& e) {
+        throw NiftiException(e);
+    }
+    flushCompressed();
+}
+
+///finishes the gzip stream and closes the file
+void GZipParallelWriter::close() throw (NiftiException)
+{
+    if (!m_file.isOpen()) return;
+    try {
+        m_deflate.finish(m_compressed);
+    } catch (CaretException& e) {
+        m_file.close();
+        throw NiftiException(e);
+    }
+    flushCompressed();
+    m_file.close();
+}
+
+void GZipParallelWriter::flushCompressed() throw (NiftiException)
+{
+    if (m_compressed.empty()) return;
+    if (m_file.write(m_compressed.data(), m_compressed.size()) != (qint64)m_compressed.size())
+    {
+        m_file.close();
+        throw NiftiException("failed to write bytes to file '" + m_file.fileName() + "'");
+    }
+    m_compressed.clear();
+}
@@ -0,0 +1,63 @@
+#ifndef __GZIP_PARALLEL_WRITER_H__
+#define __GZIP_PARALLEL_WRITER_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "AString.h"
+#include "NiftiException.h"
+#include "ParallelDeflate.h"
+
+#include <QFile>
+
+#include <stdint.h>
+#include <vector>
+
+namespace caret {
+
+    ///sequential writer for gzip files that compresses on all cores, output is a standard single member gzip file
+    class GZipParallelWriter
+    {
+    public:
+        GZipParallelWriter(const AString& fileName) throw (NiftiException);
+
+        ~GZipParallelWriter();
+
+        void write(const char* data, const int64_t& size) throw (NiftiException);
+
+        ///the uncompressed position in the file
+        int64_t pos() const { return m_deflate.getUncompressedSize(); }
+
+        void close() throw (NiftiException);
+
+    private:
+        GZipParallelWriter(const GZipParallelWriter&);
+        GZipParallelWriter& operator=(const GZipParallelWriter&);
+
+        QFile m_file;
+        ParallelDeflate m_deflate;
+        std::vector<char> m_compressed;
+
+        void flushCompressed() throw (NiftiException);
+    };
+
+}
+
+#endif //__GZIP_PARALLEL_WRITER_H__
@@ -18,6 +18,7 @@
  */
 /*LICENSE_END*/
 #include "NiftiFile.h"
+#include "GZipParallelWriter.h"
 
 
 #include <algorithm>
@@ -208,11 +209,15 @@ void NiftiFile::openFile(const AString &fileName)
         matrix.setMatrixLayoutOnDisk(header);
         matrix.setMatrixOffset((header.getVolumeOffset()));
     }
-    if(m_usingVolume) return;
-    if(isCompressed())
+    if(m_usingVolume)
     {
-        matrix.readFile(zFile);
+        if(isCompressed()) gzclose(zFile);
+        return;
+    }
+    if(isCompressed())
+    {//inflating the matrix is expensive, so wait until it is used, header queries and single frames don't need all of it
         gzclose(zFile);
+        matrix.setDeferredFile(m_fileName);
     }
     else
     {
@@ -230,6 +235,7 @@ void NiftiFile::openFile(const AString &fileName)
  */
 void NiftiFile::writeFile(const AString &fileName, NIFTI_BYTE_ORDER byteOrder)
 {  
+    matrix.loadDeferredMatrix();//before the layout changes, and before the output could overwrite the input
     this->m_fileName = fileName;
     QDir fpath(this->m_fileName);
     m_fileName = fpath.toNativeSeparators(this->m_fileName);
@@ -317,25 +323,15 @@ void NiftiFile::writeFile(const AString &fileName, NIFTI_BYTE_ORDER byteOrder)
     //need better handling for different matrices, for later
     
     QFile file;
-    gzFile zFile;
     if(isCompressed())
     {
-#ifdef CARET_OS_MACOSX
-        zFile = gzopen(m_fileName.toAscii().data(), "wb");
-#elif ZLIB_VERNUM > 0x1232
-        zFile = gzopen64(m_fileName.toAscii().data(), "wb");
-#else  // ZLIB_VERNUM > 0x1232
-        zFile = gzopen(m_fileName.toAscii().data(), "wb");
-#endif  // ZLIB_VERNUM > 0x1232
+        GZipParallelWriter zFile(m_fileName);//compresses on all cores, still a standard gzip file
         headerIO.writeFile(zFile,byteOrder);
-        if (gzwrite(zFile, extensionBytes.constData(), extensionBytes.size()) != extensionBytes.size())
-        {
-            throw NiftiException("failed to write bytes to file");
-        }
+        zFile.write(extensionBytes.constData(), extensionBytes.size());
         if(m_usingVolume && m_vol) matrix.writeVolume(zFile, *m_vol);
         else matrix.writeFile(zFile);
 
-        gzclose(zFile);
+        zFile.close();
     }
     else
     {
@@ -371,6 +367,7 @@ NiftiFile::~NiftiFile()
 // Header IO
 void NiftiFile::setHeader(const Nifti1Header &header)
 {
+    matrix.loadDeferredMatrix();
     headerIO.setHeader(header);
     matrix.setMatrixLayoutOnDisk(header);
 }
@@ -21,6 +21,7 @@
 #include <QtCore>
 #include "iostream"
 #include "NiftiHeaderIO.h"
+#include "GZipParallelWriter.h"
 #include <QFile>
 #include "zlib.h"
 #include "FloatMatrix.h"
@@ -325,7 +326,32 @@ void NiftiHeaderIO::swapHeaderBytes(nifti_2_header &header)
 void NiftiHeaderIO::writeFile(gzFile file, NIFTI_BYTE_ORDER byte_order) throw (NiftiException)
 {
     uint8_t bytes[548];
+    int64_t size = getHeaderBytes(bytes, byte_order);
+    gzwrite(file,bytes,size);
+}
+
+/**
+ * writeFile
+ *
+ * writes the nifti header to the output parallel gzip writer
+ * @param file
+ */
+void NiftiHeaderIO::writeFile(GZipParallelWriter &file, NIFTI_BYTE_ORDER byte_order) throw (NiftiException)
+{
+    uint8_t bytes[548];
+    int64_t size = getHeaderBytes(bytes, byte_order);
+    file.write((char *)bytes,size);
+}
 
+/**
+ * getHeaderBytes
+ *
+ * packs the header struct for writing, swapped if requested
+ * @param bytes must hold at least 548 bytes
+ * @return the number of bytes used
+ */
+int64_t NiftiHeaderIO::getHeaderBytes(uint8_t *bytes, NIFTI_BYTE_ORDER byte_order) throw (NiftiException)
+{
     if(this->niftiVersion == 1)
     {
         //swap for write if needed
@@ -334,7 +360,7 @@ void NiftiHeaderIO::writeFile(gzFile file, NIFTI_BYTE_ORDER byte_order) throw (N
         fixDimensions(header);
         if (byte_order == SWAPPED_BYTE_ORDER) swapHeaderBytes(header);
         memcpy(bytes,(char *)&header,sizeof(header));
-
+        return sizeof(nifti_1_header);
     }
     else if(this->niftiVersion == 2)
     {
@@ -344,11 +370,9 @@ void NiftiHeaderIO::writeFile(gzFile file, NIFTI_BYTE_ORDER byte_order) throw (N
         fixDimensions(header);
         if (byte_order == SWAPPED_BYTE_ORDER) swapHeaderBytes(header);
         memcpy(bytes,(char *)&header,sizeof(header));
+        return sizeof(nifti_2_header);
     }
     else throw NiftiException("NiftiHeaderIO only currently supports Nifti versions 1 and 2.");
-
-    if(this->niftiVersion==1) gzwrite(file,bytes,sizeof(nifti_1_header));
-    else if(this->niftiVersion==2) gzwrite(file,bytes,sizeof(nifti_2_header));
 }
 
 /**
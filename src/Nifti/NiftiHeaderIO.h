@@ -33,6 +33,8 @@
 
 namespace caret {
 
+class GZipParallelWriter;
+
 /// Class for determining Nifti Header version and return correct (nifti 1 or 2) Header version
 class NiftiHeaderIO {
 public:
@@ -44,6 +46,7 @@ public:
     void writeFile(const AString &outputFile, NIFTI_BYTE_ORDER byteOrder = NATIVE_BYTE_ORDER) throw (NiftiException);
     void writeFile(QFile &file, NIFTI_BYTE_ORDER byteOrder = NATIVE_BYTE_ORDER) throw (NiftiException);
     void writeFile(gzFile file, NIFTI_BYTE_ORDER byteOrder = NATIVE_BYTE_ORDER) throw (NiftiException);
+    void writeFile(GZipParallelWriter &file, NIFTI_BYTE_ORDER byteOrder = NATIVE_BYTE_ORDER) throw (NiftiException);
     void readFile(QFile &file) throw (NiftiException);
     void readFile(gzFile file) throw (NiftiException);    
 
@@ -100,6 +103,8 @@ public:
     void fixDimensions(nifti_2_header &header);
 
 private:
+    int64_t getHeaderBytes(uint8_t *bytes, NIFTI_BYTE_ORDER byteOrder) throw (NiftiException);
+
     int niftiVersion;
     bool m_swapNeeded;
     Nifti1Header nifti1Header;
@@ -41,6 +41,8 @@
 #endif
 
 #include "NiftiMatrix.h"
+#include "GZipIndexedReader.h"
+#include "GZipParallelWriter.h"
 #include "QFile"
 #include <limits>
 using namespace std;
@@ -64,13 +66,17 @@ void NiftiMatrix::init()
     currentTime = 0;
     file = NULL;
     zFile = NULL;
+    zIndexed = NULL;
+    zParallel = NULL;
     timeLength = 0;
     m_usingVolume = false;
+    m_deferredFileName = "";
 }
 
 bool NiftiMatrix::isCompressed()
 {
     if(file) return false;
+    else if(zIndexed || zParallel) return true;
     else if(zFile) return true;
     else return false;
 }
@@ -187,6 +193,7 @@ void NiftiMatrix::readFile(gzFile fileIn) throw (NiftiException)
 
 void NiftiMatrix::writeFile(QFile &fileOut) throw (NiftiException)
 {
+    loadDeferredMatrix();
     file = &fileOut;
     zFile = NULL;
     writeFile();
@@ -196,6 +203,7 @@ void NiftiMatrix::writeFile(QFile &fileOut) throw (NiftiException)
 
 void NiftiMatrix::writeFile(gzFile fileOut) throw (NiftiException)
 {
+    loadDeferredMatrix();
     file = NULL;
     zFile = fileOut;
     writeFile();
@@ -203,6 +211,21 @@ void NiftiMatrix::writeFile(gzFile fileOut) throw (NiftiException)
     zFile = NULL;
 }
 
+void NiftiMatrix::writeFile(GZipParallelWriter &fileOut) throw (NiftiException)
+{
+    loadDeferredMatrix();
+    file = NULL;
+    zFile = NULL;
+    zParallel = &fileOut;
+    try {
+        writeFile();
+    } catch (...) {
+        zParallel = NULL;
+        throw;
+    }
+    zParallel = NULL;
+}
+
 void NiftiMatrix::readFile() throw (NiftiException)
 {
     //for the sake of clarity, the Size suffix refers to size of bytes in memory, and Length suffix refers to the length of an array
@@ -299,6 +322,8 @@ void NiftiMatrix::readFile() throw (NiftiException)
 
     //cleanup
     matrixLoaded = true;
+    m_deferredFileName = "";
+    m_deferredIndex.grabNew(NULL);
     
     delete [] bytes;
 }
@@ -306,10 +331,15 @@ void NiftiMatrix::readFile() throw (NiftiException)
 /* WARNING!!!
    The function below currently canot seek when reading gz files, one must start at the beginning and
    read a frame at a time.  This will hopefully be fixed by updating QT on windows.
+   Single frames of deferred gz files are read through a GZipIndexedReader instead (see getFrame).
 */
-void NiftiMatrix::readMatrixBytes(char *bytes, int64_t size, int64_t frameOffset)
+void NiftiMatrix::readMatrixBytes(char *bytes, int64_t size, int64_t frameOffset, bool alwaysSeek)
 {
-    if(isCompressed())
+    if(zIndexed)
+    {
+        zIndexed->read(bytes, matrixStartOffset + frameOffset, size);
+    }
+    else if(isCompressed())
     {
         /*if((frameOffset+matrixStartOffset)!= gztell64(zFile))
         {
@@ -357,7 +387,7 @@ void NiftiMatrix::readMatrixBytes(char *bytes, int64_t size, int64_t frameOffset
         //file->read(bytes,size);
         //QT can't read files over a certain size
         int fh = file->handle();
-        if(frameOffset == 0)
+        if(frameOffset == 0 || alwaysSeek)
         {
 
 #ifdef CARET_OS_WINDOWS
@@ -400,7 +430,22 @@ void NiftiMatrix::readMatrixBytes(char *bytes, int64_t size, int64_t frameOffset
 */
 void NiftiMatrix::writeMatrixBytes(char *bytes, int64_t size,int64_t frameOffset)
 {
-    if(isCompressed())
+    if(zParallel)
+    {
+        //writes are sequential, so the only seek needed is padding between the extensions and the matrix, as gzseek does
+        int64_t position = zParallel->pos();
+        if(position > matrixStartOffset+frameOffset)
+        {
+            throw NiftiException("failed to seek in file");
+        }
+        if(position < matrixStartOffset+frameOffset)
+        {
+            vector<char> padding(matrixStartOffset+frameOffset-position, 0);
+            zParallel->write(padding.data(), padding.size());
+        }
+        zParallel->write(bytes,size);
+    }
+    else if(isCompressed())
     {
         /*if((frameOffset+matrixStartOffset)!= gztell64(zFile))
         {
@@ -620,6 +665,7 @@ void NiftiMatrix::setFrame(const float *matrixIn, const int64_t &frameLengthIn,
     if(componentIndex>(componentDimensions-1)) throw NiftiException("Component index exceeds the size of component dimensions.");
     
     if(this->frameLength != frameLengthIn) throw NiftiException("frame size does not match expected frame size!");
+    loadDeferredMatrix();//the other frames must come from the file
     
     char * tempFrame = (char *)&matrix[componentIndex*frameLength+frameLength*timeSlice*componentDimensions];//for RGB format
     memcpy(tempFrame,matrixIn,frameLength*sizeof(float));
@@ -628,13 +674,75 @@ void NiftiMatrix::setFrame(const float *matrixIn, const int64_t &frameLengthIn,
 void NiftiMatrix::getFrame(float *frameOut, const int64_t &timeSlice, const int64_t &componentIndex) throw(NiftiException)
 {
     if(!this->layoutSet) throw NiftiException("Please set layout before setting frame.");
-    if(!matrixLoaded) throw NiftiException("Please load frame before getting component.");
     if(componentIndex>(componentDimensions-1)) throw NiftiException("Component index exceeds the size of component dimensions.");
+    if(!matrixLoaded && !m_deferredFileName.isEmpty())
+    {
+        if(componentDimensions == 1)
+        {//read only this frame, through an index of the compressed file, rather than inflating everything before it
+            if(timeSlice < 0 || timeSlice >= timeLength) throw NiftiException("frame index " + AString::number(timeSlice) + " is out of range");
+            if(m_deferredIndex == NULL) m_deferredIndex.grabNew(new GZipIndexedReader(m_deferredFileName));
+            int64_t size = frameSize;
+            vector<char> byteArray(size);
+            char *bytes = byteArray.data();
+            file = NULL;
+            zFile = NULL;
+            zIndexed = m_deferredIndex.getPointer();
+            try {
+                readMatrixBytes(bytes,size,timeSlice*size,true);
+            } catch (...) {
+                zIndexed = NULL;
+                throw;
+            }
+            zIndexed = NULL;
+            convertBytes(bytes, frameOut, size);
+            return;
+        }
+        loadDeferredMatrix();//RGB components are interleaved on disk, read everything
+    }
+    if(!matrixLoaded) throw NiftiException("Please load frame before getting component.");
     //copy data to output frame    
     char * tempFrame = (char *)&matrix[componentIndex*frameLength+frameLength*timeSlice*componentDimensions];//for RGB format
     memcpy((char *)frameOut,(char *)tempFrame,this->frameLength*sizeof(float));
 }
 
+/**
+ * Don't read the matrix now, read it from the compressed file when it is first
+ * needed.  Single frames requested before that are read through a random access
+ * index of the file, so they don't require inflating the file up to that frame.
+ * The layout must already be set, and must not be changed until the matrix is
+ * loaded (see loadDeferredMatrix).
+ */
+void NiftiMatrix::setDeferredFile(const AString &fileName)
+{
+    m_deferredFileName = fileName;
+    m_deferredIndex.grabNew(NULL);
+    matrixLoaded = false;
+}
+
+/**
+ * Read the entire matrix now, if reading it was deferred.
+ */
+void NiftiMatrix::loadDeferredMatrix() throw (NiftiException)
+{
+    if(m_deferredFileName.isEmpty()) return;
+    AString fileName = m_deferredFileName;
+#ifdef CARET_OS_MACOSX
+    gzFile deferredFile = gzopen(fileName.toAscii().data(), "rb");
+#elif ZLIB_VERNUM > 0x1232
+    gzFile deferredFile = gzopen64(fileName.toAscii().data(), "rb");
+#else  // ZLIB_VERNUM > 0x1232
+    gzFile deferredFile = gzopen(fileName.toAscii().data(), "rb");
+#endif // ZLIB_VERNUM > 0x1232
+    if(deferredFile == NULL) throw NiftiException("failed to open file '" + fileName + "' for reading");
+    try {
+        readFile(deferredFile);
+    } catch (...) {
+        gzclose(deferredFile);
+        throw;
+    }
+    gzclose(deferredFile);
+}
+
 int64_t NiftiMatrix::calculateFrameLength(const std::vector<int64_t> &dimensionsIn) const
 {
     int64_t frameLength = 1;
@@ -655,6 +763,7 @@ int64_t NiftiMatrix::calculateFrameSizeInBytes(const int64_t &frameLengthIn, con
 
 void NiftiMatrix::getVolume(VolumeBase &vol)
 {
+    loadDeferredMatrix();
     float *frame= new float [this->frameLength];
     for(int t=0;t<timeLength;t++)
     {
@@ -680,6 +789,7 @@ void NiftiMatrix::setVolume(VolumeBase &vol)
 
 void NiftiMatrix::getMatrix(float* matrixOut)
 {
+    loadDeferredMatrix();
     for(int t=0;t<timeLength;t++)
     {
         for(int i=0;i<componentDimensions;i++)
@@ -961,6 +1071,20 @@ void NiftiMatrix::writeVolume(gzFile fileOut, VolumeBase &vol) throw (NiftiExcep
     zFile = NULL;
 }
 
+void NiftiMatrix::writeVolume(GZipParallelWriter &fileOut, VolumeBase &vol) throw (NiftiException)
+{
+    file = NULL;
+    zFile = NULL;
+    zParallel = &fileOut;
+    try {
+        writeVolume(vol);
+    } catch (...) {
+        zParallel = NULL;
+        throw;
+    }
+    zParallel = NULL;
+}
+
 int8_t * NiftiMatrix::allocateFrame()
 {
     int8_t *frame = NULL;
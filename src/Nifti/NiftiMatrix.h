@@ -26,6 +26,8 @@
 #include "NiftiException.h"
 #include "QFile"
 #include "AString.h"
+#include "CaretPointer.h"
+#include "GZipIndexedReader.h"
 #include "VolumeBase.h"
 #include "stdint.h"
 #include "zlib.h"
@@ -34,6 +36,8 @@
 
 namespace caret {
 
+class GZipParallelWriter;
+
 class NiftiMatrix : public LayoutType //so we don't have to qualify layouts
 {
 public:
@@ -73,6 +77,7 @@ public:
     void readFile(gzFile fileIn) throw (NiftiException);
     void writeFile(QFile &fileOut) throw (NiftiException);
     void writeFile(gzFile fileOut) throw (NiftiException);
+    void writeFile(GZipParallelWriter &fileOut) throw (NiftiException);
 
     //readMatrix(
     //readFrame(
@@ -88,6 +93,7 @@ public:
     int8_t *allocateFrame();
     void writeVolume(QFile &fileOut, VolumeBase &vol) throw (NiftiException);
     void writeVolume(gzFile fileOut, VolumeBase &vol) throw (NiftiException);
+    void writeVolume(GZipParallelWriter &fileOut, VolumeBase &vol) throw (NiftiException);
     void writeVolume(VolumeBase &vol) throw (NiftiException);
     void convertFrame(float *&frameIn, char *&bytesOut, int64_t &size) throw (NiftiException);
 
@@ -123,6 +129,11 @@ public:
 
     void setUsingVolume(bool usingVolume) { m_usingVolume = usingVolume; }
 
+    /// read the matrix from this compressed file only when it is needed, single frames are read through a random access index until then
+    void setDeferredFile(const AString &fileName);
+    /// read the entire deferred matrix, must be done before changing the layout
+    void loadDeferredMatrix() throw (NiftiException);
+
    
 
 
@@ -130,7 +141,7 @@ public:
 private:
     /// Reads frame from disk into memory, flushes previous frame to disk if changes were made.
     void readFile()  throw (NiftiException);//for loading a frame at a time
-    void readMatrixBytes(char *bytes, int64_t size, int64_t frameOffset = 0);
+    void readMatrixBytes(char *bytes, int64_t size, int64_t frameOffset = 0, bool alwaysSeek = false);
     /// Writes the current frame to disk.
     void writeFile() throw (NiftiException);
     void writeMatrixBytes(char *bytes, int64_t size, int64_t frameOffset = 0);
@@ -147,6 +158,10 @@ private:
     
     QFile *file;
     gzFile zFile;
+    GZipIndexedReader *zIndexed;//random access reads of compressed files, when set
+    AString m_deferredFileName;//compressed file the matrix has not been read from yet
+    CaretPointer<GZipIndexedReader> m_deferredIndex;
+    GZipParallelWriter *zParallel;//multithreaded compression for writes, when set
     int64_t matrixStartOffset;
 
     //layout
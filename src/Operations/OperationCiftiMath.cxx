@@ -230,8 +230,9 @@ void OperationCiftiMath::useParameters(OperationParameters* myParams, ProgressOb
     if (outXML.getNumberOfDimensions() != 2) throw OperationException("output must have exactly 2 dimensions");
     myCiftiOut->setCiftiXML(outXML);
     int numRows = outXML.getDimensionLength(CiftiXML::ALONG_COLUMN), numOutCols = outXML.getDimensionLength(CiftiXML::ALONG_ROW);
-    vector<float> values(numVars), scratchRow(numOutCols);
-    vector<vector<float> > inputRows(numVars);
+    vector<float> scratchRow(numOutCols);
+    vector<vector<float> > inputRows(numVars), selectedValues(numVars);//for -select 1, the selected value repeated for every output column
+    vector<const float*> varPointers(numVars);
     for (int v = 0; v < numVars; ++v)//HACK: this code ONLY works in the 2D case, rework from here to the end when allowing 3+ dims
     {
         inputRows[v].resize(varCiftiFiles[v]->getCiftiXMLOld().getNumberOfColumns());
@@ -240,6 +241,16 @@ void OperationCiftiMath::useParameters(OperationParameters* myParams, ProgressOb
             varCiftiFiles[v]->getRow(inputRows[v].data(), selectInfo[v][1]);
         }
     }
+    for (int v = 0; v < numVars; ++v)
+    {
+        if (selectInfo[v][0] == -1)
+        {
+            varPointers[v] = inputRows[v].data();
+        } else {
+            selectedValues[v].resize(numOutCols);
+            varPointers[v] = selectedValues[v].data();
+        }
+    }
     for (int i = 0; i < numRows; ++i)
     {
         for (int v = 0; v < numVars; ++v)
@@ -248,23 +259,21 @@ void OperationCiftiMath::useParameters(OperationParameters* myParams, ProgressOb
             {
                 varCiftiFiles[v]->getRow(inputRows[v].data(), i);
             }
+            if (selectInfo[v][0] != -1 && (i == 0 || selectInfo[v][1] == -1))
+            {
+                selectedValues[v].assign(numOutCols, inputRows[v][selectInfo[v][0]]);
+            }
         }
-        for (int j = 0; j < numOutCols; ++j)
+        myExpr.evaluateArrays(varPointers, scratchRow.data(), numOutCols);
+        if (nanfix)
         {
-            for (int v = 0; v < numVars; ++v)
+            for (int j = 0; j < numOutCols; ++j)
             {
-                if (selectInfo[v][0] == -1)
+                if (scratchRow[j] != scratchRow[j])
                 {
-                    values[v] = inputRows[v][j];
-                } else {
-                    values[v] = inputRows[v][selectInfo[v][0]];
+                    scratchRow[j] = nanfixval;
                 }
             }
-            scratchRow[j] = (float)myExpr.evaluate(values);
-            if (nanfix && scratchRow[j] != scratchRow[j])
-            {
-                scratchRow[j] = nanfixval;
-            }
         }
         myCiftiOut->setRow(scratchRow.data(), i);
     }
@@ -22,6 +22,7 @@
 #include "OperationException.h"
 
 #include "CaretHeap.h"
+#include "CaretOMP.h"
 #include "CaretSparseFile.h"
 #include "CiftiFile.h"
 #include "OxfordSparseThreeFile.h"
@@ -64,6 +65,9 @@ OperationParameters* OperationConvertMatrix4ToWorkbenchSparse::getParameters()
     volumeOpt->addCiftiParameter(1, "cifti-template", "cifti file to use the volume mappings from");
     volumeOpt->addStringParameter(2, "direction", "dimension along the cifti file to take the mapping from, ROW or COLUMN");
     
+    OptionalParameter* compressedOpt = ret->createOptionalParameter(9, "-compressed", "write the compressed version 2 of the wbsparse format");
+    compressedOpt->createOptionalParameter(1, "-column-index", "also store the matrix by column, for fast column access");
+    
     ret->setHelpText(
         AString("Converts the matrix 4 output of probtrackx to workbench sparse file format.  ") +
         "Exactly one of -surface-seeds and -volume-seeds must be specified."
@@ -189,34 +193,95 @@ void OperationConvertMatrix4ToWorkbenchSparse::useParameters(OperationParameters
             rowReorder[i / 3] = tempInd;
         }
     }
-    CaretSparseFileWriter mywriter(outFileName, myXML);//NOTE: CaretSparseFile has a different encoding of fibers, ALWAYS use getFibersRow, etc
-    vector<int64_t> indicesIn, indicesOut;//this method knows about sparseness, does sorting of indexes in order to avoid scanning full rows
-    vector<FiberFractions> fibersIn, fibersOut;//can be slower if matrix isn't very sparse, but that is a problem for other reasons anyway
-    CaretMinHeap<FiberFractions, int64_t> myHeap;//use our heap to do heapsort, rather than coding a struct for stl sort
-    for (int64_t i = 0; i < sparseDims[1]; ++i)
+    CaretSparseFileWriter::Format outFormat = CaretSparseFileWriter::FORMAT_VERSION_1;
+    bool writeColumnIndex = false;
+    OptionalParameter* compressedOpt = myParams->getOptionalParameter(9);
+    if (compressedOpt->m_present)
+    {
+        outFormat = CaretSparseFileWriter::FORMAT_VERSION_2;
+        writeColumnIndex = compressedOpt->getOptionalParameter(1)->m_present;
+    }
+    CaretSparseFileUnorderedWriter mywriter(outFileName, myXML, outFormat, writeColumnIndex);//NOTE: CaretSparseFile has a different encoding of fibers, ALWAYS use getFibersRow, etc
+    int64_t curRow = 0;
+    AString errorMessage;//exceptions must not leave a parallel region, so the first error is rethrown after it
+#pragma omp CARET_PAR
     {
-        inFile.getFibersRowSparse(i, indicesIn, fibersIn);
-        size_t numNonzero = indicesIn.size();
-        myHeap.reserve(numNonzero);
-        for (size_t j = 0; j < numNonzero; ++j)
+        vector<int64_t> indicesIn, indicesOut;//this method knows about sparseness, does sorting of indexes in order to avoid scanning full rows
+        vector<FiberFractions> fibersIn, fibersOut;//can be slower if matrix isn't very sparse, but that is a problem for other reasons anyway
+        CaretMinHeap<FiberFractions, int64_t> myHeap;//use our heap to do heapsort, rather than coding a struct for stl sort
+#pragma omp CARET_FOR schedule(dynamic)
+        for (int64_t i = 0; i < sparseDims[1]; ++i)
         {
-            int64_t newIndex = rowReorder[indicesIn[j]];//reorder
-            if (newIndex != -1)
+            int64_t myrow;
+            bool failed = false;
+#pragma omp critical
+            {//the input file isn't thread safe, and reading sequentially is faster anyway
+                myrow = curRow;
+                ++curRow;
+                if (errorMessage != "")
+                {
+                    failed = true;//skip the remaining rows
+                } else {
+                    try
+                    {
+                        inFile.getFibersRowSparse(myrow, indicesIn, fibersIn);
+                    } catch (CaretException& e) {
+                        errorMessage = e.whatString();
+                        failed = true;
+                    } catch (exception& e) {
+                        errorMessage = e.what();
+                        failed = true;
+                    } catch (...) {
+                        errorMessage = "unknown exception type thrown";
+                        failed = true;
+                    }
+                }
+            }
+            if (failed) continue;
+            size_t numNonzero = indicesIn.size();
+            myHeap.reserve(numNonzero);
+            for (size_t j = 0; j < numNonzero; ++j)
             {
-                myHeap.push(fibersIn[j], newIndex);//heapify
+                int64_t newIndex = rowReorder[indicesIn[j]];//reorder
+                if (newIndex != -1)
+                {
+                    myHeap.push(fibersIn[j], newIndex);//heapify
+                }
+            }
+            indicesOut.resize(myHeap.size());
+            fibersOut.resize(myHeap.size());
+            int64_t curIndex = 0;
+            while (!myHeap.isEmpty())
+            {
+                int64_t newIndex;
+                fibersOut[curIndex] = myHeap.pop(&newIndex);
+                indicesOut[curIndex] = newIndex;
+                ++curIndex;
+            }
+            try
+            {
+                mywriter.writeFibersRowSparse(myrow, indicesOut, fibersOut);//rows may finish out of order, the writer sorts them
+            } catch (CaretException& e) {
+#pragma omp critical
+                {
+                    if (errorMessage == "") errorMessage = e.whatString();
+                }
+            } catch (exception& e) {
+#pragma omp critical
+                {
+                    if (errorMessage == "") errorMessage = e.what();
+                }
+            } catch (...) {
+#pragma omp critical
+                {
+                    if (errorMessage == "") errorMessage = "unknown exception type thrown";
+                }
             }
         }
-        indicesOut.resize(myHeap.size());
-        fibersOut.resize(myHeap.size());
-        int64_t curIndex = 0;
-        while (!myHeap.isEmpty())
-        {
-            int64_t newIndex;
-            fibersOut[curIndex] = myHeap.pop(&newIndex);
-            indicesOut[curIndex] = newIndex;
-            ++curIndex;
-        }
-        mywriter.writeFibersRowSparse(i, indicesOut, fibersOut);
+    }
+    if (errorMessage != "")
+    {
+        throw OperationException(errorMessage);
     }
     mywriter.finish();
 }
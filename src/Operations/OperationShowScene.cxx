@@ -19,7 +19,9 @@
  */
 /*LICENSE_END*/
 
+#include <algorithm>
 #include <cstdio>
+#include <exception>
 #include <fstream>
 
 #ifdef HAVE_OSMESA
@@ -30,18 +32,25 @@
 #include <QColor>
 
 #include "CaretAssert.h"
+#include "CaretException.h"
 #include "CaretLogger.h"
+#include "CaretOMP.h"
 
 #include "Brain.h"
 #include "BrainOpenGLFixedPipeline.h"
 #include "BrainOpenGLViewportContent.h"
+#include "BrowserTabContent.h"
+#include "CaretMappableDataFile.h"
 #include "EventBrowserTabGet.h"
 #include "EventManager.h"
 #include "FileInformation.h"
 #include "GlfFontTextRenderer.h"
 #include "ImageFile.h"
+#include "Matrix4x4.h"
 #include "OperationShowScene.h"
 #include "OperationException.h"
+#include "Overlay.h"
+#include "OverlaySet.h"
 #include "Scene.h"
 #include "SceneAttributes.h"
 #include "SceneClass.h"
@@ -97,6 +106,16 @@ OperationShowScene::getParameters()
 
     ret->addIntegerParameter(5, "image-height", "height of output image(s)");
     
+    ParameterComponent* sceneOpt = ret->createRepeatableParameter(6, "-scene", "also render another scene from the scene file");
+    sceneOpt->addStringParameter(1, "scene-name-or-number", "name or number (starting at one) of the scene");
+    
+    OptionalParameter* mapSequenceOpt = ret->createOptionalParameter(7, "-map-sequence", "render a sequence of frames that step through maps");
+    mapSequenceOpt->addIntegerParameter(1, "frames", "number of frames");
+    
+    OptionalParameter* rotationSequenceOpt = ret->createOptionalParameter(8, "-rotation-sequence", "render a sequence of frames that rotate the model");
+    rotationSequenceOpt->addIntegerParameter(1, "frames", "number of frames");
+    rotationSequenceOpt->addDoubleParameter(2, "degrees", "rotation, in degrees, from one frame to the next");
+    
     AString helpText("Render content of browser windows displayed in a scene "
                      "into image file(s).  The image file name should be "
                      "similar to \"capture.png\".  If there is only one image "
@@ -105,6 +124,23 @@ OperationShowScene::getParameters()
                      "into the image name: \"capture_01.png\", \"capture_02.png\" "
                      "etc.\n"
                      "\n"
+                     "Use -scene to render more scenes from the same scene file, "
+                     "in the order given.  Data files that were loaded by the "
+                     "scene before it and are used again are not read again.\n"
+                     "\n"
+                     "Use -map-sequence to render frames in which every enabled "
+                     "overlay selects the next map of its file, starting with the "
+                     "map selected in the scene.  An overlay stays on the last "
+                     "map of its file once it is reached.  Use -rotation-sequence "
+                     "to render frames in which the model turns about the screen's "
+                     "vertical axis.  When both are given, each frame steps both "
+                     "the map and the rotation.\n"
+                     "\n"
+                     "When more than one scene or frame is rendered, every image "
+                     "is numbered in the order it is rendered.  Images are "
+                     "rendered one at a time and written to files by multiple "
+                     "threads.\n"
+                     "\n"
                      "The image format is determined by the image file extension.\n"
                      "Image formats available on this sytem are:\n");
     
@@ -160,25 +196,46 @@ OperationShowScene::useParameters(OperationParameters* myParams,
     SceneFile sceneFile;
     sceneFile.readFile(sceneFileName);
     
-    Scene* scene = sceneFile.getSceneWithName(sceneNameOrNumber);
-    if (scene == NULL) {
-        bool valid = false;
-        const int32_t sceneIndexStartAtOne = sceneNameOrNumber.toInt(&valid);
-        if (valid) {
-            const int32_t sceneIndex = sceneIndexStartAtOne - 1;
-            if ((sceneIndex >= 0)
-                && (sceneIndex < sceneFile.getNumberOfScenes())) {
-                scene = sceneFile.getSceneAtIndex(sceneIndex);
-            }
-            else {
-                throw OperationException("Scene index is invalid");
-            }
+    std::vector<Scene*> scenes;
+    scenes.push_back(getSceneWithNameOrNumber(sceneFile,
+                                              sceneNameOrNumber));
+    const std::vector<ParameterComponent*>& sceneInstances = *(myParams->getRepeatableParameterInstances(6));
+    for (int32_t i = 0; i < static_cast<int32_t>(sceneInstances.size()); i++) {
+        scenes.push_back(getSceneWithNameOrNumber(sceneFile,
+                                                  sceneInstances[i]->getString(1)));
+    }
+    
+    int32_t numberOfMapFrames = 1;
+    OptionalParameter* mapSequenceOpt = myParams->getOptionalParameter(7);
+    if (mapSequenceOpt->m_present) {
+        numberOfMapFrames = mapSequenceOpt->getInteger(1);
+        if (numberOfMapFrames < 1) {
+            throw OperationException("number of map frames must be at least one");
         }
-        else {
-            throw OperationException("Scene name is invalid");
+    }
+    
+    int32_t numberOfRotationFrames = 1;
+    float rotationDegreesPerFrame = 0.0;
+    OptionalParameter* rotationSequenceOpt = myParams->getOptionalParameter(8);
+    if (rotationSequenceOpt->m_present) {
+        numberOfRotationFrames = rotationSequenceOpt->getInteger(1);
+        if (numberOfRotationFrames < 1) {
+            throw OperationException("number of rotation frames must be at least one");
         }
+        rotationDegreesPerFrame = rotationSequenceOpt->getDouble(2);
     }
     
+    const int32_t numberOfFrames = std::max(numberOfMapFrames,
+                                            numberOfRotationFrames);
+    
+    /*
+     * With more than one scene or frame, every image is numbered
+     * sequentially.  Otherwise, only multiple windows are numbered.
+     */
+    const int32_t numberOfScenes = static_cast<int32_t>(scenes.size());
+    const bool numberAllImagesFlag = ((numberOfScenes > 1)
+                                      || (numberOfFrames > 1));
+    
     //
     // Create the Mesa Context
     //
@@ -227,24 +284,6 @@ OperationShowScene::useParameters(OperationParameters* myParams,
      */
     VolumeFile::setVoxelColoringEnabled(true);    
     
-    SceneAttributes sceneAttributes(SceneTypeEnum::SCENE_TYPE_FULL);
-    
-    const SceneClass* guiManagerClass = scene->getClassWithName("guiManager");
-    if (guiManagerClass->getName() != "guiManager") {
-        throw OperationException("Top level scene class should be guiManager but it is: "
-                               + guiManagerClass->getName());
-    }
-    
-    SessionManager* sessionManager = SessionManager::get();
-    sessionManager->restoreFromScene(&sceneAttributes,
-                                            guiManagerClass->getClass("m_sessionManager"));
-
-    
-    if (sessionManager->getNumberOfBrains() <= 0) {
-        throw OperationException("Scene loading failure, SessionManager contains no Brains");
-    }
-    Brain* brain = SessionManager::get()->getBrain(0);
-    
     BrainOpenGLTextRenderInterface* textRenderer = new GlfFontTextRenderer();
     if (! textRenderer->isValid()) {
         delete textRenderer;
@@ -262,10 +301,49 @@ OperationShowScene::useParameters(OperationParameters* myParams,
     brainOpenGL->initializeOpenGL();
     
     /*
-     * Restore windows
+     * Rendered images are written to files in groups, one file per thread,
+     * while rendering uses the single OpenGL context.
      */
-    const SceneClassArray* browserWindowArray = guiManagerClass->getClassArray("m_brainBrowserWindows");
-    if (browserWindowArray != NULL) {
+    int32_t maximumNumberOfPendingImages = 1;
+#ifdef CARET_OMP
+    maximumNumberOfPendingImages = omp_get_max_threads();
+#endif // CARET_OMP
+    std::vector<ImageFile*> pendingImageFiles;
+    std::vector<AString> pendingImageFileNames;
+    int32_t imageCounter = 0;
+    
+    for (int32_t iScene = 0; iScene < numberOfScenes; iScene++) {
+        Scene* scene = scenes[iScene];
+        
+        const SceneClass* guiManagerClass = scene->getClassWithName("guiManager");
+        if (guiManagerClass->getName() != "guiManager") {
+            throw OperationException("Top level scene class should be guiManager but it is: "
+                                     + guiManagerClass->getName());
+        }
+        
+        /*
+         * A full restore resets the Brain with resetBrainKeepSceneFiles(),
+         * so data files that were loaded by the previous scene and are
+         * not modified are reused instead of being read again.
+         */
+        SceneAttributes sceneAttributes(SceneTypeEnum::SCENE_TYPE_FULL);
+        
+        SessionManager* sessionManager = SessionManager::get();
+        sessionManager->restoreFromScene(&sceneAttributes,
+                                         guiManagerClass->getClass("m_sessionManager"));
+        
+        if (sessionManager->getNumberOfBrains() <= 0) {
+            throw OperationException("Scene loading failure, SessionManager contains no Brains");
+        }
+        Brain* brain = SessionManager::get()->getBrain(0);
+        
+        /*
+         * Restore windows
+         */
+        const SceneClassArray* browserWindowArray = guiManagerClass->getClassArray("m_brainBrowserWindows");
+        if (browserWindowArray == NULL) {
+            continue;
+        }
         const int32_t numBrowserClasses = browserWindowArray->getNumberOfArrayElements();
         for (int32_t i = 0; i < numBrowserClasses; i++) {
             const SceneClass* browserClass = browserWindowArray->getClassAtIndex(i);
@@ -274,20 +352,63 @@ OperationShowScene::useParameters(OperationParameters* myParams,
              * Restore toolbar
              */
             const SceneClass* toolbarClass = browserClass->getClass("m_toolbar");
-            if (toolbarClass != NULL) {
-                /*
-                 * Index of selected browser tab (NOT the tabBar)
-                 */
-                const int32_t selectedTabIndex = toolbarClass->getIntegerValue("selectedTabIndex", -1);
-
-                EventBrowserTabGet getTabContent(selectedTabIndex);
-                EventManager::get()->sendEvent(getTabContent.getPointer());
-                BrowserTabContent* tabContent = getTabContent.getBrowserTab();
-                if (tabContent == NULL) {
-                    throw OperationException("Failed to obtain tab number "
-                                             + AString::number(selectedTabIndex + 1)
-                                             + " for window "
-                                             + AString::number(i + 1));
+            if (toolbarClass == NULL) {
+                continue;
+            }
+            
+            /*
+             * Index of selected browser tab (NOT the tabBar)
+             */
+            const int32_t selectedTabIndex = toolbarClass->getIntegerValue("selectedTabIndex", -1);
+            
+            EventBrowserTabGet getTabContent(selectedTabIndex);
+            EventManager::get()->sendEvent(getTabContent.getPointer());
+            BrowserTabContent* tabContent = getTabContent.getBrowserTab();
+            if (tabContent == NULL) {
+                throw OperationException("Failed to obtain tab number "
+                                         + AString::number(selectedTabIndex + 1)
+                                         + " for window "
+                                         + AString::number(i + 1));
+            }
+            
+            /*
+             * Map selections and rotation restored from the scene
+             * are the first frame of a sequence.
+             */
+            OverlaySet* overlaySet = tabContent->getOverlaySet();
+            const int32_t numberOfOverlays = overlaySet->getNumberOfDisplayedOverlays();
+            std::vector<CaretMappableDataFile*> overlayMapFiles(numberOfOverlays, NULL);
+            std::vector<int32_t> overlayMapIndices(numberOfOverlays, -1);
+            for (int32_t iOverlay = 0; iOverlay < numberOfOverlays; iOverlay++) {
+                Overlay* overlay = overlaySet->getOverlay(iOverlay);
+                if (overlay->isEnabled()) {
+                    overlay->getSelectionData(overlayMapFiles[iOverlay],
+                                              overlayMapIndices[iOverlay]);
+                }
+            }
+            const Matrix4x4 sceneRotationMatrix = tabContent->getRotationMatrix();
+            
+            for (int32_t iFrame = 0; iFrame < numberOfFrames; iFrame++) {
+                if (numberOfMapFrames > 1) {
+                    const int32_t mapStep = std::min(iFrame,
+                                                     numberOfMapFrames - 1);
+                    for (int32_t iOverlay = 0; iOverlay < numberOfOverlays; iOverlay++) {
+                        CaretMappableDataFile* mapFile = overlayMapFiles[iOverlay];
+                        if ((mapFile != NULL)
+                            && (overlayMapIndices[iOverlay] >= 0)) {
+                            const int32_t mapIndex = std::min(overlayMapIndices[iOverlay] + mapStep,
+                                                              mapFile->getNumberOfMaps() - 1);
+                            overlaySet->getOverlay(iOverlay)->setSelectionData(mapFile,
+                                                                               mapIndex);
+                        }
+                    }
+                }
+                if (numberOfRotationFrames > 1) {
+                    const int32_t rotationStep = std::min(iFrame,
+                                                          numberOfRotationFrames - 1);
+                    Matrix4x4 rotationMatrix = sceneRotationMatrix;
+                    rotationMatrix.rotateY(rotationStep * rotationDegreesPerFrame);
+                    tabContent->setRotationMatrix(rotationMatrix);
                 }
                 
                 BrainOpenGLViewportContent content(viewport,
@@ -300,19 +421,36 @@ OperationShowScene::useParameters(OperationParameters* myParams,
                 
                 brainOpenGL->drawModels(viewportContents);
                 
-                const int32_t outputImageIndex = ((numBrowserClasses > 1)
-                                             ? i
-                                             : -1);
+                int32_t outputImageIndex = -1;
+                if (numberAllImagesFlag) {
+                    outputImageIndex = imageCounter;
+                }
+                else if (numBrowserClasses > 1) {
+                    outputImageIndex = i;
+                }
+                imageCounter++;
                 
-                writeImage(imageFileName,
-                           outputImageIndex,
-                           imageBuffer,
-                           imageWidth,
-                           imageHeight);
+                /*
+                 * The image file copies the content of the image buffer
+                 * so that the buffer is available for the next frame.
+                 */
+                pendingImageFiles.push_back(new ImageFile(imageBuffer,
+                                                          imageWidth,
+                                                          imageHeight,
+                                                          ImageFile::IMAGE_DATA_ORIGIN_AT_BOTTOM));
+                pendingImageFileNames.push_back(getImageFileName(imageFileName,
+                                                                 outputImageIndex));
+                if (static_cast<int32_t>(pendingImageFiles.size()) >= maximumNumberOfPendingImages) {
+                    writeImages(pendingImageFiles,
+                                pendingImageFileNames);
+                }
             }
         }
     }
     
+    writeImages(pendingImageFiles,
+                pendingImageFileNames);
+    
     if (textRenderer != NULL) {
         delete textRenderer;
     }
@@ -328,25 +466,58 @@ OperationShowScene::useParameters(OperationParameters* myParams,
 #endif // HAVE_OSMESA
 
 /**
- * Write the image data to a Image File.
+ * Get a scene using its name or its number.
+ *
+ * @param sceneFile
+ *     File containing the scenes.
+ * @param sceneNameOrNumber
+ *     Name or number (starting at one) of the scene.
+ * @return
+ *     The scene.
+ * @throw OperationException
+ *     If there is no scene with the name or number.
+ */
+Scene*
+OperationShowScene::getSceneWithNameOrNumber(SceneFile& sceneFile,
+                                             const AString& sceneNameOrNumber)
+{
+    Scene* scene = sceneFile.getSceneWithName(sceneNameOrNumber);
+    if (scene == NULL) {
+        bool valid = false;
+        const int32_t sceneIndexStartAtOne = sceneNameOrNumber.toInt(&valid);
+        if (valid) {
+            const int32_t sceneIndex = sceneIndexStartAtOne - 1;
+            if ((sceneIndex >= 0)
+                && (sceneIndex < sceneFile.getNumberOfScenes())) {
+                scene = sceneFile.getSceneAtIndex(sceneIndex);
+            }
+            else {
+                throw OperationException("Scene index is invalid: "
+                                         + sceneNameOrNumber);
+            }
+        }
+        else {
+            throw OperationException("Scene name is invalid: "
+                                     + sceneNameOrNumber);
+        }
+    }
+    
+    return scene;
+}
+
+/**
+ * Get the name for an image file.
  *
  * @param imageFileName
  *     Name of image file.
  * @param imageIndex
- *     Index of image.
- * @param imageContent
- *     content of image.
- * @param imageWidth
- *     width of image.
- * @param imageHeight
- *     height of image.
+ *     Index of image.  If negative, the name is not changed.
+ * @return
+ *     Name of image file with the image number inserted before the extension.
  */
-void
-OperationShowScene::writeImage(const AString& imageFileName,
-                               const int32_t imageIndex,
-                               const unsigned char* imageContent,
-                               const int32_t imageWidth,
-                               const int32_t imageHeight)
+AString
+OperationShowScene::getImageFileName(const AString& imageFileName,
+                                     const int32_t imageIndex)
 {
     /*
      * Create name of image
@@ -368,16 +539,59 @@ OperationShowScene::writeImage(const AString& imageFileName,
         }
     }
     
-    try {
-        //ImageFile imageFile(image);
-        ImageFile imageFile(imageContent,
-                            imageWidth,
-                            imageHeight,
-                            ImageFile::IMAGE_DATA_ORIGIN_AT_BOTTOM);
-        imageFile.writeFile(outputName);
+    return outputName;
+}
+
+/**
+ * Write image files, in parallel when threads are available.
+ * The image files are deleted and both vectors are cleared.
+ *
+ * @param imageFiles
+ *     The image files.
+ * @param imageFileNames
+ *     Name for each of the image files.
+ * @throw OperationException
+ *     If writing any of the images fails.
+ */
+void
+OperationShowScene::writeImages(std::vector<ImageFile*>& imageFiles,
+                                std::vector<AString>& imageFileNames)
+{
+    CaretAssert(imageFiles.size() == imageFileNames.size());
+    
+    const int32_t numImages = static_cast<int32_t>(imageFiles.size());
+    std::vector<AString> errorMessages(numImages);
+    
+#pragma omp CARET_PARFOR schedule(dynamic)
+    for (int32_t i = 0; i < numImages; i++) {
+        try {
+            imageFiles[i]->writeFile(imageFileNames[i]);
+        }
+        catch (const CaretException& e) {
+            errorMessages[i] = e.whatString();
+        }
+        catch (const std::exception& e) {
+            errorMessages[i] = ("Error writing image "
+                                + imageFileNames[i]
+                                + ": "
+                                + AString(e.what()));
+        }
+        catch (...) {
+            errorMessages[i] = ("Unknown error writing image "
+                                + imageFileNames[i]);
+        }
+    }
+    
+    for (int32_t i = 0; i < numImages; i++) {
+        delete imageFiles[i];
     }
-    catch (const DataFileException& dfe) {
-        throw OperationException(dfe);
+    imageFiles.clear();
+    imageFileNames.clear();
+    
+    for (int32_t i = 0; i < numImages; i++) {
+        if ( ! errorMessages[i].isEmpty()) {
+            throw OperationException(errorMessages[i]);
+        }
     }
 }
 
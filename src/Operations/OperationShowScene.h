@@ -22,10 +22,16 @@
 /*LICENSE_END*/
 
 
+#include <vector>
+
 #include "AbstractOperation.h"
 
 namespace caret {
 
+    class ImageFile;
+    class Scene;
+    class SceneFile;
+    
     class OperationShowScene : public AbstractOperation {
 
     public:
@@ -41,11 +47,14 @@ namespace caret {
         static bool isShowSceneCommandAvailable();
         
     private:
-        static void writeImage(const AString& imageFileName,
-                                  const int32_t imageIndex,
-                                  const unsigned char* imageContent,
-                                  const int32_t imageWidth,
-                                  const int32_t imageHeight);
+        static Scene* getSceneWithNameOrNumber(SceneFile& sceneFile,
+                                               const AString& sceneNameOrNumber);
+        
+        static AString getImageFileName(const AString& imageFileName,
+                                        const int32_t imageIndex);
+        
+        static void writeImages(std::vector<ImageFile*>& imageFiles,
+                                std::vector<AString>& imageFileNames);
     };
 
     typedef TemplateAutoOperation<OperationShowScene> AutoOperationShowScene;
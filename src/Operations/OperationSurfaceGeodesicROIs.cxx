@@ -97,7 +97,7 @@ void OperationSurfaceGeodesicROIs::useParameters(OperationParameters* myParams,
         throw OperationException("error opening list file for reading");
     }
     int nodenum, numNodes = mySurf->getNumberOfNodes();
-    vector<int> nodelist;
+    vector<int32_t> nodelist;
     textFile >> nodenum;
     while (textFile)
     {
@@ -164,12 +164,14 @@ void OperationSurfaceGeodesicROIs::useParameters(OperationParameters* myParams,
     switch (overlapType)
     {
         case 1://ALLOW
+        {
+            vector<vector<int32_t> > roinodelists;
+            vector<vector<float> > distlists;
+            GeodesicHelper::getNodesToGeoDistBatch(mySurf->getGeodesicHelperBase(), nodelist, limit, roinodelists, distlists);
             for (int i = 0; i < (int)nodelist.size(); ++i)
             {
-                CaretPointer<GeodesicHelper> myhelp = mySurf->getGeodesicHelper();
-                vector<int32_t> roinodes;
-                vector<float> dists;
-                myhelp->getNodesToGeoDist(nodelist[i], limit, roinodes, dists);
+                const vector<int32_t>& roinodes = roinodelists[i];
+                vector<float>& dists = distlists[i];
                 if (sigma > 0.0f)
                 {
                     double accum = 0.0;
@@ -191,25 +193,40 @@ void OperationSurfaceGeodesicROIs::useParameters(OperationParameters* myParams,
                 }
             }
             break;
+        }
         case 2:
         case 3:
         {
             vector<int> useCounts(numNodes, 0);
             vector<int> closestSeed(numNodes, -1);
             vector<float> bestDists(numNodes, -1.0f);
-            for (int i = 0; i < (int)nodelist.size(); ++i)
-            {
+            if (overlapType == 2)
+            {//CLOSEST only needs the nearest seed, which one multi-root search finds directly, with ties going to the earlier seed
                 CaretPointer<GeodesicHelper> myhelp = mySurf->getGeodesicHelper();
-                vector<int32_t> roinodes;
+                vector<int32_t> roinodes, seedIndices;
                 vector<float> dists;
-                myhelp->getNodesToGeoDist(nodelist[i], limit, roinodes, dists);
+                myhelp->getNodesToGeoDist(nodelist, limit, roinodes, dists, seedIndices);
                 for (int j = 0; j < (int)roinodes.size(); ++j)
                 {
-                    ++useCounts[roinodes[j]];
-                    if (bestDists[roinodes[j]] < 0.0f || dists[j] < bestDists[roinodes[j]])
+                    bestDists[roinodes[j]] = dists[j];
+                    closestSeed[roinodes[j]] = seedIndices[j];//nodelist array index, not node number
+                }
+            } else {
+                vector<vector<int32_t> > roinodelists;
+                vector<vector<float> > distlists;
+                GeodesicHelper::getNodesToGeoDistBatch(mySurf->getGeodesicHelperBase(), nodelist, limit, roinodelists, distlists);
+                for (int i = 0; i < (int)nodelist.size(); ++i)
+                {
+                    const vector<int32_t>& roinodes = roinodelists[i];
+                    const vector<float>& dists = distlists[i];
+                    for (int j = 0; j < (int)roinodes.size(); ++j)
                     {
-                        bestDists[roinodes[j]] = dists[j];
-                        closestSeed[roinodes[j]] = i;//nodelist array index, not node number
+                        ++useCounts[roinodes[j]];
+                        if (bestDists[roinodes[j]] < 0.0f || dists[j] < bestDists[roinodes[j]])
+                        {
+                            bestDists[roinodes[j]] = dists[j];
+                            closestSeed[roinodes[j]] = i;//nodelist array index, not node number
+                        }
                     }
                 }
             }
@@ -46,6 +46,9 @@ OperationParameters* OperationWbsparseMergeDense::getParameters()
     ParameterComponent* wbsparseOpt = ret->createRepeatableParameter(3, "-wbsparse", "specify an input wbsparse file");
     wbsparseOpt->addStringParameter(1, "wbsparse-in", "a wbsparse file to merge");
     
+    OptionalParameter* compressedOpt = ret->createOptionalParameter(4, "-compressed", "write the compressed version 2 of the wbsparse format");
+    compressedOpt->createOptionalParameter(1, "-column-index", "also store the output matrix by column, for fast column access");
+    
     ret->setHelpText(
         AString("The input wbsparse files must have matching mappings along the direction not specified, and the mapping along the specified direction must be brain models.")
     );
@@ -158,7 +161,15 @@ void OperationWbsparseMergeDense::useParameters(OperationParameters* myParams, P
     int numOutModels = (int)sourceWbsparse.size();
     CaretAssert(numOutModels == outXML.getNumberOfBrainModels(myDir));
     int64_t outColSize = outXML.getNumberOfRows();
-    CaretSparseFileWriter myWriter(outputName, outXML);
+    CaretSparseFileWriter::Format outFormat = CaretSparseFileWriter::FORMAT_VERSION_1;
+    bool writeColumnIndex = false;
+    OptionalParameter* compressedOpt = myParams->getOptionalParameter(4);
+    if (compressedOpt->m_present)
+    {
+        outFormat = CaretSparseFileWriter::FORMAT_VERSION_2;
+        writeColumnIndex = compressedOpt->getOptionalParameter(1)->m_present;
+    }
+    CaretSparseFileWriter myWriter(outputName, outXML, outFormat, writeColumnIndex);
     switch (myDir)
     {
         case CiftiXMLOld::ALONG_ROW:
@@ -0,0 +1,158 @@
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CiftiCorrelationTest.h"
+
+#include "AlgorithmCiftiCorrelation.h"
+#include "CaretException.h"
+#include "CiftiFile.h"
+#include "CiftiXMLOld.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    //the straightforward correlation, one pair at a time, with the same float and double steps as the algorithm
+    void naiveCorrelation(const vector<vector<float> >& rows, const bool& fisherZ, vector<vector<float> >& result)
+    {
+        int numRows = (int)rows.size(), numCols = (int)rows[0].size();
+        vector<vector<float> > centered(numRows, vector<float>(numCols));
+        vector<float> rootResidSqr(numRows);
+        for (int i = 0; i < numRows; ++i)
+        {
+            double accum = 0.0;
+            for (int k = 0; k < numCols; ++k) accum += rows[i][k];
+            float mean = accum / numCols;
+            accum = 0.0;
+            for (int k = 0; k < numCols; ++k)
+            {
+                float tempf = rows[i][k] - mean;
+                accum += tempf * tempf;
+                centered[i][k] = tempf;
+            }
+            rootResidSqr[i] = sqrt(accum);
+        }
+        result.assign(numRows, vector<float>(numRows));
+        for (int i = 0; i < numRows; ++i)
+        {
+            for (int j = 0; j < numRows; ++j)
+            {
+                double r = 1.0;
+                if (i != j)
+                {
+                    double accum = 0.0;
+                    for (int k = 0; k < numCols; ++k) accum += centered[j][k] * centered[i][k];
+                    r = accum / (rootResidSqr[j] * rootResidSqr[i]);
+                }
+                if (fisherZ)
+                {
+                    if (r > 0.999999) r = 0.999999;
+                    if (r < -0.999999) r = -0.999999;
+                    result[i][j] = 0.5 * log((1 + r) / (1 - r));
+                } else {
+                    if (r > 1.0) r = 1.0;
+                    if (r < -1.0) r = -1.0;
+                    result[i][j] = r;
+                }
+            }
+        }
+    }
+}
+
+CiftiCorrelationTest::CiftiCorrelationTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void CiftiCorrelationTest::execute()
+{//the tiled kernel must not depend on how rows are grouped into chunks and panels, and must match a pair by pair correlation
+    const int numRows = 45, numCols = 300;//not a multiple of the tile size, so partial tiles get used
+    CiftiXMLOld myXML;
+    myXML.resetRowsToScalars(numCols);
+    myXML.resetColumnsToScalars(numRows);
+    CiftiFile myInput(IN_MEMORY);
+    myInput.setCiftiXML(myXML);
+    vector<vector<float> > rows(numRows, vector<float>(numCols));
+    for (int i = 0; i < numRows; ++i)
+    {
+        for (int k = 0; k < numCols; ++k)
+        {
+            rows[i][k] = sin(0.05f * k * (1 + i % 7)) + 0.3f * cos(0.11f * k + i) + 0.01f * i;
+        }
+        myInput.setRow(rows[i].data(), i);
+    }
+    rows[12] = rows[3];//an exact duplicate, correlation 1 without the short circuit
+    myInput.setRow(rows[12].data(), 12);
+    for (int fisher = 0; fisher < 2; ++fisher)
+    {
+        bool fisherZ = (fisher == 1);
+        vector<vector<float> > expected;
+        naiveCorrelation(rows, fisherZ, expected);
+        const float memLimits[2] = { -1.0f, 0.0f };//all output rows in one chunk from a fully cached input, and one output row per chunk reading input rows in panels
+        vector<vector<float> > firstResult;
+        for (int m = 0; m < 2; ++m)
+        {
+            CiftiFile myOutput;
+            try
+            {
+                AlgorithmCiftiCorrelation(NULL, &myInput, &myOutput, NULL, fisherZ, memLimits[m]);
+            } catch (CaretException& e) {
+                setFailed("correlation failed: " + e.whatString());
+                return;
+            }
+            if (myOutput.getNumberOfRows() != numRows || myOutput.getNumberOfColumns() != numRows)
+            {
+                setFailed("correlation output has the wrong dimensions");
+                return;
+            }
+            vector<vector<float> > result(numRows, vector<float>(numRows));
+            for (int i = 0; i < numRows; ++i) myOutput.getRow(result[i].data(), i);
+            AString config = AString(fisherZ ? "fisher z " : "") + "correlation with memory limit " + AString::number(memLimits[m]);
+            for (int i = 0; i < numRows; ++i)
+            {
+                for (int j = 0; j < numRows; ++j)
+                {
+                    if (m > 0 && result[i][j] != firstResult[i][j])
+                    {
+                        setFailed(config + " is not identical to unlimited memory at row " + AString::number(i) + ", column " + AString::number(j));
+                        return;
+                    }
+                    if (result[i][j] != result[j][i])
+                    {
+                        setFailed(config + " is not symmetric at row " + AString::number(i) + ", column " + AString::number(j));
+                        return;
+                    }
+                    if (abs(result[i][j] - expected[i][j]) > 1e-6f * max(1.0f, abs(expected[i][j])))
+                    {
+                        setFailed(config + " gave " + AString::number(result[i][j]) + " at row " + AString::number(i) + ", column " + AString::number(j) +
+                                  ", pairwise correlation is " + AString::number(expected[i][j]));
+                        return;
+                    }
+                }
+            }
+            if (m == 0) firstResult = result;
+        }
+    }
+}
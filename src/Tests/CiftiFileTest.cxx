@@ -20,6 +20,12 @@
 
 #include "CiftiFileTest.h"
 #include "CiftiFile.h"
+#include "CiftiRowStream.h"
+#include "CiftiXMLOld.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <algorithm>
+#include <cmath>
 using namespace caret;
 CiftiFileTest::CiftiFileTest(const AString &identifier) : TestInterface(identifier)
 {
@@ -29,12 +35,16 @@ void CiftiFileTest::execute()
 {
     testObjectCreateDestroy();
     if(this->failed()) return;
+    testCiftiRowStream();//doesn't need the test data directory
+    if(this->failed()) return;
     testCiftiRead();
     if(this->failed()) return;
     testCiftiReadWriteInMemory();
     if(this->failed()) return;
     testCiftiReadWriteOnDisk();
     if(this->failed()) return;
+    testCiftiReadMemoryMapped();
+    if(this->failed()) return;
 }
 
 void CiftiFileTest::testObjectCreateDestroy()
@@ -204,3 +214,181 @@ void CiftiFileTest::testCiftiReadWriteOnDisk()
     delete [] testRow;
 }
 
+
+void CiftiFileTest::testCiftiReadMemoryMapped()
+{
+    std::cout << "Testing memory mapped Cifti reader." << std::endl;
+
+    CiftiFile reader(this->m_default_path + "/cifti/DenseTimeSeries.dtseries.nii");
+    CiftiFile mapped(this->m_default_path + "/cifti/DenseTimeSeries.dtseries.nii", MEMORY_MAPPED);
+    int64_t rowSize = reader.getNumberOfColumns();
+    int64_t columnSize = reader.getNumberOfRows();
+    if (mapped.getNumberOfColumns() != rowSize || mapped.getNumberOfRows() != columnSize)
+    {
+        setFailed("Memory mapped Cifti file has different dimensions.");
+        return;
+    }
+    if (mapped.getCaching() == IN_MEMORY)
+    {
+        setFailed("Memory mapped Cifti file reports IN_MEMORY caching before any writes.");
+        return;
+    }
+    std::vector<float> row(rowSize), testRow(rowSize), column(columnSize), testColumn(columnSize);
+    for(int64_t i = 0;i<columnSize;i++)
+    {
+        reader.getRow(row.data(),i);
+        mapped.getRow(testRow.data(),i);
+        if(memcmp((void *)row.data(),(void *)testRow.data(),rowSize*sizeof(float)))
+        {
+            setFailed("Memory mapped row " + AString::number(i) + " is not the same.");
+            return;
+        }
+        const float* rowPointer = mapped.getRowPointer(i);
+        if(rowPointer != NULL && memcmp((const void *)rowPointer,(void *)row.data(),rowSize*sizeof(float)))
+        {
+            setFailed("Memory mapped row pointer " + AString::number(i) + " is not the same.");
+            return;
+        }
+    }
+    reader.getColumn(column.data(), 0);
+    mapped.getColumn(testColumn.data(), 0);
+    if(memcmp((void *)column.data(),(void *)testColumn.data(),columnSize*sizeof(float)))
+    {
+        setFailed("Memory mapped column is not the same.");
+        return;
+    }
+    //reading a block of rows must give the same values as reading them one at a time, for each kind of caching
+    int64_t blockRows = std::min(columnSize, (int64_t)5);
+    std::vector<float> block(blockRows * rowSize), testBlock(blockRows * rowSize);
+    for (int64_t i = 0; i < blockRows; ++i) reader.getRow(block.data() + i * rowSize, i);
+    CiftiFile onDisk(this->m_default_path + "/cifti/DenseTimeSeries.dtseries.nii", ON_DISK);
+    const CiftiFile* blockReaders[3] = { &reader, &mapped, &onDisk };
+    const char* blockReaderNames[3] = { "In memory", "Memory mapped", "On disk" };
+    for (int k = 0; k < 3; ++k)
+    {
+        blockReaders[k]->getRows(testBlock.data(), 0, blockRows);
+        if(memcmp((void *)block.data(),(void *)testBlock.data(),blockRows*rowSize*sizeof(float)))
+        {
+            setFailed(AString(blockReaderNames[k]) + " block of rows is not the same as the individual rows.");
+            return;
+        }
+    }
+    //writing to a mapped file must convert it to in-memory without changing the other rows
+    for (int64_t j = 0; j < rowSize; ++j) testRow[j] = -1.0f;
+    mapped.setRow(testRow.data(), 0);
+    mapped.getRow(testRow.data(), 0);
+    if (testRow[0] != -1.0f)
+    {
+        setFailed("Setting a row on a memory mapped Cifti file did not take effect.");
+        return;
+    }
+    if (mapped.getCaching() != IN_MEMORY)
+    {
+        setFailed("Memory mapped Cifti file does not report IN_MEMORY caching after a write.");
+        return;
+    }
+    if (columnSize > 1)
+    {
+        reader.getRow(row.data(), 1);
+        mapped.getRow(testRow.data(), 1);
+        if(memcmp((void *)row.data(),(void *)testRow.data(),rowSize*sizeof(float)))
+        {
+            setFailed("Memory mapped Cifti file lost data when converting to in-memory.");
+            return;
+        }
+    }
+    std::cout << "Memory mapped reading of Cifti was successful for all rows." << std::endl;
+}
+
+void CiftiFileTest::testCiftiRowStream()
+{
+    std::cout << "Testing Cifti row stream." << std::endl;
+    const int64_t numRows = 57, numCols = 1000;
+    AString fileName = QDir::tempPath() + "/cifti_row_stream_test_" + AString::number(QCoreApplication::applicationPid()) + ".dscalar.nii";
+    {
+        CiftiXMLOld myXML;
+        myXML.resetRowsToScalars(numCols);
+        myXML.resetColumnsToScalars(numRows);
+        CiftiFile writer(IN_MEMORY);
+        writer.setCiftiXML(myXML);
+        std::vector<float> row(numCols);
+        for (int64_t i = 0; i < numRows; ++i)
+        {
+            for (int64_t j = 0; j < numCols; ++j) row[j] = i + 10.0f * sin(i * 0.37f + j * 0.01f);
+            writer.setRow(row.data(), i);
+        }
+        writer.writeFile(fileName);
+    }
+    const CacheEnum cachings[2] = { ON_DISK, IN_MEMORY };
+    const char* cachingNames[2] = { "On disk", "In memory" };
+    for (int k = 0; k < 2 && !failed(); ++k)
+    {
+        CiftiFile reader(fileName, cachings[k]);
+        std::vector<std::vector<float> > expected(numRows, std::vector<float>(numCols));
+        for (int64_t i = 0; i < numRows; ++i) reader.getRow(expected[i].data(), i);//the file must not be read directly while a stream is open
+        AString prefix = AString(cachingNames[k]) + " row stream ";
+        {//all rows, through the returned pointer
+            CiftiRowStream myStream(&reader, 4, 2);
+            int64_t count = 0, rowIndex = -1;
+            const float* rowPointer;
+            while ((rowPointer = myStream.nextRow(rowIndex)) != NULL)
+            {
+                if (rowIndex != count || memcmp(rowPointer, expected[count].data(), numCols * sizeof(float)))
+                {
+                    setFailed(prefix + "gave the wrong data for row " + AString::number(count));
+                    break;
+                }
+                ++count;
+            }
+            if (!failed() && count != numRows) setFailed(prefix + "returned " + AString::number(count) + " rows instead of " + AString::number(numRows));
+        }
+        if (failed()) break;
+        {//a row list in any order, with repeats, copied into caller memory
+            std::vector<int64_t> rowList;
+            for (int64_t i = numRows - 1; i >= 0; i -= 3) rowList.push_back(i);
+            rowList.push_back(5);
+            rowList.push_back(5);
+            CiftiRowStream myStream(&reader, rowList, 3, 3);
+            std::vector<float> row(numCols);
+            int64_t rowIndex = -1;
+            for (int i = 0; i < (int)rowList.size(); ++i)
+            {
+                if (!myStream.nextRow(row.data(), rowIndex) || rowIndex != rowList[i] || memcmp(row.data(), expected[rowList[i]].data(), numCols * sizeof(float)))
+                {
+                    setFailed(prefix + "gave the wrong data for entry " + AString::number(i) + " of a row list");
+                    break;
+                }
+            }
+            if (!failed() && myStream.nextRow(row.data(), rowIndex)) setFailed(prefix + "returned more rows than the row list");
+        }
+        if (failed()) break;
+        {//stop early, the destructor must stop the readers while they still have rows to read
+            CiftiRowStream myStream(&reader, 8, 2);
+            int64_t rowIndex = -1;
+            for (int i = 0; i < 3; ++i)
+            {
+                const float* rowPointer = myStream.nextRow(rowIndex);
+                if (rowPointer == NULL || rowIndex != i || memcmp(rowPointer, expected[i].data(), numCols * sizeof(float)))
+                {
+                    setFailed(prefix + "gave the wrong data before stopping early");
+                    break;
+                }
+            }
+        }
+        {//destroyed before any row is taken
+            CiftiRowStream myStream(&reader);
+        }
+        if (failed()) break;
+        std::vector<float> row(numCols);
+        for (int64_t i = 0; i < numRows; ++i)
+        {//the file must still read correctly after streams were abandoned
+            reader.getRow(row.data(), i);
+            if (memcmp(row.data(), expected[i].data(), numCols * sizeof(float)))
+            {
+                setFailed(AString(cachingNames[k]) + " row " + AString::number(i) + " is wrong after a stream was destroyed mid-stream");
+                break;
+            }
+        }
+    }
+    QFile::remove(fileName);
+}
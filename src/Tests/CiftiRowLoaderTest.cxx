@@ -0,0 +1,359 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+#include "CiftiRowLoaderTest.h"
+
+#include "CiftiFile.h"
+#include "CiftiRowLoader.h"
+#include "CiftiXMLOld.h"
+#include "SystemUtilities.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+
+#include <cmath>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    const int64_t NUM_ROWS = 140, NUM_COLS = 16384;//64KB rows: a 1MB cache holds 16 rows, and one 8MB read holds 128 rows
+    const int64_t TINY_CACHE_ROWS = 16, MAX_RUN_ROWS = 128;
+    
+    float testValue(const int64_t& row, const int64_t& col)
+    {
+        return row + 10.0f * sin(row * 0.37f + col * 0.01f);
+    }
+    
+    bool waitFor(CiftiRowLoader& loader, const int64_t& requestID, vector<float>& dataOut)
+    {
+        for (int i = 0; i < 100; ++i)
+        {
+            if (loader.waitForResult(requestID, dataOut, 100)) return true;
+        }
+        return false;
+    }
+    
+    bool waitForReads(CiftiRowLoader& loader, const int64_t& numReads)
+    {//prefetching has no result to wait on
+        for (int i = 0; i < 100 && loader.getNumberOfReads() < numReads; ++i)
+        {
+            SystemUtilities::sleepSeconds(0.1f);
+        }
+        return loader.getNumberOfReads() >= numReads;
+    }
+    
+    int64_t countReads(const CiftiFile& input, const vector<int64_t>& rows)
+    {
+        CiftiRowLoader myLoader(&input);
+        vector<float> result;
+        if (!waitFor(myLoader, myLoader.startRequest(rows), result)) return -1;
+        return myLoader.getNumberOfReads();
+    }
+}
+
+CiftiRowLoaderTest::CiftiRowLoaderTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void CiftiRowLoaderTest::execute()
+{
+    AString fileName = QDir::tempPath() + "/cifti_row_loader_test_" + AString::number(QCoreApplication::applicationPid()) + ".dscalar.nii";
+    {
+        CiftiXMLOld myXML;
+        myXML.resetRowsToScalars(NUM_COLS);
+        myXML.resetColumnsToScalars(NUM_ROWS);
+        CiftiFile myFile(IN_MEMORY);
+        myFile.setCiftiXML(myXML);
+        vector<float> row(NUM_COLS);
+        for (int64_t i = 0; i < NUM_ROWS; ++i)
+        {
+            for (int64_t j = 0; j < NUM_COLS; ++j)
+            {
+                row[j] = testValue(i, j);
+            }
+            myFile.setRow(row.data(), i);
+        }
+        myFile.writeFile(fileName);
+    }
+    {
+        CiftiFile myInput(fileName, ON_DISK);
+        testAverages(myInput);
+        if (!failed()) testCache(myInput);
+        if (!failed()) testMergedReads(myInput);
+        if (!failed()) testPrefetch(myInput);
+        if (!failed()) testSupersede(myInput);
+    }
+    if (!failed()) testErrors(fileName);
+    QFile::remove(fileName);
+}
+
+void CiftiRowLoaderTest::testAverages(const CiftiFile& input)
+{
+    CiftiRowLoader myLoader(&input, 2, 1);
+    vector<int64_t> rows;
+    rows.push_back(50);
+    rows.push_back(7);
+    rows.push_back(3);
+    rows.push_back(7);//repeated rows count once per repeat
+    rows.push_back(139);
+    vector<double> expected(NUM_COLS, 0.0);
+    vector<float> row(NUM_COLS), result;
+    for (int i = 0; i < (int)rows.size(); ++i)
+    {
+        input.getRow(row.data(), rows[i]);
+        for (int64_t j = 0; j < NUM_COLS; ++j)
+        {
+            expected[j] += row[j];
+        }
+    }
+    if (!waitFor(myLoader, myLoader.startRequest(rows), result))
+    {
+        setFailed("average request did not finish");
+        return;
+    }
+    if ((int64_t)result.size() != NUM_COLS)
+    {
+        setFailed("average has wrong length: " + AString::number(result.size()));
+        return;
+    }
+    for (int64_t j = 0; j < NUM_COLS; ++j)
+    {
+        float expectVal = (float)(expected[j] / rows.size());
+        if (abs(result[j] - expectVal) > 1e-4f * max(1.0f, abs(expectVal)))
+        {
+            setFailed("average differs from direct reads at column " + AString::number(j) + ": " + AString::number(result[j]) + " vs " + AString::number(expectVal));
+            return;
+        }
+    }
+    myLoader.getRow(row.data(), 139);//cached by the request
+    for (int64_t j = 0; j < NUM_COLS; ++j)
+    {
+        if (row[j] != testValue(139, j))
+        {
+            setFailed("cached row differs from file contents");
+            return;
+        }
+    }
+}
+
+void CiftiRowLoaderTest::testCache(const CiftiFile& input)
+{
+    CiftiRowLoader myLoader(&input, 2, 1);
+    vector<float> row(NUM_COLS), result;
+    for (int64_t i = 0; i < TINY_CACHE_ROWS + 4; ++i)
+    {
+        myLoader.getRow(row.data(), i);
+    }
+    if (myLoader.getNumberOfReads() != TINY_CACHE_ROWS + 4)
+    {
+        setFailed("expected one read per new row, got " + AString::number(myLoader.getNumberOfReads()));
+        return;
+    }
+    myLoader.getRow(row.data(), TINY_CACHE_ROWS + 3);
+    if (myLoader.getNumberOfReads() != TINY_CACHE_ROWS + 4)
+    {
+        setFailed("recently read row was not found in the cache");
+        return;
+    }
+    myLoader.getRow(row.data(), 0);
+    if (myLoader.getNumberOfReads() != TINY_CACHE_ROWS + 5)
+    {
+        setFailed("least recently used row was not evicted from a full cache");
+        return;
+    }
+    if (row[5] != testValue(0, 5))
+    {
+        setFailed("reread row has wrong contents");
+        return;
+    }
+    vector<int64_t> cachedRows;//row 4 was evicted to make room for row 0
+    cachedRows.push_back(5);
+    cachedRows.push_back(0);
+    cachedRows.push_back(TINY_CACHE_ROWS + 3);
+    int64_t requestID = myLoader.startRequest(cachedRows);
+    if (!myLoader.takeResult(requestID, result))
+    {
+        setFailed("request for cached rows did not finish immediately");
+        return;
+    }
+    if (myLoader.getNumberOfReads() != TINY_CACHE_ROWS + 5)
+    {
+        setFailed("request for cached rows read from the file");
+        return;
+    }
+}
+
+void CiftiRowLoaderTest::testMergedReads(const CiftiFile& input)
+{
+    vector<int64_t> rows;
+    rows.push_back(14);
+    rows.push_back(10);
+    rows.push_back(12);
+    int64_t numReads = countReads(input, rows);
+    if (numReads != 1)
+    {
+        setFailed("rows with small gaps took " + AString::number(numReads) + " reads, expected 1");
+        return;
+    }
+    rows.clear();
+    rows.push_back(60);
+    rows.push_back(65);//largest gap that is read through
+    numReads = countReads(input, rows);
+    if (numReads != 1)
+    {
+        setFailed("rows 5 apart took " + AString::number(numReads) + " reads, expected 1");
+        return;
+    }
+    rows.clear();
+    rows.push_back(70);
+    rows.push_back(76);
+    numReads = countReads(input, rows);
+    if (numReads != 2)
+    {
+        setFailed("rows 6 apart took " + AString::number(numReads) + " reads, expected 2");
+        return;
+    }
+    rows.clear();
+    for (int64_t i = 0; i <= MAX_RUN_ROWS; ++i)
+    {
+        rows.push_back(i);
+    }
+    numReads = countReads(input, rows);
+    if (numReads != 2)
+    {
+        setFailed(AString::number(MAX_RUN_ROWS + 1) + " adjacent rows took " + AString::number(numReads) + " reads, expected 2 because of the read size limit");
+        return;
+    }
+}
+
+void CiftiRowLoaderTest::testPrefetch(const CiftiFile& input)
+{
+    vector<int64_t> requestRows(1, 100), prefetchRows;
+    for (int64_t i = 0; i < TINY_CACHE_ROWS / 2; ++i)
+    {
+        prefetchRows.push_back(i);
+    }
+    vector<float> row(NUM_COLS), result;
+    {
+        CiftiRowLoader myLoader(&input, 2, 1);
+        if (!waitFor(myLoader, myLoader.startRequest(requestRows, prefetchRows), result) || !waitForReads(myLoader, 2))
+        {
+            setFailed("prefetch of half the cache was not done");
+            return;
+        }
+        for (int64_t i = 0; i < (int64_t)prefetchRows.size(); ++i)
+        {
+            myLoader.getRow(row.data(), prefetchRows[i]);
+        }
+        if (myLoader.getNumberOfReads() != 2)
+        {
+            setFailed("prefetched rows were not in the cache");
+            return;
+        }
+    }
+    prefetchRows.push_back(TINY_CACHE_ROWS / 2);
+    {
+        CiftiRowLoader myLoader(&input, 2, 1);
+        if (!waitFor(myLoader, myLoader.startRequest(requestRows, prefetchRows), result))
+        {
+            setFailed("request with too many prefetch rows did not finish");
+            return;
+        }
+        SystemUtilities::sleepSeconds(0.2f);
+        if (myLoader.getNumberOfReads() != 1)
+        {
+            setFailed("prefetch of more than half the cache was not skipped");
+            return;
+        }
+    }
+}
+
+void CiftiRowLoaderTest::testSupersede(const CiftiFile& input)
+{
+    CiftiRowLoader myLoader(&input);
+    vector<int64_t> firstRows, secondRows(1, 41), thirdRows(1, 42);
+    firstRows.push_back(40);
+    firstRows.push_back(80);
+    firstRows.push_back(120);
+    vector<float> result;
+    int64_t firstID = myLoader.startRequest(firstRows);
+    int64_t secondID = myLoader.startRequest(secondRows);
+    if (!waitFor(myLoader, secondID, result))
+    {
+        setFailed("superseding request did not finish");
+        return;
+    }
+    if (myLoader.takeResult(firstID, result) || myLoader.waitForResult(firstID, result, 200))
+    {
+        setFailed("superseded request finished");
+        return;
+    }
+    int64_t thirdID = myLoader.startRequest(thirdRows);
+    myLoader.cancelRequest();
+    if (myLoader.waitForResult(thirdID, result, 200))
+    {
+        setFailed("cancelled request finished");
+        return;
+    }
+}
+
+void CiftiRowLoaderTest::testErrors(const AString& fileName)
+{
+    AString truncatedName = fileName + ".truncated.dscalar.nii";
+    QFile::remove(truncatedName);
+    if (!QFile::copy(fileName, truncatedName))
+    {
+        setFailed("failed to copy test file");
+        return;
+    }
+    bool threwOutOfRange = false, threwTruncated = false;
+    {
+        CiftiFile myInput(truncatedName, ON_DISK);
+        QFile::resize(truncatedName, QFile(truncatedName).size() / 2);//header is still valid, the last rows are gone
+        CiftiRowLoader myLoader(&myInput);
+        try
+        {
+            myLoader.startRequest(vector<int64_t>(1, NUM_ROWS));
+        } catch (CiftiFileException&) {
+            threwOutOfRange = true;
+        }
+        vector<float> result;
+        try
+        {
+            waitFor(myLoader, myLoader.startRequest(vector<int64_t>(1, NUM_ROWS - 1)), result);
+        } catch (CiftiFileException&) {
+            threwTruncated = true;
+        }
+    }
+    QFile::remove(truncatedName);
+    if (!threwOutOfRange)
+    {
+        setFailed("out of range row did not throw");
+        return;
+    }
+    if (!threwTruncated)
+    {
+        setFailed("read error on a worker thread was not reported to the caller");
+        return;
+    }
+}
@@ -0,0 +1,306 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+#include "CommandDaemonTest.h"
+
+#include "CaretPointer.h"
+#include "CiftiFile.h"
+#include "CiftiXMLOld.h"
+#include "CommandDaemon.h"
+#include "CommandOperationManager.h"
+#include "CommandParser.h"
+#include "CommandSurfaceCache.h"
+#include "FileInformation.h"
+#include "GeodesicHelper.h"
+#include "MetricFile.h"
+#include "SurfaceFile.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QLocalServer>
+#include <QLocalSocket>
+
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    const int TEST_TIMEOUT_MSEC = 10000;
+    
+    void writeOctahedron(const AString& fileName)
+    {
+        const float coords[6][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+        const int32_t tris[8][3] = { { 0, 2, 4 }, { 2, 1, 4 }, { 1, 3, 4 }, { 3, 0, 4 }, { 2, 0, 5 }, { 1, 2, 5 }, { 3, 1, 5 }, { 0, 3, 5 } };
+        SurfaceFile mySurf;
+        mySurf.setNumberOfNodesAndTriangles(6, 8);
+        for (int i = 0; i < 6; ++i)
+        {
+            mySurf.setCoordinate(i, coords[i]);
+        }
+        for (int i = 0; i < 8; ++i)
+        {
+            mySurf.setTriangle(i, tris[i]);
+        }
+        mySurf.setStructure(StructureEnum::CORTEX_LEFT);
+        mySurf.writeFile(fileName);
+    }
+    
+    void writeScalarCifti(const AString& fileName, const float& offset)
+    {
+        const int64_t numRows = 3, numCols = 4;
+        CiftiXMLOld myXML;
+        myXML.resetRowsToScalars(numCols);
+        myXML.resetColumnsToScalars(numRows);
+        CiftiFile myFile(IN_MEMORY);
+        myFile.setCiftiXML(myXML);
+        vector<float> row(numCols);
+        for (int64_t i = 0; i < numRows; ++i)
+        {
+            for (int64_t j = 0; j < numCols; ++j)
+            {
+                row[j] = offset + i * numCols + j;
+            }
+            myFile.setRow(row.data(), i);
+        }
+        myFile.writeFile(fileName);
+    }
+    
+    CommandParser* findParser(const AString& commandSwitch)
+    {
+        vector<CommandOperation*> myOperations = CommandOperationManager::getCommandOperationManager()->getCommandOperations();
+        for (int i = 0; i < (int)myOperations.size(); ++i)
+        {
+            if (myOperations[i]->getCommandLineSwitch() == commandSwitch)
+            {
+                return dynamic_cast<CommandParser*>(myOperations[i]);
+            }
+        }
+        return NULL;
+    }
+}
+
+CommandDaemonTest::CommandDaemonTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void CommandDaemonTest::execute()
+{
+    AString dirName = QDir::tempPath() + "/command_daemon_test_" + AString::number(QCoreApplication::applicationPid());
+    if (!QDir().mkpath(dirName))
+    {
+        setFailed("failed to create directory '" + dirName + "'");
+        return;
+    }
+    writeOctahedron(dirName + "/first.surf.gii");
+    QFile::copy(dirName + "/first.surf.gii", dirName + "/second.surf.gii");//identical contents, different name
+    writeScalarCifti(dirName + "/first.dscalar.nii", 0.0f);
+    writeScalarCifti(dirName + "/second.dscalar.nii", 100.0f);
+    testSurfaceCache(dirName);
+    if (!failed()) testRepeatedRequests(dirName);
+    if (!failed()) testSocketProtocol(dirName);
+    QDir myDir(dirName);
+    QStringList myFiles = myDir.entryList(QDir::Files);
+    for (int i = 0; i < myFiles.size(); ++i)
+    {
+        myDir.remove(myFiles[i]);
+    }
+    QDir().rmdir(dirName);
+}
+
+void CommandDaemonTest::testSurfaceCache(const AString& dirName)
+{
+    CommandSurfaceCache myCache(4);
+    CaretPointer<SurfaceFile> first = myCache.getSurface(dirName + "/first.surf.gii");
+    CaretPointer<SurfaceFile> second = myCache.getSurface(dirName + "/second.surf.gii");
+    if (myCache.getNumberOfMisses() != 1 || myCache.getNumberOfHits() != 1)
+    {
+        setFailed("identical surface files were not read once and then found in the cache");
+        return;
+    }
+    if (first == second)
+    {
+        setFailed("surface cache handed out the same object twice");
+        return;
+    }
+    if (!first->getFileName().endsWith("first.surf.gii") || !second->getFileName().endsWith("second.surf.gii"))
+    {
+        setFailed("cached surface reported the wrong file name: '" + second->getFileName() + "'");
+        return;
+    }
+    float moved[3] = { 5.0f, 5.0f, 5.0f };
+    first->setCoordinate(0, moved);
+    CaretPointer<GeodesicHelperBase> secondBase = second->getGeodesicHelperBase();
+    first->getGeodesicHelperBase();
+    myCache.keepHelpers();
+    CaretPointer<SurfaceFile> third = myCache.getSurface(dirName + "/first.surf.gii");
+    if (third->getCoordinate(0)[0] != 1.0f || third->getCoordinate(0)[1] != 0.0f)
+    {
+        setFailed("modifying a surface from the cache changed the surface given to a later request");
+        return;
+    }
+    if (third->getGeodesicHelperBase() != secondBase)
+    {
+        setFailed("helper built on an unmodified cached surface was not kept for a later request");
+        return;
+    }
+}
+
+void CommandDaemonTest::testRepeatedRequests(const AString& dirName)
+{
+    CommandSurfaceCache myCache(4);
+    CommandParser::setSurfaceCache(&myCache);
+    vector<AString> firstArgs, secondArgs;
+    firstArgs.push_back("-cifti-math");
+    firstArgs.push_back("x * 2");
+    firstArgs.push_back("first_out.dscalar.nii");
+    firstArgs.push_back("-var");
+    firstArgs.push_back("x");
+    firstArgs.push_back("first.dscalar.nii");
+    AString firstReply = CommandDaemon::runRequest(dirName, firstArgs, "wb_command");
+    secondArgs = firstArgs;
+    secondArgs[2] = "first.dscalar.nii";//overwrites the previous request's input
+    secondArgs[5] = "second.dscalar.nii";
+    AString secondReply = CommandDaemon::runRequest(dirName, secondArgs, "wb_command");
+    vector<AString> areaArgs;
+    areaArgs.push_back("-surface-vertex-areas");
+    areaArgs.push_back("first.surf.gii");
+    areaArgs.push_back("first_areas.func.gii");
+    AString firstAreaReply = CommandDaemon::runRequest(dirName, areaArgs, "wb_command");
+    myCache.keepHelpers();
+    areaArgs[2] = "second_areas.func.gii";
+    AString secondAreaReply = CommandDaemon::runRequest(dirName, areaArgs, "wb_command");
+    myCache.keepHelpers();
+    CommandParser::setSurfaceCache(NULL);
+    if (firstReply != "OK" || secondReply != "OK" || firstAreaReply != "OK" || secondAreaReply != "OK")
+    {
+        setFailed("daemon request failed: " + firstReply + ", " + secondReply + ", " + firstAreaReply + ", " + secondAreaReply);
+        return;
+    }
+    CommandParser* mathParser = findParser("-cifti-math");
+    if (mathParser == NULL)
+    {
+        setFailed("failed to find parser for -cifti-math");
+        return;
+    }
+    const set<AString>& inputNames = mathParser->getInputCiftiNames();
+    if (inputNames.size() != 1 || inputNames.count(FileInformation(dirName + "/second.dscalar.nii").getCanonicalFilePath()) != 1)
+    {
+        setFailed("cifti input names from an earlier request were kept by the parser");
+        return;
+    }
+    CiftiFile firstOut(dirName + "/first_out.dscalar.nii"), secondOut(dirName + "/first.dscalar.nii");
+    vector<float> firstRow(4), secondRow(4);
+    for (int64_t i = 0; i < 3; ++i)
+    {
+        firstOut.getRow(firstRow.data(), i);
+        secondOut.getRow(secondRow.data(), i);
+        for (int64_t j = 0; j < 4; ++j)
+        {
+            float expected = 2.0f * (i * 4 + j);
+            if (firstRow[j] != expected || secondRow[j] != expected + 200.0f)
+            {
+                setFailed("wrong cifti-math output at row " + AString::number(i) + ", column " + AString::number(j));
+                return;
+            }
+        }
+    }
+    MetricFile firstAreas, secondAreas;
+    firstAreas.readFile(dirName + "/first_areas.func.gii");
+    secondAreas.readFile(dirName + "/second_areas.func.gii");
+    for (int i = 0; i < 6; ++i)
+    {
+        if (firstAreas.getValue(i, 0) != secondAreas.getValue(i, 0) || firstAreas.getValue(i, 0) <= 0.0f)
+        {
+            setFailed("vertex areas differ between requests using the cached surface");
+            return;
+        }
+    }
+}
+
+void CommandDaemonTest::testSocketProtocol(const AString& dirName)
+{
+    AString socketName = "command_daemon_test_" + AString::number(QCoreApplication::applicationPid());
+    QLocalServer myServer;
+    QLocalServer::removeServer(socketName);
+    if (!myServer.listen(socketName))
+    {
+        setFailed("failed to listen on socket: " + myServer.errorString());
+        return;
+    }
+    QByteArray goodRequest, badRequest;
+    goodRequest.append("3").append('\0').append(dirName.toUtf8()).append('\0');
+    goodRequest.append("-surface-vertex-areas").append('\0').append("second.surf.gii").append('\0').append("socket_areas.func.gii").append('\0');
+    badRequest.append("three").append('\0');
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        QLocalSocket myClient;
+        myClient.connectToServer(socketName);
+        if (!myClient.waitForConnected(TEST_TIMEOUT_MSEC) || !myServer.waitForNewConnection(TEST_TIMEOUT_MSEC))
+        {
+            setFailed("failed to connect to test socket");
+            return;
+        }
+        CaretPointer<QLocalSocket> myConnection(myServer.nextPendingConnection());
+        myConnection->setParent(NULL);
+        myClient.write(pass == 0 ? goodRequest : badRequest);
+        myClient.flush();
+        myClient.waitForBytesWritten(TEST_TIMEOUT_MSEC);
+        AString workingDir, error;
+        vector<AString> arguments;
+        bool parsed = CommandDaemon::readRequest(myConnection, workingDir, arguments, error);
+        AString reply;
+        if (pass == 0)
+        {
+            if (!parsed || workingDir != dirName || arguments.size() != 3 || arguments[1] != "second.surf.gii")
+            {
+                setFailed("request was not parsed correctly: " + error);
+                return;
+            }
+            reply = CommandDaemon::runRequest(workingDir, arguments, "wb_command");
+        } else {
+            if (parsed || error.isEmpty())
+            {
+                setFailed("malformed request was accepted");
+                return;
+            }
+            reply = "ERROR: " + error;
+        }
+        CommandDaemon::sendReply(myConnection, reply);
+        if (myClient.bytesAvailable() == 0) myClient.waitForReadyRead(TEST_TIMEOUT_MSEC);
+        AString received = AString::fromUtf8(myClient.readAll());
+        if (pass == 0 && received != "OK\n")
+        {
+            setFailed("unexpected reply to request: " + received);
+            return;
+        }
+        if (pass == 1 && !received.startsWith("ERROR: "))
+        {
+            setFailed("malformed request did not get an error reply: " + received);
+            return;
+        }
+    }
+    myServer.close();
+    if (!QFile::exists(dirName + "/socket_areas.func.gii"))
+    {
+        setFailed("socket request did not write its output");
+    }
+}
@@ -0,0 +1,181 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+#include "CommandPipelineTest.h"
+
+#include "CaretException.h"
+#include "CommandOperationManager.h"
+#include "MetricFile.h"
+#include "ProgramParameters.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QTextStream>
+
+#include <cmath>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    const int NUM_NODES = 6;
+}
+
+CommandPipelineTest::CommandPipelineTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void CommandPipelineTest::execute()
+{
+    m_dirName = QDir::tempPath() + "/command_pipeline_test_" + AString::number(QCoreApplication::applicationPid());
+    if (!QDir().mkpath(m_dirName))
+    {
+        setFailed("failed to create directory '" + m_dirName + "'");
+        return;
+    }
+    MetricFile myInput;
+    myInput.setNumberOfNodesAndColumns(NUM_NODES, 1);
+    myInput.setStructure(StructureEnum::CORTEX_LEFT);
+    for (int i = 0; i < NUM_NODES; ++i)
+    {
+        myInput.setValue(i, 0, i + 1.0f);
+    }
+    myInput.writeFile(m_dirName + "/input.func.gii");
+    testOrdering(false);
+    if (!failed()) testOrdering(true);
+    if (!failed()) testErrors();
+    QDir myDir(m_dirName);
+    QStringList myFiles = myDir.entryList(QDir::Files);
+    for (int i = 0; i < myFiles.size(); ++i)
+    {
+        myDir.remove(myFiles[i]);
+    }
+    QDir().rmdir(m_dirName);
+}
+
+AString CommandPipelineTest::runPipeline(const AString& scriptName, const vector<AString>& lines, const bool& parallel)
+{//returns the error message, or an empty string on success
+    AString scriptPath = m_dirName + "/" + scriptName;
+    {
+        QFile scriptFile(scriptPath);
+        if (!scriptFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+        {
+            return "failed to write script '" + scriptPath + "'";
+        }
+        QTextStream myStream(&scriptFile);
+        for (int i = 0; i < (int)lines.size(); ++i)
+        {
+            myStream << lines[i] << "\n";
+        }
+    }
+    ProgramParameters myParams;
+    myParams.addParameter("-pipeline");
+    myParams.addParameter(scriptPath);
+    if (parallel)
+    {
+        myParams.addParameter("-parallel");
+        myParams.addParameter("4");
+    }
+    try
+    {
+        CommandOperationManager::getCommandOperationManager()->runCommand(myParams);
+    } catch (CaretException& e) {
+        return e.whatString();
+    }
+    return "";
+}
+
+bool CommandPipelineTest::checkMetric(const AString& fileName, const float& scale, const float& offset)
+{//input values are 1 to NUM_NODES
+    MetricFile myMetric;
+    myMetric.readFile(m_dirName + "/" + fileName);
+    if (myMetric.getNumberOfNodes() != NUM_NODES) return false;
+    for (int i = 0; i < NUM_NODES; ++i)
+    {
+        if (abs(myMetric.getValue(i, 0) - ((i + 1.0f) * scale + offset)) > 0.0001f) return false;
+    }
+    return true;
+}
+
+void CommandPipelineTest::testOrdering(const bool& parallel)
+{
+    const AString dir = "'" + m_dirName + "/";
+    vector<AString> lines;
+    lines.push_back("# chained through memory and disk, interleaved with independent steps");
+    lines.push_back("-metric-math 'x + 1' @plus -var x " + dir + "input.func.gii'");
+    lines.push_back("-metric-merge " + dir + "copy.func.gii' -metric " + dir + "input.func.gii'");
+    lines.push_back("-metric-math 'x * 2' " + dir + "disk.func.gii' -var x @plus");
+    lines.push_back("-metric-merge " + dir + "reread.func.gii' -metric " + dir + "disk.func.gii'");
+    lines.push_back("-metric-math 'x - 3' " + dir + "final.func.gii' -var x " + dir + "disk.func.gii'");
+    lines.push_back("-metric-merge " + dir + "disk.func.gii' -metric " + dir + "copy.func.gii'");//overwrites a file that earlier steps read
+    AString error = runPipeline("ordering.txt", lines, parallel);
+    AString mode = (parallel ? "parallel" : "serial");
+    if (error != "")
+    {
+        setFailed(mode + " pipeline failed: " + error);
+        return;
+    }
+    if (!checkMetric("copy.func.gii", 1.0f, 0.0f) || !checkMetric("reread.func.gii", 2.0f, 2.0f) ||
+        !checkMetric("final.func.gii", 2.0f, -1.0f) || !checkMetric("disk.func.gii", 1.0f, 0.0f))
+    {
+        setFailed(mode + " pipeline ran steps out of order");
+        return;
+    }
+}
+
+void CommandPipelineTest::testErrors()
+{
+    const AString dir = "'" + m_dirName + "/";
+    vector<AString> lines;
+    lines.push_back("-metric-math 'x + 1' @plus -var x " + dir + "input.func.gii'");
+    lines.push_back("-metric-math 'x * 2' " + dir + "unused.func.gii' -var x @minus");
+    AString error = runPipeline("plan_error.txt", lines, true);
+    if (!error.contains("pipeline line 2") || !error.contains("@minus"))
+    {
+        setFailed("in-memory file used before creation was not reported for its line: " + error);
+        return;
+    }
+    if (QFile::exists(m_dirName + "/unused.func.gii"))
+    {
+        setFailed("steps were run although the script has an error");
+        return;
+    }
+    lines.clear();
+    lines.push_back("-metric-merge " + dir + "first.func.gii' -metric " + dir + "input.func.gii'");
+    lines.push_back("-metric-math 'x + 1' @plus -var x " + dir + "missing.func.gii'");
+    lines.push_back("-metric-merge " + dir + "after.func.gii' -metric @plus");
+    lines.push_back("-metric-math 'x * 2' " + dir + "other.func.gii' -var x " + dir + "also_missing.func.gii'");
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        bool parallel = (pass == 1);
+        error = runPipeline("run_error.txt", lines, parallel);
+        if (!error.contains("pipeline line 2 failed"))
+        {
+            setFailed(AString(parallel ? "parallel" : "serial") + " pipeline did not report the first failed line: " + error);
+            return;
+        }
+        if (QFile::exists(m_dirName + "/after.func.gii"))
+        {
+            setFailed("step depending on a failed step was run");
+            return;
+        }
+    }
+}
@@ -0,0 +1,209 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+#include "GZipIndexedReaderTest.h"
+
+#include "GZipIndexedReader.h"
+#include "NiftiFile.h"
+#include "VolumeFile.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "zlib.h"
+
+using namespace caret;
+using namespace std;
+
+GZipIndexedReaderTest::GZipIndexedReaderTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void GZipIndexedReaderTest::execute()
+{
+    const int64_t dataSize = 6 * 1024 * 1024 + 1234, span = 128 * 1024, memberSize = 700000;
+    vector<char> testData(dataSize);
+    srand(42);
+    for (int64_t i = 0; i < dataSize; ++i)
+    {
+        testData[i] = (char)(rand() % 7 + (i / 1000) % 5);//compressible, but not trivially
+    }
+    AString fileName = QDir::tempPath() + "/gzip_indexed_reader_test_" + AString::number(QCoreApplication::applicationPid()) + ".gz";
+    QFile::remove(fileName);
+    QFile::remove(GZipIndexedReader::getIndexFileName(fileName));
+    for (int64_t start = 0; start < dataSize; start += memberSize)
+    {//write as several gzip members, to test continuing across member boundaries
+        gzFile myOut = gzopen(fileName.toLocal8Bit().constData(), "ab");
+        if (myOut == NULL)
+        {
+            setFailed("failed to open temporary file for writing");
+            return;
+        }
+        int64_t toWrite = min(memberSize, dataSize - start);
+        if (gzwrite(myOut, &(testData[start]), toWrite) != toWrite)
+        {
+            setFailed("failed to write temporary file");
+            gzclose(myOut);
+            return;
+        }
+        gzclose(myOut);
+    }
+    vector<char> readBuffer(512 * 1024);
+    int64_t builtPoints = 0;
+    for (int pass = 0; pass < 2; ++pass)
+    {//second pass asks for a coarser index, so it only matches the first if it came from the sidecar file
+        GZipIndexedReader myReader(fileName, (pass == 0 ? span : span * 4));
+        if (myReader.getUncompressedSize() != dataSize)
+        {
+            setFailed("uncompressed size should be " + AString::number(dataSize) + ", got " + AString::number(myReader.getUncompressedSize()));
+            break;
+        }
+        if (pass == 0)
+        {
+            builtPoints = myReader.getNumberOfAccessPoints();
+            if (builtPoints < dataSize / span / 2)
+            {
+                setFailed("too few access points: " + AString::number(builtPoints));
+            }
+        } else {
+            if (myReader.getNumberOfAccessPoints() != builtPoints)
+            {
+                setFailed("index was not read from the sidecar file, " + AString::number(myReader.getNumberOfAccessPoints()) + " access points instead of " + AString::number(builtPoints));
+            }
+        }
+        for (int i = 0; i < 100; ++i)
+        {
+            int64_t length = rand() % readBuffer.size() + 1;
+            int64_t offset = rand() % (dataSize - length + 1);
+            if (i == 0) offset = 0;
+            if (i == 1) offset = dataSize - length;
+            myReader.read(readBuffer.data(), offset, length);
+            if (memcmp(readBuffer.data(), &(testData[offset]), length) != 0)
+            {
+                setFailed("data mismatch reading " + AString::number(length) + " bytes at offset " + AString::number(offset));
+                break;
+            }
+        }
+        if (pass == 0)
+        {
+            myReader.writeIndexFile();
+            GZipIndexedReader::clearIndexCache();//otherwise the next reader gets the in-process index
+            if (!testStaleIndexFile(fileName, span * 4, builtPoints)) break;
+        }
+    }
+    QFile::remove(fileName);
+    QFile::remove(GZipIndexedReader::getIndexFileName(fileName));
+    testNiftiFrames();
+}
+
+bool GZipIndexedReaderTest::testStaleIndexFile(const AString& fileName, const int64_t& span, const int64_t& builtPoints)
+{//a sidecar with the same size and time but a different fingerprint must be rescanned, not trusted
+    QFile indexFile(GZipIndexedReader::getIndexFileName(fileName));
+    if (!indexFile.open(QIODevice::ReadWrite))
+    {
+        setFailed("sidecar index file was not written");
+        return false;
+    }
+    QByteArray original = indexFile.readAll(), modified = original;
+    const int headCrcOffset = 8 + 8 + 8;//magic, file size, modification time
+    if (modified.size() <= headCrcOffset)
+    {
+        setFailed("sidecar index file is too short");
+        return false;
+    }
+    modified[headCrcOffset] = modified[headCrcOffset] ^ 0x5a;
+    indexFile.seek(0);
+    indexFile.write(modified);
+    indexFile.flush();
+    bool ret = true;
+    {
+        GZipIndexedReader myReader(fileName, span);
+        if (myReader.getNumberOfAccessPoints() == builtPoints)
+        {
+            setFailed("sidecar index with a mismatched fingerprint was used");
+            ret = false;
+        }
+    }
+    indexFile.seek(0);
+    indexFile.write(original);
+    indexFile.close();
+    GZipIndexedReader::clearIndexCache();
+    return ret;
+}
+
+void GZipIndexedReaderTest::testNiftiFrames()
+{
+    const int64_t xdim = 31, ydim = 29, zdim = 23, tdim = 60, frameLength = xdim * ydim * zdim;
+    vector<int64_t> myDims;
+    myDims.push_back(xdim);
+    myDims.push_back(ydim);
+    myDims.push_back(zdim);
+    myDims.push_back(tdim);
+    vector<vector<float> > mySform(4, vector<float>(4, 0.0f));
+    for (int i = 0; i < 4; ++i) mySform[i][i] = 1.0f;
+    VolumeFile myVol;
+    myVol.reinitialize(myDims, mySform);
+    vector<float> frame(frameLength);
+    for (int64_t t = 0; t < tdim; ++t)
+    {
+        for (int64_t i = 0; i < frameLength; ++i)
+        {
+            frame[i] = (float)(t * 1000 + (i * 7) % 997);//exact in float32
+        }
+        myVol.setFrame(frame.data(), t);
+    }
+    AString fileName = QDir::tempPath() + "/gzip_indexed_nifti_test_" + AString::number(QCoreApplication::applicationPid()) + ".nii.gz";
+    try
+    {
+        myVol.writeFile(fileName);
+        GZipIndexedReader::clearIndexCache();
+        NiftiFile myNifti(fileName);//should only read the header
+        const int64_t checkFrames[] = { 47, 3, 59, 47 };
+        for (int f = 0; f < 4; ++f)
+        {
+            myNifti.getFrame(frame.data(), checkFrames[f]);
+            for (int64_t i = 0; i < frameLength; ++i)
+            {
+                if (frame[i] != (float)(checkFrames[f] * 1000 + (i * 7) % 997))
+                {
+                    setFailed("wrong value in frame " + AString::number(checkFrames[f]) + " of compressed nifti file");
+                    break;
+                }
+            }
+        }
+        vector<float> allFrames(frameLength * tdim);
+        myNifti.getMatrix(allFrames.data());
+        for (int64_t t = 0; t < tdim; ++t)
+        {
+            if (allFrames[t * frameLength + 5] != (float)(t * 1000 + 35))
+            {
+                setFailed("wrong value in frame " + AString::number(t) + " of whole matrix read after single frames");
+                break;
+            }
+        }
+    } catch (CaretException& e) {
+        setFailed("exception while reading frames of compressed nifti file: " + e.whatString());
+    }
+    QFile::remove(fileName);
+}
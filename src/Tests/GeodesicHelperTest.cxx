@@ -0,0 +1,106 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+#include "GeodesicHelperTest.h"
+#include "GeodesicHelper.h"
+#include "SurfaceFile.h"
+
+#include <ctime>
+#include <cstdlib>
+
+using namespace caret;
+using namespace std;
+
+GeodesicHelperTest::GeodesicHelperTest(const AString& identifier): TestInterface(identifier)
+{
+}
+
+void GeodesicHelperTest::execute()
+{
+    SurfaceFile mySurf;
+    mySurf.readFile(m_default_path + "/gifti/Human.PALS_B12.LEFT_AVG_B1-12.FIDUCIAL_FLIRT.clean.73730.surf.gii");
+    CaretPointer<GeodesicHelper> myGeoHelp = mySurf.getGeodesicHelper();
+    CaretPointer<GeodesicHelperBase> myGeoBase = mySurf.getGeodesicHelperBase();
+    int numNodes = mySurf.getNumberOfNodes();
+    const int TEST_ROOTS = 16, MULTI_ROOTS = 5;
+    const float TEST_LIMIT = 10.0f;
+    int myseed = time(NULL);
+    srand(myseed);
+    vector<int32_t> roots(TEST_ROOTS);
+    for (int i = 0; i < TEST_ROOTS; ++i)
+    {
+        roots[i] = rand() % numNodes;
+    }
+    vector<float> batchValues((int64_t)TEST_ROOTS * numNodes), singleValues;
+    GeodesicHelper::getGeoFromNodesBatch(myGeoBase, roots, batchValues.data());
+    for (int i = 0; i < TEST_ROOTS; ++i)
+    {//batch must give exactly the same answer as one root at a time
+        singleValues.assign(numNodes, -1.0f);
+        myGeoHelp->getGeoFromNode(roots[i], singleValues);
+        for (int j = 0; j < numNodes; ++j)
+        {
+            if (batchValues[(int64_t)i * numNodes + j] != singleValues[j])
+            {
+                setFailed("batch distance from root " + AString::number(roots[i]) + " to node " + AString::number(j) + " differs from single root result");
+                break;
+            }
+        }
+    }
+    vector<vector<int32_t> > batchNodes;
+    vector<vector<float> > batchDists;
+    GeodesicHelper::getNodesToGeoDistBatch(myGeoBase, roots, TEST_LIMIT, batchNodes, batchDists);
+    for (int i = 0; i < TEST_ROOTS; ++i)
+    {
+        vector<int32_t> nodes;
+        vector<float> dists;
+        myGeoHelp->getNodesToGeoDist(roots[i], TEST_LIMIT, nodes, dists);
+        if (nodes != batchNodes[i] || dists != batchDists[i])
+        {
+            setFailed("batch limited distances from root " + AString::number(roots[i]) + " differ from single root result");
+        }
+    }
+    vector<int32_t> multiRoots(roots.begin(), roots.begin() + MULTI_ROOTS), rootIndices;
+    vector<float> multiValues;
+    myGeoHelp->getGeoFromNodes(multiRoots, multiValues, rootIndices);
+    if ((int)multiValues.size() != numNodes || (int)rootIndices.size() != numNodes)
+    {
+        setFailed("multiple root distances returned the wrong size");
+        return;
+    }
+    for (int j = 0; j < numNodes; ++j)
+    {//closest root should be the minimum over the single root fields, ties to the lowest index
+        float best = -1.0f;
+        int bestIndex = -1;
+        for (int i = 0; i < MULTI_ROOTS; ++i)
+        {
+            float value = batchValues[(int64_t)i * numNodes + j];
+            if (value >= 0.0f && (bestIndex == -1 || value < best))
+            {
+                best = value;
+                bestIndex = i;
+            }
+        }
+        if (multiValues[j] != best || rootIndices[j] != bestIndex)
+        {
+            setFailed("multiple root distance at node " + AString::number(j) + " is " + AString::number(multiValues[j]) + " from root index " + AString::number(rootIndices[j]) +
+                      ", expected " + AString::number(best) + " from root index " + AString::number(bestIndex));
+            break;
+        }
+    }
+}
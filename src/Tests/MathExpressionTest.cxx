@@ -55,4 +55,28 @@ void MathExpressionTest::execute()
     {
         setFailed("output value incorrect, expected " + AString::number(correctresult) + ", got " + AString::number(testresult));
     }
+    CaretMathExpression myArrayExpr("mod(x, y) + (x >= y) * atan2(x, y) - clamp(-x, y, 2) + round(x / 3)");//batch mode must match evaluate exactly
+    const vector<AString>& arrayVarNames = myArrayExpr.getVarNames();
+    const int arrayLength = 1000;//not a multiple of the chunk size
+    vector<float> xvals(arrayLength), yvals(arrayLength), arrayOut(arrayLength);
+    for (int i = 0; i < arrayLength; ++i)
+    {
+        xvals[i] = (i % 37 - 18) * 0.75f;
+        yvals[i] = (i % 11 - 5) * 1.5f;//includes 0
+    }
+    vector<const float*> arrays(2);
+    arrays[0] = (arrayVarNames[0] == "x" ? xvals.data() : yvals.data());
+    arrays[1] = (arrayVarNames[0] == "x" ? yvals.data() : xvals.data());
+    myArrayExpr.evaluateArrays(arrays, arrayOut.data(), arrayLength);
+    for (int i = 0; i < arrayLength; ++i)
+    {
+        vars[0] = arrays[0][i];
+        vars[1] = arrays[1][i];
+        float expected = (float)myArrayExpr.evaluate(vars);
+        if (arrayOut[i] != expected && (arrayOut[i] == arrayOut[i] || expected == expected))
+        {
+            setFailed("evaluateArrays differs from evaluate at index " + AString::number(i) + ", expected " + AString::number(expected) + ", got " + AString::number(arrayOut[i]));
+            break;
+        }
+    }
 }
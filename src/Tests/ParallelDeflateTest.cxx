@@ -0,0 +1,92 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+#include "ParallelDeflateTest.h"
+
+#include "GZipParallelWriter.h"
+#include "ParallelDeflate.h"
+
+#include <QDir>
+#include <QFile>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "zlib.h"
+
+using namespace caret;
+using namespace std;
+
+ParallelDeflateTest::ParallelDeflateTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void ParallelDeflateTest::execute()
+{
+    const int64_t dataSize = 3 * 1024 * 1024 + 4321;
+    vector<char> testData(dataSize);
+    srand(7);
+    for (int64_t i = 0; i < dataSize; ++i)
+    {
+        testData[i] = (char)(rand() % 5 + (i / 777) % 11);
+    }
+    vector<char> compressed;//zlib stream, as used by GIFTI, must be readable by plain zlib
+    ParallelDeflate::compress(testData.data(), dataSize, compressed, ParallelDeflate::FORMAT_ZLIB);
+    vector<char> uncompressed(dataSize);
+    uLongf uncompressedSize = dataSize;
+    if (uncompress((Bytef*)uncompressed.data(), &uncompressedSize, (const Bytef*)compressed.data(), compressed.size()) != Z_OK ||
+        (int64_t)uncompressedSize != dataSize || memcmp(uncompressed.data(), testData.data(), dataSize) != 0)
+    {
+        setFailed("zlib stream did not decompress to the original data");
+    }
+    compressed.clear();
+    ParallelDeflate::compress(testData.data(), 0, compressed, ParallelDeflate::FORMAT_ZLIB);
+    uncompressedSize = dataSize;
+    if (uncompress((Bytef*)uncompressed.data(), &uncompressedSize, (const Bytef*)compressed.data(), compressed.size()) != Z_OK || uncompressedSize != 0)
+    {
+        setFailed("empty zlib stream did not decompress correctly");
+    }
+    AString fileName = QDir::tempPath() + "/parallel_deflate_test.gz";
+    {//gzip file written in uneven pieces, like a nifti header followed by frames
+        GZipParallelWriter myWriter(fileName);
+        int64_t position = 0, pieceSizes[3] = { 348, 1000000, 77 };
+        for (int i = 0; position < dataSize; ++i)
+        {
+            int64_t toWrite = min(pieceSizes[i % 3], dataSize - position);
+            myWriter.write(testData.data() + position, toWrite);
+            position += toWrite;
+        }
+        myWriter.close();
+    }
+    gzFile myIn = gzopen(fileName.toLocal8Bit().constData(), "rb");
+    if (myIn == NULL)
+    {
+        setFailed("failed to open written gzip file");
+    } else {
+        int numRead = gzread(myIn, uncompressed.data(), dataSize);
+        char extra;
+        if (numRead != dataSize || gzread(myIn, &extra, 1) != 0 || memcmp(uncompressed.data(), testData.data(), dataSize) != 0)
+        {
+            setFailed("gzip file did not decompress to the original data");
+        }
+        gzclose(myIn);
+    }
+    QFile::remove(fileName);
+}
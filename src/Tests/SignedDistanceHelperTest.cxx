@@ -0,0 +1,174 @@
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "SignedDistanceHelperTest.h"
+
+#include "SignedDistanceHelper.h"
+#include "SurfaceFile.h"
+#include "Vector3D.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    bool distClose(const float& a, const float& b)
+    {//same exact distance function, but allow for float rounding in different search orders
+        return abs(a - b) <= 1e-5f * max(1.0f, abs(b));
+    }
+}
+
+SignedDistanceHelperTest::SignedDistanceHelperTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void SignedDistanceHelperTest::execute()
+{//compares the tree searches, single and batch, against testing every triangle
+    const int NUM_RINGS = 24, NUM_SEGMENTS = 48, NUM_NEAR = 600, NUM_FAR = 60;
+    const float RADIUS = 20.0f, NEAR_RANGE = 60.0f, FAR_RANGE = 1000.0f;
+    srand(22);
+    SurfaceFile mySurf;
+    int32_t numNodes = 2 + (NUM_RINGS - 1) * NUM_SEGMENTS;
+    int32_t numTris = 2 * NUM_SEGMENTS * (NUM_RINGS - 1);
+    mySurf.setNumberOfNodesAndTriangles(numNodes, numTris);
+    mySurf.setCoordinate(0, 0.0f, 0.0f, RADIUS);
+    mySurf.setCoordinate(numNodes - 1, 0.0f, 0.0f, -RADIUS);
+    for (int ring = 1; ring < NUM_RINGS; ++ring)
+    {
+        float theta = M_PI * ring / NUM_RINGS;
+        for (int seg = 0; seg < NUM_SEGMENTS; ++seg)
+        {
+            float phi = 2.0f * M_PI * seg / NUM_SEGMENTS;
+            float nodeRadius = RADIUS * (0.8f + 0.4f * rand() / (float)RAND_MAX);//bumpy, so the closest triangle isn't just the one in the same direction
+            mySurf.setCoordinate(1 + (ring - 1) * NUM_SEGMENTS + seg, nodeRadius * sin(theta) * cos(phi), nodeRadius * sin(theta) * sin(phi), nodeRadius * cos(theta));
+        }
+    }
+    int32_t curTri = 0;
+    for (int seg = 0; seg < NUM_SEGMENTS; ++seg)
+    {
+        int next = (seg + 1) % NUM_SEGMENTS;
+        mySurf.setTriangle(curTri++, 0, 1 + seg, 1 + next);
+        int lastRing = 1 + (NUM_RINGS - 2) * NUM_SEGMENTS;
+        mySurf.setTriangle(curTri++, numNodes - 1, lastRing + next, lastRing + seg);
+        for (int ring = 1; ring < NUM_RINGS - 1; ++ring)
+        {
+            int32_t upper = 1 + (ring - 1) * NUM_SEGMENTS, lower = upper + NUM_SEGMENTS;
+            mySurf.setTriangle(curTri++, upper + seg, lower + seg, lower + next);
+            mySurf.setTriangle(curTri++, upper + seg, lower + next, upper + next);
+        }
+    }
+    const int numPoints = NUM_NEAR + NUM_FAR;
+    vector<float> coords(numPoints * 3);
+    for (int i = 0; i < numPoints; ++i)
+    {
+        float range = (i < NUM_NEAR ? NEAR_RANGE : FAR_RANGE);//far points are well outside the surface bounds
+        for (int j = 0; j < 3; ++j)
+        {
+            coords[i * 3 + j] = range * (2.0f * rand() / (float)RAND_MAX - 1.0f);
+        }
+    }
+    CaretPointer<SignedDistanceHelper> myHelper = mySurf.getSignedDistanceHelper();
+    vector<float> batchDists(numPoints);
+    vector<BarycentricInfo> batchInfo(numPoints);
+    myHelper->dist(coords.data(), numPoints, SignedDistanceHelper::EVEN_ODD, batchDists.data());
+    myHelper->barycentricWeights(coords.data(), numPoints, batchInfo.data());
+    for (int i = 0; i < numPoints; ++i)
+    {
+        const float* thisCoord = coords.data() + i * 3;
+        float bruteDist = numeric_limits<float>::infinity();
+        SignedDistanceHelper::ClosestPointInfo tempInfo;
+        for (int32_t t = 0; t < numTris; ++t)
+        {
+            float tempf = myHelper->unsignedDistToTri(thisCoord, t, tempInfo);
+            if (tempf < bruteDist) bruteDist = tempf;
+        }
+        AString pointString = "point " + AString::number(i) + " (" + AString::number(thisCoord[0]) + ", " + AString::number(thisCoord[1]) + ", " + AString::number(thisCoord[2]) + ")";
+        float singleDist = myHelper->dist(thisCoord, SignedDistanceHelper::EVEN_ODD);
+        if (!distClose(abs(singleDist), bruteDist))
+        {
+            setFailed("single dist() of " + AString::number(singleDist) + " at " + pointString + ", brute force distance is " + AString::number(bruteDist));
+            return;
+        }
+        if (!distClose(batchDists[i], singleDist))
+        {
+            setFailed("batch dist() of " + AString::number(batchDists[i]) + " at " + pointString + ", single dist() gave " + AString::number(singleDist));
+            return;
+        }
+        BarycentricInfo singleInfo;
+        myHelper->barycentricWeights(thisCoord, singleInfo);
+        const BarycentricInfo* infos[2] = { &singleInfo, &(batchInfo[i]) };
+        const char* infoNames[2] = { "single", "batch" };
+        for (int which = 0; which < 2; ++which)
+        {
+            const BarycentricInfo& myInfo = *(infos[which]);
+            if (!distClose(myInfo.absDistance, bruteDist))
+            {
+                setFailed(AString(infoNames[which]) + " barycentricWeights() distance of " + AString::number(myInfo.absDistance) + " at " + pointString +
+                          ", brute force distance is " + AString::number(bruteDist));
+                return;
+            }
+            Vector3D weighted;
+            for (int k = 0; k < 3; ++k)
+            {
+                weighted += Vector3D(mySurf.getCoordinate(myInfo.nodes[k])) * myInfo.baryWeights[k];
+            }
+            if ((weighted - myInfo.point).length() > 1e-3f || !distClose((myInfo.point - Vector3D(thisCoord)).length(), bruteDist))
+            {
+                setFailed(AString(infoNames[which]) + " barycentricWeights() gave an inconsistent closest point at " + pointString);
+                return;
+            }
+        }
+    }
+    testEmptySurface();
+}
+
+void SignedDistanceHelperTest::testEmptySurface()
+{//the search tree isn't built without triangles, queries must report no hit rather than read it
+    SurfaceFile mySurf;
+    mySurf.setNumberOfNodesAndTriangles(3, 0);
+    mySurf.setCoordinate(0, 0.0f, 0.0f, 0.0f);
+    mySurf.setCoordinate(1, 1.0f, 0.0f, 0.0f);
+    mySurf.setCoordinate(2, 0.0f, 1.0f, 0.0f);
+    CaretPointer<SignedDistanceHelper> myHelper = mySurf.getSignedDistanceHelper();
+    float coords[6] = { 0.5f, 0.5f, 1.0f, 10.0f, -3.0f, 2.0f }, batchDists[2];
+    BarycentricInfo singleInfo, batchInfo[2];
+    if (myHelper->dist(coords, SignedDistanceHelper::EVEN_ODD) != -1.0f)
+    {
+        setFailed("single dist() on a surface without triangles should be -1");
+    }
+    myHelper->dist(coords, 2, SignedDistanceHelper::EVEN_ODD, batchDists);
+    if (batchDists[0] != -1.0f || batchDists[1] != -1.0f)
+    {
+        setFailed("batch dist() on a surface without triangles should be -1");
+    }
+    myHelper->barycentricWeights(coords, singleInfo);
+    myHelper->barycentricWeights(coords, 2, batchInfo);
+    if (singleInfo.triangle != -1 || batchInfo[0].triangle != -1 || batchInfo[1].triangle != -1)
+    {
+        setFailed("barycentricWeights() on a surface without triangles should report triangle -1");
+    }
+}
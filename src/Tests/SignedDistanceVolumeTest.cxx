@@ -0,0 +1,127 @@
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "SignedDistanceVolumeTest.h"
+
+#include "AlgorithmCreateSignedDistanceVolume.h"
+#include "SurfaceFile.h"
+#include "VolumeFile.h"
+
+#include <cmath>
+
+using namespace caret;
+using namespace std;
+
+SignedDistanceVolumeTest::SignedDistanceVolumeTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void SignedDistanceVolumeTest::execute()
+{//compares both approximate methods against the analytic distance to a sphere
+    const int NUM_RINGS = 60, NUM_SEGMENTS = 120;
+    const float RADIUS = 20.0f, EXACT_LIMIT = 3.0f, APPROX_LIMIT = 14.0f;
+    const int64_t DIM = 72;
+    SurfaceFile mySphere;
+    int32_t numNodes = 2 + (NUM_RINGS - 1) * NUM_SEGMENTS;
+    int32_t numTris = 2 * NUM_SEGMENTS * (NUM_RINGS - 1);
+    mySphere.setNumberOfNodesAndTriangles(numNodes, numTris);
+    mySphere.setCoordinate(0, 0.0f, 0.0f, RADIUS);
+    mySphere.setCoordinate(numNodes - 1, 0.0f, 0.0f, -RADIUS);
+    for (int ring = 1; ring < NUM_RINGS; ++ring)
+    {
+        float theta = M_PI * ring / NUM_RINGS;
+        for (int seg = 0; seg < NUM_SEGMENTS; ++seg)
+        {
+            float phi = 2.0f * M_PI * seg / NUM_SEGMENTS;
+            mySphere.setCoordinate(1 + (ring - 1) * NUM_SEGMENTS + seg, RADIUS * sin(theta) * cos(phi), RADIUS * sin(theta) * sin(phi), RADIUS * cos(theta));
+        }
+    }
+    int32_t curTri = 0;
+    for (int seg = 0; seg < NUM_SEGMENTS; ++seg)
+    {
+        int next = (seg + 1) % NUM_SEGMENTS;
+        mySphere.setTriangle(curTri++, 0, 1 + seg, 1 + next);
+        int lastRing = 1 + (NUM_RINGS - 2) * NUM_SEGMENTS;
+        mySphere.setTriangle(curTri++, numNodes - 1, lastRing + next, lastRing + seg);
+        for (int ring = 1; ring < NUM_RINGS - 1; ++ring)
+        {
+            int32_t upper = 1 + (ring - 1) * NUM_SEGMENTS, lower = upper + NUM_SEGMENTS;
+            mySphere.setTriangle(curTri++, upper + seg, lower + seg, lower + next);
+            mySphere.setTriangle(curTri++, upper + seg, lower + next, upper + next);
+        }
+    }
+    vector<int64_t> dims(3, DIM);
+    vector<vector<float> > sform(4, vector<float>(4, 0.0f));
+    for (int i = 0; i < 3; ++i)
+    {
+        sform[i][i] = 1.0f;
+        sform[i][3] = -(DIM - 1) / 2.0f;//centered on the sphere
+    }
+    sform[3][3] = 1.0f;
+    VolumeFile dijkstraVol(dims, sform), sweepVol(dims, sform), dijkstraRoi, sweepRoi;
+    AlgorithmCreateSignedDistanceVolume(NULL, &mySphere, &dijkstraVol, &dijkstraRoi, 0.0f, EXACT_LIMIT, APPROX_LIMIT, 2, SignedDistanceHelper::EVEN_ODD,
+                                        AlgorithmCreateSignedDistanceVolume::DIJKSTRA);
+    AlgorithmCreateSignedDistanceVolume(NULL, &mySphere, &sweepVol, &sweepRoi, 0.0f, EXACT_LIMIT, APPROX_LIMIT, 2, SignedDistanceHelper::EVEN_ODD,
+                                        AlgorithmCreateSignedDistanceVolume::FAST_SWEEP);
+    double dijkstraErrSum = 0.0, sweepErrSum = 0.0;
+    float sweepMaxErr = 0.0f;
+    int64_t numCompared = 0;
+    for (int64_t k = 0; k < DIM; ++k)
+    {
+        for (int64_t j = 0; j < DIM; ++j)
+        {
+            for (int64_t i = 0; i < DIM; ++i)
+            {
+                float coord[3];
+                sweepVol.indexToSpace(i, j, k, coord);
+                float trueDist = sqrt(coord[0] * coord[0] + coord[1] * coord[1] + coord[2] * coord[2]) - RADIUS;
+                bool inDijkstra = dijkstraRoi.getValue(i, j, k) > 0.0f, inSweep = sweepRoi.getValue(i, j, k) > 0.0f;
+                if (inDijkstra && !inSweep && abs(trueDist) < APPROX_LIMIT - 1.0f)
+                {
+                    setFailed("sweep method missed voxel " + AString::number(i) + ", " + AString::number(j) + ", " + AString::number(k) + " that dijkstra method computed");
+                    return;
+                }
+                if (!inDijkstra || !inSweep || abs(trueDist) <= EXACT_LIMIT) continue;
+                float sweepVal = sweepVol.getValue(i, j, k);
+                if ((sweepVal < 0.0f) != (trueDist < 0.0f))
+                {
+                    setFailed("sweep method has wrong sign at voxel " + AString::number(i) + ", " + AString::number(j) + ", " + AString::number(k));
+                    return;
+                }
+                float sweepErr = abs(sweepVal - trueDist);
+                if (sweepErr > sweepMaxErr) sweepMaxErr = sweepErr;
+                sweepErrSum += sweepErr;
+                dijkstraErrSum += abs(dijkstraVol.getValue(i, j, k) - trueDist);
+                ++numCompared;
+            }
+        }
+    }
+    if (numCompared == 0)
+    {
+        setFailed("no approximate voxels to compare");
+        return;
+    }
+    double sweepMean = sweepErrSum / numCompared, dijkstraMean = dijkstraErrSum / numCompared;
+    if (sweepMean > dijkstraMean + 0.25 || sweepMaxErr > 1.5f)
+    {
+        setFailed("sweep method error too large: mean " + AString::number(sweepMean) + " (dijkstra mean " + AString::number(dijkstraMean) + "), max " + AString::number(sweepMaxErr));
+    }
+}
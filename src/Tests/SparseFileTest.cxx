@@ -0,0 +1,178 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+#include "SparseFileTest.h"
+
+#include "CaretOMP.h"
+#include "CaretSparseFile.h"
+#include "CiftiXMLOld.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+SparseFileTest::SparseFileTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    void writeRows(CaretSparseFileWriter& myWriter, const vector<vector<int64_t> >& rowIndices, const vector<vector<int64_t> >& rowValues, const int64_t& numCols)
+    {
+        int64_t numRows = (int64_t)rowIndices.size();
+        vector<int64_t> denseRow(numCols);
+        for (int64_t i = 0; i < numRows; ++i)
+        {
+            if (i % 2 == 0)
+            {
+                if (!rowIndices[i].empty()) myWriter.writeRowSparse(i, rowIndices[i], rowValues[i]);
+            } else {
+                denseRow.assign(numCols, 0);
+                for (size_t j = 0; j < rowIndices[i].size(); ++j)
+                {
+                    denseRow[rowIndices[i][j]] = rowValues[i][j];
+                }
+                myWriter.writeRow(i, denseRow.data());
+            }
+        }
+        myWriter.finish();
+    }
+    
+    bool rowsMatch(CaretSparseFile& myFile, const vector<vector<int64_t> >& rowIndices, const vector<vector<int64_t> >& rowValues)
+    {
+        int64_t numRows = (int64_t)rowIndices.size();
+        vector<char> rowOK(numRows, 0);//one flag per row, so threads never write the same one
+#pragma omp CARET_PARFOR schedule(dynamic)
+        for (int64_t i = 0; i < numRows; ++i)//reads must be safe from multiple threads
+        {
+            vector<int64_t> indices, values;
+            myFile.getRowSparse(i, indices, values);
+            rowOK[i] = (indices == rowIndices[i] && values == rowValues[i]);
+        }
+        return find(rowOK.begin(), rowOK.end(), 0) == rowOK.end();
+    }
+}
+
+void SparseFileTest::execute()
+{
+    const int64_t numCols = 500, numRows = 300;
+    vector<vector<int64_t> > rowIndices(numRows), rowValues(numRows), colIndices(numCols), colValues(numCols);
+    srand(11);
+    for (int64_t i = 0; i < numRows; ++i)
+    {
+        if (i % 7 == 3) continue;//leave some rows empty
+        for (int64_t j = 0; j < numCols; ++j)
+        {
+            if (rand() % 20 != 0) continue;
+            int64_t value = ((int64_t)(rand() % 1000 + 1) << 32) | (rand() % (1<<30));//the shape of encoded fibers
+            if (i % 5 == 0) value = -(rand() % 100 + 1);//negative values must survive the unsigned encoding
+            rowIndices[i].push_back(j);
+            rowValues[i].push_back(value);
+            colIndices[j].push_back(i);
+            colValues[j].push_back(value);
+        }
+    }
+    CiftiXMLOld myXML;
+    myXML.resetRowsToScalars(numCols);//the mapping along a row gives the number of columns
+    myXML.resetColumnsToScalars(numRows);
+    AString baseName = QDir::tempPath() + "/sparse_file_test_" + AString::number(QCoreApplication::applicationPid());
+    AString fileName = baseName + ".wbsparse", compressedName = baseName + "_compressed.wbsparse", unorderedName = baseName + "_unordered.wbsparse";
+    {
+        CaretSparseFileWriter myWriter(fileName, myXML);
+        writeRows(myWriter, rowIndices, rowValues, numCols);
+    }
+    CaretSparseFile myFile(fileName);
+    if (myFile.getVersion() != 1 || myFile.hasColumnIndex())
+    {
+        setFailed("file written with the default format is not version 1 without a column index");
+    }
+    const int64_t* dims = myFile.getDimensions();
+    if (dims[0] != numCols || dims[1] != numRows)
+    {
+        setFailed("dimensions of written file are wrong");
+    }
+    if (!rowsMatch(myFile, rowIndices, rowValues)) setFailed("rows read back from version 1 file do not match what was written");
+    vector<int64_t> denseRow(numCols);
+    myFile.getRow(1, denseRow.data());
+    for (size_t j = 0, k = 0; j < (size_t)numCols; ++j)
+    {
+        int64_t expected = 0;
+        if (k < rowIndices[1].size() && rowIndices[1][k] == (int64_t)j)
+        {
+            expected = rowValues[1][k];
+            ++k;
+        }
+        if (denseRow[j] != expected)
+        {
+            setFailed("dense row read back does not match what was written");
+            break;
+        }
+    }
+    try
+    {
+        CaretSparseFileWriter myWriter(compressedName, myXML, CaretSparseFileWriter::FORMAT_VERSION_1, true);
+        setFailed("writer accepted a column index for a version 1 file");
+    } catch (DataFileException&) {
+    }
+    {
+        CaretSparseFileWriter myWriter(compressedName, myXML, CaretSparseFileWriter::FORMAT_VERSION_2, true);
+        writeRows(myWriter, rowIndices, rowValues, numCols);
+    }
+    CaretSparseFile compressedFile(compressedName);
+    if (compressedFile.getVersion() != 2 || !compressedFile.hasColumnIndex())
+    {
+        setFailed("written file is not the compressed format with a column index");
+    }
+    if (!rowsMatch(compressedFile, rowIndices, rowValues)) setFailed("rows read back from version 2 file do not match what was written");
+    vector<char> columnOK(numCols, 0);
+#pragma omp CARET_PARFOR schedule(dynamic)
+    for (int64_t j = 0; j < numCols; ++j)
+    {
+        vector<int64_t> indices, values;
+        compressedFile.getColumnSparse(j, indices, values);
+        columnOK[j] = (indices == colIndices[j] && values == colValues[j]);
+    }
+    if (find(columnOK.begin(), columnOK.end(), 0) != columnOK.end()) setFailed("columns read back do not match what was written");
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        CaretSparseFileWriter::Format myFormat = (pass == 0 ? CaretSparseFileWriter::FORMAT_VERSION_1 : CaretSparseFileWriter::FORMAT_VERSION_2);
+        {
+            CaretSparseFileUnorderedWriter myWriter(unorderedName, myXML, myFormat);
+#pragma omp CARET_PARFOR schedule(dynamic)
+            for (int64_t i = numRows - 1; i >= 0; --i)//any order, from any thread
+            {
+                if (!rowIndices[i].empty()) myWriter.writeRowSparse(i, rowIndices[i], rowValues[i]);
+            }
+            myWriter.finish();
+        }
+        CaretSparseFile unorderedFile(unorderedName);
+        if (unorderedFile.getVersion() != (int)myFormat) setFailed("file written out of order has the wrong version");
+        if (!rowsMatch(unorderedFile, rowIndices, rowValues)) setFailed("rows written out of order do not match when read back");
+    }
+    QFile::remove(fileName);
+    QFile::remove(compressedName);
+    QFile::remove(unorderedName);
+}
@@ -0,0 +1,335 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+#include "WeightOperatorFileTest.h"
+
+#include "AlgorithmException.h"
+#include "AlgorithmVolumeToSurfaceMapping.h"
+#include "MetricFile.h"
+#include "MetricSmoothingObject.h"
+#include "SurfaceFile.h"
+#include "VolumeFile.h"
+#include "WeightOperatorFile.h"
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+
+#include <cmath>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    void makeGrid(SurfaceFile& mySurf, const int& gridSize, const float& height)
+    {//flat sheet of nodes 1mm apart, slightly wavy so no two triangles are identical
+        mySurf.setNumberOfNodesAndTriangles(gridSize * gridSize, 2 * (gridSize - 1) * (gridSize - 1));
+        for (int j = 0; j < gridSize; ++j)
+        {
+            for (int i = 0; i < gridSize; ++i)
+            {
+                float coord[3] = { i + 1.0f, j + 1.0f, height + 0.1f * sin(0.3f * i) };
+                mySurf.setCoordinate(i + gridSize * j, coord);
+            }
+        }
+        int tile = 0;
+        for (int j = 0; j < gridSize - 1; ++j)
+        {
+            for (int i = 0; i < gridSize - 1; ++i)
+            {
+                int32_t base = i + gridSize * j;
+                int32_t tri1[3] = { base, base + 1, base + gridSize + 1 };
+                int32_t tri2[3] = { base, base + gridSize + 1, base + gridSize };
+                mySurf.setTriangle(tile++, tri1);
+                mySurf.setTriangle(tile++, tri2);
+            }
+        }
+        mySurf.setStructure(StructureEnum::CORTEX_LEFT);
+    }
+    
+    bool sameValues(const MetricFile& first, const MetricFile& second)
+    {
+        if (first.getNumberOfNodes() != second.getNumberOfNodes() || first.getNumberOfColumns() != second.getNumberOfColumns()) return false;
+        for (int c = 0; c < first.getNumberOfColumns(); ++c)
+        {
+            const float* firstData = first.getValuePointerForColumn(c), *secondData = second.getValuePointerForColumn(c);
+            for (int i = 0; i < first.getNumberOfNodes(); ++i)
+            {
+                if (firstData[i] != secondData[i]) return false;
+            }
+        }
+        return true;
+    }
+}
+
+WeightOperatorFileTest::WeightOperatorFileTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void WeightOperatorFileTest::execute()
+{
+    m_dirName = QDir::tempPath() + "/weight_operator_file_test_" + AString::number(QCoreApplication::applicationPid());
+    if (!QDir().mkpath(m_dirName))
+    {
+        setFailed("failed to create directory '" + m_dirName + "'");
+        return;
+    }
+    testRoundTrip();
+    if (!failed()) testSmoothingCache();
+    if (!failed()) testRibbonWeights();
+    QDir myDir(m_dirName);
+    QStringList myFiles = myDir.entryList(QDir::Files);
+    for (int i = 0; i < myFiles.size(); ++i)
+    {
+        myDir.remove(myFiles[i]);
+    }
+    QDir().rmdir(m_dirName);
+}
+
+void WeightOperatorFileTest::testRoundTrip()
+{
+    const int64_t numEntries = 300000;
+    vector<int64_t> rowStart(numEntries / 3 + 1);
+    vector<float> weights(numEntries);
+    for (int64_t i = 0; i < (int64_t)rowStart.size(); ++i)
+    {
+        rowStart[i] = i * 3;
+    }
+    for (int64_t i = 0; i < numEntries; ++i)
+    {
+        weights[i] = 1.0f / (i + 1);
+    }
+    AString fileName = m_dirName + "/roundtrip.weights";
+    {
+        WeightOperatorFile myFile;
+        if (!myFile.openWrite(fileName, "WBTEST01"))
+        {
+            setFailed("failed to open '" + fileName + "' for writing");
+            return;
+        }
+        myFile.getStream() << AString("testkey").toAscii() << (qint64)numEntries;
+        myFile.writeByteOrderCheck();
+        myFile.writeRawData(rowStart.data(), sizeof(int64_t) * rowStart.size());
+        myFile.writeRawData(weights.data(), sizeof(float) * numEntries);
+        if (!myFile.finishWrite())
+        {
+            setFailed("failed to finish writing '" + fileName + "'");
+            return;
+        }
+    }
+    if (QDir(m_dirName).entryList(QDir::Files).size() != 1)
+    {
+        setFailed("temporary file was left behind after writing");
+    }
+    {
+        WeightOperatorFile myFile;
+        if (myFile.openRead(fileName, "WBOTHR01"))
+        {
+            setFailed("file opened with the wrong magic string");
+        }
+    }
+    vector<int64_t> rowStartIn(rowStart.size());
+    vector<float> weightsIn(numEntries);
+    {
+        WeightOperatorFile myFile;
+        if (!myFile.openRead(fileName, "WBTEST01"))
+        {
+            setFailed("failed to open '" + fileName + "' for reading");
+            return;
+        }
+        QByteArray key;
+        qint64 numEntriesIn = 0;
+        myFile.getStream() >> key >> numEntriesIn;
+        if (AString(key) != "testkey" || numEntriesIn != numEntries)
+        {
+            setFailed("header fields did not survive the round trip");
+            return;
+        }
+        if (!myFile.readByteOrderCheck())
+        {
+            setFailed("byte order check failed on the machine that wrote the file");
+            return;
+        }
+        if (!myFile.readRawData(rowStartIn.data(), sizeof(int64_t) * rowStartIn.size()) ||
+            !myFile.readRawData(weightsIn.data(), sizeof(float) * numEntries))
+        {
+            setFailed("failed to read arrays back");
+            return;
+        }
+        char extra;
+        if (myFile.readRawData(&extra, 1))
+        {
+            setFailed("read past the end of the arrays");
+        }
+    }
+    if (rowStartIn != rowStart || weightsIn != weights)
+    {
+        setFailed("arrays did not survive the round trip");
+    }
+    {
+        QFile truncateFile(fileName);
+        truncateFile.resize(truncateFile.size() - 100);
+        WeightOperatorFile myFile;
+        QByteArray key;
+        qint64 numEntriesIn = 0;
+        if (!myFile.openRead(fileName, "WBTEST01"))
+        {
+            setFailed("failed to open truncated file");
+            return;
+        }
+        myFile.getStream() >> key >> numEntriesIn;
+        if (!myFile.readByteOrderCheck() || !myFile.readRawData(rowStartIn.data(), sizeof(int64_t) * rowStartIn.size()))
+        {
+            setFailed("failed to read the intact part of a truncated file");
+        }
+        if (myFile.readRawData(weightsIn.data(), sizeof(float) * numEntries))
+        {
+            setFailed("truncated arrays were reported as complete");
+        }
+    }
+}
+
+void WeightOperatorFileTest::testSmoothingCache()
+{//weights loaded from the cache must smooth exactly like freshly computed ones
+    SurfaceFile mySurf;
+    makeGrid(mySurf, 40, 0.0f);
+    const int numNodes = mySurf.getNumberOfNodes(), numColumns = 3;
+    const float kernel = 2.0f;
+    MetricFile myInput;
+    myInput.setNumberOfNodesAndColumns(numNodes, numColumns);
+    for (int c = 0; c < numColumns; ++c)
+    {
+        for (int i = 0; i < numNodes; ++i)
+        {
+            myInput.setValue(i, c, sin(0.1f * i + c) + c);
+        }
+    }
+    MetricFile freshOut, writtenOut, readOut, recomputedOut;
+    {
+        MetricSmoothingObject mySmooth(&mySurf, kernel);
+        mySmooth.smoothMetric(&myInput, &freshOut);
+    }
+    AString cacheName = m_dirName + "/" + MetricSmoothingObject::getWeightCacheKey(&mySurf, kernel) + ".wbsmooth";
+    {
+        MetricSmoothingObject mySmooth(&mySurf, kernel, NULL, MetricSmoothingObject::GEO_GAUSS_AREA, m_dirName);
+        mySmooth.smoothMetric(&myInput, &writtenOut);
+    }
+    if (!QFile::exists(cacheName))
+    {
+        setFailed("smoothing weights were not saved as '" + cacheName + "'");
+        return;
+    }
+    {
+        MetricSmoothingObject mySmooth(&mySurf, kernel, NULL, MetricSmoothingObject::GEO_GAUSS_AREA, m_dirName);
+        mySmooth.smoothMetric(&myInput, &readOut);
+    }
+    {
+        QFile truncateFile(cacheName);
+        truncateFile.resize(truncateFile.size() / 2);
+        MetricSmoothingObject mySmooth(&mySurf, kernel, NULL, MetricSmoothingObject::GEO_GAUSS_AREA, m_dirName);
+        mySmooth.smoothMetric(&myInput, &recomputedOut);
+    }
+    if (!sameValues(freshOut, writtenOut)) setFailed("smoothing while saving weights differs from smoothing without a cache");
+    if (!sameValues(freshOut, readOut)) setFailed("smoothing with cached weights differs from smoothing without a cache");
+    if (!sameValues(freshOut, recomputedOut)) setFailed("smoothing after a truncated cache file differs from smoothing without a cache");
+}
+
+void WeightOperatorFileTest::testRibbonWeights()
+{//mapping with a saved ribbon weights file must give exactly what mapping from scratch gives
+    const int gridSize = 14;
+    SurfaceFile innerSurf, outerSurf, midSurf;
+    makeGrid(innerSurf, gridSize, 3.2f);
+    makeGrid(outerSurf, gridSize, 6.7f);
+    makeGrid(midSurf, gridSize, 4.9f);
+    vector<int64_t> myDims(4);
+    myDims[0] = gridSize + 2;
+    myDims[1] = gridSize + 2;
+    myDims[2] = 10;
+    myDims[3] = 3;
+    vector<vector<float> > mySform(4, vector<float>(4, 0.0f));
+    for (int i = 0; i < 4; ++i) mySform[i][i] = 1.0f;
+    VolumeFile myVolume, myRoi;
+    myVolume.reinitialize(myDims, mySform);
+    myDims.resize(3);
+    myRoi.reinitialize(myDims, mySform);
+    for (int64_t k = 0; k < myDims[2]; ++k)
+    {
+        for (int64_t j = 0; j < myDims[1]; ++j)
+        {
+            for (int64_t i = 0; i < myDims[0]; ++i)
+            {
+                for (int64_t b = 0; b < 3; ++b)
+                {
+                    myVolume.setValue(sin(0.5f * i + 0.3f * j + 0.7f * k) + b, i, j, k, b);
+                }
+                myRoi.setValue((i + j) % 5 == 0 ? 0.0f : 1.0f, i, j, k);
+            }
+        }
+    }
+    AString weightsName = m_dirName + "/ribbon.weights";
+    MetricFile freshOut, writtenOut, readOut;
+    try
+    {
+        AlgorithmVolumeToSurfaceMapping(NULL, &myVolume, &midSurf, &freshOut, &innerSurf, &outerSurf, &myRoi, 3);
+        AlgorithmVolumeToSurfaceMapping(NULL, &myVolume, &midSurf, &writtenOut, &innerSurf, &outerSurf, &myRoi, 3, -1, -1, NULL, "", weightsName);
+        AlgorithmVolumeToSurfaceMapping(NULL, &myVolume, &midSurf, &readOut, &innerSurf, &outerSurf, &myRoi, 3, -1, -1, NULL, weightsName, "");
+    } catch (CaretException& e) {
+        setFailed("ribbon mapping failed: " + e.whatString());
+        return;
+    }
+    if (!sameValues(freshOut, writtenOut)) setFailed("ribbon mapping while saving weights differs from mapping without a weights file");
+    if (!sameValues(freshOut, readOut)) setFailed("ribbon mapping from a saved weights file differs from mapping without a weights file");
+    bool threw = false;
+    try
+    {//different subdivisions make different weights, so the file must be refused
+        MetricFile mismatchOut;
+        AlgorithmVolumeToSurfaceMapping(NULL, &myVolume, &midSurf, &mismatchOut, &innerSurf, &outerSurf, &myRoi, 4, -1, -1, NULL, weightsName, "");
+    } catch (AlgorithmException&) {
+        threw = true;
+    }
+    if (!threw) setFailed("ribbon weights file was accepted for a different number of subdivisions");
+    {//an entry count larger than the file can hold must be refused before anything is allocated for it
+        QFile myFile(weightsName);
+        if (!myFile.open(QIODevice::ReadWrite))
+        {
+            setFailed("failed to reopen ribbon weights file");
+            return;
+        }
+        QDataStream myStream(&myFile);
+        myStream.setByteOrder(QDataStream::LittleEndian);
+        myStream.skipRawData(WeightOperatorFile::MAGIC_LENGTH);
+        QByteArray storedKey;
+        myStream >> storedKey;
+        myFile.seek(myFile.pos() + 4 * sizeof(qint64));//number of vertices and volume dimensions
+        myStream << ((qint64)1 << 50);
+        myFile.close();
+    }
+    threw = false;
+    try
+    {
+        MetricFile corruptOut;
+        AlgorithmVolumeToSurfaceMapping(NULL, &myVolume, &midSurf, &corruptOut, &innerSurf, &outerSurf, &myRoi, 3, -1, -1, NULL, weightsName, "");
+    } catch (AlgorithmException&) {
+        threw = true;
+    }
+    if (!threw) setFailed("ribbon weights file with an impossible entry count was accepted");
+}
@@ -29,20 +29,31 @@
 #include "CaretCommandLine.h"
 
 //tests
+#include "CiftiCorrelationTest.h"
 #include "CiftiFileTest.h"
+#include "CiftiRowLoaderTest.h"
+#include "CommandDaemonTest.h"
+#include "CommandPipelineTest.h"
+#include "GeodesicHelperTest.h"
+#include "GZipIndexedReaderTest.h"
 #include "HttpTest.h"
 #include "HeapTest.h"
 #include "LookupTest.h"
 #include "MathExpressionTest.h"
 #include "NiftiTest.h"
 #include "NiftiMatrixTest.h"
+#include "ParallelDeflateTest.h"
 #include "PointerTest.h"
 #include "ProgressTest.h"
 #include "QuatTest.h"
+#include "SignedDistanceHelperTest.h"
+#include "SignedDistanceVolumeTest.h"
+#include "SparseFileTest.h"
 #include "StatisticsTest.h"
 #include "TimerTest.h"
 #include "TopologyHelperTest.h"
 #include "VolumeFileTest.h"
+#include "WeightOperatorFileTest.h"
 #include "XnatTest.h"
 
 using namespace std;
@@ -68,7 +79,13 @@ int main(int argc, char** argv)
         }
         SessionManager::createSessionManager();
         vector<TestInterface*> mytests;
+        mytests.push_back(new CiftiCorrelationTest("cifticorrelation"));
         mytests.push_back(new CiftiFileTest("ciftifile"));
+        mytests.push_back(new CiftiRowLoaderTest("ciftirowloader"));
+        mytests.push_back(new CommandDaemonTest("commanddaemon"));
+        mytests.push_back(new CommandPipelineTest("commandpipeline"));
+        mytests.push_back(new GeodesicHelperTest("geohelp"));
+        mytests.push_back(new GZipIndexedReaderTest("gzipindex"));
         mytests.push_back(new HeapTest("heap"));
         mytests.push_back(new HttpTest("http"));
         mytests.push_back(new LookupTest("lookup"));
@@ -76,13 +93,18 @@ int main(int argc, char** argv)
         mytests.push_back(new NiftiFileTest("niftifile"));
         mytests.push_back(new NiftiHeaderTest("niftiheader"));
         mytests.push_back(new NiftiMatrixTest("niftimatrix"));
+        mytests.push_back(new ParallelDeflateTest("paralleldeflate"));
         mytests.push_back(new PointerTest("pointer"));
         mytests.push_back(new ProgressTest("progress"));
         mytests.push_back(new QuatTest("quaternion"));
+        mytests.push_back(new SignedDistanceHelperTest("signeddistancehelper"));
+        mytests.push_back(new SignedDistanceVolumeTest("signeddistance"));
+        mytests.push_back(new SparseFileTest("sparsefile"));
         mytests.push_back(new StatisticsTest("statistics"));
         mytests.push_back(new TimerTest("timer"));
         mytests.push_back(new TopologyHelperTest("topohelp"));
         mytests.push_back(new VolumeFileTest("volumefile"));
+        mytests.push_back(new WeightOperatorFileTest("weightoperatorfile"));
         mytests.push_back(new XnatTest("xnat"));
         if (argc < 2)
         {